@@ -25,9 +25,19 @@ the normal acknowledgement will be sent, incorporating the first two args.
 mode only, and receives a string argument which is the newsgroup name. The
 integer it returns will be sent up to the reader as a score.
 
-   5. A article scorer function. This is called on each 'A' call in pipe mode;
-in background mode it is called on every article. It expects a pointer to
-an article header block.
+   5. A article scorer function. This is called on each 'A' call in pipe mode,
+and on each element of a 'B' (batch) call; in background mode it is called
+on every article, once for each group in its Newsgroups line that is in the
+active file. It expects a pointer to an article header block, and as its
+third argument a pointer to the group the article is being read in (in pipe
+mode, the group last named in an 'N' call, or NULL if that isn't an active
+group). For articles given by overview record rather than by file name, the
+header block holds only Subject, From, Date, Message-ID, References and
+Lines. Its scores go into the cache managed by savescore.c under the
+article's Message-ID and the group's name, since the scorer may apply
+different rules in different groups, and a pipe-mode call for an article
+already in the cache is answered from there without calling it. A
+successful 'P' call empties the cache.
 
    6. A program command processor, called on each 'P'. If it returns
 SUCCEED, OK will be sent up to the reader, otherwise ERROR will be sent.
@@ -76,6 +86,8 @@ optlet  filchar	flag        from      to       type     buf	*/
 };
 
 static char	response[MAXERRSIZE];
+static char	curgroup[BUFLEN];	/* group of the last 'N' call */
+static group_t	*curgp;			/* its active data, if any */
 
 static int bkgdfilt(lang, vers, init, artscore, wrap)
 /* cache selection info for a later pipe run */
@@ -85,14 +97,20 @@ int	(*artscore)();	/* article score */
 void	(*wrap)();	/* wrapup code */
 {
     FILE	*fp;
+    group_t	*gp;
+    char	groups[LBUFLEN], *cp, *np;
 
     if ((*init)(lang, vers, VPROTO) == FAIL)
 	xerror0("startup failure");
+    if (initscore(lang, vers, S_PASS) == FAIL)
+	xerror0("can't open score cache");
 
     (void) hstread(TRUE);
 
     /*
      * Loop through all articles on-line, compiling information on scores.
+     * Rules may be scoped to groups, so an article is scored in each of
+     * its groups, just as a reader would see it there.
      */
     hfree(&header);
     hstrewind();
@@ -101,9 +119,23 @@ void	(*wrap)();	/* wrapup code */
 		&& (fp = fopen(hstfile(hstid()), "r")) != (FILE *)NULL
 		&& (hread(&header, 0L, fp) != 0))
 	{
-	    putscore(header.h_ident, (*artscore)(&header, response));
-	    if (response[0])
-		(void) fprintf(stderr, "%s\n", response);
+	    (void) strncpy(groups, header.h_newsgroups, sizeof(groups) - 1);
+	    groups[sizeof(groups) - 1] = '\0';
+	    for (cp = groups; cp != (char *)NULL; cp = np)
+	    {
+		if ((np = strchr(cp, NGDELIM)) != (char *)NULL)
+		    *np++ = '\0';
+		while (isspace(*cp))
+		    cp++;
+		if ((gp = ngfind(cp)) == (group_t *)NULL)
+		    continue;
+		response[0] = '\0';
+		putscore(header.h_ident, gp->ng_name,
+			 (*artscore)(&header, response, gp));
+		if (response[0])
+		    (void) fprintf(stderr, "%s\n", response);
+	    }
+	    (void) fclose(fp);
 	    hfree(&header);
 	}
 
@@ -111,10 +143,70 @@ void	(*wrap)();	/* wrapup code */
     if (response[0])
 	(void) fprintf(stderr, "%s\n", response);
 
+    wrapscore();
     hstclose();
     return(SUCCEED);
 }
 
+static int artfilt(id, how, what, artscore)
+/* score an article given by file name ("F") or overview record ("O") */
+char	*id;		/* Message-ID, may be empty */
+char	*how, *what;	/* how the article is given, and the file or record */
+int	(*artscore)();	/* article score */
+{
+    FILE	*fp = (FILE *)NULL;
+    int		score;
+
+    if (id[0] && getscore(id, curgroup, &score) == SUCCEED)
+	return(score);
+
+    hfree(&header);
+    if (strcmp(how, "O") == 0)
+    {
+	if (hoverview(&header, what) == FAIL)
+	{
+	    (void) strcpy(response, "Overview record is garbled!");
+	    return(P_IGNORE);
+	}
+	score = (*artscore)(&header, response, curgp);
+	putscore(header.h_ident, curgroup, score);
+	return(score);
+    }
+
+    if (strcmp(how, "F") == 0)
+	fp = fopen(what, "r");
+#ifdef FOO	/* aargh! not *another* potential NNTP connect! */
+    else if (hstseek(id, FALSE) == VALID)
+	fp = fopen(hstfile(), "r");
+    else
+    {
+	(void) strcpy(response, "Couldn't find id in history!");
+	return(P_IGNORE);
+    }
+#endif
+
+    if (fp == (FILE *)NULL)
+    {
+	score = P_IGNORE;
+	(void) strcpy(response, "Article file is missing!");
+    }
+    else
+    {
+	if (hread(&header, 0L, fp) == 0)
+	{
+	    score = P_IGNORE;
+	    (void) strcpy(response, "Header is unreadable!");
+	}
+	else
+	{
+	    score = (*artscore)(&header, response, curgp);
+	    putscore(id[0] ? id : header.h_ident, curgroup, score);
+	}
+	(void) fclose(fp);
+    }
+    return(score);
+}
+
 static int pipefilt(lang, vers, init, nscore, artscore, prog, wrap)
 /* state machine harness for news filter programs */
 char	*lang, *vers;	/* filter ID info */
@@ -124,9 +216,10 @@ int	(*artscore)();	/* article score */
 int	(*prog)();	/* command processor */
 void	(*wrap)();	/* wrapup code */
 {
-    int		seqno = 0, status, score;
+    int		seqno = 0, status, score, i;
     fresp_t	r;
     char	numbuf[10];
+    static fvec_t	batch, scores;
 
     /* we talk to the reader via stdin/stdout */
     fconnect(0, 1);
@@ -148,12 +241,18 @@ void	(*wrap)();	/* wrapup code */
 		return(FAIL);
 	    }
 	    else
+	    {
+		/* failure just means we compute every score */
+		(void) initscore(lang, vers, S_WRITE);
 		status = ftransmit('R', 'V', seqno,
 			  VPROTO, "AHNBPQV","ABEHORV", lang, vers);
+	    }
 	    break;
 
 	case 'N':	/* check newsgroup */
-	    if ((getscore(r.arg1, &score)) == FAIL)
+	    (void) strncpy(curgroup, r.arg1, sizeof(curgroup) - 1);
+	    curgp = ngfind(curgroup);
+	    if ((getscore(r.arg1, (char *)NULL, &score)) == FAIL)
 		score = (*nscore)(r.arg1, response);
 	    if (score == 0)
 		status = ftransmit('R','O', seqno,
@@ -174,40 +273,7 @@ void	(*wrap)();	/* wrapup code */
 	    break;
 
 	case 'A':	/* check article */
-	    if ((getscore(r.arg1, &score)) == FAIL)
-	    {
-		FILE	*fp = (FILE *)NULL;
-
-		if (strcmp(r.arg2, "F") == 0)
-		    fp = fopen(r.arg3, "r");
-#ifdef FOO	/* aargh! not *another* potential NNTP connect! */
-		else if (hstseek(r.arg1, FALSE) == VALID)
-		    fp = fopen(hstfile(), "r");
-		else
-		{
-		    score = P_IGNORE;
-		    (void) strcpy(response, "Couldn't find id in history!");
-		}
-#endif
-
-		if (fp == (FILE *)NULL)
-		{
-		    score = P_IGNORE;
-		    (void) strcpy(response, "Article file is missing!");
-		}
-		else
-		{
-		    hfree(&header);
-		    if (hread(&header, 0L, fp) == 0)
-		    {
-			score = P_IGNORE;
-			(void) strcpy(response, "Header is unreadable!");
-		    }
-		    else
-			score = (*artscore)(&header, response);
-		    (void) fclose(fp);
-		}
-	    }
+	    score = artfilt(r.arg1, r.arg2, r.arg3, artscore);
 	    if (score == 0)
 		status = ftransmit('R','O', seqno,
 				   response[0] ? response : NOARG,
@@ -226,11 +292,33 @@ void	(*wrap)();	/* wrapup code */
 	    }
 	    break;
 
+	case VECTOR:	/* check a batch of articles */
+	    if (fvreceive(&batch) == FAIL)
+		return(FAIL);
+	    fvclear(&scores);
+	    for (i = 0; i < batch.count; i++)
+	    {
+		response[0] = '\0';
+		score = artfilt(fvarg(&batch, i, 0), fvarg(&batch, i, 1),
+				fvarg(&batch, i, 2), artscore);
+		(void) sprintf(numbuf, "%d", score);
+		(void) fvadd(&scores,
+			     (score == 0) ? "O" : ((score < 0) ? "R" : "A"),
+			     numbuf, response);
+	    }
+	    status = fvtransmit(&scores, 'R', VECTOR, seqno);
+	    break;
+
 	case 'P':	/* accept a command for the newsfilter */
 	    if ((*prog)(r.arg1, response) == SUCCEED)
+	    {
+		stalescore();	/* old scores may no longer be right */
+		fvclear(&batch);
+		fvclear(&scores);
 		status = ftransmit('R','O', seqno,
 				   response[0] ? response : NOARG,
 				   NOARG, NOARG, NOARG, NOARG);
+	    }
 	    else
 		status = ftransmit('R','E', seqno,
 				   response[0] ? response : NOARG,
@@ -242,6 +330,7 @@ void	(*wrap)();	/* wrapup code */
 			  response[0] ? response : NOARG,
 			  NOARG, NOARG, NOARG, NOARG);
 	    (*wrap)(response);
+	    wrapscore();
 	    return(SUCCEED);
 
 	default:	/* invalid call */
@@ -4,17 +4,22 @@
 
 /* filter interface functions and the response info pointer from tofilter.c */
 extern int fltinit(), fltarticle(), fltnewsgroup(), fltprogram(), fltbye();
+extern int fltqueue(), fltsend();
 extern char *fltinfo;
 
 /* filter shell, accepts -[pd] options */
 extern int filter();
 
-/* filter implementation frame */
+/* filter implementation frame, and its prefilter text-class hooks */
 extern int lnfilter();
-
-/* score-caching functions for filters */
-extern void initscore(), putscore(), wrapscore();
-extern int getscore();
+extern void lnclasses();
+
+/* score-caching functions for filters and readers */
+#define S_READ	0	/* a reader looking scores up */
+#define S_WRITE	1	/* a pipe-mode filter adding scores as it goes */
+#define S_PASS	2	/* a background filter rescoring every article */
+extern int initscore(), getscore();
+extern void putscore(), stalescore(), wrapscore();
 
 #define NULLSCORER (int (*)())NULL	/* null scoring hook */
 
@@ -9,6 +9,9 @@ SYNOPSIS
    int lnfilter(lang, vers, ainterp, cinterp)	-- implement a filter
    char *lang, *vers; int (*ainterp)(), (*cinterp)();
 
+   void lnclasses(classify, fetch)	-- declare the interpreter's text classes
+   int (*classify)(); char *(*fetch)();
+
 DESCRIPTION
    This module does all routine housekeeping for news filters obeying the
 following conventions:
@@ -42,6 +45,34 @@ called on a group.
    It should return a numeric score. The cumulated score for all commands that
 match will be returned to the reader.
 
+   A kill-file line of the form @pattern (a newsgroup subscription list in the
+usual ngmatch() syntax) makes the commands following it apply only to groups
+matching the pattern, up to the next such line; a bare @ or @all ends the
+scope. Scope lines are kept in the kill file but never passed to the
+interpreter. An article is scored in the group the reader has selected; a
+background run scores it once in each of the groups it is posted to, and
+caches each score under its group.
+
+   Commands are not run blindly on every article. The first time a group is
+scored the command list is compiled into an index of the commands that apply
+to that group, and this is reused until the group changes or a P command adds
+a rule. If the interpreter has called lnclasses() before lnfilter(), the index
+also carries a literal prefilter. The classify hook is called once on the
+parsed text of each command and returns the class of article text its RE is
+matched against (small positive integers less than MAXCLASSES), or 0 if the
+command must always be run. The fetch hook is called with a class and a header
+pointer and returns that text for an article. For each article, each class
+in use is fetched once and scanned once; every command whose RE has a
+required literal (the regmust string regcomp() computes) is bucketed by the
+literal's first two characters, and only those commands whose literal actually
+occurs in the text are handed to the interpreter. Commands with no usable
+literal, or in class 0, are always run. The interpreter must therefore return
+0 for an article whenever its RE fails to match that class of text.
+
+   Each command counts the articles and groups it gave a nonzero score. At
+wrapup time the counts are written beside the kill file, to ~/.<lang>.hits,
+one line per command as count, tab, command; a summary goes in the response.
+
 NOTE
    All the machinery to cache results from background runs should live here
 someday.
@@ -64,9 +95,17 @@ of protecting free redistribution; see the LICENSE file for details.
 #define LDELIM	'/'	/* delimit regular expressions on the left */
 #define RDELIM	'/'	/* delimit regular expressions on the right */
 #define ESCAPE	'\\'	/* can be used to escape the above */
+#define SCOPE	'@'	/* leads a line restricting following commands */
+#define HITSUFX	".hits"	/* suffix of the hit-count file */
+
+#define MAXCLASSES	8	/* text classes an interpreter may declare */
+#define NBUCKETS	256	/* prefilter hash buckets per class (power of 2) */
+#define bigram(s)	((((s)[0] & 0xff) * 31 + ((s)[1] & 0xff)) & (NBUCKETS-1))
 
 static int (*scorehook)();	/* interpreter hook for articles, groups */
 static int (*cmdhook)();	/* interpreter hook for commands */
+static int (*classhook)();	/* interpreter hook classifying commands */
+static char *(*fetchhook)();	/* interpreter hook fetching article text */
 static group_t *cgroup;		/* currently-selected group */
 #ifdef DEBUG
 static int report;		/* use this for debug messages */
@@ -79,23 +118,46 @@ typedef struct
 {
     char	*whole;		/* the entire command */
     regexp	*re;		/* associated regular expression, if any */
-    char	*parsed;	/* command with RE dropped out */
+    char	*parsed;	/* command with RE dropped out, NULL on scopes */
+    char	*scope;		/* groups the command applies to, NULL for all */
+    int		class;		/* class of text the RE is matched against */
+    long	hits;		/* count of nonzero scores from this command */
 }
 cmd_t;
 
-static int ftcread(cmd, fp)
-/* put a command in the list */
+#define isscope(c)	((c)->parsed == (char *)NULL)
+#define command(n)	((cmd_t *)itop(&killcmds, n))
+
+static char	*curscope;	/* scope in effect for the next command parsed */
+
+static void ftcparse(cmd, line)
+/* digest a command line into a command record */
 cmd_t	*cmd;
-FILE	*fp;
+char	*line;
 {
-    char	*p, *q, *r, rebuf[BUFLEN], parsebuf[BUFLEN];
+    char	*p, *q, *r, rebuf[BUFLEN], parsebuf[BUFLEN], wholebuf[BUFLEN];
     int		c, literal = 0;
     bool	buildre = FALSE;
 
+    cmd->hits = 0L;
+    cmd->re = (regexp *)NULL;
+    cmd->class = 0;
+    if (line[0] == SCOPE)
+    {
+	cmd->whole = savestr(line);
+	cmd->parsed = (char *)NULL;
+	if (line[1] == '\0' || strcmp(line + 1, "all") == 0)
+	    curscope = (char *)NULL;
+	else
+	    curscope = cmd->whole + 1;
+	cmd->scope = curscope;
+	return;
+    }
+
     p = parsebuf;
-    q = bfr;
+    q = wholebuf;
     r = rebuf;    
-    while ((c = fgetc(fp)) != '\n' && (c != EOF))
+    while ((c = *line++) != '\0')
     {
 	if (!literal && c == ESCAPE)
 	    literal = 2;
@@ -124,18 +186,35 @@ FILE	*fp;
 	    }
 	}
     }
-    if (feof(fp))
-	return(FAIL);
     *p = '\0';
     *q = '\0';
     *r = '\0';
 
-    cmd->whole = savestr(bfr);
+    cmd->whole = savestr(wholebuf);
     cmd->parsed = savestr(parsebuf);
+    cmd->scope = curscope;
     if (rebuf[0])
 	cmd->re = regcomp(rebuf);
-    else
-	cmd->re = (regexp *)NULL;
+    if (classhook != (int (*)())NULL)
+    {
+	cmd->class = (*classhook)(cmd->parsed);
+	if (cmd->class < 0 || cmd->class >= MAXCLASSES)
+	    cmd->class = 0;
+    }
+}
+
+static int ftcread(cmd, fp)
+/* put a command in the list */
+cmd_t	*cmd;
+FILE	*fp;
+{
+    char	*cp;
+
+    if (fgets(bfr, BUFLEN, fp) == (char *)NULL)
+	return(FAIL);
+    if ((cp = strchr(bfr, '\n')) != (char *)NULL)
+	*cp = '\0';
+    ftcparse(cmd, bfr);
     return(SUCCEED);
 }
 
@@ -145,6 +224,8 @@ cmd_t	*cmd;
 FILE	*fp;
 {
     (void) fputs(cmd->whole, fp);
+    (void) fputc('\n', fp);
+    return(ferror(fp) ? FAIL : SUCCEED);
 }
 
 static dbdef_t killcmds = 
@@ -157,6 +238,119 @@ static dbdef_t killcmds =
     ftcwrite,
 };
 
+/*
+ * Next, the compiled index of the commands that apply to the current group.
+ * Commands are referred to by their position in killcmds. The marks array
+ * says, for each command, whether it is always run (-1) or which article
+ * last passed it through the prefilter.
+ */
+static bool	idxvalid;		/* FALSE if the list changed */
+static group_t	*idxgroup;		/* group the index was built for */
+static int	idxsize;		/* allocated length of the arrays */
+static int	*applies;		/* commands applying to the group */
+static int	napplies;		/* count of same */
+static int	*chain;			/* next command in the same bucket */
+static long	*marks;			/* prefilter marks, see above */
+static long	stamp;			/* count of articles prefiltered */
+static int	heads[MAXCLASSES][NBUCKETS];	/* bucket chain heads */
+static bool	inuse[MAXCLASSES];	/* is this class being prefiltered? */
+
+static void ftindex()
+/* compile the command list into an index for the current group */
+{
+    register cmd_t	*cp;
+    register regexp	*re;
+    int			i, c, b, ncmds = dbatell(&killcmds);
+
+    if (ncmds > idxsize)
+    {
+	idxsize = ncmds + killcmds.chunksize;
+	if (applies == (int *)NULL)
+	{
+	    applies = (int *)malloc((unsigned)(idxsize * sizeof(int)));
+	    chain = (int *)malloc((unsigned)(idxsize * sizeof(int)));
+	    marks = (long *)malloc((unsigned)(idxsize * sizeof(long)));
+	}
+	else
+	{
+	    applies = (int *)realloc((char *)applies,
+				     (unsigned)(idxsize * sizeof(int)));
+	    chain = (int *)realloc((char *)chain,
+				   (unsigned)(idxsize * sizeof(int)));
+	    marks = (long *)realloc((char *)marks,
+				    (unsigned)(idxsize * sizeof(long)));
+	}
+	if (!applies || !chain || !marks)
+	    xerror0("out of memory while indexing kill commands");
+    }
+
+    for (c = 0; c < MAXCLASSES; c++)
+    {
+	inuse[c] = FALSE;
+	for (b = 0; b < NBUCKETS; b++)
+	    heads[c][b] = -1;
+    }
+
+    napplies = 0;
+    for (i = 0; i < ncmds; i++)
+    {
+	cp = command(i);
+	if (isscope(cp))
+	    continue;
+	if (cp->scope != (char *)NULL && (cgroup == (group_t *)NULL
+				|| !ngmatch(cgroup->ng_name, cp->scope)))
+	    continue;
+	applies[napplies++] = i;
+
+	/* bucket it by its required literal, if the interpreter lets us */
+	marks[i] = -1L;
+	re = cp->re;
+	if (fetchhook != (char *(*)())NULL && cp->class > 0
+		&& re != (regexp *)NULL
+		&& re->regmust != (char *)NULL && re->regmlen >= 2)
+	{
+	    b = bigram(re->regmust);
+	    chain[i] = heads[cp->class][b];
+	    heads[cp->class][b] = i;
+	    inuse[cp->class] = TRUE;
+	    marks[i] = 0L;
+	}
+    }
+
+    idxgroup = cgroup;
+    idxvalid = TRUE;
+}
+
+static void ftscan(class, text)
+/* mark the commands of a class whose literals occur in the given text */
+int	class;
+char	*text;
+{
+    register char	*sp;
+    register int	n;
+    register regexp	*re;
+
+    for (sp = text; sp[0] && sp[1]; sp++)
+	for (n = heads[class][bigram(sp)]; n >= 0; n = chain[n])
+	    if (marks[n] != stamp)
+	    {
+		re = command(n)->re;
+		if (strncmp(sp, re->regmust, re->regmlen) == 0)
+		    marks[n] = stamp;
+	    }
+}
+
+static void ftpass(class)
+/* text for a class is unavailable, let all its commands through */
+int	class;
+{
+    register int	b, n;
+
+    for (b = 0; b < NBUCKETS; b++)
+	for (n = heads[class][b]; n >= 0; n = chain[n])
+	    marks[n] = stamp;
+}
+
 /* 
  * Now the filter entry points proper.
  */
@@ -174,11 +368,11 @@ char	*vproto;
     }
 #endif /* DEBUG */
     (void) sprintf(bfr, "%s/.%s", userhome, Progname);
+    curscope = (char *)NULL;
+    idxvalid = FALSE;
+    killcmds.file = savestr(bfr);
     if (exists(bfr))
-    {
-	killcmds.file = savestr(bfr);
 	(void) dbaread(&killcmds);
-    }
 #ifdef DEBUG
     if (debug)
     {
@@ -197,7 +391,8 @@ static int ftgroupscore(name, response)
 char	*name;
 char	*response;
 {
-    int score = 0;
+    register cmd_t	*cp;
+    int			i, s, score = 0;
 
 #ifdef DEBUG
     if (debug)
@@ -210,46 +405,40 @@ char	*response;
 
     if ((cgroup = ngfind(name)) == (group_t *)NULL)
 	return(P_IGNORE);
+    if (!idxvalid || idxgroup != cgroup)
+	ftindex();
 
-    dbarewind(&killcmds);
-    while (dbanext(&killcmds) == SUCCEED)
+    for (i = 0; i < napplies; i++)
     {
-	score += (*scorehook)(cgroup,
-#ifndef lint
-			      ((cmd_t *)killcmds.cp)->re,
-			      ((cmd_t *)killcmds.cp)->parsed,
-#else
-			      (char *)NULL,
-			      (char *)NULL,
-#endif /* lint */
-			      cgroup,
-			      (hdr_t *)NULL);
+	cp = command(applies[i]);
+	if ((s = (*scorehook)(cp->re, cp->parsed, cgroup, (hdr_t *)NULL)) != 0)
+	{
+	    cp->hits++;
+	    score += s;
+	}
 #ifdef DEBUG
 	if (debug)
 	{
 	    (void) sprintf(bfr,
 		       "%s: after \"%s\" score was %d\n",
-		       name,
-#ifndef lint
-		       ((cmd_t *)killcmds.cp)->whole,
-#else
-		       "dummy",
-#endif /* lint */
-		       score);
+		       name, cp->whole, score);
 	    (void) write(report, bfr, (unsigned)strlen(bfr));
 	}
-    }
 #endif /* DEBUG */
+    }
     return(score);
 }
 
 /*ARGSUSED1*/
-static int ftartscore(hp, response)
-/* call scorehook on every command in the list */
+static int ftartscore(hp, response, gp)
+/* call scorehook on every command that applies and passes the prefilter */
 hdr_t   *hp;
 char	*response;
+group_t	*gp;	/* group the article is scored in, NULL if none */
 {
-    int score = 0;
+    register cmd_t	*cp;
+    char		*text;
+    int			i, c, n, s, score = 0;
 
 #ifdef DEBUG
     if (debug)
@@ -260,30 +449,41 @@ char	*response;
     }
 #endif /* DEBUG */
 
-    dbarewind(&killcmds);
-    while (dbanext(&killcmds) == SUCCEED)
+    /* background runs go through the article's groups one by one */
+    cgroup = gp;
+    if (!idxvalid || idxgroup != cgroup)
+	ftindex();
+
+    /* one pass over each class of text marks the candidate commands */
+    ++stamp;
+    for (c = 1; c < MAXCLASSES; c++)
+	if (inuse[c])
+	{
+	    if ((text = (*fetchhook)(c, hp)) != (char *)NULL)
+		ftscan(c, text);
+	    else
+		ftpass(c);
+	}
+
+    for (i = 0; i < napplies; i++)
     {
-#ifndef lint
-	score += (*scorehook)(
-				((cmd_t *)killcmds.cp)->re,
-				((cmd_t *)killcmds.cp)->parsed,
-			        cgroup,
-			        hp);
-#endif /* lint */
+	n = applies[i];
+	if (marks[n] >= 0 && marks[n] != stamp)
+	    continue;
+	cp = command(n);
+	if ((s = (*scorehook)(cp->re, cp->parsed, cgroup, hp)) != 0)
+	{
+	    cp->hits++;
+	    score += s;
+	}
 #ifdef DEBUG
-	    if (debug)
-	    {
-		(void) sprintf(bfr,
-			       "%s: after \"%s\" score was %d\n",
-			       hp->h_ident,
-#ifndef lint
-			       ((cmd_t *)killcmds.cp)->whole,
-#else
-			       "dummy",
-#endif /* lint */
-			       score);
-		(void) write(report, bfr, (unsigned)strlen(bfr));
-	    }
+	if (debug)
+	{
+	    (void) sprintf(bfr,
+			   "%s: after \"%s\" score was %d\n",
+			   hp->h_ident, cp->whole, score);
+	    (void) write(report, bfr, (unsigned)strlen(bfr));
+	}
 #endif /* DEBUG */
     }
     return(score);
@@ -294,25 +494,62 @@ static int ftprogram(cmd, response)
 /* enter a command */
 char	*cmd, *response;
 {
+    cmd_t	*cp;
+
 #ifdef DEBUG
     if (debug)
     {
-	(void) sprintf(bfr, "lnfilter (%s): ftprogram()\n", Progname, cmd);
+	(void) sprintf(bfr, "lnfilter (%s): ftprogram(%s)\n", Progname, cmd);
 	(void) write(report, bfr, (unsigned)strlen(bfr));
     }
 #endif /* DEBUG */
-    if ((*cmdhook)(bfr, cmd) == FAIL)
+    if (cmd[0] != SCOPE && (*cmdhook)(bfr, cmd) == FAIL)
+    {
 	(void) strcpy(response, "Command no good.");
+	return(FAIL);
+    }
+    else if ((cp = (cmd_t *)dballoc(&killcmds)) == (cmd_t *)NULL)
+    {
+	(void) strcpy(response, "No room for command.");
+	return(FAIL);
+    }
     else
     {
+	ftcparse(cp, cmd[0] == SCOPE ? cmd : bfr);
+	idxvalid = FALSE;
 	(void) strcpy(response, "Command O.K.");
-	dbaenter(&killcmds, bfr);
+	return(SUCCEED);
     }
 }
 
+static int fthits()
+/* write the per-command hit counts beside the kill file */
+{
+    register cmd_t	*cp;
+    FILE		*fp;
+    int			i, nhit = 0;
+
+    (void) sprintf(bfr, "%s/.%s%s", userhome, Progname, HITSUFX);
+    if ((fp = fopen(bfr, "w")) == (FILE *)NULL)
+	return(FAIL);
+    for (i = 0; i < dbatell(&killcmds); i++)
+    {
+	cp = command(i);
+	if (isscope(cp))
+	    continue;
+	if (cp->hits)
+	    nhit++;
+	(void) fprintf(fp, "%ld\t%s\n", cp->hits, cp->whole);
+    }
+    (void) fclose(fp);
+    return(nhit);
+}
+
 static void ftwrapup(response)
 char	*response;
 {
+    int	nhit;
+
 #ifdef DEBUG
     if (debug)
     {
@@ -322,7 +559,22 @@ char	*response;
 	(void) close(report);
     }
 #endif /* DEBUG */
-    dbawrite(&killcmds);
+    if (killcmds.file != (char *)NULL && dbatell(&killcmds) > 0)
+    {
+	dbawrite(&killcmds);
+	if ((nhit = fthits()) != FAIL)
+	    (void) sprintf(response, "%d commands hit, counts in ~/.%s%s",
+			   nhit, Progname, HITSUFX);
+    }
+}
+
+void lnclasses(classify, fetch)
+/* declare the text classes the interpreter matches against */
+int	(*classify)();
+char	*(*fetch)();
+{
+    classhook = classify;
+    fetchhook = fetch;
 }
 
 int lnfilter(lang, vers, score, cmdproc, argc, argv)
@@ -350,7 +602,8 @@ regexp	*re;	/* compiled RE from pattern part of command */
 group_t	*gp;	/* group data pointer fror group */
 hdr_t	*hp;	/* header of article to be scored */
 {
-    if (re != (regexp *)NULL && regexec(re, hp->h_subject))
+    if (hp != (hdr_t *)NULL
+		&& re != (regexp *)NULL && regexec(re, hp->h_subject))
     {
 	(void) fprintf(stdout,
 		       "lnfilter (%s): match triggers command %s\n",
@@ -361,6 +614,23 @@ hdr_t	*hp;	/* header of article to be scored */
 	return(0);
 }
 
+/*ARGSUSED*/
+static int classify(cmd)
+/* every RE in the tester is matched against the subject */
+char	*cmd;
+{
+    return(1);
+}
+
+/*ARGSUSED*/
+static char *fetch(class, hp)
+/* so that's what the prefilter should scan */
+int	class;
+hdr_t	*hp;
+{
+    return(hp->h_subject);
+}
+
 main(argc, argv)
 /* filter-testing code */
 int	argc;
@@ -375,6 +645,7 @@ char	*argv[];
 
     scorehook = score;
     cmdhook = (int(*)())strcpy;
+    lnclasses(classify, fetch);
 
     (void) printf("Welcome to the standard filter tester\n");
     while (fputs("> ", stdout), fgets(cmdline, BUFSIZ, stdin) != (char *)NULL)
@@ -385,6 +656,7 @@ char	*argv[];
 	    (void) printf("a id file  -- return score of article\n");
 	    (void) printf("g grp      -- return score of group\n");
 	    (void) printf("p command  -- enter filtering commmand\n");
+	    (void) printf("h          -- show per-command hit counts\n");
 #ifdef DEBUG
 	    (void) printf("D level    -- set debug level\n");
 #endif /* DEBUG */
@@ -429,11 +701,20 @@ char	*argv[];
 			   ftgroupscore(strv, (char *)NULL));
 	else if (sscanf(cmdline, "p %s", strv) == 1)
 	{
-	    if (ftprogram(strv) != FAIL)
+	    if (ftprogram(strv, strv2) != FAIL)
 		(void) fprintf(stdout, "Filter command accepted\n");
 	    else
 		(void) fprintf(stdout, "Filter command rejected\n");
 	}
+	else if (cmdline[0] == 'h')
+	{
+	    int	i;
+
+	    for (i = 0; i < dbatell(&killcmds); i++)
+		if (!isscope(command(i)))
+		    (void) fprintf(stdout, "%6ld  %s\n",
+				   command(i)->hits, command(i)->whole);
+	}
 #ifdef DEBUG
 	else if (sscanf(cmdline, "D %d", &level) == 1)
 	    debug = level;
@@ -443,7 +724,9 @@ char	*argv[];
 	else
 	    (void) fprintf(stdout, "Illegal command\n");
     }
-    ftwrapup("Wrapup executed");
+    (void) strcpy(strv2, "Wrapup executed");
+    ftwrapup(strv2);
+    (void) fprintf(stdout, "%s\n", strv2);
 }
 #endif /* MAIN */
 
@@ -6,15 +6,18 @@ NAME
 SYNOPSIS
    #include "libfilt.h"
 
-   void initscore()			-- initialize article score cacheing
+   int initscore(name, vers, mode)	-- initialize article score cacheing
+   char *name, *vers; int mode;
 
-   void putscore(id)			-- store a score
-   char *id;
+   void putscore(id, group, score)	-- store a score
+   char *id, *group; int score;
 
-   int getscore(id, pscore)		-- retrieve a score
-   char *grp; int *pscore;
+   int getscore(id, group, pscore)	-- retrieve a score
+   char *id, *group; int *pscore;
 
-   void wrapscore()			-- write out altered article file
+   void stalescore()			-- forget all stored scores
+
+   void wrapscore()			-- finish with the cache file
 
 DESCRIPTION
    These functions are used to put article and group scores from a background-
@@ -25,6 +28,41 @@ run wants them.
 to shed scores stored for expired articles, otherwise the cache file can
 grow without bound.
 
+   The cache lives in ~/.<name>.scores, where name is the filter language
+name. It is an open-addressed hash table of fixed-size slots, keyed by the
+checkstring() hash of the Message-ID and the name of the group the article
+was scored in, behind a header holding the version string of the filter that
+wrote it. The group is part of the key because a filter's rules may be
+scoped to particular groups (see the @ lines in lnfilter.c), so one article
+may score differently in each group it is crossposted to; a NULL or empty
+group means the article was scored with no group selected. On systems with mmap(2) (MMAP defined)
+the file is mapped shared, so a reader sees scores as soon as its filter
+child stores them; elsewhere each access is an lseek() and a read().
+
+   The initscore() function opens the cache. If the mode is S_READ (what a
+newsreader uses) it returns FAIL when there is no cache file; lookups fail
+until a filter with the given version stamp has written the file. In the
+S_WRITE and S_PASS modes (pipe-mode and background filters) a missing cache,
+or one written by a filter of a different version, is replaced by an empty
+one. Message-IDs and group names of NAMELEN or more characters are never
+cached.
+
+   Each slot is stamped with a generation number and with the number of the
+background pass that stored it. The stalescore() function, called when the
+filter is reprogrammed, bumps the generation and so invalidates every score
+at once. Each S_PASS run bumps the pass number and rescores every article in
+the history file; its wrapscore() then declares everything stored before
+that pass stale. Scores for articles that have expired are never refreshed,
+so they drop out. Stale slots are reused in place by later putscore() calls;
+the file is rewritten only when it has to grow.
+
+BUGS
+   There is no locking. Two filters writing the same cache at once may
+leave a slot with a mixed-up score, which lasts until the next background
+pass or reprogramming.
+   Hand edits of a filter's program are not noticed until the next background
+pass; a 'P' request through the filter protocol takes effect at once.
+
 AUTHOR
    This software is Copyright (C) 1989 by Eric S. Raymond for the sole purpose
 of protecting free redistribution; see the LICENSE file for details.
@@ -35,36 +73,398 @@ of protecting free redistribution; see the LICENSE file for details.
 #include "active.h"
 #include "libfilt.h"
 
-void initscore()
-/* initialize score cacheing */
+#define SCOREMAGIC	0x53634f32L	/* identifies a score cache file */
+#define SCORESUFX	".scores"	/* suffix of the score cache file */
+#define SCORESLOTS	1024	/* least table size, must be a power of 2 */
+#define VERSLEN		SBUFLEN	/* room for a filter version stamp */
+
+typedef struct
+{
+    long	magic;		/* always SCOREMAGIC */
+    char	vers[VERSLEN];	/* version of the filter that wrote the file */
+    long	nslots;		/* size of hash table, a power of 2 */
+    long	nused;		/* slots ever filled, live or stale */
+    long	gen;		/* bumped when the filter is reprogrammed */
+    long	pass;		/* bumped when a background pass starts */
+    long	live;		/* oldest pass whose scores are still good */
+    int		replaced;	/* TRUE once a bigger copy has been renamed in */
+}
+schead_t;
+
+typedef struct
+{
+    ulong	hash;		/* checkstring() of the Message-ID and group */
+    long	gen;		/* generation the score was computed in */
+    long	pass;		/* background pass that stored it */
+    int		score;		/* the score itself */
+    char	id[NAMELEN];	/* the Message-ID; empty if slot never used */
+    char	group[NAMELEN];	/* the group it was scored in, may be empty */
+}
+scslot_t;
+
+#define SCOFF(n)	((off_t)sizeof(schead_t) + (off_t)(n)*sizeof(scslot_t))
+#define scstale(hp, sp)	((sp)->gen != (hp)->gen || (sp)->pass < (hp)->live)
+#define scmatch(sp, h, i, g)	((sp)->hash == (h) \
+				 && strcmp((sp)->id, i) == 0 \
+				 && strcmp((sp)->group, g) == 0)
+
+private char	scfile[BUFLEN];		/* name of the cache file */
+private char	scvers[VERSLEN];	/* version stamp we expect */
+private int	scmode;			/* S_READ, S_WRITE or S_PASS */
+private int	scfd = FAIL;		/* open cache file, if any */
+#ifdef MMAP
+private char	*scbase;		/* where it is mapped */
+private off_t	scsize;			/* how much of it is mapped */
+#else
+private schead_t	schbuf;		/* the header, as last read */
+private scslot_t	scsbuf;		/* the slot, as last read */
+#endif /* MMAP */
+
+private schead_t *schdr()
+/* get the cache header */
+{
+#ifdef MMAP
+    return((schead_t *)scbase);
+#else
+    (void) lseek(scfd, (off_t)0, SEEK_SET);
+    if (read(scfd, (char *)&schbuf, sizeof(schead_t)) != sizeof(schead_t))
+	schbuf.magic = 0L;
+    return(&schbuf);
+#endif /* MMAP */
+}
+
+private void schput()
+/* write back an altered cache header */
+{
+#ifndef MMAP
+    (void) lseek(scfd, (off_t)0, SEEK_SET);
+    (void) write(scfd, (char *)&schbuf, sizeof(schead_t));
+#endif /* MMAP */
+}
+
+private scslot_t *scget(n)
+/* get a slot of the cache */
+long	n;
 {
-    /* do nothing, we're not ready to do real cacheing yet */
+#ifdef MMAP
+    return((scslot_t *)(scbase + sizeof(schead_t)) + n);
+#else
+    (void) lseek(scfd, SCOFF(n), SEEK_SET);
+    if (read(scfd, (char *)&scsbuf, sizeof(scslot_t)) != sizeof(scslot_t))
+	scsbuf.id[0] = '\0';
+    return(&scsbuf);
+#endif /* MMAP */
 }
 
 /*ARGSUSED0*/
-void putscore(id, score)
-/* cache priority score for given article */
+private void scput(n)
+/* write back the slot last fetched with scget() */
+long	n;
+{
+#ifndef MMAP
+    (void) lseek(scfd, SCOFF(n), SEEK_SET);
+    (void) write(scfd, (char *)&scsbuf, sizeof(scslot_t));
+#endif /* MMAP */
+}
+
+private void scclose()
+/* drop our connection to the cache file */
+{
+    if (scfd == FAIL)
+	return;
+#ifdef MMAP
+    if (scbase != (char *)NULL)
+	(void) munmap(scbase, (size_t)scsize);
+    scbase = (char *)NULL;
+#endif /* MMAP */
+    (void) close(scfd);
+    scfd = FAIL;
+}
+
+private int scopen()
+/* open the cache file and check its header */
+{
+    struct stat	st;
+    schead_t	*hp;
+
+    if ((scfd = open(scfile, scmode == S_READ ? O_RDONLY : O_RDWR)) == FAIL)
+	return(FAIL);
+    if (fstat(scfd, &st) == FAIL || st.st_size < sizeof(schead_t))
+    {
+	scclose();
+	return(FAIL);
+    }
+#ifdef MMAP
+    scsize = st.st_size;
+    scbase = (char *)mmap((caddr_t)NULL, (size_t)scsize,
+		  scmode == S_READ ? PROT_READ : PROT_READ | PROT_WRITE,
+		  MAP_SHARED, scfd, (off_t)0);
+    if (scbase == (char *)-1)
+    {
+	scbase = (char *)NULL;
+	scclose();
+	return(FAIL);
+    }
+#endif /* MMAP */
+    hp = schdr();
+    if (hp->magic != SCOREMAGIC || st.st_size != SCOFF(hp->nslots))
+    {
+	scclose();
+	return(FAIL);
+    }
+    return(SUCCEED);
+}
+
+private int scbuild(keep)
+/* write a new cache file, holding the live scores of the old one if keep */
+bool	keep;
+{
+    schead_t		head, *hp;
+    register scslot_t	*table, *sp;
+    register long	n, i;
+    long		nlive = 0;
+    char		tfile[BUFLEN];
+    FILE		*fp;
+
+    (void) bzero((char *)&head, sizeof(schead_t));
+    head.magic = SCOREMAGIC;
+    (void) strcpy(head.vers, scvers);
+    head.gen = head.pass = head.live = 1L;
+    if (keep)
+    {
+	hp = schdr();
+	head.gen = hp->gen;
+	head.pass = hp->pass;
+	head.live = hp->live;
+	for (n = 0; n < hp->nslots; n++)
+	    if ((sp = scget(n))->id[0] && !scstale(hp, sp))
+		nlive++;
+    }
+    for (head.nslots = SCORESLOTS; nlive * 2 >= head.nslots; head.nslots *= 2)
+	continue;
+
+    if ((table = (scslot_t *)calloc((unsigned)head.nslots,
+				    sizeof(scslot_t))) == (scslot_t *)NULL)
+	return(FAIL);
+    if (keep)
+	for (n = 0; n < hp->nslots; n++)
+	{
+	    if (!(sp = scget(n))->id[0] || scstale(hp, sp))
+		continue;
+	    for (i = sp->hash & (head.nslots - 1);
+		 table[i].id[0];
+		 i = (i + 1) & (head.nslots - 1))
+		continue;
+	    table[i] = *sp;
+	    head.nused++;
+	}
+
+    /* build it beside the old one, then swap it in */
+    (void) sprintf(tfile, "%s~", scfile);
+    if ((fp = fopen(tfile, "w")) == (FILE *)NULL)
+    {
+	(void) free((char *)table);
+	return(FAIL);
+    }
+    (void) fwrite((char *)&head, sizeof(schead_t), 1, fp);
+    (void) fwrite((char *)table, sizeof(scslot_t), (int)head.nslots, fp);
+    (void) free((char *)table);
+    if (fclose(fp) == EOF || rename(tfile, scfile) == FAIL)
+    {
+	(void) unlink(tfile);
+	return(FAIL);
+    }
+
+    /* tell anyone else using the old copy to go look at the new one */
+    if (scfd != FAIL)
+    {
+	hp = schdr();
+	hp->replaced = TRUE;
+	schput();
+	scclose();
+    }
+    return(scopen());
+}
+
+private schead_t *schecked()
+/* get the cache header if the cache is usable */
+{
+    schead_t	*hp;
+
+    if (scfd == FAIL)
+	return((schead_t *)NULL);
+    if ((hp = schdr())->replaced)
+    {
+	scclose();
+	if (scopen() == FAIL)
+	    return((schead_t *)NULL);
+	hp = schdr();
+    }
+    if (strcmp(hp->vers, scvers))
+	return((schead_t *)NULL);
+    return(hp);
+}
+
+int initscore(name, vers, mode)
+/* initialize score cacheing */
+char	*name;	/* filter language name */
+char	*vers;	/* filter version stamp */
+int	mode;	/* S_READ, S_WRITE or S_PASS */
+{
+    schead_t	*hp;
+
+    scclose();
+    (void) sprintf(scfile, "%s/.%s%s", userhome, name, SCORESUFX);
+    (void) strncpy(scvers, vers, VERSLEN - 1);
+    scvers[VERSLEN - 1] = '\0';
+    scmode = mode;
+
+    if (scopen() == FAIL)
+    {
+	if (mode == S_READ || scbuild(FALSE) == FAIL)
+	    return(FAIL);
+    }
+    else if (mode != S_READ && strcmp(schdr()->vers, scvers))
+    {
+	/* written by some other version of the filter, start over */
+	if (scbuild(FALSE) == FAIL)
+	    return(FAIL);
+    }
+
+    if (mode == S_PASS)
+    {
+	hp = schdr();
+	hp->pass++;
+	schput();
+    }
+    return(SUCCEED);
+}
+
+private ulong schash(id, group)
+/* hash an article's key in the cache */
+char	*id, *group;
+{
+    return(checkstring(group, checkstring(id, (ulong)0L)));
+}
+
+void putscore(id, group, score)
+/* cache priority score for given article in a given group */
 char	*id;
+char	*group;	/* group it was scored in, NULL if none */
 int	score;
 {
-    /* do nothing, we're not ready to do real cacheing yet */
+    register schead_t	*hp;
+    register scslot_t	*sp;
+    register long	n, i;
+    long		slot = -1L;
+    ulong		hash;
+
+    if (group == (char *)NULL)
+	group = "";
+    if (scmode == S_READ || strlen(id) >= NAMELEN || strlen(group) >= NAMELEN)
+	return;
+    if ((hp = schecked()) == (schead_t *)NULL)
+	return;
+    if (hp->nused >= hp->nslots - hp->nslots / 4)
+    {
+	if (scbuild(TRUE) == FAIL)
+	    return;
+	hp = schdr();
+    }
+
+    /* look for the ID, remembering the first stale slot along the way */
+    hash = schash(id, group);
+    for (i = hash & (hp->nslots - 1), n = 0;
+	 n < hp->nslots;
+	 i = (i + 1) & (hp->nslots - 1), n++)
+    {
+	if (!(sp = scget(i))->id[0])
+	    break;
+	if (scmatch(sp, hash, id, group))
+	{
+	    slot = i;
+	    break;
+	}
+	if (slot == -1L && scstale(hp, sp))
+	    slot = i;
+    }
+    if (slot == -1L)
+    {
+	if (n == hp->nslots)
+	    return;		/* can't happen, we grow at 3/4 full */
+	slot = i;
+	hp->nused++;
+	schput();
+    }
+
+    sp = scget(slot);
+    sp->hash = hash;
+    sp->gen = hp->gen;
+    sp->pass = hp->pass;
+    sp->score = score;
+    (void) strcpy(sp->id, id);
+    (void) strcpy(sp->group, group);
+    scput(slot);
 }
 
-/*ARGSUSED0*/
-int getscore(id, pscore)
-/* retrieve priority score for given article */
+int getscore(id, group, pscore)
+/* retrieve priority score for given article in a given group */
 char	*id;
+char	*group;	/* group the reader is in, NULL if none */
 int	*pscore;
 {
-    /* doesn't work yet, force caller to compute score */
+    register schead_t	*hp;
+    register scslot_t	*sp;
+    register long	n, i;
+    ulong		hash;
+
+    if ((hp = schecked()) == (schead_t *)NULL)
+	return(FAIL);
+    if (group == (char *)NULL)
+	group = "";
+
+    hash = schash(id, group);
+    for (i = hash & (hp->nslots - 1), n = 0;
+	 n < hp->nslots;
+	 i = (i + 1) & (hp->nslots - 1), n++)
+    {
+	if (!(sp = scget(i))->id[0])
+	    break;
+	if (scmatch(sp, hash, id, group))
+	{
+	    if (scstale(hp, sp))
+		break;
+	    *pscore = sp->score;
+	    return(SUCCEED);
+	}
+    }
     return(FAIL);
 }
 
+void stalescore()
+/* the filter has been reprogrammed, forget all cached scores */
+{
+    schead_t	*hp;
+
+    if (scmode != S_READ && (hp = schecked()) != (schead_t *)NULL)
+    {
+	hp->gen++;
+	schput();
+    }
+}
+
 void wrapscore()
 /* deinitialize score cacheing */
 {
-    /* do nothing, we're not ready to do real cacheing yet */
+    schead_t	*hp;
+
+    /* a finished background pass sheds everything it didn't rescore */
+    if (scmode == S_PASS && (hp = schecked()) != (schead_t *)NULL)
+    {
+	hp->live = hp->pass;
+	schput();
+    }
+    scclose();
 }
 
 /* savescore.c ends here */
-
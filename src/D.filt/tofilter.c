@@ -17,6 +17,11 @@ SYNOPSIS
    int fltnewsgroup(name)		-- return `interest score' of group
    char *name;
 
+   int fltqueue(id, file, ovrec)	-- add an article to the next batch
+   char *id, *file, *ovrec;
+
+   int fltsend()			-- ship the batch to the filter
+
    int fltprogram(command)		-- program the filter
    char *command;
 
@@ -38,17 +43,33 @@ newsfilter to determine the `interest score' of an article, which it returns.
 If fltinit() failed or the filter process has died it returns a constant value
 of 0. The filename argument is optional; if NULL, the protocol will exchange
 portions of the article over pipes or some other form of IPC to the filter.
+Scores a background filter run (or the filter process itself) has left in the
+score cache (see savescore.c) for the article in the group last passed to
+fltnewsgroup() are returned without talking to the filter.
 
    The fltnewsgroup() function performs a similar service for newsgroups. A
 score of zero designates a newsgroup for which fltarticle() should be called
 individually on each article.
 
+   The fltqueue() and fltsend() functions let a reader get a whole group's
+scores in one exchange rather than one per article. Each fltqueue() call
+adds an article, named either by its file (ovrec NULL, id optional) or by
+an overview record (id is then its Message-ID); it returns FAIL once the
+batch holds MAXBATCH articles or if no filter is running. The fltsend()
+function ships the batch as a single vector frame and returns without
+waiting, so the filter scores while the reader gets on with setting up
+the group. The reply is picked up before the next exchange with the filter,
+and thereafter fltarticle() answers for batched articles without asking
+the filter again. The batch lasts until the next fltqueue() after a send.
+The filter must list 'B' among its accepted requests in its version response.
+
    The fltprogram() function downloads filter-command code to the newsfilter.
 Interpretation of this code is entirely up to the newsfilter, which may conduct
 a query dialogue with the reader (as with the fltarticle() function) to obtain
 portions of the article needed to interpret the command. The filename argument
 is optional; if NULL, the protocol will exchange portions of the article over
-pipes or some other form of IPC to the filter.
+pipes or some other form of IPC to the filter. Any batch queued or answered
+before the call is dropped, so articles in it are scored afresh.
 
    The fltbye() command disconnects from a named filter. If the argument is
 NULL, all filters are dropped.
@@ -80,15 +101,34 @@ of protecting free redistribution; see the LICENSE file for details.
 char	*fltinfo;
 
 static bool filteron = FALSE;
+static bool canbatch = FALSE;	/* does the filter accept vector requests? */
 static fresp_t	resp;
+static int	seqno = 0;
+
+static fvec_t	batch;		/* articles queued or sent in one go */
+static fvec_t	scores;		/* the filter's answers to them */
+static int	batchseq = 0;	/* seqno of the unanswered batch, if any */
+static bool	batchsent;	/* has the batch gone to the filter? */
+static int	batchnext;	/* where to start looking for the next hit */
+static char	curgroup[BUFLEN];	/* group last scored, for the cache */
+
+static void fltcollect()
+/* pick up the filter's answer to a batch */
+{
+    int	seq = fvreceive(&scores);
+
+    if (seq != batchseq || scores.code != VECTOR || scores.count != batch.count)
+	fvclear(&scores);	/* no use to us, everything goes one by one */
+    batchseq = 0;
+}
 
 static int ftransact(type, code, arg1, arg2, arg3, arg4, arg5)
 char	type;
 char	code;
 char	*arg1, *arg2, *arg3, *arg4, *arg5;
 {
-    static int		seqno = 0;
-
+    if (batchseq)
+	fltcollect();
     if (ftransmit(type, code, ++seqno, arg1, arg2, arg3, arg4, arg5)==FAIL)
 	return(FAIL);
     else if (freceive(&resp) == FAIL)
@@ -97,6 +137,17 @@ char	*arg1, *arg2, *arg3, *arg4, *arg5;
 	return(seqno);
 }
 
+static void fltforget()
+/* throw away the batch and any answers to it */
+{
+    if (batchseq)
+	fltcollect();
+    fvclear(&batch);
+    fvclear(&scores);
+    batchsent = FALSE;
+    batchnext = 0;
+}
+
 static catch_t deadkid()
 {
     msg0("Newsfilter process aborted!");
@@ -196,20 +247,94 @@ char	*filt, *flang, *fversion;
     else
     {
 	filteron = TRUE;
+	canbatch = (strchr(resp.arg2, VECTOR) != (char *)NULL);
+	(void) initscore(flang, resp.arg5, S_READ);
 	return(SUCCEED);
     }
 }
 
+static bool fltbatched(id, fn, pscore)
+/* look for an article's score among the answers to the last batch */
+char	*id, *fn;
+int	*pscore;
+{
+    int		i, n;
+    char	*code;
+
+    if (batchseq)
+	fltcollect();
+
+    /* articles are usually asked about in the order they were queued */
+    for (n = 0; n < scores.count; n++)
+    {
+	i = (batchnext + n) % scores.count;
+	if ((id != (char *)NULL && strcmp(fvarg(&batch, i, 0), id) == 0)
+	    || (fn != (char *)NULL
+		&& strcmp(fvarg(&batch, i, 1), "F") == 0
+		&& strcmp(fvarg(&batch, i, 2), fn) == 0))
+	{
+	    batchnext = i + 1;
+	    code = fvarg(&scores, i, 0);
+	    *pscore = (code[0] == 'O') ? 0 : atoi(fvarg(&scores, i, 1));
+	    fltinfo = fvarg(&scores, i, 2);
+	    return(TRUE);
+	}
+    }
+    return(FALSE);
+}
+
+int fltqueue(id, fn, ovrec)
+/* add an article to the batch to be sent */
+char	*id, *fn, *ovrec;
+{
+    if (!filteron || !canbatch)
+	return(FAIL);
+    if (batchseq)
+	fltcollect();
+    if (batchsent)
+	fltforget();
+
+    if (ovrec != (char *)NULL)
+	return(fvadd(&batch, id, "O", ovrec));
+    else
+	return(fvadd(&batch, id ? id : "", "F", fn));
+}
+
+int fltsend()
+/* ship the batch to the filter, don't wait for the answer */
+{
+    if (!filteron || batchsent || batch.count == 0)
+	return(SUCCEED);
+    if (batchseq)
+	fltcollect();
+
+    batchsent = TRUE;
+    if (fvtransmit(&batch, 'C', VECTOR, ++seqno) == FAIL)
+	return(FAIL);
+    batchseq = seqno;
+    return(SUCCEED);
+}
+
 int fltarticle(id, fn)
 /* get an accept-reject status for a given article */
 char	*id, *fn;
 {
+    int	score;
+
     if (!filteron)
     {
 	fltinfo = "";
 	return(0);
     }
 
+    if (fltbatched(id, fn, &score))
+	return(score);
+    if (getscore(id, curgroup, &score) == SUCCEED)
+    {
+	fltinfo = "";
+	return(score);
+    }
+
     (void) ftransact('C','A', id, "F", fn, NOARG, NOARG);
     if (resp.code == 'A' || resp.code == 'R')
     {
@@ -233,6 +358,8 @@ char	*name;
 	return(0);
     }
 
+    /* scoped rules make article scores depend on the group */
+    (void) strncpy(curgroup, name, sizeof(curgroup) - 1);
     (void) ftransact('C', 'N', name, NOARG, NOARG, NOARG, NOARG);
     if (resp.code == 'O')
     {
@@ -258,6 +385,7 @@ char	*command;
 
     (void) ftransact('C', 'P', command, NOARG, NOARG, NOARG, NOARG);
     fltinfo = resp.arg1;
+    fltforget();			/* batched scores may have changed */
     if (resp.code == 'O')		/* everything is OK */
 	return(SUCCEED);
     else
@@ -275,6 +403,7 @@ char	*filtername;
 	return(0);
     }
 
+    wrapscore();
     (void) ftransact('C', 'Q', NOARG, NOARG, NOARG, NOARG, NOARG);
     fltinfo = resp.arg1;
     if (resp.code == 'O')
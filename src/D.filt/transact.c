@@ -15,10 +15,45 @@ SYNOPSIS
    int freceive(response)		-- accept a response
    fresp_t *response;
 
+   void fvclear(vec)			-- empty a vector
+   fvec_t *vec;
+
+   int fvadd(vec, arg1, arg2, arg3)	-- add an element to a vector
+   fvec_t *vec; char *arg1, *arg2, *arg3;
+
+   char *fvarg(vec, i, n)		-- get argument n of element i
+   fvec_t *vec; int i, n;
+
+   int fvtransmit(vec, type, code, seqno)	-- transmit a vector
+   fvec_t *vec; char type, code; int seqno;
+
+   int fvreceive(vec)			-- accept a vector
+   fvec_t *vec;
+
 DESCRIPTION
    This module provides lowest-level primitives for communication from
 a newsreader to a newsfilter child process.
 
+   An ordinary frame is a 14-byte prefix giving the frame type, code,
+sequence number and body length, followed by up to 5 NUL-terminated args.
+A frame whose code is VECTOR instead carries up to MAXBATCH elements, so
+a reader can ask about a whole group's worth of articles in one exchange;
+the length field of its prefix is the element count, and each element is
+a 6-byte length field followed by up to 3 NUL-terminated args. The vector
+is written with a few writev(2) calls (one write(2) per piece without
+WRITEV).
+
+   When freceive() meets the prefix of a vector frame it returns at once with
+the code set to VECTOR, and the caller must then collect the elements with
+fvreceive(). Called without such a pending prefix, fvreceive() reads a whole
+frame itself; if that turns out to be an ordinary frame (an error response,
+say) its args come back as a single element.
+
+   The fvadd() function returns FAIL if the vector is full or if there is no
+room to grow it. Arguments past the end of an element read as empty
+strings. An fvec_t must start out zeroed; it keeps its buffer across
+fvclear() calls.
+
 AUTHOR
    Eric S. Raymond, from a protocol spec developed with Brad Templeton.
    This software is Copyright (C) 1989 by Eric S. Raymond for the sole purpose
@@ -32,7 +67,16 @@ of protecting free redistribution; see the LICENSE file for details.
 /* length of fixed-size article header (counting terminating NUL) */
 #define PREFIXLEN	14
 
+/* length of the element length fields in a vector frame */
+#define ELEMLEN		6
+
+/* most iovecs to hand to one writev() call; old systems allow only 16 */
+#define FTIOVMAX	16
+
 static int	ifd, ofd;	/* comm file descriptors */
+static int	fvseq = FAIL;	/* seqno of a vector frame freceive() met */
+static char	fvtype;		/* and its type... */
+static unsigned	fvcount;	/* ...and element count */
 
 void fconnect(fd1, fd2)
 int	fd1, fd2;
@@ -92,24 +136,45 @@ char	*arg1, *arg2, *arg3, *arg4, *arg5;
     return(SUCCEED);
 }
 
-int freceive(rp)
-fresp_t	*rp;
+static int frprefix(buf, ptype, pcode, plen)
+/* read and crack a frame prefix, returning its sequence number */
+char		*buf;
+char		*ptype, *pcode;
+unsigned	*plen;
 {
     int	seq = FAIL;
-    unsigned int len = 0;
 
-    rp->buf[0] = '\0';
+    *plen = 0;
     errno = 0;
-    if (read(ifd, rp->buf, PREFIXLEN) != PREFIXLEN)
+    if (read(ifd, buf, PREFIXLEN) != PREFIXLEN)
 	return(FAIL);
 #ifdef PDEBUG
     (void) fprintf(stderr, "%s: received \"%s\" (%d bytes), errno = %d\n",
-		   Progname, rp->buf, strlen(rp->buf), errno);
+		   Progname, buf, strlen(buf), errno);
 #endif /*PDEBUG */
-    (void) sscanf(rp->buf, "%c%c %d %u", &rp->type, &rp->code, &seq, &len);
+    (void) sscanf(buf, "%c%c %d %u", ptype, pcode, &seq, plen);
+    return(seq);
+}
+
+int freceive(rp)
+fresp_t	*rp;
+{
+    int	seq = FAIL;
+    unsigned int len = 0;
+
+    rp->buf[0] = '\0';
+    if ((seq = frprefix(rp->buf, &rp->type, &rp->code, &len)) == FAIL)
+	return(FAIL);
 
     rp->arg1 = rp->arg2 = rp->arg3 = rp->arg4 = rp->arg5 = "";
-    if (len != 0)
+    if (rp->code == VECTOR)
+    {
+	/* leave the elements for fvreceive() */
+	fvseq = seq;
+	fvtype = rp->type;
+	fvcount = len;
+    }
+    else if (len != 0)
     {
 	(void) bzero(rp->buf, MAXERRSIZE);
 	if (read(ifd, rp->buf, len) == FAIL)
@@ -128,4 +193,203 @@ fresp_t	*rp;
     return(seq);
 }
 
+static int fullread(buf, len)
+/* read exactly len bytes from the partner, however the pipe splits them */
+char		*buf;
+unsigned	len;
+{
+    int	n;
+
+    while (len > 0)
+	if ((n = read(ifd, buf, len)) <= 0)
+	    return(FAIL);
+	else
+	{
+	    buf += n;
+	    len -= n;
+	}
+    return(SUCCEED);
+}
+
+static int fvroom(vp, len)
+/* make sure a vector has room for len more bytes and a NUL */
+fvec_t		*vp;
+unsigned	len;
+{
+    unsigned	need = vp->off[vp->count] + len + 1;
+    char	*new;
+
+    if (need <= vp->size)
+	return(SUCCEED);
+    if (vp->size == 0)
+	vp->size = LBUFLEN;
+    while (vp->size < need)
+	vp->size *= 2;
+    if (vp->buf == (char *)NULL)
+	new = malloc(vp->size);
+    else
+	new = realloc(vp->buf, vp->size);
+    if (new == (char *)NULL)
+    {
+	vp->size = 0;
+	return(FAIL);
+    }
+    vp->buf = new;
+    return(SUCCEED);
+}
+
+void fvclear(vp)
+/* empty a vector */
+fvec_t	*vp;
+{
+    vp->count = 0;
+    vp->off[0] = 0;
+}
+
+int fvadd(vp, arg1, arg2, arg3)
+/* add an element of up to 3 args to a vector */
+fvec_t	*vp;
+char	*arg1, *arg2, *arg3;
+{
+    char	*args[3];
+    unsigned	len;
+    int		i;
+
+    if (vp->count >= MAXBATCH)
+	return(FAIL);
+    args[0] = arg1;
+    args[1] = (arg1 == NOARG) ? NOARG : arg2;
+    args[2] = (args[1] == NOARG) ? NOARG : arg3;
+    for (len = i = 0; i < 3 && args[i] != NOARG; i++)
+	len += strlen(args[i]) + 1;
+    if (fvroom(vp, len) == FAIL)
+	return(FAIL);
+
+    len = vp->off[vp->count];
+    for (i = 0; i < 3 && args[i] != NOARG; i++)
+    {
+	(void) strcpy(vp->buf + len, args[i]);
+	len += strlen(args[i]) + 1;
+    }
+    vp->off[++vp->count] = len;
+    return(SUCCEED);
+}
+
+char *fvarg(vp, i, n)
+/* get argument n of element i */
+fvec_t	*vp;
+int	i, n;
+{
+    char	*cp, *end;
+
+    if (i < 0 || i >= vp->count)
+	return("");
+    cp = vp->buf + vp->off[i];
+    end = vp->buf + vp->off[i + 1];
+    while (n-- > 0 && cp < end)
+	cp += strlen(cp) + 1;
+    return((cp < end) ? cp : "");
+}
+
+int fvtransmit(vp, type, code, seqno)
+/* transmit a vector frame */
+fvec_t	*vp;
+char	type;
+char	code;
+int	seqno;
+{
+    char	prefix[PREFIXLEN], lens[MAXBATCH][ELEMLEN];
+    int		i;
+#ifdef WRITEV
+    struct iovec	iov[FTIOVMAX];
+    int			n, len;
+#endif /* WRITEV */
+
+    (void) sprintf(prefix, "%c%c %06d %03d", type, code, seqno, vp->count);
+    for (i = 0; i < vp->count; i++)
+	(void) sprintf(lens[i], "%05u", vp->off[i + 1] - vp->off[i]);
+#ifdef PDEBUG
+    (void) fprintf(stderr, "%s: about to transmit \"%s\", (%d elements)\n",
+		   Progname, prefix, vp->count);
+#endif /* PDEBUG */
+
+#ifdef WRITEV
+    iov[0].iov_base = prefix;
+    len = iov[0].iov_len = PREFIXLEN;
+    n = 1;
+    for (i = 0; i <= vp->count; i++)
+    {
+	if (n + 2 > FTIOVMAX || i == vp->count)
+	{
+	    if (writev(ofd, iov, n) != len)
+		return(FAIL);
+	    n = len = 0;
+	}
+	if (i < vp->count)
+	{
+	    iov[n].iov_base = lens[i];
+	    len += iov[n++].iov_len = ELEMLEN;
+	    iov[n].iov_base = vp->buf + vp->off[i];
+	    len += iov[n++].iov_len = vp->off[i + 1] - vp->off[i];
+	}
+    }
+#else
+    if (write(ofd, prefix, PREFIXLEN) == FAIL)
+	return(FAIL);
+    for (i = 0; i < vp->count; i++)
+	if (write(ofd, lens[i], ELEMLEN) == FAIL
+		|| write(ofd, vp->buf + vp->off[i],
+			 (int)(vp->off[i + 1] - vp->off[i])) == FAIL)
+	    return(FAIL);
+#endif /* WRITEV */
+
+    return(SUCCEED);
+}
+
+int fvreceive(vp)
+/* accept a vector frame, or an ordinary one as a single element */
+fvec_t	*vp;
+{
+    char	prefix[PREFIXLEN], lenbuf[ELEMLEN];
+    unsigned	len, elen;
+    int		seq;
+
+    fvclear(vp);
+    if ((seq = fvseq) != FAIL)
+    {
+	/* freceive() has already read the prefix */
+	vp->type = fvtype;
+	vp->code = VECTOR;
+	len = fvcount;
+	fvseq = FAIL;
+    }
+    else if ((seq = frprefix(prefix, &vp->type, &vp->code, &len)) == FAIL)
+	return(FAIL);
+
+    if (vp->code != VECTOR)
+    {
+	if (fvroom(vp, len) == FAIL || fullread(vp->buf, len) == FAIL)
+	    return(FAIL);
+	vp->buf[len] = '\0';
+	vp->off[vp->count = 1] = len;
+	return(seq);
+    }
+
+    if (len > MAXBATCH)
+	return(FAIL);
+    while (vp->count < len)
+    {
+	if (fullread(lenbuf, ELEMLEN) == FAIL)
+	    return(FAIL);
+	elen = (unsigned)atoi(lenbuf);
+	if (fvroom(vp, elen) == FAIL
+		|| fullread(vp->buf + vp->off[vp->count], elen) == FAIL)
+	    return(FAIL);
+	vp->buf[vp->off[vp->count] + elen] = '\0';
+	vp->off[vp->count + 1] = vp->off[vp->count] + elen;
+	vp->count++;
+    }
+    return(seq);
+}
+
 /* transact.c ends here */
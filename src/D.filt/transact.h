@@ -16,4 +16,24 @@ extern void fconnect();
 extern int ftransmit();
 extern int freceive();
 
+/* frames with this code carry a vector of elements rather than 5 args */
+#define VECTOR		'B'
+#define MAXBATCH	256	/* most elements in one vector frame */
+
+typedef struct
+{
+    char	type, code;
+    int		count;			/* elements in the vector */
+    unsigned	off[MAXBATCH + 1];	/* where each one starts in buf */
+    char	*buf;			/* the elements, end to end */
+    unsigned	size;			/* allocated size of buf */
+}
+fvec_t;
+
+extern void fvclear();
+extern int fvadd();
+extern char *fvarg();
+extern int fvtransmit();
+extern int fvreceive();
+
 /* transact.h ends here */
@@ -9,6 +9,14 @@ extern	void	nntpsync();
 extern	int	nntpcommand();
 extern	int	nntpsnarf();
 extern	int	nntpspew();
+extern	long	nntpsend();
+extern	int	nntpwait();
+extern	int	nntpgroup();
+
+extern	int	cachefind();
+extern	int	cachesave();
+
+#define NSARTPREF	"/tmp/nsart"	/* prefix of nntpsnarf() temp files */
 
 /*
  * Response codes for NNTP server
@@ -46,6 +54,7 @@ extern	int	nntpspew();
 #define	OK_CANPOST	200	/* Hello; you can post */
 #define	OK_NOPOST	201	/* Hello; you can't post */
 #define	OK_SLAVE	202	/* Slave status noted */
+#define	OK_STREAM	203	/* Streaming permitted (RFC 4644) */
 #define	OK_GOODBYE	205	/* Closing connection */
 #define	OK_GROUP	211	/* Group selected */
 #define	OK_GROUPS	215	/* Newsgroups follow */
@@ -53,9 +62,12 @@ extern	int	nntpspew();
 #define	OK_HEAD		221	/* Head follows */
 #define	OK_BODY		222	/* Body follows */
 #define	OK_NOTEXT	223	/* No text sent -- stat, next, last */
+#define	OK_XOVER	224	/* Overview data follows (common extension) */
 #define	OK_NEWNEWS	230	/* New articles by message-id follow */
 #define	OK_NEWGROUPS	231	/* New newsgroups follow */
 #define	OK_XFERED	235	/* Article transferred successfully */
+#define	OK_CHECK	238	/* Send this article by TAKETHIS */
+#define	OK_TAKETHIS	239	/* Article taken by TAKETHIS */
 #define	OK_POSTED	240	/* Article posted successfully */
 
 #define CONT_XFER	335	/* Continue to send article */
@@ -69,9 +81,12 @@ extern	int	nntpspew();
 #define	ERR_NOPREV	422	/* No previous article in this group */
 #define	ERR_NOARTIG	423	/* No such article in this group */
 #define ERR_NOART	430	/* No such article at all */
+#define ERR_CHECKLATER	431	/* Offer this one again later */
 #define ERR_GOTIT	435	/* Already got that article, don't send */
 #define ERR_XFERFAIL	436	/* Transfer failed */
 #define	ERR_XFERRJCT	437	/* Article rejected, don't resend */
+#define	ERR_NOCHECK	438	/* Don't send this article by TAKETHIS */
+#define	ERR_TAKETHIS	439	/* Article sent by TAKETHIS rejected */
 #define	ERR_NOPOST	440	/* Posting not allowed */
 #define	ERR_POSTFAIL	441	/* Posting failed */
 
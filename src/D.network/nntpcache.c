@@ -0,0 +1,311 @@
+/****************************************************************************
+
+NAME
+   nntpcache.c -- local cache of articles fetched from the NNTP server
+
+SYNOPSIS
+   #include "news.h"
+   #include "nntp.h"
+
+   int cachefind(group, num, id, buf)	-- look for a cached article
+   char *group; long num; char *id; char *buf;
+
+   int cachesave(tfile, group, num, buf)	-- cache a freshly fetched article
+   char *tfile; char *group; long num; char *buf;
+
+DESCRIPTION
+   Without this code every article a NONLOCAL reader looks at is fetched
+into a fresh temporary file, which is thrown away as soon as the reader moves
+on; going back one article, or revisiting a thread, fetches it all again.
+These functions keep fetched articles in a size-bounded directory, named
+~/.artcache.<server>, so that they are fetched only once.
+
+   Each cached article is filed under its group and number, as "group:num",
+and hard-linked under its Message-ID (with any '/' in the ID changed to '%')
+so a crossposted copy can be found from any of its groups. The cachesave()
+function moves a file made by nntpsnarf() into the cache, puts the cached
+name in the given buffer and returns SUCCEED. If the cache can't be used it
+returns FAIL and leaves the file alone.
+
+   The cachefind() function looks for an article by group and number, and if
+that fails and the id argument isn't NULL, by Message-ID (in which case the
+group-and-number name is added for next time). A server may renumber a group,
+so when the Message-ID is known a group-and-number entry whose article has a
+different one is thrown away rather than returned. On a hit it puts the name of
+the cached file in the given buffer, marks the entry recently used, and
+returns SUCCEED; otherwise it returns FAIL. The returned name is an ordinary
+article file that msgopen() opens directly. It must not be unlinked by the
+caller.
+
+   The cache size is given in kilobytes by the "artcache" attribute (default
+CACHESIZE). Whenever the articles added since the last check come to an
+eighth of that, entries are thrown away least-recently-used first (by
+modification time, which every hit resets) until the cache is down to three
+quarters of its size.
+
+NOTES
+   Several reader processes of the same user may share the cache. Entries
+are built under a per-process scratch name and then renamed into place, so
+nobody ever sees a partly written article, and they are never modified after
+that. An entry evicted by one process while another has it open stays
+readable through the open handle, since unlink(2) only removes the name.
+
+BUGS
+   An entry may be evicted between cachefind() and the caller's open, in
+which case the open fails and the article looks missing until it is asked
+for again.
+   When the caller doesn't know the Message-ID, a group-and-number entry
+left over from before a renumbering can't be told from a good one.
+
+SEE ALSO
+   nntpread.c	-- artname(), the only caller
+   nntpclient.c	-- nntpsnarf(), which makes the files that go in here
+
+AUTHOR
+   Eric S. Raymond
+   This software is Copyright (C) 1989 by Eric S. Raymond for the sole purpose
+of protecting free redistribution; see the LICENSE file for details.
+
+**************************************************************************/
+/*LINTLIBRARY*/
+#include "news.h"
+#include "nntp.h"
+
+#define CACHEDIR	".artcache"	/* article cache directory prefix */
+#define CACHESIZE	"2048"		/* default cache size, in kbytes */
+
+typedef struct
+{
+    char	*name;		/* entry name within the cache directory */
+    time_t	used;		/* when it was last used */
+    off_t	size;		/* its share of the space its file takes */
+}
+centry_t;
+
+private char	cachedir[BUFLEN];	/* where the cache lives, "" if nowhere */
+private bool	cacheup;		/* have we tried to set it up yet? */
+private off_t	cachemax;		/* the size limit, in bytes */
+private off_t	cachegrew;		/* bytes added since the last sweep */
+
+private int cachecmp(e1, e2)
+/* order cache entries, least recently used first */
+centry_t	*e1, *e2;
+{
+    return(e1->used < e2->used ? -1 : e1->used > e2->used);
+}
+
+private void cachesweep()
+/* throw away least recently used entries until the cache fits */
+{
+    DIR			*directory;
+    struct dirent	*entry;
+    struct stat		st;
+    centry_t		*ents = (centry_t *)NULL;
+    int			nents = 0, maxents = 0, i;
+    off_t		total = 0;
+    char		fname[BUFLEN];
+
+    cachegrew = 0;
+    if ((directory = opendir(cachedir)) == (DIR *)NULL)
+	return;
+    while ((entry = readdir(directory)) != (struct dirent *)NULL)
+    {
+	/* dot files are scratch copies on their way in */
+	if (entry->d_name[0] == '.')
+	    continue;
+	(void) sprintf(fname, "%s/%s", cachedir, entry->d_name);
+	if (stat(fname, &st) == FAIL)
+	    continue;		/* somebody else just swept it */
+
+	if (nents >= maxents)
+	{
+	    maxents = maxents ? maxents * 2 : 64;
+	    if (ents == (centry_t *)NULL)
+		ents = (centry_t *)malloc(maxents * sizeof(centry_t));
+	    else
+		ents = (centry_t *)realloc((char *)ents,
+					   maxents * sizeof(centry_t));
+	    if (ents == (centry_t *)NULL)
+	    {
+		(void) closedir(directory);
+		return;
+	    }
+	}
+	ents[nents].name = savestr(entry->d_name);
+	ents[nents].used = st.st_mtime;
+	ents[nents].size = st.st_size / (st.st_nlink ? st.st_nlink : 1);
+	total += ents[nents].size;
+	nents++;
+    }
+    (void) closedir(directory);
+
+    if (total > cachemax)
+    {
+	(void) qsort((char *)ents, (iolen_t)nents, sizeof(centry_t), cachecmp);
+	for (i = 0; i < nents && total > cachemax / 4 * 3; i++)
+	{
+	    (void) sprintf(fname, "%s/%s", cachedir, ents[i].name);
+	    (void) unlink(fname);
+	    total -= ents[i].size;
+	}
+    }
+
+    for (i = 0; i < nents; i++)
+	(void) free(ents[i].name);
+    if (ents != (centry_t *)NULL)
+	(void) free((char *)ents);
+}
+
+private bool cacheopen()
+/* make sure the cache directory is there, if it's going to be */
+{
+    if (!cacheup)
+    {
+	cacheup = TRUE;
+	cachemax = atol(newsattr("artcache", CACHESIZE)) * 1024L;
+	(void) sprintf(cachedir, "%s/%s.%s",
+		       userhome, CACHEDIR, newsattr("nntphost", NNTPSERVER));
+	if (cachemax <= 0 || (mkdir(cachedir, 0700) == FAIL && !isdir(cachedir)))
+	    cachedir[0] = '\0';
+	else
+	    cachesweep();
+    }
+    return(cachedir[0] != '\0');
+}
+
+private void cacheid(buf, id)
+/* generate the name an article is cached under by Message-ID */
+char	*buf, *id;
+{
+    register char	*cp;
+
+    (void) sprintf(buf, "%s/", cachedir);
+    for (cp = buf + strlen(buf); *id && cp < buf + BUFLEN - 1; id++)
+	*cp++ = (*id == '/') ? '%' : *id;
+    *cp = '\0';
+}
+
+private bool cacheident(file, id)
+/* pull the Message-ID out of an article file's header */
+char	*file, *id;
+{
+    FILE	*fp;
+    char	line[LBUFLEN], *cp, *ep;
+    bool	found = FALSE;
+
+    if ((fp = fopen(file, "r")) == (FILE *)NULL)
+	return(FALSE);
+    while (!found && fgets(line, sizeof(line), fp) != (char *)NULL
+		&& line[0] != '\n')
+    {
+	(void) strncpy(bfr, line, 11);
+	bfr[11] = '\0';
+	lcase(bfr);
+	if (strcmp(bfr, "message-id:") == 0
+		&& (cp = strchr(line, '<')) != (char *)NULL
+		&& (ep = strchr(cp, '>')) != (char *)NULL
+		&& ep - cp + 1 < NAMELEN)
+	{
+	    (void) strncpy(id, cp, ep - cp + 1);
+	    id[ep - cp + 1] = '\0';
+	    found = TRUE;
+	}
+    }
+    (void) fclose(fp);
+    return(found);
+}
+
+int cachefind(group, num, id, buf)
+/* look for an article in the cache */
+char	*group;		/* group it's in */
+long	num;		/* its number in that group */
+char	*id;		/* its Message-ID, or NULL if not known */
+char	*buf;		/* where to put the cache file name */
+{
+    char	name[BUFLEN], alias[BUFLEN], fileid[NAMELEN];
+
+    if (!cacheopen())
+	return(FAIL);
+
+    (void) sprintf(name, "%s/%s:%ld", cachedir, group, num);
+
+    /* if the server has renumbered the group, this entry is for another */
+    if (id != (char *)NULL && id[0] != '\0' && exists(name)
+	    && (!cacheident(name, fileid) || strcmp(fileid, id) != 0))
+	(void) unlink(name);
+
+    if (!exists(name))
+    {
+	/* maybe we have it from another group it was crossposted to */
+	if (id == (char *)NULL || id[0] == '\0')
+	    return(FAIL);
+	cacheid(alias, id);
+	if (link(alias, name) == FAIL && !exists(name))
+	    return(FAIL);
+    }
+
+    setmodtime(name, time((time_t *)NULL));
+    (void) strcpy(buf, name);
+    return(SUCCEED);
+}
+
+int cachesave(tfile, group, num, buf)
+/* move a fetched article into the cache */
+char	*tfile;		/* the temporary file it was fetched into */
+char	*group;		/* group it's in */
+long	num;		/* its number in that group */
+char	*buf;		/* where to put the cache file name */
+{
+    char	name[BUFLEN], work[BUFLEN], id[NAMELEN];
+    FILE	*ifp, *ofp;
+    int		c;
+
+    if (!cacheopen())
+	return(FAIL);
+
+    /* get a copy into the cache directory under a name nobody else uses */
+    (void) sprintf(work, "%s/.new%d", cachedir, getpid());
+    (void) unlink(work);
+    if (link(tfile, work) == FAIL)
+    {
+	if ((ifp = fopen(tfile, "r")) == (FILE *)NULL)
+	    return(FAIL);
+	if ((ofp = fopen(work, "w")) == (FILE *)NULL)
+	{
+	    (void) fclose(ifp);
+	    return(FAIL);
+	}
+	while ((c = getc(ifp)) != EOF)
+	    (void) putc(c, ofp);
+	(void) fclose(ifp);
+	if (fclose(ofp) == EOF)
+	{
+	    (void) unlink(work);
+	    return(FAIL);
+	}
+    }
+
+    /* make room, then put it in place all at once */
+    if ((cachegrew += filesize(work)) > cachemax / 8)
+	cachesweep();
+    (void) sprintf(name, "%s/%s:%ld", cachedir, group, num);
+    if (rename(work, name) == FAIL)
+    {
+	(void) unlink(work);
+	return(FAIL);
+    }
+    (void) unlink(tfile);
+
+    /* it's all right if somebody already has it under this ID */
+    if (cacheident(name, id))
+    {
+	char	alias[BUFLEN];
+
+	cacheid(alias, id);
+	(void) link(name, alias);
+    }
+    (void) strcpy(buf, name);
+    return(SUCCEED);
+}
+
+/* nntpcache.c ends here */
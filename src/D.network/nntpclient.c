@@ -28,12 +28,55 @@ SYNOPSIS
    int nntpspew(cmd, srcfile)		-- send command, follow with file
    char *command, *srcfile;
 
+   long nntpsend(cmd, snarf)		-- queue a command, don't wait
+   char *cmd; bool snarf;
+
+   int nntpwait(ticket, buf, size)	-- collect the response to a command
+   long ticket; char *buf; int size;
+
+   int nntpgroup(name)			-- select a group if not already in it
+   char *name;
+
 DESCRIPTION
    These are transaction routines for communication with an NNTP server. They
 are the only ones that know about the client-to-server interface; everybody
 above them sees it through them. The strindex function is assumed to be
 the portability library's substring finder.
 
+   Commands may be pipelined. The nntpsend() function appends a command to
+an output buffer and returns a ticket for it (or FAIL). Nothing is sent until
+somebody wants a response, and then everything queued goes in one write(2),
+so a batch of commands costs one round trip rather than one each. The
+nntpwait() function reads responses in order until it has the one for the
+given ticket, and returns its numeric code (FAIL if the connection has
+dropped or the ticket is more than NNTPDEPTH commands old). The response
+line is copied into the given buffer; but if the command was queued with
+snarf TRUE and the server sent text, the text has been copied to a temporary
+file (as by nntpsnarf()) and the buffer gets the file's name instead. The
+text of a response collected by nntpwait() for a non-snarfing command is
+left for the caller to read with nntpget() or discard with nntpsync(). Text
+following responses that went by on the way to the wanted one is thrown
+away unless it was to be snarfed. If NNTPDEPTH commands are outstanding,
+nntpsend() collects the oldest response first.
+
+   The nntpcommand(), nntpsnarf() and nntpspew() functions are written on
+top of these, so they are safe to mix with pipelined requests.
+
+   Responses are read through a private buffer, so nntpget() returns exactly
+one line per call no matter how the server's output was split into packets.
+Dot-stuffed text lines are unstuffed.
+
+   The client remembers which group it last selected. The nntpgroup()
+function sends a GROUP command only if the server isn't already in that
+group, and waits for the answer before returning SUCCEED, so nothing is
+pipelined behind a GROUP that may fail; if the server rejects it, a command
+queued next would be run in the old group. A failing GROUP (or any "not in
+a newsgroup" response) makes the client forget the group.
+
+   Calls to nntpinit() on a resource that is already connected share the
+existing connection; the link is really closed only when nntpclose() has
+been called as many times as nntpinit() was.
+
 BUGS
    Probably legion -- I don't have an nntp to test this on.
 
@@ -56,7 +99,35 @@ of protecting free redistribution; see the LICENSE file for details.
 #include <netdb.h>
 #endif /* BSD4_2 */
 
+#define NNTPDEPTH	16	/* most commands in the pipeline */
+#define NNTPBUFSIZ	4096	/* size of the server input buffer */
+
+typedef struct
+{
+    long	ticket;			/* which command this was */
+    bool	snarf;			/* save any text that follows? */
+    bool	group;			/* is this a GROUP command? */
+    int		code;			/* response code, once it's in */
+    char	line[NNTP_STRLEN];	/* the response line */
+    char	file[BUFLEN];		/* where the text went, if snarfed */
+}
+nreq_t;
+
 private server_t server;
+private char	curhost[BUFLEN];	/* what we are connected to */
+private int	nopens;			/* nntpinit() calls sharing the link */
+private char	curgroup[BUFLEN];	/* the group the server has selected */
+
+private nreq_t	pend[NNTPDEPTH];	/* the pipeline of commands */
+private long	nsent, nreaped;		/* tickets issued and answered */
+private bool	intext;			/* in text the caller is reading? */
+
+private char	obuf[NNTPDEPTH * NNTP_STRLEN];	/* commands not yet sent */
+private int	olen;
+private char	ibuf[NNTPBUFSIZ];	/* server output not yet parsed */
+private char	*iptr, *iend;
+
+forward static void nntpflush(), nntpreap();
 
 /*
  * nntpinit  Get a connection to the news server.
@@ -72,6 +143,24 @@ int nntpinit(resource)
 char	*resource;
 {
     char	line[BUFLEN];
+
+    /* share a connection that's already up */
+    if (nopens > 0 && strcmp(resource, curhost) == 0)
+    {
+	nopens++;
+	return(SUCCEED);
+    }
+    else if (nopens > 0)
+    {
+	nopens = 1;
+	nntpclose();
+    }
+    iptr = iend = ibuf;
+    olen = 0;
+    nsent = nreaped = 0L;
+    intext = FALSE;
+    curgroup[0] = '\0';
+
 #ifdef BSD4_2
     /* we have sockets? then get server fds from a socket to the resource */
     if ((server.readsrv = getsocket(resource)) == FAIL
@@ -80,7 +169,7 @@ char	*resource;
 #else
     /* no sockets? then just spawn a child server */
     server_t	*srv;
-    char	**sargv;
+    char	*sargv[2];
 
     sargv[0] = resource;
     sargv[1] = (char *)NULL;
@@ -89,16 +178,18 @@ char	*resource;
 	perror("nntpinit: couldn't open server");
 	return(FAIL);
     }
+    server = *srv;
 #endif /* BSD4_2 */
 
     /* Now get the server's signon message */
-    (void) nntpget(line, sizeof(line));
-    if (line[0] != CHAR_OK)
+    if (nntpget(line, sizeof(line)) == FAIL || line[0] != CHAR_OK)
     {
 	(void) close(server.readsrv);
 	(void) close(server.writesrv);
 	return(FAIL);		/* And abort if it's not good */
     }
+    (void) strcpy(curhost, resource);
+    nopens = 1;
     return(SUCCEED);
 }
 
@@ -159,6 +250,30 @@ char	*machine;
 }
 #endif /* BSD4_2 */
 
+private void nntpqueue(string)
+/* add a line to the output buffer, sending the buffer if it's full */
+char	*string;
+{
+    int	len = strlen(string);
+
+#ifdef DEBUG
+    (void) fprintf(stderr, ">>> %s\n", string);
+#endif
+    if (olen + len + 2 > sizeof(obuf))
+	nntpflush();
+    (void) strcpy(obuf + olen, string);
+    (void) strcpy(obuf + olen + len, "\r\n");
+    olen += len + 2;
+}
+
+private void nntpflush()
+/* send everything queued in the output buffer */
+{
+    if (olen > 0)
+	(void) write(server.writesrv, obuf, olen);
+    olen = 0;
+}
+
 /*
  * nntpput -- send a line of text to the server, terminating it
  * with CR and LF, as per ARPA standard.
@@ -171,20 +286,15 @@ char	*machine;
  *	Side effects:	Talks to the server.
  *
  *	Note:		This routine flushes the buffer each time
- *			it is called.  For large transmissions
- *			(i.e., posting news) don't use it.  Instead,
- *			do the (void) fprintf's yourself, and then a final
- *			fflush.
+ *			it is called, along with any pipelined
+ *			commands queued ahead of it.
  */
 
 void nntpput(string)
 char *string;
 {
-#ifdef DEBUG
-    (void) fprintf(stderr, ">>> %s\n", string);
-#endif
-    (void) strcpy(bfr, string); (void) strcat(string, "\r\n");
-    (void) write(server.writesrv, string, strlen(string));
+    nntpqueue(string);
+    nntpflush();
 }
 
 
@@ -199,26 +309,52 @@ char *string;
  *	Returns:	-1 on error, 0 otherwise.
  *
  *	Side effects:	Talks to server, changes contents of "string".
+ *			Overlong lines are truncated.
  */
 
 int nntpget(string, size)
 char	*string;
 int	size;
 {
-    register char *cp;
-    char	*index();
+    register char	*cp = string;
+    register int	c;
+    int			n;
 
-    if (read(server.readsrv, string, size) == FAIL)
-	return(FAIL);
+    /* any commands waiting to go out must be sent before we wait on a reply */
+    nntpflush();
 
-    if ((cp = index(string, '\r')) != NULL)
-	*cp = '\0';
-    else if ((cp = index(string, '\n')) != NULL)
-	*cp = '\0';
+    for (;;)
+    {
+	if (iptr >= iend)
+	{
+	    if ((n = read(server.readsrv, ibuf, sizeof(ibuf))) <= 0)
+	    {
+		*cp = '\0';
+		return(FAIL);
+	    }
+	    iptr = ibuf;
+	    iend = ibuf + n;
+	}
+	if ((c = *iptr++) == '\n')
+	    break;
+	if (cp < string + size - 1)
+	    *cp++ = c;
+    }
+    if (cp > string && cp[-1] == '\r')
+	--cp;
+    *cp = '\0';
 #ifdef DEBUG
     (void) fprintf(stderr, "<<< %s\n", string);
 #endif
 
+    if (intext && string[0] == '.')
+    {
+	if (string[1] == '\0')
+	    intext = FALSE;
+	else			/* dot-stuffed line */
+	    for (cp = string; (cp[0] = cp[1]) != '\0'; cp++)
+		continue;
+    }
     return(SUCCEED);
 }
 
@@ -240,11 +376,17 @@ void nntpclose()
 {
     char	ser_line[BUFLEN];
 
+    if (nopens == 0 || --nopens > 0)
+	return;
+
     nntpput("QUIT");
+    while (nreaped < nsent)	/* drain the pipeline so QUIT gets its turn */
+	nntpreap(FALSE);
     (void) nntpget(ser_line, sizeof(ser_line));
 
     (void) close(server.writesrv);
     (void) close(server.readsrv);
+    curhost[0] = curgroup[0] = '\0';
 }
 
 void nntpsync()
@@ -252,9 +394,150 @@ void nntpsync()
 {
     char nntpbuf[BUFLEN];
 
-    while (nntpget(nntpbuf, sizeof(nntpbuf)) >= 0)
-	if (nntpbuf[0] == '.' && strlen(nntpbuf) == 1)
-	    break;
+    while (intext && nntpget(nntpbuf, sizeof(nntpbuf)) >= 0)
+	continue;
+    intext = FALSE;
+}
+
+private bool nntptext(code)
+/* does text follow a response with this code? */
+int	code;
+{
+    switch (code)
+    {
+    case INF_HELP:
+    case OK_GROUPS:
+    case OK_ARTICLE:
+    case OK_HEAD:
+    case OK_BODY:
+    case OK_XOVER:
+    case OK_NEWNEWS:
+    case OK_NEWGROUPS:
+	return(TRUE);
+    default:
+	return(FALSE);
+    }
+}
+
+private int nntpsave(file)
+/* copy the text of a response into a new temporary file */
+char	*file;
+{
+    FILE *fp;
+    char nntpbuf[NNTP_STRLEN];
+
+    (void) strcpy(file, NSARTPREF);
+    (void) strcat(file, "XXXXXX");
+    (void) mktemp(file);
+    intext = TRUE;
+    if ((fp = fopen(file, "w")) == (FILE *)NULL)
+    {
+	nntpsync();
+	return(FAIL);
+    }
+    while (nntpget(nntpbuf, sizeof(nntpbuf)) >= 0 && intext)
+    {
+	(void) fputs(nntpbuf, fp);	/* copy it to the temp file */
+	(void) putc('\n', fp);
+    }
+    intext = FALSE;
+    (void) fclose(fp);
+    return(SUCCEED);
+}
+
+private void nntpreap(keep)
+/* read the response to the oldest command in the pipeline */
+bool	keep;	/* leave any unsnarfed text for the caller? */
+{
+    register nreq_t	*rp = &pend[(nreaped + 1) % NNTPDEPTH];
+
+    if (intext)			/* caller didn't want all the last text */
+	nntpsync();
+    nreaped++;
+    if (nntpget(rp->line, sizeof(rp->line)) == FAIL)
+    {
+	rp->code = FAIL;
+	return;
+    }
+    rp->code = atoi(rp->line);
+    if ((rp->group && rp->line[0] != CHAR_OK) || rp->code == ERR_NCING)
+	curgroup[0] = '\0';
+
+    if (!nntptext(rp->code))
+	return;
+    else if (rp->snarf)
+    {
+	if (nntpsave(rp->file) == FAIL)
+	    rp->code = ERR_FAULT;
+	return;
+    }
+    intext = TRUE;
+    if (!keep)
+	nntpsync();
+}
+
+long nntpsend(cmd, snarf)
+/* queue a command, returning a ticket for its response */
+char	*cmd;
+bool	snarf;
+{
+    register nreq_t	*rp;
+
+    if (nopens == 0)
+	return((long)FAIL);
+    if (nsent - nreaped >= NNTPDEPTH)
+	nntpreap(FALSE);
+
+    rp = &pend[++nsent % NNTPDEPTH];
+    rp->ticket = nsent;
+    rp->snarf = snarf;
+    rp->group = prefix(cmd, "GROUP ");
+    rp->code = 0;
+    rp->file[0] = '\0';
+    nntpqueue(cmd);
+    return(nsent);
+}
+
+int nntpwait(ticket, buf, size)
+/* collect the response to a queued command */
+long	ticket;
+char	*buf;
+int	size;
+{
+    register nreq_t	*rp = &pend[ticket % NNTPDEPTH];
+
+    if (ticket <= 0 || ticket > nsent || rp->ticket != ticket)
+	return(FAIL);
+    while (nreaped < ticket)
+	nntpreap(nreaped + 1 == ticket);
+    if (rp->code == FAIL)
+	return(FAIL);
+
+    (void) strncpy(buf, (rp->snarf && rp->file[0]) ? rp->file : rp->line,
+		   size - 1);
+    buf[size - 1] = '\0';
+    return(rp->code);
+}
+
+int nntpgroup(name)
+/* make sure the server has the named group selected */
+char	*name;
+{
+    char	cmd[NNTP_STRLEN];
+    long	ticket;
+
+    if (strcmp(curgroup, name) == 0)
+	return(SUCCEED);
+    (void) sprintf(cmd, "GROUP %s", name);
+    if ((ticket = nntpsend(cmd, FALSE)) == (long)FAIL)
+	return(FAIL);
+
+    /* commands behind it must not run in whatever group we were in */
+    curgroup[0] = '\0';
+    if (nntpwait(ticket, cmd, sizeof(cmd)) != OK_GROUP)
+	return(FAIL);
+    (void) strcpy(curgroup, name);
+    return(SUCCEED);
 }
 
 int nntpcommand(cmdbuf, bufsiz, save)
@@ -265,16 +548,17 @@ int	save;
 {
     int n = save;
 
-    nntpput(cmdbuf);
-    (void) nntpget(cmdbuf, bufsiz);
-    if (*cmdbuf != CHAR_OK)
+    if (nntpwait(nntpsend(cmdbuf, FALSE), cmdbuf, bufsiz) == FAIL
+		|| *cmdbuf != CHAR_OK)
     {
 	errno = atoi(cmdbuf);
+	if (intext)
+	    nntpsync();
 	return(FAIL);
     }
-    while (n--)
+    while (n-- && intext)
 	(void) nntpget(cmdbuf, bufsiz);
-    if (save > 0)
+    if (intext)
 	nntpsync();
     return(SUCCEED);
 }
@@ -283,28 +567,11 @@ int nntpsnarf(command, tempfile)
 /* send down a command, snarf the returned file data */
 char *command, *tempfile;
 {
-    FILE *fp;
     char nntpbuf[BUFLEN];
 
-    nntpput(command);
-    (void) nntpget(nntpbuf, sizeof(nntpbuf));
-    if (*nntpbuf != CHAR_OK)
-	return(FAIL);
-    (void) strcpy(tempfile, "/tmp/nsartXXXXXX");
-    (void) mktemp(tempfile);
-    if ((fp = fopen(tempfile, "w")) == (FILE *)NULL)
-    {
-	nntpsync();
+    if (!nntptext(nntpwait(nntpsend(command, TRUE), nntpbuf, sizeof(nntpbuf))))
 	return(FAIL);
-    }
-    while (nntpget(nntpbuf, sizeof(nntpbuf)) >= 0)
-    {
-	if (nntpbuf[0] == '.' && strlen(nntpbuf) == 1)
-	    break;	/* get it and write it to */
-	(void) fputs(nntpbuf, fp);	/* the temp file */
-	(void) putc('\n', fp);
-    }
-    (void) fclose(fp);
+    (void) strcpy(tempfile, nntpbuf);
     return(SUCCEED);
 }
 
@@ -314,6 +581,10 @@ char	*cmd, *file;
 {
     FILE *fp;
 
+    /* this one goes in lockstep, so empty the pipeline first */
+    while (nreaped < nsent)
+	nntpreap(FALSE);
+
     /* send the command down */
     nntpput(cmd);
 
@@ -326,7 +597,7 @@ char	*cmd, *file;
     }
 
     /* if so, stuff the file contents down it */
-    if ((fp = fopen()) == (FILE *)NULL)
+    if ((fp = fopen(file, "r")) == (FILE *)NULL)
 	return(FAIL);
     bfr[0] = '.';
     while (fgets(bfr + 1, sizeof(bfr), fp) != NULL)
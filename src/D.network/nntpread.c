@@ -13,6 +13,15 @@ SYNOPSIS
    int artname(place, buf)	-- generate an article name into given buffer
    place_t *place; char *buf;
 
+   void artdone(buf)		-- release a name artname() generated
+   char *buf;
+
+   void artahead(place)		-- start fetching an article in advance
+   place_t *place;
+
+   int artoverview(ngp, num, hp)	-- get header fields from overview data
+   group_t *ngp; nart_t num; hdr_t *hp;
+
    char *getactive();		-- fetch an active file copy
 
    void hstread(flg)		-- establish nntp connection
@@ -33,6 +42,45 @@ NNTP. This code thus does as much as possible to hide the differences between
 sites that run with their own administrative files in ADM (the normal case)
 and sites that talk to an NNTP server over Internet.
 
+   Requests are pipelined through nntpsend() and nntpwait() in nntpclient.c,
+and a GROUP command is sent only when the server isn't already in the
+group wanted. The artahead() function queues an ARTICLE request for a
+location the reader expects to want soon (the read-ahead code in prefetch.c
+calls it for each article it predicts) and returns at once; a later artname()
+for that location collects the text without another round trip. At most
+NAHEAD articles are outstanding; beyond that the oldest is collected and
+thrown away. The hstseek() function asks all its questions of the server in
+one batch.
+
+   Fetched articles go into the local article cache (see nntpcache.c), so
+artname() hands back the name of a cache file and an article is fetched from
+the server only once, however often the reader comes back to it. If the
+overview data for the group gives the article's Message-ID, a copy cached
+from another group it was crossposted to will do. Articles fetched ahead and
+then not asked for are cached too. Only if the cache is unusable does
+artname() fall back on a temporary file; the artdone() function removes such
+a file when its user is through with it, and does nothing to cache files.
+
+   The artoverview() function fills in the Subject, From, Date, Message-ID,
+References and Lines fields of a header block without fetching the article,
+so subject menus built by indexline() don't download a whole article per
+line. Overview records are requested OVCHUNK articles at a time with XOVER
+(or OVER, if the server only knows the RFC 3977 name); a server with neither
+is asked for the same fields with a pipelined batch of XHDR range commands.
+A command the server rejects as unknown is not tried again for the rest of
+the session. It returns FAIL if the server has no overview data for the
+article, or no way of giving any, in which case the caller should fall back
+on artname().
+
+   Overview records are also kept on disk, one file per group in a directory
+named ~/.overview.<server>, so a menu for a group already seen costs only the
+records for articles that arrived since. The first line of each file is the
+highest article number it holds, and an article the server lacks gets a
+record consisting of its number alone; if the server's high-water mark for the group
+is ever below that, the group has been renumbered and the file is thrown away.
+Records for expired articles are dropped when the file is next loaded, if
+they outnumber the live ones.
+
 NOTE
    #define ALIASES should be turned on if you are running NNTP 1.5 patchlevel 4
 or a more recent version.
@@ -55,14 +103,48 @@ of protecting free redistribution; see the LICENSE file for details.
 **************************************************************************/
 /*LINTLIBRARY*/
 #include "news.h"
+#include "header.h"
 #include "active.h" 
 #include "newsrc.h"
 #include "history.h"
 #include "nntp.h"
 #include "response_codes.h"
 
+#define NAHEAD		4	/* articles fetched ahead, well inside the pipeline */
+#define XHDRBATCH	8	/* XHDR requests to have outstanding at once */
+#define OVCHUNK		100	/* overview records fetched per round trip */
+#define OVDIR		".overview"	/* overview cache directory prefix */
+
+typedef struct
+{
+    group_t	*group;		/* article location, NULL if slot free */
+    nart_t	number;
+    long	ticket;		/* nntpsend() ticket for its ARTICLE command */
+}
+ahead_t;
+
 private char nntpbuf[BUFLEN];	/* scratch space for comm. with nntp */
 private lptr_t	hstlst;		/* location descriptor for the xref list */
+private ahead_t	ahead[NAHEAD];	/* articles on their way to us */
+
+private group_t	*ovgroup;	/* group the overview table describes */
+private nart_t	ovbase;		/* article number of ovlines[0] */
+private int	ovcount;	/* number of slots in ovlines */
+private char	**ovlines;	/* records; NULL if unasked, "" if none */
+private FILE	*ovfp;		/* the group's overview cache file */
+private nart_t	ovhigh;		/* highest article the cache file holds */
+private char	*ovcmd = "XOVER";	/* overview command, NULL if none */
+private bool	ovhdrok = TRUE;		/* does the server know XHDR? */
+private char	ovnone[] = "";	/* record for an article the server lacks */
+
+forward static char *ovident();
+
+/* XHDR header names for the overview fields, in record order */
+private char	*ovnames[OVFIELDS] =
+{
+    (char *)NULL, "subject", "from", "date",
+    "message-id", "references", "bytes", "lines",
+};
 
 /* here's the getfiles.c emulation */
 
@@ -76,22 +158,116 @@ void artinit()
 	xerror1("Couldn't reach %s news server, try again later.", host);
 }
 
+private ahead_t *aheadfind(place)
+/* find the fetch-ahead slot for a location, if any */
+place_t	*place;
+{
+    register ahead_t	*ap;
+
+    for (ap = ahead; ap < ahead + NAHEAD; ap++)
+	if (ap->group == place->m_group && ap->number == place->m_number)
+	    return(ap);
+    return((ahead_t *)NULL);
+}
+
+private int artkeep(ngname, num, tfile, buf)
+/* file a fetched article in the cache if we can */
+char	*ngname;
+nart_t	num;
+char	*tfile, *buf;
+{
+    if (cachesave(tfile, ngname, (long)num, buf) == FAIL)
+	(void) strcpy(buf, tfile);
+    return(SUCCEED);
+}
+
+void artdone(buf)
+/* release an article name we gave back earlier */
+char	*buf;
+{
+    if (buf != (char *)NULL && prefix(buf, NSARTPREF))
+	(void) unlink(buf);	/* a temporary copy, not a cache file */
+}
+
+private void aheaddrop(ap)
+/* collect an article nobody asked for after all, and keep it for later */
+ahead_t	*ap;
+{
+    char	tfile[BUFLEN], cfile[BUFLEN];
+
+    if (ap->group != (group_t *)NULL
+		&& nntpwait(ap->ticket, tfile, sizeof(tfile)) == OK_ARTICLE)
+    {
+	(void) artkeep(ap->group->ng_name, ap->number, tfile, cfile);
+	artdone(cfile);
+    }
+    ap->group = (group_t *)NULL;
+}
+
+void artahead(place)
+/* start fetching an article we'll probably want soon */
+place_t	*place;
+{
+    register ahead_t	*ap, *slot = (ahead_t *)NULL;
+    char		cmd[NNTP_STRLEN], id[NAMELEN];
+
+    if (aheadfind(place) != (ahead_t *)NULL
+		|| cachefind(place->m_group->ng_name, (long)place->m_number,
+			     ovident(place, id), cmd) == SUCCEED)
+	return;
+    for (ap = ahead; ap < ahead + NAHEAD; ap++)
+	if (ap->group == (group_t *)NULL)
+	{
+	    slot = ap;
+	    break;
+	}
+	else if (slot == (ahead_t *)NULL || ap->ticket < slot->ticket)
+	    slot = ap;
+    aheaddrop(slot);
+
+    if (nntpgroup(place->m_group->ng_name) == FAIL)
+	return;
+    (void) sprintf(cmd, "ARTICLE %ld", (long)place->m_number);
+    if ((slot->ticket = nntpsend(cmd, TRUE)) == (long)FAIL)
+	return;
+    slot->group = place->m_group;
+    slot->number = place->m_number;
+}
+
 int artname(place, buf)
 /* snarf the textfile corresponding to an article location */
 place_t	*place;
 char	*buf;
 {
-    static char	*oldpt = (char *)NULL;
+    ahead_t	*ap;
+    char	id[NAMELEN], tfile[BUFLEN];
+
+    /* whatever name was in the buffer, the caller is through with it */
+    artdone(buf);
+
+    /* we may have fetched it before */
+    if (cachefind(place->m_group->ng_name, (long)place->m_number,
+		  ovident(place, id), buf ? buf : tfile) == SUCCEED)
+	return(SUCCEED);
 
-    /*
-     * KLUGE -- assuming we never step on our current-article-file-name global
-     * buffers, this will delete the last current article copy
-     */
-    if (oldpt != (char *)NULL && oldpt[0])
-	(void) unlink(oldpt);
+    /* maybe it's already on its way */
+    if (buf != (char *)NULL && (ap = aheadfind(place)) != (ahead_t *)NULL)
+    {
+	ap->group = (group_t *)NULL;
+	switch (nntpwait(ap->ticket, tfile, sizeof(tfile)))
+	{
+	case OK_ARTICLE:
+	    return(artkeep(place->m_group->ng_name, place->m_number,
+			   tfile, buf));
+	case FAIL:		/* lost track of it, ask again */
+	    break;
+	default:
+	    buf[0] = '\0';
+	    return(FAIL);
+	}
+    }
 
-    (void) sprintf(bfr, "GROUP %s", place->m_group->ng_name);
-    if (nntpcommand(bfr, sizeof(bfr), 0) == FAIL)
+    if (nntpgroup(place->m_group->ng_name) == FAIL)
 	return(FAIL);
 
     if (buf == (char *)NULL)	/* user just wants to know if it exists */
@@ -102,14 +278,313 @@ char	*buf;
     else			/* user wants the text back */
     {
 	(void) sprintf(bfr, "ARTICLE %ld", (long)place->m_number);
-	if (nntpsnarf(bfr, buf) == FAIL)
+	if (nntpsnarf(bfr, tfile) == FAIL)
 	    return(FAIL);
+	return(artkeep(place->m_group->ng_name, place->m_number, tfile, buf));
+    }
+}
+
+/* here's the overview code */
+
+private void ovfile(ngp, fname)
+/* generate the name of a group's overview cache file */
+group_t	*ngp;
+char	*fname;
+{
+    (void) sprintf(fname, "%s/%s.%s",
+		   userhome, OVDIR, newsattr("nntphost", NNTPSERVER));
+    (void) mkdir(fname, 0777);
+    (void) strcat(fname, "/");
+    (void) strcat(fname, ngp->ng_name);
+}
+
+private void ovmark(high)
+/* record the highest article number the cache file holds */
+nart_t	high;
+{
+    if (ovfp == (FILE *)NULL || high <= ovhigh)
+	return;
+    ovhigh = high;
+    (void) fseek(ovfp, 0L, SEEK_SET);
+    (void) fprintf(ovfp, "%10ld\n", (long)ovhigh);
+    (void) fseek(ovfp, 0L, SEEK_END);
+}
+
+private void ovstore(rec, save)
+/* enter an overview record in the table, and maybe the cache file */
+char	*rec;
+bool	save;
+{
+    nart_t	num = atoa(rec);
+
+    if (num < ovbase || num >= ovbase + ovcount || ovlines[num - ovbase])
+	return;
+    if (strchr(rec, '\t') == (char *)NULL)
+	ovlines[num - ovbase] = ovnone;
+    else
+	ovlines[num - ovbase] = savestr(rec);
+    if (save && ovfp != (FILE *)NULL)
+	(void) fprintf(ovfp, "%s\n", rec);
+}
+
+private char *ovident(place, id)
+/* get an article's Message-ID from overview data already in hand */
+place_t	*place;
+char	*id;
+{
+    register char	*cp, *ep;
+    int			f;
+
+    if (place->m_group != ovgroup || place->m_number < ovbase
+		|| place->m_number >= ovbase + ovcount
+		|| (cp = ovlines[place->m_number - ovbase]) == (char *)NULL
+		|| cp == ovnone)
+	return((char *)NULL);
+
+    for (f = 0; f < OV_IDENT; f++)
+	if ((cp = strchr(cp, '\t')) == (char *)NULL)
+	    return((char *)NULL);
+	else
+	    cp++;
+    if ((ep = strchr(cp, '\t')) == (char *)NULL)
+	ep = cp + strlen(cp);
+    if (ep == cp || ep - cp >= NAMELEN)
+	return((char *)NULL);
+    (void) strncpy(id, cp, ep - cp);
+    id[ep - cp] = '\0';
+    return(id);
+}
+
+private void ovflush()
+/* forget the overview data for the current group */
+{
+    register int	i;
+
+    for (i = 0; i < ovcount; i++)
+	if (ovlines[i] != (char *)NULL && ovlines[i] != ovnone)
+	    (void) free(ovlines[i]);
+    if (ovlines != (char **)NULL)
+	(void) free((char *)ovlines);
+    if (ovfp != (FILE *)NULL)
+	(void) fclose(ovfp);
+    ovlines = (char **)NULL;
+    ovfp = (FILE *)NULL;
+    ovcount = 0;
+    ovgroup = (group_t *)NULL;
+}
+
+private void ovload(ngp)
+/* set up the overview table for a group from its cache file */
+group_t	*ngp;
+{
+    char	fname[BUFLEN], rec[LBUFLEN], *cp;
+    int		live = 0, stale = 0, i;
+
+    ovflush();
+    ovgroup = ngp;
+    ovbase = ngp->ng_min;
+    if ((ovcount = ngp->ng_max - ngp->ng_min + 1) <= 0)
+	ovcount = 0;
+    else if ((ovlines = (char **)calloc((unsigned)ovcount, sizeof(char *)))
+							== (char **)NULL)
+	ovcount = 0;
+    ovhigh = 0;
+
+    ovfile(ngp, fname);
+    if ((ovfp = fopen(fname, "r+")) != (FILE *)NULL)
+    {
+	if (fgets(rec, sizeof(rec), ovfp) == (char *)NULL
+			|| (ovhigh = atoa(rec)) > ngp->ng_max)
+	{
+	    /* the group has been renumbered, start again */
+	    (void) fclose(ovfp);
+	    ovfp = (FILE *)NULL;
+	    ovhigh = 0;
+	}
 	else
 	{
-	    oldpt = buf;
+	    while (fgets(rec, sizeof(rec), ovfp) != (char *)NULL)
+		if ((cp = strchr(rec, '\n')) != (char *)NULL)
+		{
+		    *cp = '\0';
+		    if (atoa(rec) < ngp->ng_min)
+			stale++;
+		    else
+		    {
+			ovstore(rec, FALSE);
+			live++;
+		    }
+		}
+	    if (stale > live)
+	    {
+		(void) fclose(ovfp);
+		ovfp = (FILE *)NULL;
+	    }
+	}
+    }
+
+    /* (re)write the file if it was missing, renumbered or mostly expired */
+    if (ovfp == (FILE *)NULL && (ovfp = fopen(fname, "w+")) != (FILE *)NULL)
+    {
+	(void) fprintf(ovfp, "%10ld\n", (long)ovhigh);
+	for (i = 0; i < ovcount; i++)
+	    if (ovlines[i] == ovnone)
+		(void) fprintf(ovfp, "%ld\n", (long)(ovbase + i));
+	    else if (ovlines[i] != (char *)NULL)
+		(void) fprintf(ovfp, "%s\n", ovlines[i]);
+	(void) fflush(ovfp);
+    }
+    if (ovfp != (FILE *)NULL)
+	(void) fseek(ovfp, 0L, SEEK_END);
+}
+
+private int ovxover(lo, hi)
+/* fetch overview records for a range with XOVER or OVER */
+nart_t	lo, hi;
+{
+    char	rec[LBUFLEN];
+    long	ticket;
+    int		code;
+
+    while (ovcmd != (char *)NULL)
+    {
+	(void) sprintf(rec, "%s %ld-%ld", ovcmd, (long)lo, (long)hi);
+	if ((ticket = nntpsend(rec, FALSE)) == (long)FAIL)
+	    return(FAIL);
+	if ((code = nntpwait(ticket, rec, sizeof(rec))) == OK_XOVER)
+	{
+	    /* data lines begin with a number, so can't be the lone dot */
+	    while (nntpget(rec, sizeof(rec)) >= 0 && strcmp(rec, ".") != 0)
+		ovstore(rec, TRUE);
 	    return(SUCCEED);
 	}
+	else if (code != ERR_COMMAND)
+	    return(FAIL);
+	else if (strcmp(ovcmd, "XOVER") == 0)
+	    ovcmd = "OVER";
+	else
+	    ovcmd = (char *)NULL;
+    }
+    return(FAIL);
+}
+
+private int ovxhdr(lo, hi)
+/* build overview records for a range out of XHDR responses */
+nart_t	lo, hi;
+{
+    static char	*field[OVCHUNK][OVFIELDS];
+    char	rec[LBUFLEN], *cp;
+    long	tickets[OVFIELDS];
+    int		i, f, code, n = hi - lo + 1, status = SUCCEED;
+
+    /* one command per field, all in flight at once */
+    for (f = 0; f < OVFIELDS; f++)
+	if (ovnames[f] != (char *)NULL)
+	{
+	    (void) sprintf(rec, "XHDR %s %ld-%ld", ovnames[f], (long)lo, (long)hi);
+	    tickets[f] = nntpsend(rec, FALSE);
+	}
+
+    for (f = 0; f < OVFIELDS; f++)
+    {
+	if (ovnames[f] == (char *)NULL)
+	    continue;
+	if ((code = nntpwait(tickets[f], rec, sizeof(rec))) != OK_HEAD)
+	{
+	    if (code == ERR_COMMAND)
+		ovhdrok = FALSE;	/* don't ask again */
+	    if (f == OV_IDENT)
+		status = FAIL;
+	    continue;
+	}
+
+	/* data lines look like "number value" */
+	while (nntpget(rec, sizeof(rec)) >= 0 && strcmp(rec, ".") != 0)
+	    if ((i = atoa(rec) - lo) >= 0 && i < n
+			&& (cp = strchr(rec, ' ')) != (char *)NULL
+			&& strcmp(++cp, "(none)") != 0
+			&& field[i][f] == (char *)NULL)
+		field[i][f] = savestr(cp);
+    }
+
+    /* assemble the records; no Message-ID means no article */
+    for (i = 0; i < n; i++)
+    {
+	if (status == SUCCEED && field[i][OV_IDENT] != (char *)NULL)
+	{
+	    (void) sprintf(rec, "%ld", (long)(lo + i));
+	    for (f = 1; f < OVFIELDS; f++)
+		if (strlen(rec) + 1 + (field[i][f] ? strlen(field[i][f]) : 0)
+							< sizeof(rec))
+		{
+		    (void) strcat(rec, "\t");
+		    if (field[i][f] != (char *)NULL)
+			(void) strcat(rec, field[i][f]);
+		}
+	    ovstore(rec, TRUE);
+	}
+	for (f = 0; f < OVFIELDS; f++)
+	    if (field[i][f] != (char *)NULL)
+	    {
+		(void) free(field[i][f]);
+		field[i][f] = (char *)NULL;
+	    }
+    }
+    return(status);
+}
+
+int artoverview(ngp, num, hp)
+/* fill in a header block from the server's overview data */
+group_t	*ngp;
+nart_t	num;
+hdr_t	*hp;
+{
+    nart_t	lo, hi;
+    int		i;
+
+    if (ngp != ovgroup || ngp->ng_min != ovbase
+		|| ngp->ng_max - ngp->ng_min + 1 != ovcount)
+	ovload(ngp);
+    if (num < ovbase || num >= ovbase + ovcount)
+	return(FAIL);
+
+    if (ovlines[num - ovbase] == (char *)NULL)
+    {
+	/* if the server can't give us overview data, go get the article */
+	if (ovcmd == (char *)NULL && !ovhdrok)
+	    return(FAIL);
+
+	/* fetch the chunk around this article, skipping what we have */
+	lo = num - (num - ovbase) % OVCHUNK;
+	if ((hi = lo + OVCHUNK - 1) >= ovbase + ovcount)
+	    hi = ovbase + ovcount - 1;
+	while (ovlines[lo - ovbase] != (char *)NULL)
+	    lo++;
+	while (ovlines[hi - ovbase] != (char *)NULL)
+	    hi--;
+
+	if (nntpgroup(ngp->ng_name) == FAIL)
+	    return(FAIL);
+	if (ovxover(lo, hi) == FAIL
+		&& (ovcmd != (char *)NULL || ovxhdr(lo, hi) == FAIL))
+	    return(FAIL);
+
+	/* whatever the server didn't send, it hasn't got */
+	for (i = lo - ovbase; i <= hi - ovbase; i++)
+	    if (ovlines[i] == (char *)NULL)
+	    {
+		ovlines[i] = ovnone;
+		if (ovfp != (FILE *)NULL)
+		    (void) fprintf(ovfp, "%ld\n", (long)(ovbase + i));
+	    }
+	ovmark(hi);
+	if (ovfp != (FILE *)NULL)
+	    (void) fflush(ovfp);
     }
+
+    if (ovlines[num - ovbase] == ovnone)
+	return(FAIL);
+    return(hoverview(hp, ovlines[num - ovbase]));
 }
 
 /* here's the active-file snarfer */
@@ -133,6 +608,24 @@ bool	flg;
     /* do nothing -- connection already established */
 }
 
+#ifndef ALIASES
+private int xhdrline(ticket, buf, size)
+/* collect an XHDR response for a single article */
+long	ticket;
+char	*buf;
+int	size;
+{
+    if (nntpwait(ticket, buf, size) != OK_HEAD)
+	return(FAIL);
+
+    /* data lines look like "<id> value", the terminating dot doesn't */
+    if (nntpget(buf, size) == FAIL || strchr(buf, ' ') == (char *)NULL)
+	return(FAIL);
+    nntpsync();
+    return(SUCCEED);
+}
+#endif /* ALIASES */
+
 /* ARGSUSED2 */
 int hstseek(name, wlock)
 /* grab cross-reference data on an article id */
@@ -155,21 +648,30 @@ bool wlock;
 	return(SUCCEED);
     }
 #else /* !ALIASES */
-    char	*p;
+    char	*p, *q, grouplist[BUFLEN], *groups[XHDRBATCH];
+    long	stat, xref, ngs, tickets[XHDRBATCH];
+    int		i, n;
+
+    /* ask everything at once, though we may not need the last answer */
+    (void) sprintf(bfr, "STAT %s", name);
+    stat = nntpsend(bfr, FALSE);
+    (void) sprintf(bfr, "XHDR xref %s", name);
+    xref = nntpsend(bfr, FALSE);
+    (void) sprintf(bfr, "XHDR newsgroups %s", name);
+    ngs = nntpsend(bfr, FALSE);
 
     /* first, check that the server knows about the message */
-    (void) sprintf(bfr, "STAT %s",name);
-    if (nntpcommand(bfr, sizeof(bfr), 0) == FAIL)
-	return(FAIL);
-
-    /* then demand the xref header line */
-    (void) sprintf(bfr, "XHDR xref %s",name);
-    if (nntpcommand(bfr, sizeof(bfr), 1) == FAIL)
+    if (nntpwait(stat, bfr, sizeof(bfr)) != OK_NOTEXT)
 	return(FAIL);
 
     /* if there is an xref line, simply convert it */
-    if ((p = strchr(bfr, ' ')) != (char *)NULL && *++p != '(')
+    if (xhdrline(xref, bfr, sizeof(bfr)) == SUCCEED
+		&& (p = strchr(bfr, ' ')) != (char *)NULL && *++p != '(')
     {
+	/* skip the name of the site that made the xref */
+	if ((q = strchr(p, ' ')) != (char *)NULL && strchr(p, ':') > q)
+	    p = q + 1;
+
 	/* copy to target buffer, convert from xref form to history form */
 	(void) strcpy(hstline, p);
 	for (p = hstline; p != (char *)NULL && *p; p = strchr(hstline, ':'))
@@ -177,42 +679,45 @@ bool wlock;
     }
     else	/* no xref line -- must do it the ugly way */
     {
-	char grouplist[BUFLEN], *thisgroup, *bufp;
-
-	(void) sprintf(grouplist, "XHDR newsgroups %s", name);
-	if (nntpcommand(grouplist, sizeof(grouplist), 1) == FAIL)
+	if (xhdrline(ngs, grouplist, sizeof(grouplist)) == FAIL
+		|| (p = strchr(grouplist, ' ')) == (char *)NULL)
 	    return(FAIL);
 
-	bufp = hstline;
-	thisgroup = strtok(grouplist, " ");
-	do {
-	    group_t	*ngp;
-	    nart_t	artnum;
-
-	    if ((ngp = ngfind(thisgroup)) == (group_t *)NULL)
-		return(FAIL);
-
-	    (void)sprintf(bfr,"XHDR message-id %d-%d",ngp->ng_min,ngp->ng_max);
-	    nntpput(bfr);
-	    (void) nntpget(bfr, sizeof(bfr));
-	    if (*bfr != CHAR_OK)
-		return(FAIL);
-	    while (nntpget(bfr, sizeof(bfr)) >= 0)
+	hstline[0] = '\0';
+	p = strtok(p + 1, ", ");
+	while (p != (char *)NULL)
+	{
+	    /* send off a batch of XHDR requests, one per group */
+	    for (n = 0; n < XHDRBATCH && p != (char *)NULL; n++)
+	    {
+		group_t	*ngp;
+
+		if ((ngp = ngfind(p)) == (group_t *)NULL)
+		    return(FAIL);
+		groups[n] = p;
+		(void) sprintf(bfr, "XHDR message-id %ld-%ld",
+			       (long)ngp->ng_min, (long)ngp->ng_max);
+		tickets[n] = nntpsend(bfr, FALSE);
+		p = strtok((char *)NULL, ", ");
+	    }
+
+	    /* then pick up the answers, looking for our ID in each */
+	    for (i = 0; i < n; i++)
 	    {
-		if (*bfr == '.'  && strlen(bfr) == 1) 
+		if (nntpwait(tickets[i], bfr, sizeof(bfr)) != OK_HEAD)
 		    return(FAIL);
-		if (strindex(bfr, name) > -1)
-		{
-		    (void) sprintf(bufp, "%s/%s ", thisgroup, artnum);
-		    bufp += strlen(bufp);
-		    break;
-		}
-		else
-		    artnum++;
+		while (nntpget(bfr, sizeof(bfr)) >= 0
+		       && (q = strchr(bfr, ' ')) != (char *)NULL)
+		    if (strcmp(q + 1, name) == 0)
+		    {
+			*q = '\0';
+			(void) sprintf(hstline + strlen(hstline),
+				       "%s/%s ", groups[i], bfr);
+			break;
+		    }
+		nntpsync();
 	    }
-	    nntpsync();
-	} while
-	    ((thisgroup = strtok(NULL, " ")) != (char *)NULL);
+	}
     }
     artlstset(&hstlst, hstline);
     return(SUCCEED);
@@ -229,6 +734,11 @@ place_t    *exloc;
 void hstclose()
 /* close the history file -- really the connection to the NNTP server */
 {
+    register ahead_t	*ap;
+
+    for (ap = ahead; ap < ahead + NAHEAD; ap++)
+	aheaddrop(ap);
+    ovflush();
     nntpclose();
     (void) unlink(ACTIVE);
 }
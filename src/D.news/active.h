@@ -27,11 +27,6 @@ typedef struct	/* an element of the in-core group data table */
     char	*ng_defdist;	/* Default distributions */
 #endif
 
-#ifdef FEEDBITS
-    /* following information valid only after a feedbits() */
-    bits_t	ng_feeds;	/* subscription bits for news feeds */
-#endif	/* FEEDBITS */
-
 #ifdef MULTISOURCE
     /* this tells us how to get at an article's text */
     rconn_t	*rc_srctype;	/* method table for article source */
@@ -152,9 +147,30 @@ extern group_t *ngfind();	/* select a group by name */
 #define msgnum()	art.m_number
 
 #ifdef FEEDBITS
+/* feed subscription bitsets, valid only after a feedbits() */
+typedef unsigned long	fword_t;	/* a word of a feed bitset */
+
+typedef struct
+{
+    fword_t	*map;		/* the sets, nwords words per group */
+    int		nwords;		/* words in each set */
+    int		nfeeds;		/* count of feeds the sets have bits for */
+    int		ngroups;	/* count of leading groups that have sets */
+}
+feedmap_t;
+extern feedmap_t	feedmap;
+
+#define FWBITS		(sizeof(fword_t) * 8)
+#define FBWORDS(n)	(((n) + FWBITS - 1) / FWBITS)
+#define fbtest(set, n)	(((set)[(n) / FWBITS] >> ((n) % FWBITS)) & 1)
+#define fbset(set, n)	((set)[(n) / FWBITS] |= (fword_t)1 << ((n) % FWBITS))
+
 /* get or set feed subscription bits */
-#define ngfeed(gp, n)	(((gp)->ng_feeds >> (n)) & 1)
-#define ngmkfeed(gp, n)	((gp)->ng_feeds |= (1 << (n)))
+#define ngfeedok(gp, n)	((gp) - active.newsgroups < feedmap.ngroups \
+				&& (n) < feedmap.nfeeds)
+#define ngfeeds(gp)	(feedmap.map + ((gp) - active.newsgroups) * feedmap.nwords)
+#define ngfeed(gp, n)	fbtest(ngfeeds(gp), n)
+#define ngmkfeed(gp, n)	fbset(ngfeeds(gp), n)
 #endif /* FEEDBITS */
 
 /* methods for modifying current-group data */
@@ -187,18 +187,17 @@ char *idmake(file)
 char	*file;
 {
     static char	name[NAMELEN], timestamp[LONGLEN], hashrep[LONGLEN];
-    hdr_t	hh;
+    static hdr_t hh;	/* hfree() keeps its arena for the next call */
     FILE	*ofp, *fp;
     int 	status;
 
     if ((fp = fopen(file, "r")) == (FILE *)NULL)
 	return((char *)NULL);
 
-    (void) bzero(&hh, sizeof(hdr_t));
     if (hread(&hh, 0L, fp) == 0)
     {
 	(void) fclose(fp);
-        hfree(&hh);
+	hfree(&hh);
 	return((char *)NULL);
     }
 
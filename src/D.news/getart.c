@@ -33,6 +33,9 @@ article, prefixed by a character of status information. If RNESCAPES is enabled
 the format of the subject abstract part is macroexpanded from the environment
 variable SUBJLINE. Currently the only flag prefix character supported is '!'
 indicating an article that references some posting by the invoking user.
+Under NONLOCAL the header fields for the index line come from the server's
+overview data when it has any (see artoverview() in nntpread.c), so the
+article itself need not be fetched.
 
    The author() function tries to extract a human name for an article author
 out of the header's Reply-To and From lines.
@@ -218,7 +221,17 @@ char	*buf;
 
     loc.m_group = ngrp;
     loc.m_number = num;
-    if ((status = getart(&loc, &subjhdr, buf)) < 0)
+#ifdef NONLOCAL
+    if (subjhdr.h_fp != (FILE *)NULL)
+    {
+	(void) msgclose(subjhdr.h_fp);
+	subjhdr.h_fp = (FILE *)NULL;
+    }
+    hfree(&subjhdr);
+    if ((status = artoverview(ngrp, num, &subjhdr)) == FAIL)
+#endif /* NONLOCAL */
+	status = getart(&loc, &subjhdr, buf);
+    if (status < 0)
     {
 	buf[0] = I_NOART;
 	(void) arterr(status, &loc, &subjhdr, buf + 1);
@@ -12,6 +12,12 @@ SYNOPSIS
    int hread(hp, maxsize, fp)		-- read a header into core
    hdr_t *hp; int maxsize; FILE *fp;
 
+   int hparse(hp, text, len)		-- parse a header already in core
+   hdr_t *hp; char *text; int len;
+
+   int hoverview(hp, rec)		-- fill a header from an overview record
+   hdr_t *hp; char *rec;
+
    void hwrite(hp, fp, wr)		-- write a header to a file, B format
    hdr_t *hp; FILE *fp; int wr;
 
@@ -32,6 +38,17 @@ unbatching code.
    If the (long) second argument of hread() is nonzero, the read will abort
 if it goes over that number of characters without recognizing a full header.
 
+   The hparse() function does the same job as hread() for a header that is
+already in memory (say, a mapped file or an NNTP buffer); it takes the text
+and its length and returns the header length just as hread() does. The
+h_textoff of the result is the offset of the body within the text.
+
+   The hoverview() function fills in a header from an overview record, the
+tab-separated "number subject from date message-id references bytes lines"
+form served by NNTP XOVER. Only the Subject, From, Date, Message-ID,
+References and Lines fields are set. It returns FAIL if the record has no
+Message-ID, SUCCEED otherwise.
+
    The hwrite() function writes news headers to an output stream.
    If the (boolean) third argument of hwrite() is true, the Receipt-Date
 header will be written out along with the others.
@@ -65,6 +82,16 @@ before writing a header.
 article's actual length. Code that uses headers should assume that an (off_t)0
 in that field means the message text runs to EOF.
 
+   Both functions share a single-pass lexer. Each logical line is collected
+(continuations folded in, control characters dropped) in one scan, during
+which the header name is hashed; the line is then classified by one probe
+of a hash table built from the headers[] table. When hread() is given a plain
+file it reads ahead a block at a time and seeks back to the start of the body
+afterwards, so stdio is not called per character; on pipes and terminals it
+has to fall back on getc(), since only one character can be pushed back.
+   The value of a field is taken to start at the first non-blank after the
+colon. (The old code took it from the first blank anywhere on the line.)
+
    See comments in the code for more details.
 
 NOTES
@@ -75,12 +102,27 @@ It no longer forces message-id's to lower case.
    The hwrite() code prepends your local sitename to the Path if it's not
 already there. For this to work properly, sitenames() must have been called.
 
-   If the ALLOC_HDRS define is set in header.h, the implementation is
-changed to use malloc()ed lines for header text rather than a bunch of
+   If the ALLOCHDRS define is set in header.h, the implementation is
+changed to use variable-length lines for header text rather than a bunch of
 fixed-length buffers. Be warned that though other news modules generally use
-an interface that hides the difference, the ALLOC_HDRS version has not been
+an interface that hides the difference, the ALLOCHDRS version has not been
 tested in some time and may have bugs.
 
+   Header text read by hread() is not malloc()ed line by line. Each header
+block owns an arena (the h_store member) that holds all the text parsed into
+it; the unrecognized lines collected in h_other always live there, and with
+ALLOCHDRS on so do all the other header lines. An arena is a region (see
+region.c) that hfree() resets in one step, keeping it for the next hread();
+its memory is never given back.
+   With ALLOCHDRS on, the values of Newsgroups, Distribution, Followup-To,
+Organization and Content-Type lines are interned. Identical values in
+different articles share a single copy, up to a fixed limit of HINTERNMAX
+distinct values. Interned values and arena text must be treated as read-only
+by callers that may be working on a header read by hread(); in particular,
+strtok() a copy of them rather than the header line itself.
+   Lines set from outside this module with hlcpy() are still malloc()ed
+individually, and hlfree()/hfree() know to free those but not arena text.
+
    Support for A and 2.9 news headers (non RFC-1036) has been removed.
 
 REVISED BY
@@ -91,6 +133,7 @@ of protecting free redistribution; see the LICENSE file for details.
 *****************************************************************************/
 /*LINTLIBRARY*/
 #include "news.h"
+#include "region.h"
 #include "header.h"
 
 hdr_t header;	/* general-use header structure */
@@ -98,6 +141,118 @@ hdr_t header;	/* general-use header structure */
 private int hdrsize;	/* track the byte length of the header being read */
 private int hdrlineno;	/* track the current line of the header being read */
 
+/*
+ * Header text arenas. Each is a region (see region.c) chained onto the list
+ * of all of them through its rg_next link.
+ */
+#define HSTORESIZE	2048	/* initial size of a header arena */
+
+private region_t *hstores;	/* every arena we've made */
+
+private region_t *hsget(hp)
+/* return the arena of a given header, making it if need be */
+hdr_t	*hp;
+{
+    region_t	*st;
+
+    if ((st = hp->h_store) == (region_t *)NULL)
+    {
+	st = rgnew(HSTORESIZE);
+	st->rg_next = hstores;
+	hp->h_store = hstores = st;
+    }
+    return(st);
+}
+
+private bool hlowned(cp)
+/* is the given text in some header arena (rather than malloc()ed)? */
+char	*cp;
+{
+    register region_t	*st;
+
+    for (st = hstores; st; st = st->rg_next)
+	if (rgowns(st, cp))
+	    return(TRUE);
+    return(FALSE);
+}
+
+private char *hsave(hp, cp)
+/* copy a string into a header's arena */
+hdr_t	*hp;
+char	*cp;
+{
+    return(rgsave(hsget(hp), cp));
+}
+
+#ifdef ALLOCHDRS
+#define HINTERNSIZE	509	/* slots in the intern table (a prime) */
+#define HINTERNMAX	384	/* most values we'll intern */
+
+private char	*interned[HINTERNSIZE];	/* open-addressed intern table */
+private int	ninterned;		/* count of values in it */
+private hdr_t	internhdr;		/* its arena lives here */
+
+private char *hintern(hp, cp)
+/* return a shared copy of a common header value */
+hdr_t	*hp;
+char	*cp;
+{
+    register char	*sp;
+    register ulong	h = 0;
+
+    for (sp = cp; *sp; sp++)
+	h = (h << 5) + h + (uchar)*sp;
+    for (h %= HINTERNSIZE; interned[h]; h = (h + 1) % HINTERNSIZE)
+	if (strcmp(interned[h], cp) == 0)
+	    return(interned[h]);
+
+    /* if the table is full, this value just goes with the article */
+    if (ninterned >= HINTERNMAX)
+	return(hsave(hp, cp));
+    ninterned++;
+    return(interned[h] = hsave(&internhdr, cp));
+}
+
+private char *hscat(hp, hf, cp)
+/* return header line hf with cp and a space added, in hp's arena */
+hdr_t	*hp;
+char	*hf, *cp;
+{
+    int		oldlen = hf ? strlen(hf) : 0;
+    char	*new = rgtext(hsget(hp), oldlen + strlen(cp) + 2);
+
+    if (hf)
+	(void) strcpy(new, hf);
+    (void) strcpy(new + oldlen, cp);
+    (void) strcat(new + oldlen, " ");
+    return(new);
+}
+
+void hldrop(hf)
+/* release a header line, unless it lives in an arena */
+char	*hf;
+{
+    if (hf != (char *)NULL && !hlowned(hf))
+	(void) free(hf);
+}
+
+char *hlsave(hf, cp)
+/* replace header line hf with a malloc()ed copy of cp */
+char	*hf, *cp;
+{
+    hldrop(hf);
+    return(savestr(cp));
+}
+
+#define hlset(hp, hf, x)	(hf = hsave(hp, x))
+#define hlshare(hp, hf, x)	(hf = hintern(hp, x))
+#define hlappend(hp, hf, x)	(hf = hscat(hp, hf, x))
+#else
+#define hlset(hp, hf, x)	hlcpy(hf, x)
+#define hlshare(hp, hf, x)	hlcpy(hf, x)
+#define hlappend(hp, hf, x)	((void) strcat(hf, x), (void) strcat(hf, " "))
+#endif /* ALLOCHDRS */
+
 void hfree(hp)
 /* Free the allocated storage in a header block. */
 hdr_t	*hp;
@@ -130,15 +285,13 @@ hdr_t	*hp;
     if (hlnblank(hp->h_xref))		hlfree(hp->h_xref);
 #endif /* DOXREFS */
     if (hlnblank(hp->h_backrefs))	hlfree(hp->h_backrefs);
-    if (hp->h_other)
-    {
-	(void) free(hp->h_other);
-	hp->h_other = (char *)NULL;
-    }
+    hp->h_other = (char *)NULL;		/* it lives in the arena */
+    rgreset(hp->h_store);
     hp->h_exptime = hp->h_rectime = hp->h_posttime = (time_t) 0;
     hp->h_intnumlines = hp->h_intpriority = 0;
     hp->h_fp = (FILE *)NULL;
     hp->h_startoff = hp->h_endoff = hp->h_textoff = (off_t)0;
+    hp->h_bodysum[0] = '\0';
 }
 
 void happend(hp, cp)
@@ -146,23 +299,23 @@ void happend(hp, cp)
 hdr_t	*hp;
 char	*cp;
 {
-    char    *unrec;
-    int     oldsize = hp->h_other ? strlen(hp->h_other) : 0;
-    int     newsize = oldsize + strlen(cp) + 2;
+    region_t	*st = hsget(hp);
+    int		oldsize = hp->h_other ? strlen(hp->h_other) : 0;
+    int		addsize = strlen(cp) + 1;
 
-    if ((unrec = malloc((unsigned)newsize)) != (char *)NULL)
+    /* if h_other is the newest thing in the arena, grow it in place */
+    if (hp->h_other && rgextend(st, hp->h_other + oldsize + 1, addsize))
+	;
+    else
     {
-	if (oldsize == 0)
-	    unrec[0] = '\0';
-	else
-	{
+	char	*unrec = rgtext(st, oldsize + addsize + 1);
+
+	if (oldsize)
 	    (void) strcpy(unrec, hp->h_other);
-	    (void) free(hp->h_other);
-	}
-	(void) strcat(unrec, cp);
-	(void) strcat(unrec, "\n");
 	hp->h_other = unrec;
     }
+    (void) strcpy(hp->h_other + oldsize, cp);
+    (void) strcpy(hp->h_other + oldsize + addsize - 1, "\n");
 }
 
 /* ordinal values for header fields, returned by type() */
@@ -199,115 +352,123 @@ char	*cp;
 #define OTHER		99
 
 typedef struct {char *hname; int hval; char *offset;} symbol;
+
+/* the offset field holds the address of a line in the global header */
+#define HSLOT(f)	((char *)&header.f)
+#ifdef ALLOCHDRS
+#define hslot(p)	(*(char **)(p))
+#else
+#define hslot(p)	(p)
+#endif /* ALLOCHDRS */
 static symbol headers[] =
 {
-	{"Approved:",		APPROVED,	header.h_approved},
-	{"Back-References:",	BACKREFS,	header.h_backrefs},
+	{"Approved:",		APPROVED,	HSLOT(h_approved)},
+	{"Back-References:",	BACKREFS,	HSLOT(h_backrefs)},
 	{"Bcc:",		TO,		(char *)NULL},
 	{"Cc:",			TO,		(char *)NULL},
-	{"Content-Type:",	CONTENTTYPE,	header.h_contenttype},
-	{"Control:",		CONTROL,	header.h_ctlmsg},
+	{"Content-Type:",	CONTENTTYPE,	HSLOT(h_contenttype)},
+	{"Control:",		CONTROL,	HSLOT(h_ctlmsg)},
 	{"Date-Received:",	RECEIVED,	(char *)NULL},
-	{"Date:",		POSTDATE,	header.h_postdate},
-	{"Distribution:",	DISTRIBUTION,	header.h_distribution},
+	{"Date:",		POSTDATE,	HSLOT(h_postdate)},
+	{"Distribution:",	DISTRIBUTION,	HSLOT(h_distribution)},
 	{"Expires:",		EXPIREDATE,	(char *)NULL},
-	{"Followup-To:",	FOLLOWTO,	header.h_followto},
-	{"From:",		FROM,		header.h_from},
-	{"Keywords:",		KEYWORDS,	header.h_keywords},
+	{"Followup-To:",	FOLLOWTO,	HSLOT(h_followto)},
+	{"From:",		FROM,		HSLOT(h_from)},
+	{"Keywords:",		KEYWORDS,	HSLOT(h_keywords)},
 	{"Lines:",		NUMLINES,	(char *)NULL},
-	{"Message-ID:",		MESSAGEID,	header.h_ident},
-	{"News-Path:",		PATH,		header.h_path},
-	{"Newsgroups:",		NEWSGROUP,	header.h_newsgroups},
-	{"Nf-From:",		NFFROM,		header.h_nffrom},
-	{"Nf-ID:",		NFID,		header.h_nfid},
-	{"Organization:",	ORGANIZATION,	header.h_organization},
-	{"Path:",		PATH,		header.h_path},
-	{"Posted:",		POSTDATE,	header.h_postdate},
+	{"Message-ID:",		MESSAGEID,	HSLOT(h_ident)},
+	{"News-Path:",		PATH,		HSLOT(h_path)},
+	{"Newsgroups:",		NEWSGROUP,	HSLOT(h_newsgroups)},
+	{"Nf-From:",		NFFROM,		HSLOT(h_nffrom)},
+	{"Nf-ID:",		NFID,		HSLOT(h_nfid)},
+	{"Organization:",	ORGANIZATION,	HSLOT(h_organization)},
+	{"Path:",		PATH,		HSLOT(h_path)},
+	{"Posted:",		POSTDATE,	HSLOT(h_postdate)},
 	{"Posting-Version:",	IGNORE,		(char *)NULL},
 	{"Priority:",		PRIORITY,	(char *)NULL},
 	{"Received:",		RECEIVED,	(char *)NULL},
-	{"References:",		REFERENCES,	header.h_references},
+	{"References:",		REFERENCES,	HSLOT(h_references)},
 	{"Relay-Version:",	IGNORE,		(char *)NULL},
-	{"Reply-To:",		REPLYTO,	header.h_replyto},
-	{"Sender:",		SENDER,		header.h_sender},
+	{"Reply-To:",		REPLYTO,	HSLOT(h_replyto)},
+	{"Sender:",		SENDER,		HSLOT(h_sender)},
 	{"Status:",		IGNORE,		(char *)NULL},
-	{"Subject:",		SUBJECT,	header.h_subject},
-	{"Summary:",		SUMMARY,	header.h_summary},
-	{"Supersedes:",		SUPERSEDES,	header.h_supersedes},
-	{"Title:",		SUBJECT,	header.h_subject},
-	{"To:",			TO,		header.h_to},
+	{"Subject:",		SUBJECT,	HSLOT(h_subject)},
+	{"Summary:",		SUMMARY,	HSLOT(h_summary)},
+	{"Supersedes:",		SUPERSEDES,	HSLOT(h_supersedes)},
+	{"Title:",		SUBJECT,	HSLOT(h_subject)},
+	{"To:",			TO,		HSLOT(h_to)},
 #ifdef DOXREFS
-	{"Xref:",		XREF,		header.h_xref},
+	{"Xref:",		XREF,		HSLOT(h_xref)},
 #else
 	{"Xref:",		IGNORE,		(char *)NULL},
 #endif /* DOXREFS */
 	{(char *)NULL,		OTHER,		(char *)NULL}
 };
 
-private int nheaders = (sizeof headers / sizeof *headers) - 1 ;
+/*
+ * Header names are looked up by hashing the text before the colon. The hash
+ * is accumulated a character at a time while the line is being lexed, so
+ * classifying a line costs one table probe and one strncmp(). With this
+ * multiplier and table size the standard names happen not to collide, but
+ * we probe anyway so adding names to the table can't break anything.
+ */
+#define HNAMESIZE	128		/* slots in the name table (power of 2) */
+#define hnhash(h, c)	((h) * 21 + (c))
 
-char *hlget(ptr)
-/* return the value of a named header */
-register char	*ptr;
-{
-    /* bug: this returns failure inappropriately on integer-valued headers */
-    register symbol *ht, *ht1, *ht2;
+private symbol	*hnames[HNAMESIZE];	/* header-name hash table */
+private char	hcdrop[256];		/* control characters we throw away */
+private bool	hlexready;		/* are the above set up yet? */
 
-    /*
-     * ht1 is at the begining of the search area
-     * ht2 is one past the end.
-     */
-    for (ht1 = headers, ht2 = headers + nheaders; ht1 < ht2;) {
-	    register	i;
+private void hlexinit()
+/* build the lexer's tables */
+{
+    register symbol	*ht;
+    register char	*cp;
+    register unsigned	h;
 
-	    ht = ht1 + ((ht2 - ht1) / 2);
-	    if ((i = *ptr - *ht->hname) == 0 &&
-		(i = strncmp(ptr, ht->hname, strlen(ht->hname))) == 0)
-		    return(ht->offset);
-	    if (i < 0)
-		    ht2 = ht;
-	    else
-		    ht1 = ht+1;
+    for (ht = headers; ht->hname; ht++)
+    {
+	for (h = 0, cp = ht->hname; *cp != ':'; cp++)
+	    h = hnhash(h, *cp);
+	for (h %= HNAMESIZE; hnames[h]; h = (h + 1) % HNAMESIZE)
+	    continue;
+	hnames[h] = ht;
     }
-    return((char *) NULL);
-#ifdef notdef
-    register symbol *ht;
+    for (h = 0; h < sizeof(hcdrop); h++)
+	hcdrop[h] = (iscntrl(h) && h != '\b' && h != '\t');
+    hlexready = TRUE;
+}
 
-    for (ht = headers; ht->hname; ht++)
-	if (strncmp(ht->hname, ptr, strlen(ht->hname)) == 0)
-	    return(ht->offset);
-    return((char *)NULL);
-#endif
+private symbol *hnlookup(name, len, h)
+/* find the table entry for a header name of given length and hash */
+char		*name;
+int		len;
+register unsigned h;
+{
+    register symbol	*ht;
+
+    for (h %= HNAMESIZE; (ht = hnames[h]) != (symbol *)NULL; h = (h+1) % HNAMESIZE)
+	if (strncmp(ht->hname, name, len) == 0 && ht->hname[len] == ':')
+	    return(ht);
+    return((symbol *)NULL);
 }
 
-private int type(ptr)
+char *hlget(ptr)
+/* return the value of a named header */
 register char	*ptr;
 {
-    register symbol *ht, *ht1, *ht2;
-
-    /*
-     * ht1 is at the begining of the search area
-     * ht2 is one past the end.
-     */
-    for (ht1 = headers, ht2 = headers + nheaders; ht1 < ht2;) {
-	    register	i;
+    /* bug: this returns failure inappropriately on integer-valued headers */
+    register symbol	*ht;
+    register char	*cp;
+    register unsigned	h = 0;
 
-	    ht = ht1 + ((ht2 - ht1) / 2);
-	    if ((i = *ptr - *ht->hname) == 0 &&
-		(i = strncmp(ptr, ht->hname, strlen(ht->hname))) == 0)
-		    return(ht->hval);
-	    if (i < 0)
-		    ht2 = ht;
-	    else
-		    ht1 = ht+1;
-    }
-    return(OTHER);
-#ifdef notdef
-    for (ht = headers; ht->hname; ht++)
-	if (strncmp(ht->hname, ptr, strlen(ht->hname)) == 0)
-	    return(ht->hval);
-    return(OTHER);
-#endif
+    if (!hlexready)
+	hlexinit();
+    for (cp = ptr; *cp && *cp != ':'; cp++)
+	h = hnhash(h, *cp);
+    if (*cp != ':' || (ht = hnlookup(ptr, cp - ptr, h)) == (symbol *)NULL)
+	return((char *)NULL);
+    return(ht->offset ? hslot(ht->offset) : (char *)NULL);
 }
 
 private time_t cgtdate(date)
@@ -337,48 +498,25 @@ char *date;
     return(lasttime);
 }
 
-private int addhline(hp, cp)
-/* add a new line to the given header */
+private void hfield(hp, t, cp, ptr)
+/* set the field of type t from the line cp, whose value starts at ptr */
 register hdr_t	*hp;
-char		*cp;
+int		t;
+char		*cp, *ptr;
 {
-    char    *ptr, *colon;
-    
-    if (!isalpha(*cp) || (colon = strchr(cp, ':')) == (char *)NULL)
-	return(FAIL);
-    else if ((ptr = strchr(cp, ' ')) == (char *)NULL)
-	ptr = colon + 1;
-    else
-	while (isspace(*++ptr))
-	    continue;
-
-    /* if there's nothing there, skip this field */
-    if (*ptr == '\0' || *ptr == '\n')
-	return(SUCCEED);
-
-    (void) nstrip(ptr);	/* suppress any trailing \n */
-
-    switch(type(cp))
+    switch(t)
     {
-    case FAIL:		return(FAIL);
     case IGNORE:	break;
     case TO:		hlfree(hp->h_to);	/* fall through to CC case */
-    case CC:		{
-#ifdef ALLOCHDRS
-			   hlcat(hp->to, ptr, " ");
-#else
-			   (void) strcat(hp->h_to, ptr);
-			   (void) strcat(hp->h_to, " ");
-#endif /* ALLOCHDRS */
-			}
-			break;
-    case PATH:		if (hlblank(hp->h_path)) hlcpy(hp->h_path,ptr); break;
-    case FROM:		if (hlblank(hp->h_from)) hlcpy(hp->h_from,ptr); break;
-    case NEWSGROUP: 	if (hlblank(hp->h_newsgroups)) hlcpy(hp->h_newsgroups,ptr); break;
-    case SUBJECT: 	if (hlblank(hp->h_subject))hlcpy(hp->h_subject,ptr);break;
-    case MESSAGEID:	if (hlblank(hp->h_ident))hlcpy(hp->h_ident,ptr);break;
+    case CC:		hlappend(hp, hp->h_to, ptr); break;
+    case PATH:		if (hlblank(hp->h_path)) hlset(hp, hp->h_path, ptr); break;
+    case FROM:		if (hlblank(hp->h_from)) hlset(hp, hp->h_from, ptr); break;
+    case NEWSGROUP:
+	if (hlblank(hp->h_newsgroups)) hlshare(hp, hp->h_newsgroups, ptr);break;
+    case SUBJECT: 	if (hlblank(hp->h_subject))hlset(hp, hp->h_subject, ptr);break;
+    case MESSAGEID:	if (hlblank(hp->h_ident))hlset(hp, hp->h_ident, ptr);break;
     case POSTDATE: 
-	if (hlblank(hp->h_postdate)) hlcpy(hp->h_postdate, ptr);
+	if (hlblank(hp->h_postdate)) hlset(hp, hp->h_postdate, ptr);
 	hp->h_posttime = cgtdate(hp->h_postdate);
 	break;
     case RECEIVED:
@@ -386,135 +524,208 @@ char		*cp;
 	    hp->h_rectime = cgtdate(ptr);
 	break;
     case EXPIREDATE:
-	if (hlblank(hp->h_expdate)) hlcpy(hp->h_expdate, ptr);
+	if (hlblank(hp->h_expdate)) hlset(hp, hp->h_expdate, ptr);
 	hp->h_exptime = cgtdate(hp->h_expdate);
 	break;
     case REFERENCES:
-	if (hlblank(hp->h_references)) hlcpy(cp = hp->h_references, ptr);
+	if (hlblank(hp->h_references)) hlset(hp, hp->h_references, ptr);
 	break;
-    case CONTROL: if (hlblank(hp->h_ctlmsg)) hlcpy(hp->h_ctlmsg,ptr); break;
-    case SENDER:  if (hlblank(hp->h_sender)) hlcpy(hp->h_sender,ptr); break;
-    case REPLYTO: if (hlblank(hp->h_replyto))hlcpy(hp->h_replyto,ptr);break;
-    case FOLLOWTO:if (hlblank(hp->h_followto))hlcpy(hp->h_followto,ptr);break;
+    case CONTROL: if (hlblank(hp->h_ctlmsg)) hlset(hp, hp->h_ctlmsg, ptr); break;
+    case SENDER:  if (hlblank(hp->h_sender)) hlset(hp, hp->h_sender, ptr); break;
+    case REPLYTO: if (hlblank(hp->h_replyto))hlset(hp, hp->h_replyto, ptr);break;
+    case FOLLOWTO:if (hlblank(hp->h_followto))hlshare(hp, hp->h_followto, ptr);break;
     case DISTRIBUTION:
-	if (hlblank(hp->h_distribution)) hlcpy(hp->h_distribution, ptr);break;
+	if (hlblank(hp->h_distribution)) hlshare(hp, hp->h_distribution, ptr);break;
     case ORGANIZATION: 
-	if (hlblank(hp->h_organization)) hlcpy(hp->h_organization, ptr);break;
+	if (hlblank(hp->h_organization)) hlshare(hp, hp->h_organization, ptr);break;
     case NUMLINES:  hp->h_intnumlines = atoi(ptr); break;
     case KEYWORDS:
-	if (hlblank(hp->h_keywords)) hlcpy(hp->h_keywords, ptr); break;
+	if (hlblank(hp->h_keywords)) hlset(hp, hp->h_keywords, ptr); break;
     case SUMMARY:
-	if (hlblank(hp->h_summary)) hlcpy(hp->h_summary, ptr); break;
+	if (hlblank(hp->h_summary)) hlset(hp, hp->h_summary, ptr); break;
     case PRIORITY:  hp->h_intpriority = atoi(ptr); break;
     case APPROVED:
-	if (hlblank(hp->h_approved)) hlcpy(hp->h_approved, ptr); break;
+	if (hlblank(hp->h_approved)) hlset(hp, hp->h_approved, ptr); break;
     case SUPERSEDES:
-	if (hlblank(hp->h_supersedes)) hlcpy(cp = hp->h_supersedes, ptr);
+	if (hlblank(hp->h_supersedes)) hlset(hp, hp->h_supersedes, ptr);
 	break;
     case CONTENTTYPE:
-	if (hlblank(hp->h_contenttype)) hlcpy(hp->h_contenttype, ptr); break;
+	if (hlblank(hp->h_contenttype)) hlshare(hp, hp->h_contenttype, ptr); break;
 #ifdef ZAPNOTES
-    case NFID:	    if (hlblank(hp->h_nfid)) hlcpy(hp->h_approved, ptr);break;
+    case NFID:	    if (hlblank(hp->h_nfid)) hlset(hp, hp->h_approved, ptr);break;
     case NFFROM:
-	if (hlblank(hp->h_nffrom)) hlcpy(hp->h_approved, ptr); break;
+	if (hlblank(hp->h_nffrom)) hlset(hp, hp->h_approved, ptr); break;
 #endif /* ZAPNOTES */
     case BACKREFS:
-	if (hlblank(hp->h_backrefs)) hlcpy(cp = hp->h_backrefs, ptr);
+	if (hlblank(hp->h_backrefs)) hlset(hp, hp->h_backrefs, ptr);
 	break;
 #ifdef DOXREFS
     case XREF:
-	if (hlblank(hp->h_xref)) hlcpy(hp->h_xref, ptr); break;
+	if (hlblank(hp->h_xref)) hlset(hp, hp->h_xref, ptr); break;
 #endif /* DOXREFS */
     case OTHER:
 	happend(hp, cp);
 	break;
     }
     hdrlineno++;
-    return(SUCCEED);
 }
 
-private char *hfgets(buf, len, fp)
 /*
- * hfgets() is like fgets(), but deals with continuation lines.
- * It also ensures that even if a line that is too long is
- * received, the remainder of the line is thrown away
- * instead of treated like a second line. Also, for each character
- * read it increments hdrsize.
+ * The lexer's input. Text is taken from the buffer until it runs dry, then
+ * refilled from the stream (if any). When the stream is a plain file we read
+ * ahead a block at a time and seek back to the end of the header when done;
+ * otherwise (pipes, terminals) we can only afford to read a character at a
+ * time, since exactly one character can be pushed back.
  */
-char *buf;
-int len;
-FILE *fp;
+#define HLEXBUF		BUFSIZ
+
+typedef struct
 {
-    register int    c;
-    register int    n = 0;
-    register char  *cp;
+    FILE	*fp;		/* stream to refill from, NULL for in-core text */
+    bool	ahead;		/* TRUE if we may read past the header */
+    bool	eof;		/* TRUE if we've hit the end of the text */
+    char	*ptr, *end;	/* unlexed text in the buffer */
+    long	taken;		/* count of bytes taken into the buffer */
+    char	buf[HLEXBUF];	/* buffer for text read from the stream */
+}
+hlex_t;
 
-    /* first, fill the supplied buffer with characters */
-    cp = buf;
-    while (n < len && (c = getc(fp)) != EOF)
-    {
-	hdrsize++;
-	if (c == '\n')
-	    break;
-	if (!iscntrl(c) || c == '\b' || c == '\t')
-	{
-	    *cp++ = c;
-	    n++;
-	}
-    }
-    if (c == EOF && cp == buf)
-	return((char *)NULL);
-    *cp = '\0';
+#define hgetc(lx)	((lx)->ptr < (lx)->end ? *(lx)->ptr++ & 0xff : hfill(lx))
+#define hungetc(lx)	((lx)->ptr--)		/* only after a non-EOF hgetc */
+#define hlexed(lx)	((lx)->taken - ((lx)->end - (lx)->ptr))
 
-    if (c != '\n')
+private int hfill(lx)
+/* refill the lexer's buffer and return the next character */
+register hlex_t	*lx;
+{
+    register int	n = 0;
+
+    if (lx->fp == (FILE *)NULL || lx->eof)
+	n = 0;
+    else if (lx->ahead)
+	n = fread(lx->buf, sizeof(char), sizeof(lx->buf), lx->fp);
+    else if ((n = getc(lx->fp)) != EOF)
     {
-	/* Line too long - throw away the rest */
-	while ((c = getc(fp)) != '\n' && c != EOF)
-	    hdrsize++;
-	if (c == '\n')
-	    hdrsize++;
+	lx->buf[0] = n;
+	n = 1;
     }
-    else if (cp == buf)
+
+    if (n <= 0)
     {
-	/* Don't look for continuation of blank lines */
-	*cp++ = '\n';
-	*cp = '\0';
-	return buf;
+	lx->eof = TRUE;
+	return(EOF);
     }
+    lx->taken += n;
+    lx->ptr = lx->buf;
+    lx->end = lx->buf + n;
+    return(*lx->ptr++ & 0xff);
+}
 
-    while ((c = getc (fp)) == ' ' || c == '\t')	    /* for each cont line */
-    {
-	hdrsize++;
+private int hlexline(lx, buf, len, valp)
+/*
+ * Lex one logical header line (continuations included) into buf, dropping
+ * control characters other than backspace and tab and silently truncating
+ * at len. Return the line's type, or FAIL at the blank line (or non-header
+ * line, or EOF) that ends the header. The value, with leading and trailing
+ * white space stripped, is returned through valp; for OTHER lines the whole
+ * line in buf is wanted.
+ */
+register hlex_t	*lx;
+char		*buf;
+int		len;
+char		**valp;
+{
+    register int	c;
+    register char	*cp = buf, *lim = buf + len - 1;
+    register unsigned	h = 0;
+    char		*colon = (char *)NULL, *vp;
+    symbol		*ht;
 
-	/* Continuation line. */
-	if ((n += 2) < len)
+    /* the first physical line; hash the name as it goes by */
+    while ((c = hgetc(lx)) != '\n' && c != EOF)
+	if (!hcdrop[c] && cp < lim)
 	{
-	    *cp++ = '\n';
+	    if (colon == (char *)NULL)
+		if (c == ':')
+		    colon = cp;
+		else
+		    h = hnhash(h, c);
 	    *cp++ = c;
 	}
-	while ((c = getc(fp)) != '\n' && c != EOF)
+    if (cp == buf)
+	return(FAIL);		/* EOF, or the blank line ending the header */
+
+    /* now any continuation lines */
+    while (c != EOF && ((c = hgetc(lx)) == ' ' || c == '\t'))
+    {
+	if (cp < lim - 1)
 	{
-	    hdrsize++;
-	    if ((!iscntrl (c) || c == '\b' || c == '\t') && n++ < len)
-		*cp++ = c;
+	    *cp++ = '\n';
+	    *cp++ = c;
 	}
-	if (c != EOF)
-	    hdrsize++;
+	while ((c = hgetc(lx)) != '\n' && c != EOF)
+	    if (!hcdrop[c] && cp < lim)
+	    {
+		if (colon == (char *)NULL && c == ':')
+		    colon = cp;
+		*cp++ = c;
+	    }
     }
-/*
-   if (c != EOF)
-	hdrsize++;
-*/
-    if (n >= len - 1)
-	cp = buf + len - 2;
-    *cp++ = '\n';
-    *cp = '\0';
     if (c != EOF)
+	hungetc(lx);		/* push back first char of next header */
+
+    /* strip trailing white space, then find the value */
+    while (cp > buf && isspace(cp[-1]))
+	cp--;
+    *cp = '\0';
+    if (!isalpha(buf[0]) || colon == (char *)NULL)
+	return(FAIL);
+    for (vp = colon + 1; isspace(*vp); vp++)
+	continue;
+    if (*(*valp = vp) == '\0')
+	return(IGNORE);		/* if there's nothing there, skip this field */
+
+    if ((ht = hnlookup(buf, colon - buf, h)) == (symbol *)NULL)
+	return(OTHER);
+    return(ht->hval);
+}
+
+private int hlex(hp, lx, maxsize)
+/* lex a header into *hp; return its length if okay, else 0 */
+register hdr_t	*hp;
+register hlex_t	*lx;
+long		maxsize;
+{
+    char	lbuf[LBUFLEN];	/* sizeof(lbuf) = longest line we can handle */
+    char	*val;
+    int		t;
+
+    if (!hlexready)
+	hlexinit();
+    hdrlineno = 1;
+    while ((t = hlexline(lx, lbuf, sizeof(lbuf) - 1, &val)) != FAIL)
     {
-	(void) ungetc(c, fp);	/* push back first char of next header */
-/*	hdrsize--;	*/
+	hfield(hp, t, lbuf, val);
+	if (maxsize && hlexed(lx) > maxsize)
+	    break;
     }
-    return(buf);
+    hdrsize = hlexed(lx);
+
+    /* give back whatever we read past the end of the header */
+    if (lx->fp != (FILE *)NULL && lx->ptr < lx->end)
+	if (lx->ahead)
+	    (void) fseek(lx->fp, hp->h_startoff + hdrsize, SEEK_SET);
+	else
+	    (void) ungetc(*lx->ptr, lx->fp);
+
+    if (maxsize && hdrsize > maxsize)
+	return(0);
+
+    /* we don't check for all the RFC-1036 required headers here */
+    if (hlblank(hp->h_from) || hlblank(hp->h_path) || hp->h_posttime == 0)
+	return(0);
+
+    return(hdrsize);
 }
 
 int hread(hp, maxsize, fp)
@@ -526,29 +737,80 @@ register hdr_t *hp;
 long maxsize;
 FILE *fp;
 {
-    char lbuf[LBUFLEN];		/* sizeof(lbuf) = longest line we can handle */
-    forward static int addhline();
-    
+    hlex_t	lx;
+    struct stat	st;
+    int		size;
+
     if (fp == (FILE *)NULL)
 	return(0);
     else
 	hp->h_fp = fp;
 
-    hdrsize = 0;
-    hdrlineno = 1;
     hp->h_startoff = ftell(fp);
-    while (hfgets(lbuf, sizeof(lbuf) - 1, fp) != (char *)NULL)
-	if (addhline(hp, lbuf) == FAIL)
-	    break;
-        else if (maxsize && (hdrsize > maxsize))
-	    return(0);
+    lx.fp = fp;
+    lx.ahead = (hp->h_startoff >= 0
+		&& fstat(fileno(fp), &st) == 0
+		&& (st.st_mode & S_IFMT) == S_IFREG);
+    lx.eof = FALSE;
+    lx.ptr = lx.end = lx.buf;
+    lx.taken = 0L;
+    size = hlex(hp, &lx, maxsize);
     hp->h_textoff = ftell(fp);
+    return(size);
+}
 
-    /* we don't check for all the RFC-1036 required headers here */
-    if (hlblank(hp->h_from) || hlblank(hp->h_path) || hp->h_posttime == 0)
-	return(0);
+int hparse(hp, text, len)
+/*
+ * Parse a header from len bytes of in-core (or mapped) text into *hp.
+ * Return header length if header okay, else 0.
+ */
+register hdr_t *hp;
+char	*text;
+int	len;
+{
+    hlex_t	lx;
+    int		size;
 
-    return(hdrsize);
+    hp->h_startoff = (off_t)0;
+    lx.fp = (FILE *)NULL;
+    lx.ahead = lx.eof = FALSE;
+    lx.ptr = text;
+    lx.end = text + len;
+    lx.taken = len;
+    size = hlex(hp, &lx, 0L);
+    hp->h_textoff = (off_t)hdrsize;
+    return(size);
+}
+
+int hoverview(hp, rec)
+/* fill in a header from an overview record */
+register hdr_t	*hp;
+char		*rec;
+{
+    char	*field[OVFIELDS], copy[LBUFLEN], *cp;
+    int		n;
+
+    (void) strncpy(copy, rec, sizeof(copy) - 1);
+    copy[sizeof(copy) - 1] = '\0';
+    for (n = 0, cp = copy; n < OVFIELDS && cp != (char *)NULL; n++)
+    {
+	field[n] = cp;
+	if ((cp = strchr(cp, '\t')) != (char *)NULL)
+	    *cp++ = '\0';
+    }
+    if (n <= OV_IDENT || field[OV_IDENT][0] == '\0')
+	return(FAIL);
+
+    hlset(hp, hp->h_subject, field[OV_SUBJECT]);
+    hlset(hp, hp->h_from, field[OV_FROM]);
+    hlset(hp, hp->h_postdate, field[OV_DATE]);
+    hp->h_posttime = cgtdate(hp->h_postdate);
+    hlset(hp, hp->h_ident, field[OV_IDENT]);
+    if (n > OV_REFS && field[OV_REFS][0])
+	hlset(hp, hp->h_references, field[OV_REFS]);
+    if (n > OV_LINES)
+	hp->h_intnumlines = atoi(field[OV_LINES]);
+    return(SUCCEED);
 }
 
 void hwrite(hp, fp, wr)
@@ -672,4 +934,236 @@ hdr_t *hp;
     return(pathbuf);
 }
 
+#ifdef PROFILE
+/*
+ * The old header reader, kept here so the lexer can be timed against it:
+ * hfgets() did the line reading a getc() at a time, then addhline() found
+ * the colon and value with strchr() and classified the line by binary search.
+ */
+private int nheaders = (sizeof headers / sizeof *headers) - 1 ;
+
+private int otype(ptr)
+/* the old binary search of the header table */
+register char	*ptr;
+{
+    register symbol *ht, *ht1, *ht2;
+
+    /*
+     * ht1 is at the begining of the search area
+     * ht2 is one past the end.
+     */
+    for (ht1 = headers, ht2 = headers + nheaders; ht1 < ht2;) {
+	    register	i;
+
+	    ht = ht1 + ((ht2 - ht1) / 2);
+	    if ((i = *ptr - *ht->hname) == 0 &&
+		(i = strncmp(ptr, ht->hname, strlen(ht->hname))) == 0)
+		    return(ht->hval);
+	    if (i < 0)
+		    ht2 = ht;
+	    else
+		    ht1 = ht+1;
+    }
+    return(OTHER);
+}
+
+private char *ohfgets(buf, len, fp)
+/*
+ * The old hfgets() was like fgets(), but deals with continuation lines.
+ * It also ensured that even if a line that is too long is
+ * received, the remainder of the line is thrown away
+ * instead of treated like a second line. Also, for each character
+ * read it increments hdrsize.
+ */
+char *buf;
+int len;
+FILE *fp;
+{
+    register int    c;
+    register int    n = 0;
+    register char  *cp;
+
+    /* first, fill the supplied buffer with characters */
+    cp = buf;
+    while (n < len && (c = getc(fp)) != EOF)
+    {
+	hdrsize++;
+	if (c == '\n')
+	    break;
+	if (!iscntrl(c) || c == '\b' || c == '\t')
+	{
+	    *cp++ = c;
+	    n++;
+	}
+    }
+    if (c == EOF && cp == buf)
+	return((char *)NULL);
+    *cp = '\0';
+
+    if (c != '\n')
+    {
+	/* Line too long - throw away the rest */
+	while ((c = getc(fp)) != '\n' && c != EOF)
+	    hdrsize++;
+	if (c == '\n')
+	    hdrsize++;
+    }
+    else if (cp == buf)
+    {
+	/* Don't look for continuation of blank lines */
+	*cp++ = '\n';
+	*cp = '\0';
+	return buf;
+    }
+
+    while ((c = getc (fp)) == ' ' || c == '\t')	    /* for each cont line */
+    {
+	hdrsize++;
+
+	/* Continuation line. */
+	if ((n += 2) < len)
+	{
+	    *cp++ = '\n';
+	    *cp++ = c;
+	}
+	while ((c = getc(fp)) != '\n' && c != EOF)
+	{
+	    hdrsize++;
+	    if ((!iscntrl (c) || c == '\b' || c == '\t') && n++ < len)
+		*cp++ = c;
+	}
+	if (c != EOF)
+	    hdrsize++;
+    }
+/*
+   if (c != EOF)
+	hdrsize++;
+*/
+    if (n >= len - 1)
+	cp = buf + len - 2;
+    *cp++ = '\n';
+    *cp = '\0';
+    if (c != EOF)
+    {
+	(void) ungetc(c, fp);	/* push back first char of next header */
+/*	hdrsize--;	*/
+    }
+    return(buf);
+}
+
+private int oread(hp, fp)
+/* read a header the old way */
+register hdr_t *hp;
+FILE *fp;
+{
+    char lbuf[LBUFLEN], *ptr, *colon;
+
+    hp->h_fp = fp;
+    hdrsize = 0;
+    hp->h_startoff = ftell(fp);
+    while (ohfgets(lbuf, sizeof(lbuf) - 1, fp) != (char *)NULL)
+    {
+	if (!isalpha(lbuf[0]) || (colon = strchr(lbuf, ':')) == (char *)NULL)
+	    break;
+	else if ((ptr = strchr(lbuf, ' ')) == (char *)NULL)
+	    ptr = colon + 1;
+	else
+	    while (isspace(*++ptr))
+		continue;
+	if (*ptr == '\0' || *ptr == '\n')
+	    continue;
+	(void) nstrip(ptr);
+	hfield(hp, otype(lbuf), lbuf, ptr);
+    }
+    hp->h_textoff = ftell(fp);
+    return(hdrsize);
+}
+
+char *Progname = "profheader";
+
+private void report(what, count, start)
+char	*what;
+long	count;
+time_t	start;
+{
+    time_t	secs = time((time_t *)NULL) - start;
+
+    (void) printf("%-24s %8ld headers in %4ld secs, %8ld headers/sec\n",
+		  what, count, (long)secs, count / (secs ? secs : 1));
+}
+
+main(argc, argv)
+/*
+ * A speed tester for the header lexer. Takes an iteration count and one or
+ * more article files. Each file is parsed that many times by the old reader,
+ * by hread() and by hparse() on an in-core copy, and the rate in headers/sec
+ * is reported for each. Compile with -p as well to see where the time goes.
+ */
+int	argc;
+char	*argv[];
+{
+    long	iterations, count, i;
+    int		nfiles = argc - 2, f;
+    FILE	**fps;
+    char	**texts;
+    int		*lens;
+    time_t	start;
+
+    if (argc < 3)
+    {
+	(void) fprintf(stderr, "usage: profheader iterations file...\n");
+	exit(1);
+    }
+    iterations = atol(argv[1]);
+    fps = (FILE **)calloc((unsigned)nfiles, sizeof(FILE *));
+    texts = (char **)calloc((unsigned)nfiles, sizeof(char *));
+    lens = (int *)calloc((unsigned)nfiles, sizeof(int));
+    for (f = 0; f < nfiles; f++)
+    {
+	if ((fps[f] = fopen(argv[f + 2], "r")) == (FILE *)NULL)
+	{
+	    (void) fprintf(stderr, "profheader: can't open %s\n", argv[f + 2]);
+	    exit(1);
+	}
+	lens[f] = (int)filesize(argv[f + 2]);
+	texts[f] = malloc((unsigned)lens[f] + 1);
+	lens[f] = fread(texts[f], sizeof(char), lens[f], fps[f]);
+    }
+
+    count = 0;
+    start = time((time_t *)NULL);
+    for (i = 0; i < iterations; i++)
+	for (f = 0; f < nfiles; f++, count++)
+	{
+	    hfree(&header);
+	    (void) fseek(fps[f], 0L, SEEK_SET);
+	    (void) oread(&header, fps[f]);
+	}
+    report("hfgets()/type()", count, start);
+
+    count = 0;
+    start = time((time_t *)NULL);
+    for (i = 0; i < iterations; i++)
+	for (f = 0; f < nfiles; f++, count++)
+	{
+	    hfree(&header);
+	    (void) fseek(fps[f], 0L, SEEK_SET);
+	    (void) hread(&header, 0L, fps[f]);
+	}
+    report("hread()", count, start);
+
+    count = 0;
+    start = time((time_t *)NULL);
+    for (i = 0; i < iterations; i++)
+	for (f = 0; f < nfiles; f++, count++)
+	{
+	    hfree(&header);
+	    (void) hparse(&header, texts[f], lens[f]);
+	}
+    report("hparse()", count, start);
+
+    exit(0);
+}
+#endif /* PROFILE */
+
 /* header.c ends here */
@@ -49,12 +49,14 @@ typedef struct
     off_t	h_startoff;	/* start offset of article in file */
     off_t	h_textoff;	/* start offset of article body in file */
     off_t	h_endoff;	/* end offset of article in file */
+    char	h_bodysum[CKSUMLEN];	/* fingerprint of the body, if known */
+    struct region *h_store;	/* arena holding this header's text */
 }
 hdr_t;
 
 #ifdef ALLOCHDRS
-#define hlcpy(hf, x)	((hf) ? free(hf) : (char *)NULL, hf = savestr(x))
-#define hlfree(x)	(void) (free(x), x = (char *)NULL)
+#define hlcpy(hf, x)	(hf = hlsave(hf, x))
+#define hlfree(x)	(void) (hldrop(x), x = (char *)NULL)
 #define hlblank(hf)	(hf == (char *)NULL)
 #define hlnblank(hf)	(hf != (char *)NULL)
 #else
@@ -66,11 +68,28 @@ hdr_t;
 
 extern void hfree();		/* free the allocated storage of a header */
 extern int hread();		/* read a B format header, return length */
+extern int hparse();		/* parse an in-core header, return length */
+extern int hoverview();		/* fill a header from an overview record */
 extern void hwrite();		/* write a header to a stream */
 extern char *hlget();		/* look up a header by name */
 extern void happend();		/* add 'unrecognized' lines to a header */
+#ifdef ALLOCHDRS
+extern char *hlsave();		/* replace a header line with a copy */
+extern void hldrop();		/* release a header line */
+#endif /* ALLOCHDRS */
 extern char *tailpath();	/* return a short form of a sender's name */
 
+/* fields of an overview record, as in NNTP XOVER responses */
+#define OV_NUMBER	0
+#define OV_SUBJECT	1
+#define OV_FROM		2
+#define OV_DATE		3
+#define OV_IDENT	4
+#define OV_REFS		5
+#define OV_BYTES	6
+#define OV_LINES	7
+#define OVFIELDS	8
+
 extern hdr_t header;	/* scratch header for everyone's use */
 
 /* header.h ends here */
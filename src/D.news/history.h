@@ -36,6 +36,8 @@ extern int hstseek();		/* select a history entry by name */
 #define hstid()		chstname
 #define hstdate()	chstdate
 #define hstexp()	chstexpd
+#define hstpost()	chstpost
+#define hstfrom()	chstfrom
 #define hstat()		chstatus
 #define hstline()	chline
 #define hstattr()	hstlst.l_this
@@ -44,6 +46,7 @@ extern int hstloc();	    /* get the next article location */
 /* ways to modify the current entry data */
 extern int hstexpire();	    /* drop the current article location */
 extern int hstadd();	    /* add a location to the list */
+extern int hstaddh();	    /* same, recording metadata from a header */
 extern char *hstfile();	    /* find an article file by ID */
 extern void hstparent();    /* mark the parents of a given header */
 #define hstcancel(id)	  (void)hstadd(id,(time_t)0,(time_t)0,CANCEL_TOKEN,(nart_t)FAIL)
@@ -56,6 +59,8 @@ extern void hstparent();    /* mark the parents of a given header */
 extern char chstname[];		/* ID of the current record */
 extern time_t chstdate;		/* receipt date of the current record */
 extern time_t chstexpd;		/* expire date of the current record */
+extern time_t chstpost;		/* post date of the current record */
+extern ulong chstfrom;		/* checksum of its From line */
 extern int chstatus;		/* status of the last hstparse() */
 
 /*
@@ -129,8 +129,17 @@ extern char *getactive();
 extern char *getgroups();
 extern char *getdistribs();
 extern int net_post();
+extern void artahead();
+extern int artoverview();
+extern void artdone();
 #endif /* NONLOCAL */
 
+/* these are from ngmatch.c */
+typedef struct ngnode	*ngpat_t;	/* a compiled subscription list */
+extern ngpat_t ngcompile();
+extern bool ngexec();
+extern void ngfree();
+
 /* these are from escapes.c */
 #define RNESCCHR	'%'	/* escape character for builtin expansion */
 extern void escapes();		/* expand C-style escapes */
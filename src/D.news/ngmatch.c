@@ -7,6 +7,15 @@ SYNOPSIS
    bool ngmatch(nglist, sublist)	-- match groups against subscriptions
    register char *nglist, *sublist;
 
+   ngpat_t ngcompile(sublist)		-- compile a subscription list
+   char *sublist;
+
+   bool ngexec(pat, nglist)		-- match groups against compiled list
+   ngpat_t pat; char *nglist;
+
+   void ngfree(pat)			-- release a compiled list
+   ngpat_t pat;
+
 DESCRIPTION
    If nglist is a list of newsgroups, and sublist is a list of subscriptions,
 then ngmatch(nglist, sublist) will return TRUE if some one of the groups in
@@ -53,6 +62,24 @@ happen if your braces are not balanced!
 Thus, you can format a subscription string with tabs and \<NL> digraphs
 and it will still be interpreted properly.
 
+   A subscription list is matched by first compiling it with ngcompile()
+into a trie over name segments. Braces are expanded (so the trie holds
+comp.sources.unix and comp.sources.mac for the example above) and each
+resulting subscription is entered under its segments, any and all becoming
+wildcard edges; the node where a subscription ends records its position in
+the list and whether it was an exclusion. Since each subscription that
+matches overrides all earlier ones, a group is accepted just if the last
+subscription matching it is not an exclusion. The ngexec() function splits
+each group in nglist into segments once and walks the trie with them,
+tracking the latest subscription passed; it returns TRUE as soon as some
+group is accepted. The ngfree() function releases a compiled list.
+
+   The ngmatch() function is ngcompile() followed by ngexec(), with the last
+NGCACHE compiled lists kept (by content, least recently used dropped) so
+that callers looping over groups or articles with the same subscription
+list don't recompile it. Callers that hold a list for a long time may as
+well compile it themselves.
+
 NOTE
    The 'all' prefix used to match segments only. The change was deliberate,
 for 2 reasons: 1) if you used to subscribe to all.foo you probably want
@@ -61,6 +88,13 @@ connotations of 'any' and 'all' in English fit this scheme better. Due to
 the rule that 'X matches G <=> X matches G.anything', foo.any and foo.all
 are equivalent.
 
+   Three corner cases differ from the old string-walking matcher. An
+exclusion inside braces now excludes exactly as if the list had been
+written out in full. Text following a closing brace no longer matches
+against later groups of nglist. And 'any' and 'all' are wildcards only as
+whole segments (the old code took the tail of 'football' as 'foot' and an
+'all').
+
 REVISED BY
    Eric S. Raymond
    This software is Copyright (C) 1989 by Eric S. Raymond for the sole purpose
@@ -74,109 +108,305 @@ of protecting free redistribution; see the LICENSE file for details.
 #define OPEN	    '{'	    /* start bracket for news subscriptions */
 #define CLOSE	    '}'	    /* end bracket for news subscriptions */
 
-#define END_GROUP(c)	(c == '\0' || c == NGDELIM)
-#define END_SEGMENT(c)	(c == '\0' || c == NGDELIM || c == NGSEP)
-#define SKIP_SEGMENT(n)	while (!END_SEGMENT(*n)) n++
+#define N_LITERAL   0	    /* segment must match literally */
+#define N_ANY	    1	    /* 'any' -- matches one segment */
+#define N_ALL	    2	    /* 'all' -- matches one or more segments */
 
-bool ngmatch(nglist, sublist)
-/* compare a list of newsgroups against a list of subscriptions */
-register char *nglist, *sublist;
+#define NGSEGS	    64	    /* most segments in a group name */
+#define NGCACHE	    16	    /* compiled lists kept by ngmatch() */
+
+struct ngnode
 {
-    register char  *n, *s, ch;
-    register bool   rc;
-    forward static bool ngcmp();
+    char		*seg;		/* segment text, N_LITERAL only */
+    int			len;		/* its length */
+    int			kind;		/* N_LITERAL, N_ANY or N_ALL */
+    int			last;		/* latest subscription ending here */
+    bool		neg;		/* was it an exclusion? */
+    struct ngnode	*child;		/* first node for the next segment */
+    struct ngnode	*sibling;	/* next alternative for this segment */
+};
+
+private ngpat_t ngnode(seg, len)
+/* make a trie node */
+char	*seg;
+int	len;
+{
+    register ngpat_t	np;
+
+    if ((np = (ngpat_t)malloc(sizeof(struct ngnode))) == (ngpat_t)NULL)
+	xerror0("out of memory compiling subscription list");
+    np->kind = N_LITERAL;
+    np->seg = (char *)NULL;
+    np->len = len;
+    if (len == 3 && strncmp(seg, "any", 3) == 0)
+	np->kind = N_ANY;
+    else if (len == 3 && strncmp(seg, "all", 3) == 0)
+	np->kind = N_ALL;
+    else if (seg != (char *)NULL)
+    {
+	np->seg = malloc((unsigned)len + 1);
+	if (np->seg == (char *)NULL)
+	    xerror0("out of memory compiling subscription list");
+	(void) strncpy(np->seg, seg, len);
+	np->seg[len] = '\0';
+    }
+    np->last = 0;
+    np->neg = FALSE;
+    np->child = np->sibling = (ngpat_t)NULL;
+    return(np);
+}
 
-#ifdef PARANOID
-    if (!nglist || !sublist)
-	return(FALSE);
-#endif /* PARANOID */
+private void ngenter(pat, sub, neg, term)
+/* enter one (brace-free) subscription into the trie */
+ngpat_t	pat;
+char	*sub;
+bool	neg;
+int	term;
+{
+    register ngpat_t	np;
+    register char	*ep;
+    register int	len;
+    ngpat_t		node = pat;
 
-    rc = FALSE;
-    for (n = nglist; *n != '\0' && rc == FALSE;)
+    for (;;)
     {
-	if (isspace(*n) || *n == '\\')
+	if ((ep = strchr(sub, NGSEP)) == (char *)NULL)
+	    ep = sub + strlen(sub);
+	len = ep - sub;
+
+	for (np = node->child; np != (ngpat_t)NULL; np = np->sibling)
+	    if (np->len == len
+		&& (np->kind == N_LITERAL
+		    ? strncmp(np->seg, sub, len) == 0
+		    : strncmp(np->kind == N_ANY ? "any" : "all", sub, 3) == 0))
+		break;
+	if (np == (ngpat_t)NULL)
 	{
-	    n++;
-	    continue;
+	    np = ngnode(sub, len);
+	    np->sibling = node->child;
+	    node->child = np;
 	}
+	node = np;
 
-	for (s = sublist; *s != '\0' && *s != CLOSE;)
-	{
-	    register int    bdepth = 0;
+	if (*ep == '\0')
+	    break;
+	sub = ep + 1;
+    }
 
+    /* later subscriptions override earlier ones */
+    if (term > node->last)
+    {
+	node->last = term;
+	node->neg = neg;
+    }
+}
+
+private char *ngexpand(pat, s, buf, len, neg, termp)
+/* expand braces in a subscription list, entering each result in the trie */
+ngpat_t		pat;
+register char	*s;	/* the list, ending at NUL or an unmatched CLOSE */
+char		*buf;	/* text of the enclosing prefix, extended in place */
+int		len;	/* length of same */
+bool		neg;	/* is the enclosing element an exclusion? */
+int		*termp;	/* count of subscriptions entered */
+{
+    register int	n, depth;
+    bool		not, braced;
+
+    for (;;)
+    {
+	n = len;
+	not = neg;
+	braced = FALSE;
+	for (; *s != '\0' && *s != NGDELIM && *s != CLOSE; s++)
 	    if (isspace(*s) || *s == '\\')
-	    {
-		s++;
 		continue;
+	    else if (*s == NEGCHAR && n == len && not == neg)
+		not = !not;
+	    else if (*s == OPEN)
+	    {
+		s = ngexpand(pat, s + 1, buf, n, not, termp);
+		braced = TRUE;
+
+		/* like the old code, ignore anything after the close */
+		if (*s == CLOSE)
+		    s++;
+		for (depth = 0; *s != '\0'; s++)
+		    if (*s == OPEN)
+			depth++;
+		    else if (*s == CLOSE && depth-- == 0)
+			break;
+		    else if (*s == NGDELIM && depth == 0)
+			break;
+		break;
 	    }
+	    else if (n < BUFLEN - 1)
+		buf[n++] = *s;
 
-	    /* match current group against current subscription part */
-	    if (*s != NEGCHAR)
-		rc = rc || ngcmp(n, s);
-	    else
-		rc = rc && !ngcmp(n, s + 1);
-
-	    /* skip to next subscription component */
-	    while (((ch = *s++) != NGDELIM || bdepth > 0) && *s != '\0')
-		if (ch == OPEN)
-		    bdepth++;
-		else if (ch == CLOSE)
-		    bdepth--;
+	if (!braced && n > len)
+	{
+	    buf[n] = '\0';
+	    ngenter(pat, buf, not, ++*termp);
 	}
 
-	/* skip to next NGDELIM-separated token in nglist */
-	while (*n++ != NGDELIM && *n != '\0')
-	    continue;
+	if (*s != NGDELIM)
+	    return(s);
+	s++;
     }
-    return rc;
 }
 
-private bool ngcmp(group, subsc)
-/*
- * Compare two newsgroups for equality. The second one may be a "meta"
- * newsgroup, i.e. a subscription including 'all' and 'any' wildcards.
- * The code is optimized for speed.
- */
-register char *group, *subsc;
+ngpat_t ngcompile(sublist)
+/* compile a subscription list into a trie */
+char	*sublist;
+{
+    ngpat_t	pat = ngnode((char *)NULL, 0);
+    char	buf[BUFLEN];
+    int		terms = 0;
+
+    (void) ngexpand(pat, sublist, buf, 0, FALSE, &terms);
+    return(pat);
+}
+
+void ngfree(pat)
+/* release a compiled subscription list */
+ngpat_t	pat;
 {
-    while (!END_GROUP(*subsc) && *subsc != CLOSE)
+    register ngpat_t	np, next;
+
+    for (np = pat->child; np != (ngpat_t)NULL; np = next)
     {
-	if (subsc[0] == 'a' )
+	next = np->sibling;
+	ngfree(np);
+    }
+    if (pat->seg != (char *)NULL)
+	(void) free(pat->seg);
+    (void) free((char *)pat);
+}
+
+private void ngwalk(node, segs, lens, i, n, bestp, negp)
+/* find the latest subscription matching some prefix of a group's segments */
+ngpat_t	node;
+char	*segs[];
+int	lens[];
+int	i, n;
+int	*bestp;
+bool	*negp;
+{
+    register ngpat_t	np;
+    register int	j;
+
+    for (np = node->child; np != (ngpat_t)NULL; np = np->sibling)
+	for (j = i + 1; j <= n; j++)
 	{
-	    if (subsc[1] == 'l' && subsc[2] == 'l' && END_SEGMENT(subsc[3]))
+	    if (np->kind == N_LITERAL
+		&& (np->len != lens[i] || strncmp(np->seg, segs[i], lens[i])))
+		break;
+
+	    if (np->last > *bestp)
 	    {
-		/*
-		 * skip current subscription segment, then see if the subsc is
-		 * matched by any tail of the remainder of the group name
-		 */
-		subsc += 3;	/* strlen("all") */
-		while (!END_GROUP(*group))
-		    if (ngcmp(group++, subsc))
-			return(TRUE);
-		return(ngcmp(group, subsc));
+		*bestp = np->last;
+		*negp = np->neg;
 	    }
-	    else if (subsc[1]=='n' && subsc[2]=='y' && END_SEGMENT(subsc[3]))
+	    if (np->child != (ngpat_t)NULL)
+		ngwalk(np, segs, lens, j, n, bestp, negp);
+
+	    if (np->kind != N_ALL)
+		break;
+	}
+}
+
+bool ngexec(pat, nglist)
+/* compare a list of newsgroups against a compiled subscription list */
+ngpat_t		pat;
+register char	*nglist;
+{
+    register char	*cp;
+    char		*segs[NGSEGS];
+    int			lens[NGSEGS], n, best;
+    bool		neg;
+
+#ifdef PARANOID
+    if (!pat || !nglist)
+	return(FALSE);
+#endif /* PARANOID */
+
+    while (*nglist != '\0')
+    {
+	if (isspace(*nglist) || *nglist == '\\' || *nglist == NGDELIM)
+	{
+	    nglist++;
+	    continue;
+	}
+
+	/* chop the group into segments */
+	n = 0;
+	for (cp = nglist; ; cp++)
+	    if (*cp == NGSEP || *cp == NGDELIM || *cp == '\0')
 	    {
-		/* skip current subscription segment, and one group segment */
-		subsc += 3;	/* strlen("any") */
-		SKIP_SEGMENT(group);
-		continue;
+		if (n < NGSEGS)
+		{
+		    segs[n] = nglist;
+		    lens[n++] = cp - nglist;
+		}
+		nglist = cp;
+		if (*cp != NGSEP)
+		    break;
+		nglist++;
 	    }
-	}
 
-	if (isspace(*subsc) || *subsc == '\\')
-	    subsc++;
-	else if (*subsc == OPEN)
-	    return(ngmatch(group, ++subsc));	/* the ++ is the key! */
-	else if (*subsc++ != *group++)
-	    return(FALSE);
+	best = 0;
+	neg = FALSE;
+	ngwalk(pat, segs, lens, 0, n, &best, &neg);
+	if (best && !neg)
+	    return(TRUE);
     }
+    return(FALSE);
+}
 
-    /*
-     * If I'm ever free to nuke the `foo matches foo.bar' misfeature, this
-     * will become END_GROUP(*group)
-     */
-    return(END_SEGMENT(*group));
+private struct
+{
+    char	*text;		/* the subscription list */
+    ngpat_t	pat;		/* its compiled form */
+    long	used;		/* when it was last used */
+}
+ngcache[NGCACHE];
+private long	ngclock;
+
+bool ngmatch(nglist, sublist)
+/* compare a list of newsgroups against a list of subscriptions */
+register char *nglist, *sublist;
+{
+    register int	i, victim = 0;
+
+#ifdef PARANOID
+    if (!nglist || !sublist)
+	return(FALSE);
+#endif /* PARANOID */
+
+    for (i = 0; i < NGCACHE; i++)
+	if (ngcache[i].text == (char *)NULL)
+	{
+	    victim = i;
+	    break;
+	}
+	else if (ngcache[i].text[0] == sublist[0]
+		 && strcmp(ngcache[i].text, sublist) == 0)
+	{
+	    ngcache[i].used = ++ngclock;
+	    return(ngexec(ngcache[i].pat, nglist));
+	}
+	else if (ngcache[i].used < ngcache[victim].used)
+	    victim = i;
+
+    if (ngcache[victim].text != (char *)NULL)
+    {
+	(void) free(ngcache[victim].text);
+	ngfree(ngcache[victim].pat);
+    }
+    ngcache[victim].text = savestr(sublist);
+    ngcache[victim].pat = ngcompile(sublist);
+    ngcache[victim].used = ++ngclock;
+    return(ngexec(ngcache[victim].pat, nglist));
 }
 
 /* ngmatch.c ends here */
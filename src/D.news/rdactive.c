@@ -234,10 +234,6 @@ group_t	    *ngp;
 #ifdef HASHGROUPS
     ngp->ng_nextg = 0;
 #endif /* HASHGROUPS */
-#ifdef FEEDBITS
-    /* following information valid only after a feedbits() */
-    ngp->ng_feeds = (bits_t)0;	/* subscription bits for news feeds */
-#endif	/* FEEDBITS */
     ngp->rc_flags = (bits_t)0;
     ngp->rc_seen = (uchar *)NULL;
 
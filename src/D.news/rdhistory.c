@@ -64,6 +64,9 @@ that have side-effects) and pretty much self-explanatory.
 
 hstid()		-- return the ID of the current article
 hstdate()	-- return the receipt timestamp of the current article
+hstexp()	-- return the explicit expire date of the current article
+hstpost()	-- return its post date, or 0 if the history line predates that
+hstfrom()	-- return the checkstring() sum of its From line
 hstcancel()	-- cancel the current article
 
 FILE FORMATS
@@ -73,6 +76,11 @@ an angle-bracket-enclosed Internet-style Message-ID; the second is a date
 stamp (time of receipt) in getdate() format, and the third (if present)
 is either a space-separated list of article names (each in the form
 <newsgroup>/<number>), or the word 'cancelled'.
+   In the new format the second field holds space-separated decimal numbers:
+the receipt time and explicit expire date, then (in lines written by
+hstaddh()) the post date and a hex checkstring() sum of the From line. These
+last two let expire decide an article's fate without opening it. Lines
+without them are still accepted; hstpost() and hstfrom() return 0 for them.
 
 NOTES
    If TMNCONVERT or DEBUG is on this module will accept the old history
@@ -107,6 +115,7 @@ of protecting free redistribution; see the LICENSE file for details.
 #include "active.h"
 #include "newsrc.h"
 #include "history.h"
+#include "region.h"
 
 #ifndef NONLOCAL	/* let a network service library take over, maybe */
 
@@ -117,6 +126,8 @@ char	*HISTORY;		/* the name of the history file */
 char	chstname[BUFLEN];	/* ID of the current article */
 time_t	chstdate;		/* receipt date of the article */
 time_t	chstexpd;		/* expire date of the article */
+time_t	chstpost;		/* post date of the article, 0 if unknown */
+ulong	chstfrom;		/* checkstring() of its From line */
 int	chstatus;		/* status of the last hstcrack() */
 lptr_t	hstlst;			/* location descriptor for the xref list */
 
@@ -127,13 +138,28 @@ int	histrdok = 0;		/* >0 if history records read in */
 database    *rdhistdb;	/* database of pointers to history lines */
 database    *wrhistdb;	/* database to use when writing stuff out  */
 char	    *chline;	/* allocated copy of current line */
+private region_t *chstore;	/* where chline lives */
 private char	line[LBUFLEN];	/* scratch space for everybody */
 
+private char *chsave(text)
+/* make text the current line, releasing the previous one */
+char	*text;
+{
+    if (chstore == (region_t *)NULL)
+	chstore = rgnew(LBUFLEN);
+    else
+	rgreset(chstore);
+    return(chline = rgsave(chstore, text));
+}
+
 static int hstcrack(text)
 /* crack a history record into its component fields */
 char	*text;
 {
-    register char   *tab1, *tab2, *tab3;
+    register char   *tab1, *tab2, *tab3, *cp;
+
+    chstpost = (time_t)0;
+    chstfrom = (ulong)0;
 
     /* delimit the ID field */
     if (text[0] != '<' || ((tab1 = strchr(text, TAB)) == (char *)NULL))
@@ -184,6 +210,12 @@ char	*text;
 	{
 	    *tab3 = '\0';
 	    chstexpd = atol(tab2);
+	    if ((cp = strchr(tab2, SPACE)) != (char *)NULL)
+	    {
+		chstpost = atol(++cp);
+		if ((cp = strchr(cp, SPACE)) != (char *)NULL)
+		    (void) sscanf(cp + 1, "%lx", &chstfrom);
+	    }
 	    *tab3++ = TAB;
 	}
     }
@@ -214,12 +246,9 @@ bool	wlock;
 	unsigned int clen;
 	int status;
 
-	if (chline != (char *)NULL)
-	    (void) free(chline);
 	chline = dbmget(&clen, rdhistdb);
 	chline[clen] = '\0';
-	chline = savestr(chline);
-	if ((status = hstcrack(chline)) == GARBLED)
+	if ((status = hstcrack(chsave(chline))) == GARBLED)
 	    return(GARBLED);
 	else
 	    return(status);
@@ -249,11 +278,8 @@ char	*hlin;
     lcase(namebuf);
     (void) dbmput(namebuf, (unsigned) strlen(namebuf),
 		hlin, (unsigned) strlen(hlin), wrhistdb);
-    if (chline != hlin) {
-	    if (chline != (char *)NULL)
-		    (void) free(chline);
-	    chline = savestr(hlin);
-    }
+    if (chline != hlin)
+	(void) chsave(hlin);
 }
 
 void hstread(readstuff)
@@ -292,14 +318,11 @@ bool wlock;
     {
 	unsigned int clen;
 
-	if (chline != (char *)NULL)
-	    (void) free(chline);
 	chline = dbmget(&clen, rdhistdb);
 	if (chline == NULL)
 	    return(FAIL);
 	chline[clen] = '\0';
-	chline = savestr(chline);
-	return(hstcrack(chline));
+	return(hstcrack(chsave(chline)));
     }
 }
 
@@ -308,9 +331,11 @@ char *hstfile(artid)
 char *artid;
 {
     static char	hstfilen[BUFLEN];
-    char	*cloc = (char *)NULL;
+    char	cloc[BUFLEN];
     place_t	myloc;
 
+    cloc[0] = '\0';
+
     if (hstseek(artid, FALSE) != SUCCEED)
 	return((char *)NULL);
 
@@ -322,17 +347,16 @@ char *artid;
 	/* we'd prefer an uncompressed version */
 	if (myloc.m_group->ng_flags & NG_COMPRESSED)
 	{
-	    cloc = savestr(hstfilen);
+	    (void) strcpy(cloc, hstfilen);
 	    continue;
 	}
 
 	return(hstfilen);
     }
 
-    if (cloc)	/* we only found a compressed version */
+    if (cloc[0])	/* we only found a compressed version */
     {
 	(void) strcpy(hstfilen, cloc);
-	(void) free(cloc);
 	return(hstfilen);
     }
     else
@@ -12,9 +12,50 @@ SYNOPSIS
    ulong checkstring(str, crc)			-- add checksum of a string
    register char *str; register ulong crc;
 
+   #include "checksum.h"
+
+   void ckinit(ck)				-- start a body fingerprint
+   cksum_t *ck;
+
+   void ckupdate(ck, buf, len)			-- add text to a fingerprint
+   cksum_t *ck; char *buf; int len;
+
+   char *ckfinal(ck, sum)			-- finish a fingerprint
+   cksum_t *ck; char sum[CKSUMLEN];
+
 DESCRIPTION
    This code computes a 32-bit CRC hash of article text for authentication
-purposes.
+purposes. The checksum() function reads the file from its current position
+to EOF (or for len bytes, if len is nonzero) in big gulps and runs the CRC
+over them eight bytes at a time, using tables of the CRC of each byte value
+shifted through zero to seven further bytes. It gives the same answers as
+the old byte-at-a-time loop; the authentication hash (see hashart() in
+articleid.c) and the sums kept in the history file depend on that.
+
+   The ck functions compute a fingerprint of a stream of text handed them
+in pieces of any size, so a caller that is already reading an article (the
+batch splitter in unbatch.c, for instance) can fingerprint it on the way by
+without a second read. Call ckinit() on a cksum_t, ckupdate() with each
+piece of text, and then ckfinal(), which copies the fingerprint into sum as
+a string of CKSUMLEN - 1 hex digits and returns sum. Two fingerprints of
+the same text are always the same, and two of different texts almost never
+are, so they can be compared to find duplicated article bodies. After
+ckfinal() the ck_crc member of the cksum_t holds the CRC-32C (Castagnoli
+polynomial, as in iSCSI) of the text, for integrity checks on stored copies.
+
+   The fingerprint is a 128-bit hash built from 32-bit multiplies, shifts
+and rotations, so it is as fast with 32-bit longs as with 64-bit ones. It
+is the x86 128-bit variant of Austin Appleby's MurmurHash3, with a seed of
+zero. It is not a cryptographic hash; somebody who wants to can make two
+texts with the same fingerprint.
+
+   The CRC tables are built the first time one of these functions needs
+them.
+
+BUGS
+   The checksum() function includes the EOF that stopped its reads in the
+sum, because the old loop fed the value fgetc() returned at end of file to
+the CRC. It doesn't do this if len runs out first.
 
 REVISED BY
    Eric S. Raymond
@@ -23,10 +64,17 @@ of protecting free redistribution; see the LICENSE file for details.
    The table and macro definition were distributed under following copyright:
 Copyright (C) 1986 Gary S. Brown.  You may use this program, or
 code or tables extracted from it, as desired without restriction.
+   MurmurHash3 was written by Austin Appleby, who placed it in the public
+domain.
 
 *****************************************************************************/
 /*LINTLIBRARY*/
 #include "libport.h"
+#include "checksum.h"
+
+#ifndef private
+#define private static
+#endif /* private */
 
 /* First, the polynomial itself and its table of feedback terms.  The  */
 /* polynomial is                                                       */
@@ -130,16 +178,89 @@ static ulong crc_32_tab[] = /* CRC polynomial 0xedb88320 */
 
 #define UPDC32(octet,crc) (crc_32_tab[((crc) ^ (octet)) & 0xff] ^ ((crc) >> 8))
 
+/*
+ * For the eight-at-a-time CRC, crctab[k][b] is the CRC of the byte b followed
+ * by k zero bytes. The first table of the CRC-32 set is crc_32_tab itself.
+ * We do the CRC-32C the same way, with the reversed Castagnoli polynomial.
+ */
+#define POLY32C		0x82f63b78L	/* CRC-32C polynomial, reversed */
+#define MASK32		0xffffffffL	/* ulong may be wider than 32 bits */
+
+private ulong	crc32x[8][256];		/* sliced tables for CRC-32 */
+private ulong	crc32c[8][256];		/* sliced tables for CRC-32C */
+private bool	crcready;		/* TRUE when they have been built */
+
+/* fetch four bytes as a little-endian 32-bit quantity, on any machine */
+#define GET32(p)	((ulong)(p)[0] | (ulong)(p)[1] << 8 \
+			| (ulong)(p)[2] << 16 | (ulong)(p)[3] << 24)
+
+private void crcinit()
+/* build the CRC tables */
+{
+    register int	i, k;
+    register ulong	c;
+
+    for (i = 0; i < 256; i++)
+    {
+	crc32x[0][i] = crc_32_tab[i];
+	for (c = i, k = 0; k < 8; k++)
+	    c = (c & 1) ? (c >> 1) ^ POLY32C : (c >> 1);
+	crc32c[0][i] = c;
+    }
+    for (k = 1; k < 8; k++)
+	for (i = 0; i < 256; i++)
+	{
+	    c = crc32x[k - 1][i];
+	    crc32x[k][i] = crc32x[0][c & 0xff] ^ (c >> 8);
+	    c = crc32c[k - 1][i];
+	    crc32c[k][i] = crc32c[0][c & 0xff] ^ (c >> 8);
+	}
+    crcready = TRUE;
+}
+
+private ulong crcslice(tab, crc, cp, n)
+/* run a CRC over n bytes, eight at a time while there are that many */
+register ulong	(*tab)[256];	/* the tables for the CRC */
+register ulong	crc;		/* the CRC so far */
+register uchar	*cp;		/* the bytes */
+register int	n;		/* how many */
+{
+    for (; n >= 8; cp += 8, n -= 8)
+    {
+	crc ^= GET32(cp);
+	crc = tab[7][crc & 0xff] ^ tab[6][(crc >> 8) & 0xff]
+	    ^ tab[5][(crc >> 16) & 0xff] ^ tab[4][crc >> 24]
+	    ^ tab[3][cp[4]] ^ tab[2][cp[5]] ^ tab[1][cp[6]] ^ tab[0][cp[7]];
+    }
+    while (n-- > 0)
+	crc = tab[0][(crc ^ *cp++) & 0xff] ^ (crc >> 8);
+    return(crc);
+}
+
 ulong checksum(fp, len)
+/* return the CRC of the rest of the file, or of len bytes of it */
 FILE *fp; ulong len;
 {
     ulong	crc = 0;
+    uchar	buf[BUFSIZ];
+    int		want, got;
+
+    if (feof(fp))
+	return(crc);
+    if (!crcready)
+	crcinit();
 
     /* compute checksum until we run out of length, or out of input */
-    while (!feof(fp) && (len == 0 || len-- > 0))
-	crc = UPDC32(fgetc(fp), crc);
+    do {
+	want = (len == 0 || len > sizeof(buf)) ? sizeof(buf) : (int)len;
+	if ((got = fread((char *)buf, sizeof(uchar), want, fp)) > 0)
+	    crc = crcslice(crc32x, crc, buf, got);
+	if (len > 0 && (len -= got) == 0)
+	    return(crc);
+    } while
+	(got == want);
 
-    return(crc);
+    return(UPDC32(EOF, crc));
 }
 
 ulong checkstring(str, crc)
@@ -151,4 +272,205 @@ register ulong	crc;
     return(crc);
 }
 
+/* the mixing steps of the fingerprint hash, in 32-bit arithmetic */
+#define ROTL32(x, r)	((((x) << (r)) | ((x) >> (32 - (r)))) & MASK32)
+#define MUL32(x, k)	(((x) * (k)) & MASK32)
+#define MIXK(k, c1, r, c2)	(k = MUL32(k, c1), k = ROTL32(k, r), k = MUL32(k, c2))
+#define MIXH(h, r, h2, c) \
+	(h = ROTL32(h, r), h = (h + h2) & MASK32, h = (h * 5 + (c)) & MASK32)
+
+#define C1	0x239b961bL
+#define C2	0xab0e9789L
+#define C3	0x38b34ae5L
+#define C4	0xa1e38b93L
+
+private void ckblock(h, cp)
+/* mix a CKBLOCK-byte block into the hash */
+register ulong	*h;
+register uchar	*cp;
+{
+    ulong	k;
+
+    k = GET32(cp);	 MIXK(k, C1, 15, C2); h[0] ^= k;
+    MIXH(h[0], 19, h[1], 0x561ccd1bL);
+    k = GET32(cp + 4);	 MIXK(k, C2, 16, C3); h[1] ^= k;
+    MIXH(h[1], 17, h[2], 0x0bcaa747L);
+    k = GET32(cp + 8);	 MIXK(k, C3, 17, C4); h[2] ^= k;
+    MIXH(h[2], 15, h[3], 0x96cd1c35L);
+    k = GET32(cp + 12);	 MIXK(k, C4, 18, C1); h[3] ^= k;
+    MIXH(h[3], 13, h[0], 0x32ac3b17L);
+}
+
+private ulong ckmix(h)
+/* scramble the bits of a lane for the final hash */
+register ulong	h;
+{
+    h ^= h >> 16;
+    h = MUL32(h, 0x85ebca6bL);
+    h ^= h >> 13;
+    h = MUL32(h, 0xc2b2ae35L);
+    h ^= h >> 16;
+    return(h);
+}
+
+void ckinit(ck)
+/* start a new fingerprint */
+cksum_t	*ck;
+{
+    if (!crcready)
+	crcinit();
+    ck->ck_crc = MASK32;
+    ck->ck_hash[0] = ck->ck_hash[1] = ck->ck_hash[2] = ck->ck_hash[3] = 0;
+    ck->ck_len = 0;
+    ck->ck_nbuf = 0;
+}
+
+void ckupdate(ck, buf, len)
+/* add text to a fingerprint */
+register cksum_t	*ck;
+char		*buf;
+register int	len;
+{
+    register uchar	*cp = (uchar *)buf;
+    int			n;
+
+    ck->ck_crc = crcslice(crc32c, ck->ck_crc, cp, len);
+    ck->ck_len += len;
+
+    /* top up a block left over from last time */
+    if (ck->ck_nbuf > 0)
+    {
+	if ((n = CKBLOCK - ck->ck_nbuf) > len)
+	    n = len;
+	(void) memcpy((char *)ck->ck_buf + ck->ck_nbuf, (char *)cp, n);
+	cp += n;
+	len -= n;
+	if ((ck->ck_nbuf += n) < CKBLOCK)
+	    return;
+	ckblock(ck->ck_hash, ck->ck_buf);
+	ck->ck_nbuf = 0;
+    }
+
+    /* hash the whole blocks in place, and keep what's left */
+    for (; len >= CKBLOCK; cp += CKBLOCK, len -= CKBLOCK)
+	ckblock(ck->ck_hash, cp);
+    if (len > 0)
+	(void) memcpy((char *)ck->ck_buf, (char *)cp, len);
+    ck->ck_nbuf = len;
+}
+
+char *ckfinal(ck, sum)
+/* finish a fingerprint, leave its text in sum */
+register cksum_t	*ck;
+char		*sum;
+{
+    register ulong	*h = ck->ck_hash;
+    register uchar	*tp = ck->ck_buf;
+    ulong		k;
+    int			i;
+
+    /* mix in the odd bytes at the end, as zero-padded words */
+    for (i = ck->ck_nbuf; i < CKBLOCK; i++)
+	tp[i] = 0;
+    switch ((ck->ck_nbuf + 3) / 4)
+    {
+    case 4: k = GET32(tp + 12); MIXK(k, C4, 18, C1); h[3] ^= k;
+	/* FALLTHROUGH */
+    case 3: k = GET32(tp + 8);  MIXK(k, C3, 17, C4); h[2] ^= k;
+	/* FALLTHROUGH */
+    case 2: k = GET32(tp + 4);  MIXK(k, C2, 16, C3); h[1] ^= k;
+	/* FALLTHROUGH */
+    case 1: k = GET32(tp);      MIXK(k, C1, 15, C2); h[0] ^= k;
+    }
+
+    /* fold in the length and mix the lanes together */
+    for (i = 0; i < 4; i++)
+	h[i] ^= ck->ck_len & MASK32;
+    h[0] = (h[0] + h[1] + h[2] + h[3]) & MASK32;
+    for (i = 1; i < 4; i++)
+	h[i] = (h[i] + h[0]) & MASK32;
+    for (i = 0; i < 4; i++)
+	h[i] = ckmix(h[i]);
+    h[0] = (h[0] + h[1] + h[2] + h[3]) & MASK32;
+    for (i = 1; i < 4; i++)
+	h[i] = (h[i] + h[0]) & MASK32;
+
+    ck->ck_crc ^= MASK32;
+    ck->ck_nbuf = 0;
+    (void) sprintf(sum, "%08lx%08lx%08lx%08lx", h[0], h[1], h[2], h[3]);
+    return(sum);
+}
+
+#ifdef MAIN
+/*
+ * An exerciser for this code. Give it file names; for each it shows the
+ * checksum() sum, the CRC-32C and the fingerprint, and checks the first
+ * against the byte-at-a-time loop and the others against the same text
+ * fed to ckupdate() in odd-sized pieces.
+ */
+char	*Progname = "checksum";
+
+main(argc, argv)
+int	argc;
+char	**argv;
+{
+    FILE	*fp;
+    cksum_t	ck, ck2;
+    char	buf[BUFSIZ], sum[CKSUMLEN], sum2[CKSUMLEN];
+    ulong	crc, old;
+    int		n, c, i, status = 0;
+
+    /* the standard check values */
+    ckinit(&ck);
+    ckupdate(&ck, "123456789", 9);
+    (void) ckfinal(&ck, sum);
+    if (ck.ck_crc != 0xe3069283L)
+    {
+	(void) printf("CRC-32C check value wrong: %08lx\n", ck.ck_crc);
+	status = 1;
+    }
+
+    while (*++argv)
+    {
+	if ((fp = fopen(*argv, "r")) == (FILE *)NULL)
+	{
+	    perror(*argv);
+	    status = 1;
+	    continue;
+	}
+
+	crc = checksum(fp, (ulong)0);
+	rewind(fp);
+	old = 0;
+	while (!feof(fp))
+	    old = UPDC32(fgetc(fp), old);
+
+	rewind(fp);
+	ckinit(&ck);
+	ckinit(&ck2);
+	i = 1;
+	while ((n = fread(buf, sizeof(char), sizeof(buf), fp)) > 0)
+	{
+	    ckupdate(&ck, buf, n);
+	    for (c = 0; c < n; c += i, i = i % 37 + 1)
+		ckupdate(&ck2, buf + c, (c + i > n) ? n - c : i);
+	}
+	(void) fclose(fp);
+	(void) ckfinal(&ck, sum);
+	(void) ckfinal(&ck2, sum2);
+
+	(void) printf("%s: checksum %08lx crc32c %08lx %s\n",
+		      *argv, crc, ck.ck_crc, sum);
+	if (crc != old)
+	    (void) printf("%s: byte-at-a-time checksum was %08lx\n", *argv, old);
+	if (ck2.ck_crc != ck.ck_crc || strcmp(sum, sum2))
+	    (void) printf("%s: piecewise sums were %08lx %s\n",
+			  *argv, ck2.ck_crc, sum2);
+	if (crc != old || ck2.ck_crc != ck.ck_crc || strcmp(sum, sum2))
+	    status = 1;
+    }
+    return(status);
+}
+#endif /* MAIN */
+
 /* checksum.c ends here */
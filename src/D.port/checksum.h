@@ -0,0 +1,18 @@
+/* checksum.h -- interface to the streaming CRC and body fingerprint code */
+
+#define CKBLOCK	16	/* bytes the fingerprint hash takes at a time */
+
+typedef struct
+{
+    ulong	ck_crc;		/* CRC-32C of the text so far */
+    ulong	ck_hash[4];	/* the fingerprint hash, four 32-bit lanes */
+    ulong	ck_len;		/* count of bytes seen */
+    int		ck_nbuf;	/* bytes waiting in ck_buf */
+    uchar	ck_buf[CKBLOCK];	/* a partial block of the hash */
+}
+cksum_t;
+
+extern void ckinit(), ckupdate();
+extern char *ckfinal();
+
+/* checksum.h ends here */
@@ -36,11 +36,26 @@ DESCRIPTION
    These routines provide the rudiments of an in-core database facility for
 an arbitrary number of records of some fixed length. Sequential and by-name
 access are supported (name is assumed to be stored as a char * at the front
-of the record, and simple linear search is used).
+of the record).
+   By-name lookups with a comparison function other than streq() (ngmatch(),
+say) use simple linear search, starting from the current record. Exact-match
+lookups on a table of HASHMIN or more records go through an open-addressed
+hash index on the names instead, which dbafind() builds the first time it is
+needed. Records added since the last lookup are entered in the index on the
+next one, and the index is doubled when it gets half full, so its cost is
+spread over the table's growth. Sequential access and dbanext() are not
+affected.
    Two additional entry points are defined by the dbatell() and dbaseek()
 macros. The first resturns the count of entries in the database; the second
 changes the location of the next-free slot to a given index, implicitly
-discarding that record and all following ones.
+discarding that record and all following ones (the name index is rebuilt
+at the next lookup).
+
+BUGS
+   The index assumes that a record's name doesn't change once it has been
+looked up by. If a name appears more than once, a hashed lookup finds the
+last such record, where a linear search finds the next one after the current
+record.
 
 AUTHOR
    Eric S. Raymond
@@ -133,6 +148,47 @@ dbdef_t	*db;
     return(--db->nextfree);
 }
 
+#define HASHMIN	16	/* smaller tables just get searched */
+#define dbakey(db, n)	(*((char **) itop(db, n)))
+#define dbahash(db, s)	((int)checkstring(s, (ulong)0L) & ((db)->indsize - 1))
+#define dbaprobe(db, h)	(((h) + 1) & ((db)->indsize - 1))
+
+static void dbaindex(db)
+/* bring the name index up to date with the table */
+register dbdef_t *db;
+{
+#ifndef lint	/* no way to placate lint about those pointer coercions */
+    register int	h, i, n;
+    char		*key;
+
+    /* start over if records have been discarded or the index is half full */
+    if (db->indexed == 0 || db->indexed > db->nextfree
+			|| 2 * db->nextfree > db->indsize)
+    {
+	if (db->index != (int *)NULL)
+	    (void) free((char *)db->index);
+	for (db->indsize = 2 * HASHMIN; db->indsize < 4 * db->nextfree; )
+	    db->indsize *= 2;
+	db->index = (int *)calloc((unsigned)db->indsize, sizeof(int));
+	db->indexed = 0;
+	if (db->index == (int *)NULL)
+	    return;
+    }
+
+    /* enter the records added since last time */
+    for (n = db->indexed; n < db->nextfree; n++)
+    {
+	if ((key = dbakey(db, n)) == (char *)NULL)
+	    continue;
+	for (h = dbahash(db, key); (i = db->index[h]) != 0; h = dbaprobe(db, h))
+	    if (strcmp(key, dbakey(db, i - 1)) == 0)
+		break;		/* a later duplicate supersedes the earlier */
+	db->index[h] = n + 1;
+    }
+    db->indexed = db->nextfree;
+#endif /* lint */
+}
+
 /*
  * Find in-core data corresponding to a given key.
  * This assumes that the first two bytes of the structure
@@ -146,6 +202,21 @@ bool	(*cmpfun)();
 {
 #ifndef lint	/* no way to placate lint about those pointer coercions */
     register char *dp;
+    register int h, i;
+
+    /* exact matches in big tables can go through the index */
+    if (cmpfun == streq && db->nextfree >= HASHMIN)
+    {
+	dbaindex(db);
+	if (db->index != (int *)NULL)
+	{
+	    for (h = dbahash(db, name); (i = db->index[h]) != 0;
+							h = dbaprobe(db, h))
+		if (strcmp(name, *((char **) (dp = itop(db, i - 1)))) == 0)
+		    return(db->cp = dp);
+	    return((char *)NULL);
+	}
+    }
 
     /* first, search from the previous value up to the table end */
     for (dp = db->cp; ptoi(db, dp) < db->nextfree; dp += db->recsize)
@@ -154,7 +225,7 @@ bool	(*cmpfun)();
 
     /* next, try from the table base to the previous value */
     for (dp = db->records; dp < db->cp; dp += db->recsize)
-	if (strncmp(name, *((char **) dp), strlen(name)) == 0)
+	if ((*cmpfun)(name, *((char **) dp)))
 	    return(db->cp = dp);
 #endif /* lint */
 
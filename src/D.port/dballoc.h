@@ -20,6 +20,11 @@ typedef struct
     char    *records;		/* allocated area for the stuff */
     int     nextfree;		/* count of records */
     char    *cp;		/* pointer to the current record */
+
+    /* name index for dbafind(), built and maintained there */
+    int	    *index;		/* open hash table of record numbers + 1 */
+    int	    indsize;		/* its size, a power of 2 */
+    int	    indexed;		/* count of records entered in it */
 }
 dbdef_t;
 
@@ -29,7 +34,7 @@ dbdef_t;
 
 #define dbathis(db)	(db->cp)
 #define dbatell(db)	((db)->nextfree)
-#define dbaseek(db, n)  ((db)->cp = itop((db), (db)->nextfree = (n)))
+#define dbaseek(db, n)  ((db)->indexed = 0, (db)->cp = itop((db), (db)->nextfree = (n)))
 
 extern char *dballoc();
 extern void dbaenter();
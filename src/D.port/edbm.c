@@ -63,7 +63,9 @@ appended to the data file.
    The dbmget() function returns a pointer to an allocated area of
 storage containing the content of the currently-selected database item.
 This area will be automatically deallocated by the next dbmseek(), dbmnext(),
-or dbmrewind(). If the first (unsigned *) arg of dbmget() is non-NULL, it
+or dbmrewind(). Content areas are carved off a region (see region.c) kept
+with each open database, so they cost no malloc() once the region has grown
+to fit, and a run of dbmget() calls on the same item doesn't leak. If the first (unsigned *) arg of dbmget() is non-NULL, it
 will be used as an address to deposit the content length in.
 
 CONCURRENT ACCESS
@@ -208,6 +210,7 @@ of protecting free redistribution; see the LICENSE file for details.
 ***********************************************************************/
 /*LINTLIBRARY*/
 #include "libport.h"
+#include "region.h"
 #include "edbm.h"
 
 #if defined(vax) || defined(iAPX386) || defined(i386) || defined(mc68030)
@@ -220,6 +223,7 @@ of protecting free redistribution; see the LICENSE file for details.
 
 #define	BYTESIZ	8	/* bits per byte */
 #define EXTLEN	5	/* length of .pag, .dir or .dat extension + 1 NUL */
+#define DBSTORE	512	/* initial size of a database's content region */
 
 #ifndef private
 #define private static
@@ -339,16 +343,16 @@ char    buf[PBLKSIZ];
 #endif /* SHARED */
 
 /*
- * Using this macro for freeing the current data alloc area guarantees that
- * it will always point either to an allocated data area or be NULL.
+ * Using this macro for freeing the current data alloc area releases every
+ * content area handed out by dbmget() since the last one in a single step.
  */
-#define FREE(d)	if(d->freeptr){(void)free(d->freeptr);d->freeptr=(char*)NULL;}
+#define FREE(d)	rgreset(d->dbstore)
 
 database *dbmopen(file)
 /* opens a database for use */
 char   *file;
 {
-    /* we use calloc() because freeptr field must be initially zeroed out */
+    /* we use calloc() so that all fields are initially zeroed out */
 #ifndef lint
     register database *db = (database *) calloc(sizeof(*db), 1);
 #else
@@ -379,6 +383,7 @@ char   *file;
     }
     (void) fstat(db->dirf, &statb);
     db->maxbno = statb.st_size * BYTESIZ - 1;
+    db->dbstore = rgnew(DBSTORE);
     return(db);
 }
 
@@ -398,6 +403,7 @@ register    database *db;
 	db->dirf = db->pagf = db->datf = FAIL;
 	lastdatabase = 0;
     }
+    rgfree(db->dbstore);
     (void) free(db->dirnm);
     (void) free((char *)db);
 }
@@ -1194,11 +1200,14 @@ unsigned contentlen;	/* the length of the content */
 register database *db;
 {
     int	    foundit;
-    static char    *malloc_kludge = NULL;
-    
-    if (malloc_kludge)
-	    free(malloc_kludge);
-    malloc_kludge = savestr(key);
+    static region_t *keystore;
+
+    /* the key copy has to survive the FREE() calls in dbmseek() */
+    if (keystore == (region_t *)NULL)
+	keystore = rgnew(DBSTORE);
+    else
+	rgreset(keystore);
+    key = rgsave(keystore, key);
     (void) setup_db(db);
     foundit = (dbmseek(key, keylen, db, TRUE) == SUCCEED);
 #ifdef LENGTHOPTIM	/* this should work, but doesn't */
@@ -1215,11 +1224,10 @@ register database *db;
 	    (void) dbmdelete(db);
 	    (void) dbmseek(key, keylen, db, TRUE);
 	}
-	db->current.dptr = malloc_kludge; /* key */
+	db->current.dptr = key;
 	db->current.dsize = keylen;
 	db->current.daddress = lseek(db->datf, (off_t)0, SEEK_END);
 	db->current.dlength = contentlen;
-	db->freeptr = (char *)NULL;
     }
     if (store(db->current, db) < 0)
 	return(FAIL);
@@ -1241,14 +1249,13 @@ register database   *db;
     char    *content;
 
     (void) setup_db(db);
-    if ((content = malloc((unsigned) db->current.dlength+1)) == (char *)NULL)
-	return((char *)NULL);
+    content = rgtext(db->dbstore, (int)db->current.dlength + 1);
     if (contentlen)
 	*contentlen = db->current.dlength;
     (void) lseek(db->datf, (off_t)db->current.daddress, SEEK_SET);
     if (read(db->datf, content,
 		(iolen_t) db->current.dlength) == db->current.dlength)
-	return(db->freeptr = content);
+	return(content);
     else
 	return((char *)NULL);
 }
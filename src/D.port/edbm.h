@@ -20,7 +20,7 @@ typedef struct
     int	    dbrdonly;	/* TRUE if the database is to be read-only */
 
     datum   current;	/* the currently-selected datum */
-    char    *freeptr;	/* content of the datum (so we can free it later) */
+    struct region *dbstore;	/* where dbmget() content areas live */
 
     long    bitno;
     long    maxbno;
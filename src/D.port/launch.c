@@ -0,0 +1,596 @@
+/*****************************************************************************
+
+NAME
+   launch.c -- start child processes cheaply, and keep helpers to start more
+
+SYNOPSIS
+   #include "launch.h"
+
+   int launch(file, argv, envp, fds, flags)	-- start a command, return pid
+   char *file, **argv, **envp; int *fds; int flags;
+
+   int lwait(pid)			-- wait for a launched child
+   int pid;
+
+   int lreap()				-- collect detached children, don't block
+
+   int lrun(cmd, flags)			-- run a command through a helper
+   char *cmd; int flags;
+
+   int lsync()				-- wait for commands started by lrun()
+
+   void lclose()			-- shut down the helper processes
+
+DESCRIPTION
+   Every place in the news system that starts a child process used to do its
+own fork(2), descriptor juggling and exec(2). The launch() function does all
+that in one place. It uses vfork(2), so the parent's address space is not
+copied just to be thrown away by the exec; configsys.h maps vfork onto fork
+where there is no vfork.
+
+   The file argument is the command to run, and must be a full path name
+unless LPATH is given; argv is its argument vector, as for execv(3). If envp
+is non-NULL it becomes the child's environment. The fds argument, if
+non-NULL, points to LNFDS descriptors that become the child's standard input,
+output and error in that order. Each entry may be one of the parent's descriptors, L_KEEP to leave the
+child's descriptor of that number as it is, or L_NULL to connect it to
+/dev/null. The same descriptor may appear twice, and the map may swap
+descriptors. Mapped descriptors above LNFDS-1 are closed in the child once
+they have been moved, so a pipe end passed this way doesn't linger there. If
+LCLOSE is set, every other descriptor above LNFDS-1 is closed too; otherwise
+the caller should mark close-on-exec any descriptors the child mustn't keep.
+LNOINTR makes the child ignore SIGINT and SIGQUIT, LDFLSIG gives it the
+default actions for SIGINT, SIGQUIT and SIGHUP whatever the caller does with
+them, and LNOPRIVS makes it give up set-user-ID and set-group-ID privileges. A child whose exec fails exits
+with status LEXECFAIL.
+
+   On BSD4_2 systems all signals are blocked while the parent is suspended in
+vfork(), and the child restores the caller's mask just before the exec. A
+handler that ran in the child before the exec would be running on the
+parent's stack and data; blocking closes that window.
+
+   The return value is the child's pid, or FAIL with errno set. A vfork that
+fails for lack of processes is retried a few times, a second apart.
+
+   Children are remembered in a small table. The lwait() function waits for
+the given child and returns its wait(2) status, or -1 if there is no such
+child. The status of any other launched child that exits in the meantime is
+saved, so a later lwait() for it returns at once instead of hanging; the bare
+wait() loops this replaces threw such statuses away.
+
+   A child launched with LDETACH is one nobody will wait for, such as a
+background command or a server that will be killed. The lreap() function
+collects any such children that have exited, without blocking, so they don't
+pile up as zombies; launch() calls it each time, and a long-running program
+may call it from its main loop. It returns the number of children collected.
+It needs wait3(2) with WNOHANG, so on non-BSD systems it does nothing.
+
+   Forking a big process like rnews once per article to run a transmission
+command is expensive even with vfork. The lrun() function hands the command
+line instead to one of LHELPERS helper processes, which are forked the first
+time they are needed and kept until lclose() is called or the caller exits.
+A helper is a copy of the caller that has closed all its descriptors but its
+pipes to and from the caller, stdout and stderr, and sits reading command
+lines; for each one it launches the command with stdin on /dev/null and
+writes back the exit status. A helper ignores keyboard signals and hangups,
+but the commands it runs get the default actions for them. So the cost to the caller of running a command
+is a pipe write and read. A command given with LSHELL goes to /bin/sh -c;
+otherwise the line is cracked at white space and the command is found by
+PATH search.
+
+   Normally lrun() waits for the command and returns its wait(2) status. With
+LNOWAIT it returns SUCCEED as soon as a helper has the command; the status is
+collected when that helper is next needed. The helpers are used in turn, so
+LNOWAIT commands run up to LHELPERS at a time. The lsync() function waits for
+the helpers to finish and returns the number of commands that exited with
+nonzero status since the last lsync(). If a helper can't be started, lrun()
+runs the command itself with launch(); an LNOWAIT command run that way is
+waited for by the next lsync(), and counted there if it fails.
+
+BUGS
+   The lreap() function may collect a child that some other code fork()ed
+and means to wait for itself, which then waits in vain. Code that forks for
+itself should wait for its child before anything calls launch() again.
+
+   A command given to lrun() may not contain a newline.
+
+SEE ALSO
+   spawn.c, peopen.c, server.c -- the front ends that use launch()
+
+AUTHOR
+   Eric S. Raymond
+   This software is Copyright (C) 1989 by Eric S. Raymond for the sole purpose
+of protecting free redistribution; see the LICENSE file for details.
+
+*****************************************************************************/
+/*LINTLIBRARY*/
+#include "libport.h"
+#include "launch.h"
+#include "procopts.h"
+#ifdef BSD4_2
+#include <sys/resource.h>
+#endif /* BSD4_2 */
+
+#ifndef private
+#define private static
+#endif
+
+#ifndef _NFILE		/* this will be defined correctly on USG systems */
+#define _NFILE	64
+#endif
+
+#define MAXKIDS	32	/* launched children we keep track of */
+#define RETRIES	5	/* times to retry a vfork that fails with EAGAIN */
+#define KSYNC	010000	/* kid flag: lsync() waits for it, not a launch() flag */
+
+typedef struct
+{
+    int		pid;		/* process ID, 0 if the slot is free */
+    int		flags;		/* the launch() flags */
+    bool	done;		/* it has exited and status is valid */
+    int		status;		/* its wait(2) status */
+}
+kid_t;
+
+typedef struct
+{
+    int		pid;		/* process ID of the helper, 0 if none */
+    int		tofd;		/* command lines go to the helper here */
+    int		fromfd;		/* statuses come back here */
+    bool	busy;		/* it has a command whose status is unread */
+}
+helper_t;
+
+private kid_t kids[MAXKIDS];
+private int detached;		/* LDETACH children not yet collected */
+private helper_t helpers[LHELPERS];
+private int nexthelper;		/* the helper lrun() uses next */
+private int failures;		/* nonzero statuses seen since lsync() */
+
+extern char **environ;
+
+private void kidadd(pid, flags)
+/* remember a new child */
+int	pid, flags;
+{
+    register kid_t	*kp;
+
+    for (kp = kids; kp < kids + MAXKIDS; kp++)
+	if (kp->pid == 0)
+	{
+	    kp->pid = pid;
+	    kp->flags = flags;
+	    kp->done = FALSE;
+	    if (flags & LDETACH)
+		detached++;
+	    return;
+	}
+}
+
+private void kidnote(pid, status)
+/* record the exit status of a child */
+int	pid, status;
+{
+    register kid_t	*kp;
+
+    for (kp = kids; kp < kids + MAXKIDS; kp++)
+	if (kp->pid == pid)
+	{
+	    if (kp->flags & LDETACH)
+	    {
+		kp->pid = 0;	/* nobody wants the status */
+		detached--;
+	    }
+	    else
+	    {
+		kp->done = TRUE;
+		kp->status = status;
+	    }
+	    return;
+	}
+}
+
+private void fdmove(from, to)
+/* make descriptor to refer to whatever from does */
+int	from, to;
+{
+    if (from != to)
+    {
+	(void) close(to);
+	(void) fcntl(from, F_DUPFD, to);
+    }
+}
+
+int launch(file, argv, envp, fds, flags)
+/* start a child process and return its pid */
+char	*file;	/* the command */
+char	**argv;	/* its arguments */
+char	**envp;	/* the child's environment, or NULL for ours */
+int	*fds;	/* the child's stdin, stdout and stderr, or NULL */
+int	flags;	/* options */
+{
+    register int	pid, i, fd;
+    int			map[LNFDS], tries;
+    char		**oldenv = environ;
+#ifdef BSD4_2
+    int			omask;
+#endif /* BSD4_2 */
+
+    (void) lreap();
+
+    for (tries = 0; ; tries++)
+    {
+#ifdef BSD4_2
+	omask = sigblock(~0);
+#endif /* BSD4_2 */
+	if ((pid = vfork()) != FAIL || errno != EAGAIN || tries >= RETRIES)
+	    break;
+#ifdef BSD4_2
+	(void) sigsetmask(omask);
+#endif /* BSD4_2 */
+	(void) sleep(1);
+    }
+
+    /*
+     * The child side. After a vfork this runs in the parent's address
+     * space, so it must not touch anything the parent relies on and must
+     * leave by exec or _exit.
+     */
+    if (pid == 0)
+    {
+	if (fds != (int *)NULL)
+	{
+	    /* get sources out of the way of the targets before moving */
+	    for (i = 0; i < LNFDS; i++)
+	    {
+		map[i] = fds[i];
+		if (map[i] >= 0 && map[i] < LNFDS && map[i] != i)
+		    map[i] = fcntl(map[i], F_DUPFD, LNFDS);
+	    }
+
+	    for (i = 0; i < LNFDS; i++)
+		if (map[i] == L_NULL)
+		{
+		    if ((fd = open("/dev/null", O_RDWR)) != FAIL && fd != i)
+		    {
+			fdmove(fd, i);
+			(void) close(fd);
+		    }
+		}
+		else if (map[i] != L_KEEP)
+		    fdmove(map[i], i);
+
+	    for (i = 0; i < LNFDS; i++)
+		if (map[i] >= LNFDS)
+		    (void) close(map[i]);
+	}
+
+	if (flags & LCLOSE)
+	    for (fd = LNFDS; fd < _NFILE; fd++)
+		(void) close(fd);
+
+	if (flags & LDFLSIG)
+	{
+	    (void) signal(SIGINT, SIGCAST(SIG_DFL));
+	    (void) signal(SIGQUIT, SIGCAST(SIG_DFL));
+	    (void) signal(SIGHUP, SIGCAST(SIG_DFL));
+	}
+	if (flags & LNOINTR)
+	{
+	    (void) signal(SIGINT, SIGCAST(SIG_IGN));
+	    (void) signal(SIGQUIT, SIGCAST(SIG_IGN));
+	}
+
+#ifndef lint		/* various lints disagree on setuid/setgid arg type */
+	if (flags & LNOPRIVS)
+	{
+	    (void) setgid(getgid());
+	    (void) setuid(getuid());
+	}
+#endif /* lint */
+
+	if (envp != (char **)NULL)
+	    environ = envp;	/* the parent puts it back */
+#ifdef BSD4_2
+	(void) sigsetmask(omask);
+#endif /* BSD4_2 */
+	if (flags & LPATH)
+	    (void) execvp(file, argv);
+	else
+	    (void) execv(file, argv);
+	(void) write(2, file, strlen(file));
+	(void) write(2, ": not found\n", 12);
+	_exit(LEXECFAIL);
+    }
+
+    environ = oldenv;
+#ifdef BSD4_2
+    i = errno;
+    (void) sigsetmask(omask);
+    errno = i;
+#endif /* BSD4_2 */
+    if (pid != FAIL)
+	kidadd(pid, flags);
+    return(pid);
+}
+
+int lwait(pid)
+/* wait for a launched child to exit and return its status */
+int	pid;
+{
+    register kid_t	*kp, *mine = (kid_t *)NULL;
+    register int	w;
+    wait_t		status;
+
+    for (kp = kids; kp < kids + MAXKIDS; kp++)
+	if (kp->pid == pid)
+	    mine = kp;
+    if (mine != (kid_t *)NULL && mine->done)
+    {
+	mine->pid = 0;
+	return(mine->status);
+    }
+
+    while ((w = wait(&status)) != pid)
+	if (w != FAIL)
+	    kidnote(w, status.w_status);
+	else if (errno != EINTR)
+	{
+	    status.w_status = -1;
+	    break;
+	}
+
+    if (mine != (kid_t *)NULL)
+    {
+	if (mine->flags & LDETACH)
+	    detached--;
+	mine->pid = 0;
+    }
+    return(status.w_status);
+}
+
+int lreap()
+/* collect detached children that have exited, without blocking */
+{
+    int		n = 0;
+#ifdef BSD4_2
+    register int	w;
+    wait_t		status;
+
+    while (detached > 0
+	   && (w = wait3(&status, WNOHANG, (struct rusage *)NULL)) > 0)
+    {
+	kidnote(w, status.w_status);
+	n++;
+    }
+#endif /* BSD4_2 */
+    return(n);
+}
+
+private bool lcrack(line, argv, shell)
+/* make an argument vector for a command line, cracking it in place */
+char	*line;		/* the command line */
+char	**argv;		/* where to put the vector, MAXARGS long */
+bool	shell;		/* hand it to the shell instead */
+{
+    if (!shell)
+	return(vcrack(line, argv, MAXARGS) > 0);
+    argv[0] = "/bin/sh";
+    argv[1] = "-c";
+    argv[2] = line;
+    argv[3] = (char *)NULL;
+    return(TRUE);
+}
+
+private void helper(in, out)
+/* a helper's main loop: run command lines, write back their statuses */
+int	in;	/* command lines come in here */
+int	out;	/* statuses go out here */
+{
+    char	line[BUFSIZ], reply[20], *argv[MAXARGS], *cp;
+    FILE	*fp;
+    int		fd, pid, status;
+
+    /* forget the caller's children and helpers, they aren't ours */
+    for (fd = 0; fd < MAXKIDS; fd++)
+	kids[fd].pid = 0;
+    detached = 0;
+    for (fd = 0; fd < LHELPERS; fd++)
+	helpers[fd].pid = 0;
+
+    for (fd = LNFDS; fd < _NFILE; fd++)
+	if (fd != in && fd != out)
+	    (void) close(fd);
+    (void) close(0);
+    (void) open("/dev/null", O_RDONLY);
+    (void) fcntl(in, F_SETFD, 1);
+    (void) fcntl(out, F_SETFD, 1);
+    (void) signal(SIGINT, SIGCAST(SIG_IGN));
+    (void) signal(SIGQUIT, SIGCAST(SIG_IGN));
+    (void) signal(SIGHUP, SIGCAST(SIG_IGN));
+
+    if ((fp = fdopen(in, "r")) == (FILE *)NULL)
+	_exit(1);
+    while (fgets(line, sizeof(line), fp) != (char *)NULL)
+    {
+	if ((cp = strchr(line, '\n')) != (char *)NULL)
+	    *cp = '\0';
+	if (!lcrack(line + 1, argv, line[0] == 's'))
+	    status = LEXECFAIL << 8;
+	else if ((pid = launch(argv[0], argv,
+			       (char **)NULL, (int *)NULL, LPATH|LDFLSIG)) == FAIL)
+	    status = LEXECFAIL << 8;
+	else
+	    status = lwait(pid);
+	(void) sprintf(reply, "%d\n", status);
+	if (write(out, reply, strlen(reply)) == FAIL)
+	    break;
+    }
+    _exit(0);
+    /*NOTREACHED*/
+}
+
+private bool hstart(hp)
+/* fork a helper process */
+register helper_t	*hp;
+{
+    int		topipe[2], frompipe[2];
+
+    if (pipe(topipe) == FAIL)
+	return(FALSE);
+    if (pipe(frompipe) == FAIL)
+    {
+	(void) close(topipe[0]);
+	(void) close(topipe[1]);
+	return(FALSE);
+    }
+
+    if ((hp->pid = fork()) == 0)
+    {
+	(void) close(topipe[1]);
+	(void) close(frompipe[0]);
+	helper(topipe[0], frompipe[1]);
+	/*NOTREACHED*/
+    }
+
+    (void) close(topipe[0]);
+    (void) close(frompipe[1]);
+    if (hp->pid == FAIL)
+    {
+	(void) close(topipe[1]);
+	(void) close(frompipe[0]);
+	hp->pid = 0;
+	return(FALSE);
+    }
+    hp->tofd = topipe[1];
+    hp->fromfd = frompipe[0];
+    hp->busy = FALSE;
+    (void) fcntl(hp->tofd, F_SETFD, 1);	/* children don't get our pipes */
+    (void) fcntl(hp->fromfd, F_SETFD, 1);
+    kidadd(hp->pid, 0);
+    return(TRUE);
+}
+
+private void hstop(hp)
+/* shut down a helper; it exits when it sees EOF */
+register helper_t	*hp;
+{
+    (void) close(hp->tofd);
+    (void) close(hp->fromfd);
+    (void) lwait(hp->pid);
+    hp->pid = 0;
+    hp->busy = FALSE;
+}
+
+private int hreply(hp)
+/* collect the status of the command a helper was given */
+register helper_t	*hp;
+{
+    char	reply[20];
+    int		n = 0, status;
+
+    while (n < sizeof(reply) - 1)
+	if ((status = read(hp->fromfd, reply + n, 1)) == 1)
+	{
+	    if (reply[n++] == '\n')
+		break;
+	}
+	else if (status == 0 || errno != EINTR)
+	    break;
+    hp->busy = FALSE;
+
+    if (n == 0 || reply[n - 1] != '\n')		/* the helper died */
+    {
+	hstop(hp);
+	status = -1;
+    }
+    else
+    {
+	reply[n] = '\0';
+	status = atoi(reply);
+    }
+    if (status != 0)
+	failures++;
+    return(status);
+}
+
+int lrun(cmd, flags)
+/* run a command line through a helper process */
+char	*cmd;	/* the command line */
+int	flags;	/* LSHELL, LNOWAIT */
+{
+    register helper_t	*hp;
+    char		line[BUFSIZ], *argv[MAXARGS];
+    catch_t		(*onpipe)();
+    int			pid, status, n = strlen(cmd);
+
+    hp = helpers + nexthelper;
+    nexthelper = (nexthelper + 1) % LHELPERS;
+    if (hp->busy)
+	(void) hreply(hp);
+
+    if (n < sizeof(line) - 2 && (hp->pid || hstart(hp)))
+    {
+	(void) sprintf(line, "%c%s\n", (flags & LSHELL) ? 's' : 'x', cmd);
+	n += 2;
+	onpipe = signal(SIGPIPE, SIGCAST(SIG_IGN));
+	status = write(hp->tofd, line, n);
+	(void) signal(SIGPIPE, SIGCAST(onpipe));
+	if (status == n)
+	{
+	    hp->busy = TRUE;
+	    if (flags & LNOWAIT)
+		return(SUCCEED);
+	    return(hreply(hp));
+	}
+	hstop(hp);	/* it died; start another next time round */
+    }
+
+    /* no helper to be had, do it ourselves */
+    if (n >= sizeof(line))
+	return(FAIL);
+    (void) strcpy(line, cmd);
+    if (!lcrack(line, argv, (flags & LSHELL) != 0))
+	return(FAIL);
+    if ((pid = launch(argv[0], argv, (char **)NULL, (int *)NULL,
+		      LPATH | ((flags & LNOWAIT) ? KSYNC : 0))) == FAIL)
+	return(FAIL);
+    if (flags & LNOWAIT)
+	return(SUCCEED);
+    if ((status = lwait(pid)) != 0)
+	failures++;
+    return(status);
+}
+
+int lsync()
+/* wait for the helpers to finish, return the count of failed commands */
+{
+    register helper_t	*hp;
+    register kid_t	*kp;
+    int			n;
+
+    for (hp = helpers; hp < helpers + LHELPERS; hp++)
+	if (hp->busy)
+	    (void) hreply(hp);
+
+    /* and for any commands lrun() had to start without a helper */
+    for (kp = kids; kp < kids + MAXKIDS; kp++)
+	if (kp->pid != 0 && (kp->flags & KSYNC) && lwait(kp->pid) != 0)
+	    failures++;
+    n = failures;
+    failures = 0;
+    return(n);
+}
+
+void lclose()
+/* shut down the helper processes */
+{
+    register helper_t	*hp;
+
+    (void) lsync();
+    for (hp = helpers; hp < helpers + LHELPERS; hp++)
+	if (hp->pid)
+	    hstop(hp);
+}
+
+/* launch.c ends here */
@@ -0,0 +1,27 @@
+/* launch.h -- definitions for the process launcher and its helper pool */
+
+#define LNFDS	3	/* descriptors a launch() map covers: stdin/out/err */
+
+/* launch() descriptor map values other than a descriptor number */
+#define L_KEEP	(-1)	/* child inherits the parent's descriptor */
+#define L_NULL	(-2)	/* connect the child's descriptor to /dev/null */
+
+/* launch() flag masks */
+#define LPATH	0001	/* search PATH for the command, as execvp(3) does */
+#define LCLOSE	0002	/* close all descriptors above the mapped ones */
+#define LNOINTR	0004	/* child ignores SIGINT and SIGQUIT */
+#define LNOPRIVS 0010	/* child gives up setuid and setgid privileges */
+#define LDETACH	0020	/* nobody will lwait() for it; lreap() collects it */
+#define LDFLSIG	0040	/* child takes SIGINT, SIGQUIT and SIGHUP by default */
+
+/* lrun() flag masks */
+#define LSHELL	0001	/* hand the command to sh -c rather than cracking it */
+#define LNOWAIT	0002	/* don't wait for the command to finish */
+
+#define LEXECFAIL 127	/* exit status of a child whose exec failed */
+#define LHELPERS  2	/* helper processes kept by lrun() */
+
+extern int launch(), lwait(), lreap(), lrun(), lsync();
+extern void lclose();
+
+/* launch.h ends here */
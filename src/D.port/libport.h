@@ -75,6 +75,7 @@ extern	time_t	modtime(), getdate(), cgtdate();
 extern	void	lcase(), setmodtime();
 extern	bool	exists(), isdir(), prefix(), bitbucket(), setenv(), delenv();
 extern	ulong	checksum(), checkstring();
+#define CKSUMLEN	33	/* size of a body fingerprint string, see checksum.h */
 extern	off_t	filesize(), df();
 extern	FILE	*xfopen(), *peopen();
 
@@ -0,0 +1,211 @@
+/****************************************************************************
+
+NAME
+   mbench.c -- run a synthetic ingest trace to benchmark a malloc(3)
+
+SYNOPSIS
+   mbench [articles]
+
+DESCRIPTION
+   This program imitates the storage traffic of a long-running rnews or
+nntprecv, so the malloc(3) replacements in this directory (kmalloc.c,
+nmalloc.c, smalloc.c) can be compared with each other and with the system
+malloc. The Makefile target mallocbench builds it against each of them and
+runs them all.
+
+   For each article the trace allocates the copies of its header lines, a
+body buffer that is sometimes grown with realloc(), and a few scratch
+buffers. They are all freed, in a scrambled order, when the article is done,
+which is INFLIGHT articles later (a streaming feed has that many going).
+Alongside that it keeps a cache of recent Message-IDs whose oldest entry is
+freed as each new one goes in, and a table of group names that gets a new
+entry every so often and is extended with realloc() in steps, like the active
+array. Every thousand articles it allocates and frees a big batch buffer.
+The trace is generated from a fixed seed, so every run does the same thing.
+
+   At the end it reports the processor time taken, the allocator calls per
+second, and how far the break moved. On systems with getrusage(2) (BSD4_2)
+it reports the peak resident set size as well, which also counts storage
+gotten with mmap(2). If MSTATS is defined it calls mstats() first.
+
+   The default is 20000 articles.
+
+AUTHOR
+   Eric S. Raymond
+   This software is Copyright (C) 1989 by Eric S. Raymond for the sole purpose
+of protecting free redistribution; see the LICENSE file for details.
+
+**************************************************************************/
+#include "libport.h"
+#include <sys/times.h>
+#ifdef BSD4_2
+#include <sys/resource.h>
+#endif /* BSD4_2 */
+
+#define IDCACHE		2000	/* Message-IDs kept */
+#define MAXLINES	40	/* most header lines in an article */
+#define NSCRATCH	4	/* scratch buffers per article */
+#define NHELD		(MAXLINES + NSCRATCH + 1)	/* most per article */
+#define INFLIGHT	16	/* articles in progress at once */
+#define GROUPSTEP	64	/* the group table grows this much at a time */
+#define NEWGROUP	50	/* a new group turns up every this many articles */
+#ifndef HZ
+#define HZ		60	/* clock ticks per second */
+#endif /* HZ */
+
+extern char *sbrk();
+
+char	*Progname = "mbench";
+
+static unsigned long	seed = 1989;
+static long		calls;		/* allocator calls made */
+
+static unsigned rnd(n)
+/* return a pseudo-random number from 0 to n-1 */
+unsigned	n;
+{
+    seed = seed * 1103515245L + 12345;
+    return((unsigned)((seed >> 16) & 0x7fff) % n);
+}
+
+static unsigned skew(lo, hi)
+/* return a size from lo to hi, with small sizes the most likely */
+unsigned	lo, hi;
+{
+    unsigned	span = hi - lo;
+
+    while (span > 16 && rnd(3) != 0)
+	span /= 2;
+    return(lo + rnd(span + 1));
+}
+
+static char *get(n)
+/* allocate and touch storage */
+unsigned	n;
+{
+    char	*cp;
+
+    calls++;
+    if ((cp = malloc(n)) == (char *)NULL)
+    {
+	(void) fprintf(stderr, "mbench: out of memory after %ld calls\n", calls);
+	exit(1);
+    }
+    cp[0] = cp[n - 1] = 'x';
+    return(cp);
+}
+
+static char *regrow(cp, n)
+/* resize storage and touch it */
+char		*cp;
+unsigned	n;
+{
+    calls++;
+    if ((cp = realloc(cp, n)) == (char *)NULL)
+    {
+	(void) fprintf(stderr, "mbench: out of memory after %ld calls\n", calls);
+	exit(1);
+    }
+    cp[n - 1] = 'x';
+    return(cp);
+}
+
+static void put(cp)
+/* free storage */
+char	*cp;
+{
+    calls++;
+    free(cp);
+}
+
+main(argc, argv)
+int	argc;
+char	**argv;
+{
+    char	*held[INFLIGHT][NHELD], *ids[IDCACHE], **groups = NULL;
+    char	*brk0 = sbrk(0), **lines, *tp;
+    int		nheld[INFLIGHT];
+    int		articles = 20000, art, n, i, ngroups = 0, gsize = 0;
+    unsigned	size;
+    long	ticks;
+    struct tms	tms;
+#ifdef BSD4_2
+    struct rusage	ru;
+#endif /* BSD4_2 */
+
+    if (argc > 1)
+	articles = atoi(argv[1]);
+    for (i = 0; i < IDCACHE; i++)
+	ids[i] = (char *)NULL;
+    for (i = 0; i < INFLIGHT; i++)
+	nheld[i] = 0;
+
+    for (art = 0; art < articles + INFLIGHT; art++)
+    {
+	/* done with an article, free its storage in a scrambled order */
+	lines = held[art % INFLIGHT];
+	n = nheld[art % INFLIGHT];
+	while (n > 0)
+	{
+	    i = rnd((unsigned)n);
+	    put(lines[i]);
+	    lines[i] = lines[--n];
+	}
+	if (art >= articles)
+	    continue;
+
+	/* the header lines */
+	n = 10 + rnd(MAXLINES - 10);
+	for (i = 0; i < n; i++)
+	    lines[i] = get(skew(12, 400));
+
+	/* the body, read in pieces */
+	lines[n] = get(size = skew(512, 65536));
+	if (rnd(4) == 0)
+	    lines[n] = regrow(lines[n], size += skew(512, 32768));
+	n++;
+
+	/* scratch space */
+	for (i = 0; i < NSCRATCH; i++)
+	    lines[n++] = get(skew(64, 4096));
+
+	/* remember the ID */
+	tp = get(skew(20, 80));
+	if (ids[art % IDCACHE])
+	    put(ids[art % IDCACHE]);
+	ids[art % IDCACHE] = tp;
+
+	/* maybe it's in a group we haven't seen */
+	if (art % NEWGROUP == 0)
+	{
+	    if (ngroups == gsize)
+		groups = (char **)regrow((char *)groups,
+			(unsigned)((gsize += GROUPSTEP) * sizeof(char *)));
+	    groups[ngroups++] = get(skew(8, 48));
+	}
+
+	/* a batch goes out every so often */
+	if (art % 1000 == 999)
+	    put(get(skew(102400, 409600)));
+
+	nheld[art % INFLIGHT] = n;
+    }
+    (void) times(&tms);
+    ticks = tms.tms_utime + tms.tms_stime;
+
+#ifdef MSTATS
+    mstats("after the trace");
+#endif /* MSTATS */
+    (void) printf("%d articles, %ld allocator calls in %ld.%02ld seconds",
+		  articles, calls, ticks / HZ, ticks % HZ * 100 / HZ);
+    if (ticks > 0)
+	(void) printf(" (%ld per second)", (long)(calls * (double)HZ / ticks));
+    (void) printf("\nbreak moved %ld bytes\n", (long)(sbrk(0) - brk0));
+#ifdef BSD4_2
+    (void) getrusage(RUSAGE_SELF, &ru);
+    (void) printf("peak resident set %ld Kbytes\n", (long)ru.ru_maxrss);
+#endif /* BSD4_2 */
+    return(0);
+}
+
+/* mbench.c ends here */
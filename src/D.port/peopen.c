@@ -17,7 +17,12 @@ bare process instead of a shell. Path search and a limited I/O redirection
 capability is supported. Commands opened for "r" may include an argument of
 the form "<file", commands opened for "w" may have an argument like ">file";
 these do the obvious redirections and are dropped out of the argument list
-before the execvp().
+before the execvp(). If the redirection file can't be opened peopen() returns
+NULL.
+
+   The child is started with launch(). The caller's end of the pipe is marked
+close-on-exec, so the child doesn't hold it open, and peclose() waits with
+lwait(), so closing one pipe doesn't swallow the exit status of another.
 
 BUGS
    We'd like to close all file descriptors except stdin or stdout before
@@ -32,6 +37,7 @@ of protecting free redistribution; see the LICENSE file for details.
 ****************************************************************************/
 /*LINTLIBRARY*/
 #include "libport.h"
+#include "launch.h"
 
 #define MAXARGS	64	/* max # of arguments accepted for secure command */
 
@@ -52,11 +58,13 @@ FILE *peopen(cmd, mode)
  */
 char *cmd, *mode;
 {
-    int	pipes[2];
+    int	pipes[2], fds[LNFDS];
     register int fd, myside, yourside, pid, wmode = (strcmp(mode, "w") == 0);
+    char    *largv[MAXARGS];
 
 #ifdef NOSHELL
-    char    *cp, line[BUFSIZ], *largv[MAXARGS], *redirect = (char *)NULL;
+    int	    lflags = LPATH;
+    char    *cp, line[BUFSIZ], *redirect = (char *)NULL;
     int	    largc = 0;
 
     /* crack the argument list into a dope vector */
@@ -82,58 +90,52 @@ char *cmd, *mode;
 	}
     }
     largv[largc] = (char *) NULL;
+#else
+    int	    lflags = 0;		/* no PATH search for the shell itself */
+
+    largv[0] = "/bin/sh"; largv[1] = "-c"; largv[2] = cmd; largv[3] = (char *)NULL;
 #endif /* NOSHELL */
 
     if (pipe(pipes) < 0)
 	return((FILE *)NULL);
     myside = (wmode ? pipes[WTR] : pipes[RDR]);
     yourside = (wmode ? pipes[RDR] : pipes[WTR]);
-    if ((pid = fork()) == 0)	/* myside/yourside reverse roles in child */
-    {
-#ifdef CLOSEALL	/* this seems to break processes with multiple peopens() */
-	/* close all pipes from other peopen()s */
-	for (fd = 2; fd < _NFILE; fd)
-	    if (peopen_pid[fd])
-		(void) close(fd);
-#endif /* CLOSEALL */
-
-	(void) close(myside);
-	if (yourside != (wmode ? 0 : 1))
-	{
-	    (void) close(wmode ? 0 : 1);
-	    (void) dup(yourside);
-	    (void) close(yourside);
-	}
+    fds[0] = fds[1] = fds[2] = L_KEEP;
+    fds[!wmode] = yourside;
 
 #ifdef NOSHELL
-	/* do redirections */
-	if (redirect != (char *)NULL)
+    /* do redirections */
+    if (redirect != (char *)NULL)
+    {
+	if (wmode)
+	    fd = open(redirect, O_WRONLY | O_CREAT | O_TRUNC, 0666);
+	else
+	    fd = open(redirect, O_RDONLY);
+	if (fd == FAIL)
 	{
-	    FILE *fp;
-
-	    fp = fopen(redirect, mode);
-	    if (fp == (FILE *)NULL || (fd = fileno(fp)) == FAIL)
-		_exit(2);
-
-	    if (wmode != fd)
-	    {
-		(void) close(wmode);
-		(void) dup(fd);
-		(void) close(fd);
-	    }
+	    (void) close(myside);
+	    (void) close(yourside);
+	    return((FILE *)NULL);
 	}
+	fds[wmode] = fd;
+    }
+#endif /* NOSHELL */
 
-	(void) execvp(largv[0], largv);
+#ifdef CLOSEALL	/* this seems to break processes with multiple peopens() */
+    pid = launch(largv[0], largv, (char **)NULL, fds, lflags|LCLOSE);
 #else
-	(void) execl("/bin/sh", "sh", "-c", cmd, 0);
-#endif /* NOSHELL */
-	perror("exec in peopen() failed");
-	_exit(1);
-    }
-    if (pid == -1)
+    (void) fcntl(myside, F_SETFD, 1);	/* the child mustn't hold our end */
+    pid = launch(largv[0], largv, (char **)NULL, fds, lflags);
+#endif /* CLOSEALL */
+    (void) close(yourside);
+    if (fds[wmode] >= 0)
+	(void) close(fds[wmode]);
+    if (pid == FAIL)
+    {
+	(void) close(myside);
 	return((FILE *)NULL);
+    }
     peopen_pid[myside] = pid;
-    (void) close(yourside);
     return(fdopen(myside, mode));
 }
 
@@ -143,24 +145,20 @@ FILE *ptr;
 {
     register int	f, r;
     catch_t		(*hangupf)(), (*ignoref)(), (*quitf)();
-    wait_t		status;
 
     f = fileno(ptr);
     (void) fclose(ptr);
     ignoref = signal(SIGINT, SIGCAST(SIG_IGN));
     quitf = signal(SIGQUIT, SIGCAST(SIG_IGN));
     hangupf = signal(SIGHUP, SIGCAST(SIG_IGN));
-    while((r = wait(&status)) != peopen_pid[f] && (r != -1 || errno == EINTR))
-	continue;
-    if (r == -1)
-	status.w_status = -1;
+    r = lwait(peopen_pid[f]);
     (void) signal(SIGINT, SIGCAST(ignoref));
     (void) signal(SIGQUIT, SIGCAST(quitf));
     (void) signal(SIGHUP, SIGCAST(hangupf));
 #ifdef CLOSEALL	/* this seems to break processes with multiple peopens() */
     peopen_pid[f] = 0;
 #endif /* CLOSEALL */
-    return(status.w_status);
+    return(r);
 }
 
 /* peopen.c ends here */
@@ -16,6 +16,31 @@ DESCRIPTION
    These routines provide V8-compatible expression matching for the
 news code. 
 
+   The matcher proper is a backtracking interpreter of the compiled program,
+which can take time exponential in the length of the string on patterns with
+nested or adjacent closures. Two things keep the common cases fast. First,
+regcomp() records the longest literal every match must contain (regmust) for
+all unanchored patterns, not just those starting with a closure, and
+regexec() rejects strings lacking it with a strchr() scan before anything
+else is tried. Second, patterns containing closures or alternations also get
+a small lazily-built DFA, simulated directly over the compiled program.
+regexec() runs the string through it first, in time linear in the string
+length; only if the DFA says a match exists is the backtracker run, to find
+it and fill in startp[] and endp[]. The DFA works on byte classes (bytes the
+pattern cannot tell apart share transitions) and caches at most DFASTATES
+states; when the cache fills it is flushed and rebuilt as needed, and a
+pattern that keeps flushing is left to the backtracker alone.
+
+   The DFA cache lives in the same malloc'd block as the program, so a
+compiled expression may still be freed with a single free().
+
+   If compiled with -DPROFILE, this module becomes a benchmark. Give it an
+iteration count, a file of patterns (one per line) and a corpus of header
+lines; it reports, for each pattern, the match count and time with and
+without the DFA. The distribution includes regexp.pats and regexp.hdrs for
+this purpose; the latter holds a few hundred header lines of the usual
+kinds, with made-up names.
+
 REVISED BY
    Eric S. Raymond
 These are a truncated and slightly munged version of Henry Spencer's regexp(3)
@@ -104,6 +129,7 @@ static void regc();
 static void reginsert();
 static void regtail();
 static void regoptail();
+static regexp *regdfainit();
 #ifndef USG
 static int strcspn();
 #endif
@@ -175,6 +201,11 @@ char *exp;
     if (reg(0, &flags) == (char *)NULL)
 	return((regexp *)NULL);
 
+    /* Maybe set up a DFA; this may move the program. */
+    r->regdfa = (char *)NULL;
+    if ((r = regdfainit(r, regsize)) == (regexp *)NULL)
+	return((regexp *)NULL);
+
     /* Dig out information for optimizations. */
     r->regstart = '\0';	/* Worst-case defaults. */
     r->reganch = 0;
@@ -191,24 +222,24 @@ char *exp;
 	    r->reganch++;
 
 	/*
-	 * If there's something expensive in the r.e., find the
-	 * longest literal string that must appear and make it the
-	 * regmust.  Resolve ties in favor of later strings, since
+	 * Find the longest literal string that must appear and make
+	 * it the regmust.  Spencer did this only if there was something
+	 * expensive in the r.e., but the scan is cheap next to even one
+	 * failed regtry(), and callers like lnfilter use regmust to
+	 * prefilter.  Resolve ties in favor of later strings, since
 	 * the regstart check works with the beginning of the r.e.
 	 * and avoiding duplication strengthens checking.  Not a
 	 * strong reason, but sufficient in the absence of others.
 	 */
-	if (flags&SPSTART) {
-	    longest = (char *)NULL;
-	    len = 0;
-	    for (; scan != (char *)NULL; scan = regnext(scan))
-		if (OP(scan) == EXACTLY && strlen(OPERAND(scan)) >= len) {
-		    longest = OPERAND(scan);
-		    len = strlen(OPERAND(scan));
-		}
-	    r->regmust = longest;
-	    r->regmlen = len;
-	}
+	longest = (char *)NULL;
+	len = 0;
+	for (; scan != (char *)NULL; scan = regnext(scan))
+	    if (OP(scan) == EXACTLY && strlen(OPERAND(scan)) >= len) {
+		longest = OPERAND(scan);
+		len = strlen(OPERAND(scan));
+	    }
+	r->regmust = longest;
+	r->regmlen = len;
     }
 
     return(r);
@@ -619,6 +650,464 @@ char *val;
     regtail(OPERAND(p), val);
 }
 
+/*
+ * The DFA.
+ *
+ * A thread is a place in the program where the simulation waits to consume
+ * a character: a one-character node (ANY, ANYOF, ANYBUT, STAR, PLUS), a
+ * character within an EXACTLY string, or an EOL waiting for the end of the
+ * string.  A thread is encoded in a long as the node's offset in the
+ * program plus, for EXACTLY, the index of the character in the string
+ * shifted left T_SHIFT bits.  A DFA state is a sorted set of threads,
+ * plus a note of whether the closure that made it reached END.
+ *
+ * There are no backreferences in this dialect, so every program can be
+ * simulated this way.  Subexpression boundaries aren't tracked; the DFA
+ * only decides whether there is a match, and regexec() leaves finding it
+ * to the backtracker.
+ */
+#define	DFASTATES	32	/* States cached per expression. */
+#define	DFAFLUSH	16	/* Cache flushes before we give up on it. */
+#define	T_SHIFT		16
+#define	T_NODE		0xffffL
+
+#define	D_ACCEPT	01	/* Closure reached END. */
+#define	D_EOLDONE	02	/* D_EOLOK is valid. */
+#define	D_EOLOK		04	/* Matches if the string ends here. */
+
+/* Round up to an alignment safe for anything. */
+#define	DALIGN(n)	((((n)+sizeof(double)-1)/sizeof(double))*sizeof(double))
+
+typedef struct {
+	char *prog;		/* The program being simulated. */
+	int nclass;		/* Count of byte classes. */
+	int nthreads;		/* Most threads a state can hold. */
+	int nstates;		/* States now in the cache. */
+	int start;		/* State at start of string, -1 if unknown. */
+	int flushes;		/* Times the cache has filled up. */
+	int accept;		/* Set when a closure reaches END. */
+	int neps;		/* Count of entries in eps. */
+	unsigned char class[256];	/* Byte class of each character. */
+	long *sets;		/* DFASTATES+1 thread sets, the last scratch. */
+	char **eps;		/* Epsilon nodes a closure has visited. */
+	int *setlen;		/* Thread count of each set. */
+	short *trans;		/* DFASTATES by nclass, -1 if not known yet. */
+	char *flags;		/* D_ flags of each state. */
+	char *rep;		/* A representative character of each class. */
+} regdfa_t;
+
+/*
+ - regsplit - refine byte classes by membership in a set of characters
+ */
+static int			/* New count of classes. */
+regsplit(class, nclass, set)
+unsigned char *class;
+int nclass;
+char *set;
+{
+    register int c;
+    register int in;
+    short newid[256][2];
+    int next = 0;
+    char member[256];
+
+    (void) bzero(member, sizeof(member));
+    for (; *set != '\0'; set++)
+	member[UCHARAT(set)] = 1;
+    for (c = 0; c < nclass; c++)
+	newid[c][0] = newid[c][1] = -1;
+    for (c = 0; c < 256; c++) {
+	in = member[c];
+	if (newid[class[c]][in] < 0)
+	    newid[class[c]][in] = next++;
+	class[c] = newid[class[c]][in];
+    }
+    return(next);
+}
+
+/*
+ - regdfainit - size up a freshly compiled program, attach a DFA if useful
+ *
+ * Programs without closures or alternations are left to the backtracker,
+ * which does them in one pass anyway.  Bytes are split into classes such
+ * that no node of the program can tell two bytes of a class apart; the
+ * transition table needs only one column per class.  The DFA's space is
+ * added to the end of the program's block with realloc(), which may move
+ * it; if there's no room we just do without.
+ */
+static regexp *
+regdfainit(r, size)
+regexp *r;
+long size;
+{
+    register char *scan;
+    register char *opnd;
+    register regdfa_t *d;
+    register int i;
+    char *end = r->program + size;
+    int worth = 0, nthreads = 0, nnodes = 0, nclass;
+    unsigned char class[256];
+    char one[2];
+    unsigned base, dsize;
+    regexp *nr;
+
+    /* NUL ends the string; keep it in a class by itself. */
+    (void) bzero((char *)class, sizeof(class));
+    class[0] = 1;
+    nclass = 2;
+
+    for (scan = r->program + 1; scan < end; scan = opnd) {
+	nnodes++;
+	opnd = scan + 3;
+	switch (OP(scan)) {
+	case STAR:
+	case PLUS:
+	    worth++;
+	    nthreads++;
+	    break;
+	case BACK:
+	    worth++;
+	    break;
+	case BRANCH:
+	    if (regnext(scan) != (char *)NULL && OP(regnext(scan)) == BRANCH)
+		worth++;
+	    break;
+	case ANY:
+	case EOL:
+	    nthreads++;
+	    break;
+	case ANYOF:
+	case ANYBUT:
+	    nthreads++;
+	    nclass = regsplit(class, nclass, opnd);
+	    opnd += strlen(opnd) + 1;
+	    break;
+	case EXACTLY:
+	    one[1] = '\0';
+	    for (; *opnd != '\0'; opnd++) {
+		nthreads++;
+		one[0] = *opnd;
+		nclass = regsplit(class, nclass, one);
+	    }
+	    opnd++;
+	    break;
+	}
+    }
+    if (!worth || nthreads == 0 || size > T_NODE)
+	return(r);
+
+    base = DALIGN(sizeof(regexp) + (unsigned)size);
+    dsize = DALIGN(sizeof(regdfa_t))
+	+ (DFASTATES+1) * nthreads * sizeof(long)
+	+ nnodes * sizeof(char *)
+	+ (DFASTATES+1) * sizeof(int)
+	+ DFASTATES * nclass * sizeof(short)
+	+ DFASTATES + nclass;
+#ifndef lint
+    nr = (regexp *)realloc((char *)r, base + dsize);
+#else
+    nr = (regexp *)NULL;
+#endif /* lint */
+    if (nr == (regexp *)NULL)
+	return(r);		/* Can't help, but r is still good. */
+    r = nr;
+
+    d = (regdfa_t *)((char *)r + base);
+    d->prog = r->program;
+    d->nclass = nclass;
+    d->nthreads = nthreads;
+    d->nstates = 0;
+    d->start = -1;
+    d->flushes = 0;
+    for (i = 0; i < 256; i++)
+	d->class[i] = class[i];
+#ifndef lint
+    d->sets = (long *)((char *)d + DALIGN(sizeof(regdfa_t)));
+    d->eps = (char **)(d->sets + (DFASTATES+1) * nthreads);
+    d->setlen = (int *)(d->eps + nnodes);
+    d->trans = (short *)(d->setlen + (DFASTATES+1));
+#endif /* lint */
+    d->flags = (char *)(d->trans + DFASTATES * nclass);
+    d->rep = d->flags + DFASTATES;
+    for (i = 255; i >= 0; i--)
+	d->rep[class[i]] = i;
+    r->regdfa = (char *)d;
+    return(r);
+}
+
+/*
+ - regthread - add a thread to a set, if it isn't there already
+ */
+static void
+regthread(d, set, np, t)
+register regdfa_t *d;
+register long *set;
+int *np;
+long t;
+{
+    register int i;
+
+    for (i = 0; i < *np; i++)
+	if (set[i] == t)
+	    return;
+    if (*np < d->nthreads)
+	set[(*np)++] = t;
+}
+
+/*
+ - regclose - add the threads reachable from a node without consuming input
+ */
+static void
+regclose(d, set, np, scan, atbol, atend)
+register regdfa_t *d;
+long *set;
+int *np;
+register char *scan;
+int atbol;			/* At the beginning of the string? */
+int atend;			/* At the end of the string? */
+{
+    register char *next;
+    register int i;
+
+    while (scan != (char *)NULL) {
+	next = regnext(scan);
+	switch (OP(scan)) {
+	case BOL:
+	    if (!atbol)
+		return;
+	    break;
+	case EOL:
+	    if (!atend) {
+		regthread(d, set, np, (long)(scan - d->prog));
+		return;
+	    }
+	    break;
+	case ANY:
+	case ANYOF:
+	case ANYBUT:
+	case EXACTLY:
+	case PLUS:
+	    regthread(d, set, np, (long)(scan - d->prog));
+	    return;
+	case STAR:
+	    regthread(d, set, np, (long)(scan - d->prog));
+	    break;		/* Zero times is fine, go on. */
+	case END:
+	    d->accept = 1;
+	    return;
+	default:		/* BRANCH, BACK, NOTHING, OPEN, CLOSE. */
+	    for (i = 0; i < d->neps; i++)
+		if (d->eps[i] == scan)
+		    return;	/* Been here already. */
+	    d->eps[d->neps++] = scan;
+	    if (OP(scan) == BRANCH) {
+		if (next != (char *)NULL && OP(next) == BRANCH)
+		    regclose(d, set, np, next, atbol, atend);
+		next = OPERAND(scan);
+	    }
+	    break;
+	}
+	scan = next;
+    }
+}
+
+/*
+ - regone - does a simple node match a single character?
+ */
+static int
+regone(p, c)
+register char *p;
+register int c;
+{
+    switch (OP(p)) {
+    case ANY:
+	return(1);
+    case EXACTLY:
+	return(*OPERAND(p) == c);
+    case ANYOF:
+	return(strchr(OPERAND(p), c) != (char *)NULL);
+    case ANYBUT:
+	return(strchr(OPERAND(p), c) == (char *)NULL);
+    }
+    return(0);
+}
+
+/*
+ - regstep - advance one thread over a (non-NUL) character
+ */
+static void
+regstep(d, set, np, t, c)
+register regdfa_t *d;
+long *set;
+int *np;
+long t;
+register int c;
+{
+    register char *node = d->prog + (t & T_NODE);
+    register char *opnd = OPERAND(node);
+    register int k;
+
+    switch (OP(node)) {
+    case ANY:
+    case ANYOF:
+    case ANYBUT:
+	if (regone(node, c))
+	    regclose(d, set, np, regnext(node), 0, 0);
+	break;
+    case EXACTLY:
+	k = (int)(t >> T_SHIFT);
+	if (opnd[k] != c)
+	    break;
+	if (opnd[k+1] == '\0')
+	    regclose(d, set, np, regnext(node), 0, 0);
+	else
+	    regthread(d, set, np, t + (1L << T_SHIFT));
+	break;
+    case STAR:
+    case PLUS:
+	/* Once one has matched, either may repeat or stop. */
+	if (regone(opnd, c)) {
+	    regthread(d, set, np, t);
+	    regclose(d, set, np, regnext(node), 0, 0);
+	}
+	break;
+    }				/* EOL threads just die. */
+}
+
+/*
+ - regstate - find or make the state for the thread set in the scratch slot
+ */
+static int
+regstate(d, n)
+register regdfa_t *d;
+int n;
+{
+    register long *set = d->sets + DFASTATES * d->nthreads;
+    register long *old;
+    register int i, j;
+    int flag = d->accept ? D_ACCEPT : 0;
+    long t;
+
+    /* Canonicalize; the sets are small, so an insertion sort will do. */
+    for (i = 1; i < n; i++) {
+	t = set[i];
+	for (j = i; j > 0 && set[j-1] > t; j--)
+	    set[j] = set[j-1];
+	set[j] = t;
+    }
+
+    for (i = 0; i < d->nstates; i++) {
+	if (d->setlen[i] != n || (d->flags[i] & D_ACCEPT) != flag)
+	    continue;
+	old = d->sets + i * d->nthreads;
+	for (j = 0; j < n && old[j] == set[j]; j++)
+	    continue;
+	if (j == n)
+	    return(i);
+    }
+
+    if (d->nstates >= DFASTATES) {
+	d->flushes++;
+	d->nstates = 0;
+	d->start = -1;
+    }
+    i = d->nstates++;
+    old = d->sets + i * d->nthreads;
+    for (j = 0; j < n; j++)
+	old[j] = set[j];
+    d->setlen[i] = n;
+    d->flags[i] = flag;
+    for (j = 0; j < d->nclass; j++)
+	d->trans[i * d->nclass + j] = -1;
+    return(i);
+}
+
+/*
+ - regtrans - work out the state reached from a state on a byte class
+ *
+ * The search is unanchored, so every step also starts the program afresh;
+ * anchored programs die at their BOL.
+ */
+static int
+regtrans(d, s, class)
+register regdfa_t *d;
+int s;
+int class;
+{
+    register long *from = d->sets + s * d->nthreads;
+    long *set = d->sets + DFASTATES * d->nthreads;
+    register int i;
+    int n = 0;
+
+    d->neps = 0;
+    d->accept = 0;
+    for (i = 0; i < d->setlen[s]; i++)
+	regstep(d, set, &n, from[i], UCHARAT(d->rep + class));
+    regclose(d, set, &n, d->prog + 1, 0, 0);
+    return(regstate(d, n));
+}
+
+/*
+ - regdfaexec - run a string through the DFA
+ */
+static int			/* 1 match, 0 no match, -1 can't tell. */
+regdfaexec(prog, string)
+regexp *prog;
+char *string;
+{
+    register regdfa_t *d = (regdfa_t *)prog->regdfa;
+    register char *s;
+    register int st;
+    register int next;
+    long *set;
+    int i, n, flushes, cl;
+
+    /* On an empty string BOL and EOL hold at once; leave that to regtry(). */
+    if (d->flushes >= DFAFLUSH || *string == '\0')
+	return(-1);
+
+    if ((st = d->start) < 0) {
+	set = d->sets + DFASTATES * d->nthreads;
+	n = 0;
+	d->neps = 0;
+	d->accept = 0;
+	regclose(d, set, &n, d->prog + 1, 1, 0);
+	d->start = st = regstate(d, n);
+    }
+
+    for (s = string; *s != '\0'; s++) {
+	if (d->flags[st] & D_ACCEPT)
+	    return(1);
+	cl = d->class[UCHARAT(s)];
+	if ((next = d->trans[st * d->nclass + cl]) < 0) {
+	    flushes = d->flushes;
+	    next = regtrans(d, st, cl);
+	    if (d->flushes == flushes)
+		d->trans[st * d->nclass + cl] = next;
+	    else if (d->flushes >= DFAFLUSH)
+		return(-1);
+	}
+	st = next;
+    }
+    if (d->flags[st] & D_ACCEPT)
+	return(1);
+
+    /* At the end; see whether any EOL threads get through to END. */
+    if (!(d->flags[st] & D_EOLDONE)) {
+	set = d->sets + DFASTATES * d->nthreads;
+	n = 0;
+	d->neps = 0;
+	d->accept = 0;
+	for (i = 0; i < d->setlen[st]; i++) {
+	    s = d->prog + (d->sets[st * d->nthreads + i] & T_NODE);
+	    if (OP(s) == EOL)
+		regclose(d, set, &n, regnext(s), 0, 1);
+	}
+	d->flags[st] |= D_EOLDONE | (d->accept ? D_EOLOK : 0);
+    }
+    return((d->flags[st] & D_EOLOK) != 0);
+}
+
 /*
  * regexec and friends
  */
@@ -637,6 +1126,9 @@ static char **regendp;		/* Ditto for endp. */
 static int regtry();
 static int regmatch();
 static int regrepeat();
+#ifdef PROFILE
+static int regnodfa;		/* Set to time the backtracker alone. */
+#endif /* PROFILE */
 
 /*
  - regexec - match a regexp against a string
@@ -673,6 +1165,14 @@ register char *string;
 	    return(0);
     }
 
+    /* If there's a DFA, let it rule out a match cheaply. */
+    if (prog->regdfa != (char *)NULL
+#ifdef PROFILE
+	&& !regnodfa
+#endif /* PROFILE */
+	&& regdfaexec(prog, string) == 0)
+	return(0);
+
     /* Mark beginning of line for ^ . */
     regbol = string;
 
@@ -781,7 +1281,8 @@ char *prog;
 	    }
 	    break;
 	case ANYOF:
-	    if (strchr(OPERAND(scan), *reginput) == (char *)NULL)
+	    if (*reginput == '\0'
+			|| strchr(OPERAND(scan), *reginput) == (char *)NULL)
 		return(0);
 	    reginput++;
 	    break;
@@ -985,4 +1486,108 @@ register char *p;
 	return(p+offset);
 }
 
+#ifdef PROFILE
+/*
+ * A benchmark for the matcher. Takes an iteration count, a file of patterns
+ * and a file of lines to match them against (regexp.pats and regexp.hdrs
+ * will do). Each pattern is run over the lines that many times, first by
+ * the backtracker alone, then with the DFA in front of it; the match counts
+ * had better agree.
+ */
+#include <time.h>
+
+char	*Progname = "profregexp";
+
+static char **slurp(file, np)
+/* read the lines of a file into core */
+char	*file;
+int	*np;
+{
+    FILE	*fp;
+    char	buf[BUFSIZ], **lines;
+    int		n = 0, size = 64;
+
+    if ((fp = fopen(file, "r")) == (FILE *)NULL)
+    {
+	(void) fprintf(stderr, "profregexp: can't open %s\n", file);
+	exit(1);
+    }
+    lines = (char **)malloc((unsigned)(size * sizeof(char *)));
+    while (fgets(buf, sizeof(buf), fp) != (char *)NULL)
+    {
+	if (buf[0] && buf[strlen(buf) - 1] == '\n')
+	    buf[strlen(buf) - 1] = '\0';
+	if (n >= size)
+	    lines = (char **)realloc((char *)lines,
+				     (unsigned)((size *= 2) * sizeof(char *)));
+	lines[n] = malloc((unsigned)strlen(buf) + 1);
+	(void) strcpy(lines[n++], buf);
+    }
+    (void) fclose(fp);
+    *np = n;
+    return(lines);
+}
+
+static long runpat(re, lines, n, iterations, timep)
+/* match one pattern against the corpus, return the match count */
+regexp	*re;
+char	**lines;
+int	n;
+long	iterations;
+double	*timep;
+{
+    clock_t	start = clock();
+    long	i, count = 0;
+    int		l;
+
+    for (i = 0; i < iterations; i++)
+	for (l = 0; l < n; l++)
+	    if (regexec(re, lines[l]))
+		count++;
+    *timep = (double)(clock() - start) / CLOCKS_PER_SEC;
+    return(count / iterations);
+}
+
+main(argc, argv)
+int	argc;
+char	*argv[];
+{
+    char	**pats, **lines;
+    int		npats, nlines, p;
+    long	iterations, oldcount, newcount;
+    double	oldtime, newtime, oldtotal = 0, newtotal = 0;
+    regexp	*re;
+
+    if (argc != 4)
+    {
+	(void) fprintf(stderr,
+		       "usage: profregexp iterations patterns corpus\n");
+	exit(1);
+    }
+    iterations = atol(argv[1]);
+    pats = slurp(argv[2], &npats);
+    lines = slurp(argv[3], &nlines);
+
+    (void) printf("%-40s %7s %9s %9s\n", "pattern", "matches", "backtrack", "DFA");
+    for (p = 0; p < npats; p++)
+    {
+	if ((re = regcomp(pats[p])) == (regexp *)NULL)
+	    continue;
+	regnodfa = 1;
+	oldcount = runpat(re, lines, nlines, iterations, &oldtime);
+	regnodfa = 0;
+	newcount = runpat(re, lines, nlines, iterations, &newtime);
+	(void) printf("%-40s %7ld %8.2fs %8.2fs%s%s\n",
+		      pats[p], newcount, oldtime, newtime,
+		      re->regdfa ? "" : "  (no DFA)",
+		      oldcount != newcount ? "  MISMATCH" : "");
+	oldtotal += oldtime;
+	newtotal += newtime;
+	free((char *)re);
+    }
+    (void) printf("%-40s %7s %8.2fs %8.2fs\n", "total", "", oldtotal, newtotal);
+    exit(0);
+}
+#endif /* PROFILE */
+
 /* regexp.c ends here */
@@ -0,0 +1,219 @@
+/****************************************************************************
+
+NAME
+   region.c -- region allocation, for storage that all dies at once
+
+SYNOPSIS
+   #include "region.h"
+
+   region_t *rgnew(size)	-- make a region
+   int size;
+
+   char *rgalloc(rp, n)		-- allocate n bytes, aligned for any use
+   region_t *rp; int n;
+
+   char *rgtext(rp, n)		-- allocate n bytes of character space
+   region_t *rp; int n;
+
+   char *rgsave(rp, cp)		-- copy a string into a region
+   region_t *rp; char *cp;
+
+   void rgreset(rp)		-- free everything allocated in a region
+   region_t *rp;
+
+   bool rgextend(rp, end, n)	-- grow the newest allocation in place
+   region_t *rp; char *end; int n;
+
+   bool rgowns(rp, cp)		-- was the given storage allocated in a region?
+   region_t *rp; char *cp;
+
+   void rgfree(rp)		-- free a region and all its storage
+   region_t *rp;
+
+DESCRIPTION
+   A lot of the storage allocated while processing an article (copies of
+header lines, destination group names, history lines) lives exactly as long
+as the article does. These functions let such storage be carved off a region
+and all given back in a single rgreset() call when the article is done, rather
+than malloc()ed and free()d piece by piece (or, all too often, leaked).
+
+   A region is a chain of blocks. Storage is carved off the front block, and
+a fresh block at least as large is pushed on when that one fills. The
+rgreset() call frees all the storage in a region in constant time when the
+region has one block. If it overflowed, rgreset() coalesces its blocks into
+one block of their total size, so the next article of the same size fits in
+one block again. Either way the region keeps its memory for reuse; only
+rgfree() gives it back.
+
+   The rgalloc() call returns storage aligned for any type; rgtext() and
+rgsave() don't bother, since they're used for characters.
+
+   The rgextend() call lets a string that is still the newest thing in its
+region grow without being copied. If end is the end of the newest allocation
+and n more bytes fit in its block, they are added to it and TRUE is returned;
+otherwise nothing happens and the caller must allocate afresh.
+
+   Each region counts the allocations made in it and their total size since
+the last rgreset(), in its rg_allocs and rg_bytes members. Callers can report
+these for debugging or tuning.
+
+   Allocation failure is fatal (it's reported through xerror()).
+
+AUTHOR
+   Eric S. Raymond
+   This software is Copyright (C) 1989 by Eric S. Raymond for the sole purpose
+of protecting free redistribution; see the LICENSE file for details.
+
+**************************************************************************/
+/*LINTLIBRARY*/
+#include "libport.h"
+#include "region.h"
+
+#define ALIGN	sizeof(double)	/* strictest alignment we need */
+
+/* the space follows the block header, rounded up to keep it aligned */
+#define RBHEAD		((sizeof(rgblock_t) + ALIGN - 1) / ALIGN * ALIGN)
+#define rbtext(b)	((char *)(b) + RBHEAD)
+
+static rgblock_t *rbnew(size)
+/* allocate a new region block */
+int	size;
+{
+    rgblock_t	*bp;
+
+    if ((bp = (rgblock_t *)malloc((unsigned)(RBHEAD + size))) == (rgblock_t *)NULL)
+	xerror1("out of memory for a %d-byte region block", size);
+    bp->rb_next = (rgblock_t *)NULL;
+    bp->rb_size = size;
+    bp->rb_used = 0;
+    return(bp);
+}
+
+region_t *rgnew(size)
+/* make a region whose first block has the given size */
+int	size;
+{
+    region_t	*rp;
+
+    if ((rp = (region_t *)malloc(sizeof(region_t))) == (region_t *)NULL)
+	xerror0("out of memory for a region");
+    rp->rg_blocks = rbnew(size);
+    rp->rg_next = (region_t *)NULL;
+    rp->rg_allocs = rp->rg_bytes = 0L;
+    return(rp);
+}
+
+char *rgtext(rp, n)
+/* carve n bytes off a region */
+region_t	*rp;
+int		n;
+{
+    register rgblock_t	*bp = rp->rg_blocks;
+
+    if (bp->rb_used + n > bp->rb_size)
+    {
+	bp = rbnew(n > bp->rb_size ? n : bp->rb_size);
+	bp->rb_next = rp->rg_blocks;
+	rp->rg_blocks = bp;
+    }
+    rp->rg_allocs++;
+    rp->rg_bytes += n;
+    bp->rb_used += n;
+    return(rbtext(bp) + bp->rb_used - n);
+}
+
+char *rgalloc(rp, n)
+/* carve n bytes off a region, aligned for any use */
+region_t	*rp;
+int		n;
+{
+    register rgblock_t	*bp = rp->rg_blocks;
+    int			pad;
+
+    /* the block text is aligned, so we need only pad out the used part */
+    if ((pad = bp->rb_used % ALIGN) != 0)
+    {
+	pad = ALIGN - pad;
+	if (bp->rb_used + pad + n <= bp->rb_size)
+	    bp->rb_used += pad;
+    }
+    return(rgtext(rp, n));
+}
+
+char *rgsave(rp, cp)
+/* copy a string into a region */
+region_t	*rp;
+char		*cp;
+{
+    return(strcpy(rgtext(rp, strlen(cp) + 1), cp));
+}
+
+void rgreset(rp)
+/* free all storage in a region, coalescing it into one block if need be */
+region_t	*rp;
+{
+    register rgblock_t	*bp, *next;
+    int			total = 0;
+
+    if (rp == (region_t *)NULL)
+	return;
+    else if (rp->rg_blocks->rb_next == (rgblock_t *)NULL)
+	rp->rg_blocks->rb_used = 0;
+    else
+    {
+	for (bp = rp->rg_blocks; bp; bp = next)
+	{
+	    next = bp->rb_next;
+	    total += bp->rb_size;
+	    (void) free((char *)bp);
+	}
+	rp->rg_blocks = rbnew(total);
+    }
+    rp->rg_allocs = rp->rg_bytes = 0L;
+}
+
+bool rgextend(rp, end, n)
+/* try to grow the newest allocation in a region by n bytes */
+region_t	*rp;
+char		*end;	/* where the allocation ends now */
+int		n;
+{
+    register rgblock_t	*bp = rp->rg_blocks;
+
+    if (end != rbtext(bp) + bp->rb_used || bp->rb_used + n > bp->rb_size)
+	return(FALSE);
+    bp->rb_used += n;
+    rp->rg_bytes += n;
+    return(TRUE);
+}
+
+bool rgowns(rp, cp)
+/* was the given storage allocated from the given region? */
+region_t	*rp;
+char		*cp;
+{
+    register rgblock_t	*bp;
+
+    for (bp = rp->rg_blocks; bp; bp = bp->rb_next)
+	if (cp >= rbtext(bp) && cp < rbtext(bp) + bp->rb_size)
+	    return(TRUE);
+    return(FALSE);
+}
+
+void rgfree(rp)
+/* give back a region and all its storage */
+region_t	*rp;
+{
+    register rgblock_t	*bp, *next;
+
+    if (rp == (region_t *)NULL)
+	return;
+    for (bp = rp->rg_blocks; bp; bp = next)
+    {
+	next = bp->rb_next;
+	(void) free((char *)bp);
+    }
+    (void) free((char *)rp);
+}
+
+/* region.c ends here */
@@ -0,0 +1,27 @@
+/* region.h -- definitions for region (arena) allocation */
+
+typedef struct rgblock
+{
+    struct rgblock *rb_next;	/* next (older) block in this region */
+    int		rb_size;	/* bytes of space in the block */
+    int		rb_used;	/* bytes of it in use */
+}
+rgblock_t;
+
+typedef struct region
+{
+    rgblock_t	*rg_blocks;	/* the block chain, newest first */
+    struct region *rg_next;	/* free for the owner's use as a chain link */
+
+    /* statistics, cleared by rgreset() */
+    long	rg_allocs;	/* count of allocations */
+    long	rg_bytes;	/* bytes allocated */
+}
+region_t;
+
+extern region_t *rgnew();
+extern char *rgalloc(), *rgtext(), *rgsave();
+extern void rgreset(), rgfree();
+extern bool rgextend(), rgowns();
+
+/* region.h ends here */
@@ -27,8 +27,9 @@ will close both fds and make the server array slot available. It does not wait
 for the process to terminate (it is presumed that the caller, which has access
 to the server's pid, will have killed the process if it cares).
 
-   The srvopen() code uses execvp(), so it will check the user's PATH
-variable and does not demand full filenames.
+   The srvopen() code uses launch() with PATH search, so it will check the
+user's PATH variable and does not demand full filenames. The server is
+launched detached, so once it has been killed lreap() collects it.
 
    Compiling this module with -DMAIN yields an interactive tester. To test
 only the read from server, call 'server -r'; to test only the write to server,
@@ -49,6 +50,7 @@ of protecting free redistribution; see the LICENSE file for details.
 /*LINTLIBRARY*/
 #include "libport.h"
 #include "server.h"
+#include "launch.h"
 
 #ifndef private
 #define private static
@@ -61,7 +63,7 @@ server_t *srvopen(file, argv)
 char	*file;
 char	*argv[];
 {
-    int		    inpipe[2], outpipe[2];
+    int		    inpipe[2], outpipe[2], fds[LNFDS];
     server_t	    *csrv;
 
     for (csrv = servers; csrv < &servers[MAXSERVERS]; csrv++)
@@ -71,27 +73,21 @@ char	*argv[];
     if (csrv->pid || pipe(inpipe) < 0 || pipe(outpipe) < 0)
 	return((server_t *)NULL);
 
-    if ((csrv->pid = vfork()) == 0)
-    {
-	(void) close(0);
-	(void) close(1);
-	(void) close(2);
-	(void) dup(inpipe[0]);
-	(void) dup(outpipe[1]);
-	(void) dup(outpipe[1]);
-	(void) close(inpipe[0]);
-	(void) close(inpipe[1]);
-	(void) close(outpipe[0]);
-	(void) close(outpipe[1]);
-
-	(void) execvp(file, argv);
-	_exit(1);
-    }
-    if (csrv->pid == -1)
-	return((server_t *)NULL);
+    fds[0] = inpipe[0];
+    fds[1] = fds[2] = outpipe[1];
+    (void) fcntl(inpipe[1], F_SETFD, 1);	/* these are our ends */
+    (void) fcntl(outpipe[0], F_SETFD, 1);
+    csrv->pid = launch(file, argv, (char **)NULL, fds, LPATH|LDETACH);
 
     (void) close(outpipe[1]);
     (void) close(inpipe[0]);
+    if (csrv->pid == FAIL)
+    {
+	csrv->pid = 0;
+	(void) close(outpipe[0]);
+	(void) close(inpipe[1]);
+	return((server_t *)NULL);
+    }
 
     csrv->readsrv = outpipe[0];
     csrv->writesrv = inpipe[1];
@@ -108,7 +108,7 @@ main()
 	}
 	else if (sscanf(cmdline, "g %s", strv) == 1)
 	{
-	    char *ngp = dbafind(&slist, strv);
+	    char *ngp = dbafind(&slist, strv, streq);
 
 	    if (ngp == (char *)NULL)
 		(void) printf("%s: no such string\n", strv);
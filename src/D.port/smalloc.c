@@ -0,0 +1,791 @@
+/****************************************************************************
+
+NAME
+   smalloc.c -- size-class slab storage allocator
+
+SYNOPSIS
+   char *malloc(n)		-- allocate n bytes
+   unsigned n;
+
+   void free(cp)		-- give back allocated storage
+   char *cp;
+
+   char *realloc(cp, n)		-- change the size of allocated storage
+   char *cp; unsigned n;
+
+   char *calloc(nitems, size)	-- allocate zeroed storage
+   unsigned nitems, size;
+
+   void cfree(cp)		-- same as free()
+   char *cp;
+
+   void mstats(s)		-- report allocation statistics (MSTATS only)
+   char *s;
+
+DESCRIPTION
+   This is a replacement for the malloc(3) family, chosen like kmalloc.c or
+nmalloc.c by giving its name at Configure's malloc question. Those two round
+every request up to a power of two less a header word, never hand storage
+freed in one size to a request of another, and never give anything back to
+the system; a long-running rnews daemon or a reader with a big active array
+ends up with a heap that is largely slack.
+
+   Memory is taken from the system in segments of SEGSIZE bytes, aligned on
+a SEGSIZE boundary and cut into pages of PAGESIZE bytes. The front of each
+segment holds a descriptor for each of its pages, so free() can find what
+an address belongs to by masking it; there are no per-object headers.
+
+   Requests of up to SMALLMAX bytes are rounded up to one of NCLASSES size
+classes, spaced a quarter of a power of two apart so no more than a fifth of
+an object is padding, and served from slabs. A slab is a run of one or more
+pages (as many as it takes to keep the leftover at the end under an eighth)
+carved into objects of a single class. Each class keeps a list of its slabs
+that have room. Freed objects go back on their slab's free list, and a slab
+whose objects are all free is given back to the segment (except for the last
+one a class has, to avoid thrashing).
+
+   Bigger requests get a run of whole pages, first fit. Free runs in a
+segment are merged with their neighbors as they're freed, and a realloc()
+of a big block shrinks it or grows it in place when it can (which suits the
+arrays grow.c and the active-file code keep extending). Requests bigger than
+a segment get a chunk of their own.
+
+   An emptied segment is given back to the system, except that KEEPSEGS of
+them are held for reuse. Segments come from sbrk(2), or from mmap(2) if MMAP
+is defined. With sbrk(), storage can only be given back from the top of the
+heap; storage freed below that is kept, merged with its neighbors, for reuse.
+
+   If MSTATS is defined, mstats() prints per-class counts of free and in-use
+objects in the same form as the kmalloc.c version, followed by a line on big
+blocks and the total obtained from the system.
+
+   The mbench program made in this directory runs a synthetic ingest trace
+and reports its speed and memory use, so this can be compared with kmalloc.c
+and the system malloc on a given machine.
+
+BUGS
+   Unlike the kmalloc.c version, realloc() of storage already freed doesn't
+work.
+   A free() of something that didn't come from malloc() may dump core rather
+than be ignored, since the segment header it looks at may not be mapped.
+   Other code that moves the break with sbrk() doesn't break anything, but
+keeps storage below its allocation from being given back.
+
+AUTHOR
+   Eric S. Raymond
+   This software is Copyright (C) 1989 by Eric S. Raymond for the sole purpose
+of protecting free redistribution; see the LICENSE file for details.
+
+**************************************************************************/
+/*LINTLIBRARY*/
+#ifndef lint	/* let the lint library handle references to malloc & co. */
+
+#include "libport.h"
+
+#define public	/* empty */
+#ifndef private
+#define private static
+#endif
+
+#ifdef SMALL_ADDRESS_SPACE
+#define SEGSHIFT	14		/* log2 of the segment size */
+#define PAGESHIFT	9		/* log2 of the page size */
+#define SMALLMAX	1024		/* biggest request served from slabs */
+#define NCLASSES	24		/* size classes up to SMALLMAX */
+#else
+#define SEGSHIFT	18
+#define PAGESHIFT	12
+#define SMALLMAX	16384
+#define NCLASSES	40
+#endif /* SMALL_ADDRESS_SPACE */
+#define SEGSIZE		(1L << SEGSHIFT)
+#define PAGESIZE	(1L << PAGESHIFT)
+#define NPAGES		(1 << (SEGSHIFT - PAGESHIFT))	/* pages per segment */
+#define MAXSLAB		16		/* most pages in a slab */
+#define KEEPSEGS	1		/* empty segments held for reuse */
+
+#define ALIGNMENT	sizeof(double)	/* strictest alignment we need */
+#define rndup(n, m)	(((n) + (m) - 1) / (m) * (m))
+
+/* page kinds */
+#define P_HEAD		0	/* holds the segment header */
+#define P_FREE		1	/* free */
+#define P_SLAB		2	/* first page of a slab */
+#define P_BIG		3	/* first page of a big block */
+#define P_TAIL		4	/* later page of a slab or big block */
+
+typedef struct page
+{
+    unsigned char	pg_kind;	/* one of the P_ values */
+    unsigned char	pg_class;	/* size class (slabs) */
+    unsigned short	pg_npages;	/* length of the run this heads */
+    unsigned short	pg_head;	/* first page of this run (tails) */
+    unsigned short	pg_inuse;	/* objects handed out (slabs) */
+    char		*pg_free;	/* freed objects, linked by 1st word */
+    char		*pg_fresh;	/* first object never handed out */
+    struct page		*pg_next;	/* next slab of this class with room */
+    struct page		*pg_prev;	/* previous slab on that list */
+}
+page_t;
+
+#define SEGMAGIC	0x5e6dL
+#define HUGEMAGIC	0x4e6eL
+
+typedef struct
+{
+    long	ch_magic;	/* SEGMAGIC or HUGEMAGIC */
+    long	ch_size;	/* bytes in the chunk */
+}
+chunk_t;
+
+typedef struct seg
+{
+    chunk_t	sg_chunk;		/* must be first */
+    struct seg	*sg_next, *sg_prev;	/* links on the segment list */
+    int		sg_nfree;		/* count of free pages */
+    page_t	sg_pages[NPAGES];	/* page descriptors */
+}
+seg_t;
+
+#define HDRPAGES	((int)((sizeof(seg_t) + PAGESIZE - 1) / PAGESIZE))
+#define MAXRUN		(NPAGES - HDRPAGES)	/* biggest run a segment has */
+#define HUGEHEAD	rndup(sizeof(chunk_t), ALIGNMENT)
+
+#define segof(cp)	((seg_t *)((long)(cp) & ~(SEGSIZE - 1)))
+#define pageno(sg, cp)	((int)(((char *)(cp) - (char *)(sg)) >> PAGESHIFT))
+#define pageaddr(sg, pd) ((char *)(sg) + ((long)((pd) - (sg)->sg_pages) << PAGESHIFT))
+
+private bool	ready;			/* have the tables been set up? */
+private unsigned short	clsize[NCLASSES];	/* object size of each class */
+private unsigned char	clpages[NCLASSES];	/* pages in a slab of it */
+private unsigned short	clcount[NCLASSES];	/* objects in a slab of it */
+private unsigned char	classof[SMALLMAX / ALIGNMENT + 1];	/* size to class */
+private page_t	*partial[NCLASSES];	/* slabs with room, by class */
+private seg_t	*segs, *lastseg;	/* segments, oldest first */
+private int	nempty;			/* empty segments held */
+private long	sysbytes;		/* bytes got from the system */
+#ifdef MSTATS
+/* nmalloc[i] is the count of objects of class i in use */
+private unsigned int	nmalloc[NCLASSES];
+private unsigned int	nbig, nhuge;	/* big blocks and huge chunks in use */
+private long		bigbytes;	/* bytes of them */
+#endif /* MSTATS */
+
+private void sminit()
+/* build the size class tables */
+{
+    register int	c, n, k;
+    long		size, step;
+
+    /* classes go up by ALIGNMENT to 64, then by quarters of a power of 2 */
+    for (c = 0, size = ALIGNMENT; c < NCLASSES; c++)
+    {
+	clsize[c] = size;
+	if (size < 64)
+	    size += ALIGNMENT;
+	else
+	{
+	    for (step = 64; step * 2 <= size; step *= 2)
+		continue;
+	    size += step / 4;
+	}
+    }
+
+    /* pick a slab size for each class that wastes little space */
+    for (c = 0; c < NCLASSES; c++)
+    {
+	for (k = 1; k < MAXSLAB; k++)
+	    if (k * PAGESIZE >= clsize[c]
+		&& (k * PAGESIZE) % clsize[c] <= k * PAGESIZE / 8)
+		break;
+	clpages[c] = k;
+	clcount[c] = k * PAGESIZE / clsize[c];
+    }
+
+    for (n = c = 0; n <= SMALLMAX / ALIGNMENT; n++)
+    {
+	while (clsize[c] < n * ALIGNMENT)
+	    c++;
+	classof[n] = c;
+    }
+    ready = TRUE;
+}
+
+/*
+ * Getting storage from and giving it back to the system
+ */
+
+#ifdef MMAP
+#ifndef MAP_ANON
+private int	zerofd = FAIL;		/* /dev/zero, to map from */
+#endif /* MAP_ANON */
+
+private char *sysget(size)
+/* get size bytes from the system, on a segment boundary */
+long	size;
+{
+    char	*cp;
+    long	lead;
+
+#ifdef MAP_ANON
+    cp = (char *)mmap((char *)NULL, (size_t)(size + SEGSIZE),
+		      PROT_READ|PROT_WRITE, MAP_PRIVATE|MAP_ANON, -1, (off_t)0);
+#else
+    if (zerofd == FAIL && (zerofd = open("/dev/zero", O_RDWR)) == FAIL)
+	return((char *)NULL);
+    cp = (char *)mmap((char *)NULL, (size_t)(size + SEGSIZE),
+		      PROT_READ|PROT_WRITE, MAP_PRIVATE, zerofd, (off_t)0);
+#endif /* MAP_ANON */
+    if (cp == (char *)-1)
+	return((char *)NULL);
+
+    /* trim the mapping to an aligned piece */
+    if ((lead = (SEGSIZE - ((long)cp & (SEGSIZE - 1))) & (SEGSIZE - 1)) != 0)
+	(void) munmap(cp, (size_t)lead);
+    if (SEGSIZE - lead > 0)
+	(void) munmap(cp + lead + size, (size_t)(SEGSIZE - lead));
+    sysbytes += size;
+    return(cp + lead);
+}
+
+private void sysfree(cp, size)
+/* give storage back to the system */
+char	*cp;
+long	size;
+{
+    (void) munmap(cp, (size_t)size);
+    sysbytes -= size;
+}
+#else
+extern char *sbrk();
+
+/* storage freed below the break, in address order */
+typedef struct spare
+{
+    struct spare	*sp_next;
+    long		sp_size;
+}
+spare_t;
+private spare_t	*spares;
+
+private char *sysget(size)
+/* get size bytes from the system, on a segment boundary */
+long	size;
+{
+    register spare_t	*sp, **pp;
+    char		*cp;
+    long		lead;
+
+    /* first fit from the storage we already have */
+    for (pp = &spares; (sp = *pp) != (spare_t *)NULL; pp = &sp->sp_next)
+	if (sp->sp_size >= size)
+	{
+	    if (sp->sp_size == size)
+		*pp = sp->sp_next;
+	    else
+	    {
+		*pp = (spare_t *)((char *)sp + size);
+		(*pp)->sp_next = sp->sp_next;
+		(*pp)->sp_size = sp->sp_size - size;
+	    }
+	    return((char *)sp);
+	}
+
+    cp = sbrk(0);
+    lead = (SEGSIZE - ((long)cp & (SEGSIZE - 1))) & (SEGSIZE - 1);
+    if ((cp = sbrk((int)(lead + size))) == (char *)-1)
+	return((char *)NULL);
+    sysbytes += size;
+    return(cp + lead);
+}
+
+private void sysfree(cp, size)
+/* keep freed storage, giving it back to the system if it tops the heap */
+char	*cp;
+long	size;
+{
+    register spare_t	*sp, **pp, *prev = (spare_t *)NULL;
+    spare_t		*new = (spare_t *)cp;
+
+    for (pp = &spares; (sp = *pp) != (spare_t *)NULL && (char *)sp < cp; pp = &sp->sp_next)
+	prev = sp;
+    new->sp_size = size;
+    new->sp_next = sp;
+    *pp = new;
+
+    /* merge it with its neighbors */
+    if (sp != (spare_t *)NULL && cp + size == (char *)sp)
+    {
+	new->sp_size += sp->sp_size;
+	new->sp_next = sp->sp_next;
+    }
+    if (prev != (spare_t *)NULL && (char *)prev + prev->sp_size == cp)
+    {
+	prev->sp_size += new->sp_size;
+	prev->sp_next = new->sp_next;
+	new = prev;
+    }
+
+    /* only the last one can be at the top */
+    if (new->sp_next == (spare_t *)NULL
+		&& (char *)new + new->sp_size == sbrk(0))
+    {
+	for (pp = &spares; *pp != new; pp = &(*pp)->sp_next)
+	    continue;
+	*pp = (spare_t *)NULL;
+	sysbytes -= new->sp_size;
+	(void) sbrk((int)-new->sp_size);
+    }
+}
+#endif /* MMAP */
+
+/*
+ * Page runs within segments
+ */
+
+private void runmark(sg, i, n, kind)
+/* make pages i through i+n-1 of a segment a run of the given kind */
+register seg_t	*sg;
+int		i, n, kind;
+{
+    register int	j;
+
+    sg->sg_pages[i].pg_kind = kind;
+    sg->sg_pages[i].pg_npages = n;
+    for (j = i + 1; j < i + n; j++)
+    {
+	sg->sg_pages[j].pg_kind = (kind == P_FREE) ? P_FREE : P_TAIL;
+	sg->sg_pages[j].pg_head = i;
+    }
+    sg->sg_pages[i + n - 1].pg_head = i;
+}
+
+private void runtake(sg, i, n)
+/* take the first n pages of the free run at page i */
+register seg_t	*sg;
+int		i, n;
+{
+    int	left = sg->sg_pages[i].pg_npages - n;
+
+    if (sg->sg_nfree == MAXRUN)
+	nempty--;
+    if (left > 0)
+	runmark(sg, i + n, left, P_FREE);
+    sg->sg_nfree -= n;
+}
+
+private seg_t *segnew()
+/* get a new segment and put it on the list */
+{
+    register seg_t	*sg;
+    int			i;
+
+    if ((sg = (seg_t *)sysget(SEGSIZE)) == (seg_t *)NULL)
+	return((seg_t *)NULL);
+    sg->sg_chunk.ch_magic = SEGMAGIC;
+    sg->sg_chunk.ch_size = SEGSIZE;
+    for (i = 0; i < HDRPAGES; i++)
+	sg->sg_pages[i].pg_kind = P_HEAD;
+    runmark(sg, HDRPAGES, MAXRUN, P_FREE);
+    sg->sg_nfree = MAXRUN;
+    nempty++;
+
+    sg->sg_next = (seg_t *)NULL;
+    if ((sg->sg_prev = lastseg) != (seg_t *)NULL)
+	lastseg->sg_next = sg;
+    else
+	segs = sg;
+    lastseg = sg;
+    return(sg);
+}
+
+private void segfree(sg)
+/* take a segment off the list and give it back */
+register seg_t	*sg;
+{
+    if (sg->sg_prev)
+	sg->sg_prev->sg_next = sg->sg_next;
+    else
+	segs = sg->sg_next;
+    if (sg->sg_next)
+	sg->sg_next->sg_prev = sg->sg_prev;
+    else
+	lastseg = sg->sg_prev;
+    sg->sg_chunk.ch_magic = 0L;
+    sysfree((char *)sg, SEGSIZE);
+}
+
+private page_t *pageget(n, kind)
+/* get a run of n pages, first fit */
+int	n, kind;
+{
+    register seg_t	*sg;
+    register int	i;
+
+    for (sg = segs; ; sg = sg->sg_next)
+    {
+	if (sg == (seg_t *)NULL && (sg = segnew()) == (seg_t *)NULL)
+	    return((page_t *)NULL);
+	if (sg->sg_nfree < n)
+	    continue;
+	for (i = HDRPAGES; i < NPAGES; i += sg->sg_pages[i].pg_npages)
+	    if (sg->sg_pages[i].pg_kind == P_FREE
+			&& sg->sg_pages[i].pg_npages >= n)
+	    {
+		runtake(sg, i, n);
+		runmark(sg, i, n, kind);
+		return(&sg->sg_pages[i]);
+	    }
+    }
+}
+
+private void pagefree(sg, i)
+/* give back the run at page i of a segment, merging it with free neighbors */
+register seg_t	*sg;
+register int	i;
+{
+    int	n = sg->sg_pages[i].pg_npages, j;
+
+    sg->sg_nfree += n;
+    if ((j = i + n) < NPAGES && sg->sg_pages[j].pg_kind == P_FREE)
+	n += sg->sg_pages[j].pg_npages;
+    if (i > HDRPAGES && sg->sg_pages[i - 1].pg_kind == P_FREE)
+    {
+	j = sg->sg_pages[i - 1].pg_head;
+	n += i - j;
+	i = j;
+    }
+    runmark(sg, i, n, P_FREE);
+
+    if (sg->sg_nfree == MAXRUN)
+	if (nempty < KEEPSEGS)
+	    nempty++;
+	else
+	    segfree(sg);
+}
+
+/*
+ * Slabs
+ */
+
+private void slabunlink(pd)
+/* take a slab off its class's list of slabs with room */
+register page_t	*pd;
+{
+    if (pd->pg_prev)
+	pd->pg_prev->pg_next = pd->pg_next;
+    else
+	partial[pd->pg_class] = pd->pg_next;
+    if (pd->pg_next)
+	pd->pg_next->pg_prev = pd->pg_prev;
+    pd->pg_next = pd->pg_prev = (page_t *)NULL;
+}
+
+private void slablink(pd)
+/* put a slab on the front of its class's list of slabs with room */
+register page_t	*pd;
+{
+    pd->pg_prev = (page_t *)NULL;
+    if ((pd->pg_next = partial[pd->pg_class]) != (page_t *)NULL)
+	pd->pg_next->pg_prev = pd;
+    partial[pd->pg_class] = pd;
+}
+
+private page_t *slabnew(c)
+/* make a new slab for class c */
+int	c;
+{
+    register page_t	*pd;
+
+    if ((pd = pageget((int)clpages[c], P_SLAB)) == (page_t *)NULL)
+	return((page_t *)NULL);
+    pd->pg_class = c;
+    pd->pg_inuse = 0;
+    pd->pg_free = (char *)NULL;
+    pd->pg_fresh = pageaddr(segof(pd), pd);
+    slablink(pd);
+    return(pd);
+}
+
+/*
+ * Huge chunks
+ */
+
+private char *hugeget(nbytes)
+/* get a chunk of its own for a request bigger than a segment can hold */
+unsigned	nbytes;
+{
+    chunk_t	*ch;
+    long	size;
+
+#ifdef MMAP
+    size = rndup(HUGEHEAD + (long)nbytes, PAGESIZE);
+#else
+    size = rndup(HUGEHEAD + (long)nbytes, SEGSIZE);	/* so it can be spares */
+#endif /* MMAP */
+    if ((ch = (chunk_t *)sysget(size)) == (chunk_t *)NULL)
+	return((char *)NULL);
+    ch->ch_magic = HUGEMAGIC;
+    ch->ch_size = size;
+#ifdef MSTATS
+    nhuge++;
+    bigbytes += size;
+#endif /* MSTATS */
+    return((char *)ch + HUGEHEAD);
+}
+
+/*
+ * The entry points
+ */
+
+public char *malloc(nbytes)
+register unsigned nbytes;
+{
+    register page_t	*pd;
+    register char	*cp;
+    int			c;
+
+    if (!ready)
+	sminit();
+
+    if (nbytes > SMALLMAX)
+    {
+	if ((nbytes + PAGESIZE - 1) / PAGESIZE > MAXRUN)
+	    return(hugeget(nbytes));
+	if ((pd = pageget((int)((nbytes + PAGESIZE - 1) / PAGESIZE), P_BIG)) == (page_t *)NULL)
+	    return((char *)NULL);
+#ifdef MSTATS
+	nbig++;
+	bigbytes += pd->pg_npages * PAGESIZE;
+#endif /* MSTATS */
+	return(pageaddr(segof(pd), pd));
+    }
+
+    c = classof[(nbytes + ALIGNMENT - 1) / ALIGNMENT];
+    if ((pd = partial[c]) == (page_t *)NULL && (pd = slabnew(c)) == (page_t *)NULL)
+	return((char *)NULL);
+    if ((cp = pd->pg_free) != (char *)NULL)
+	pd->pg_free = *(char **)cp;
+    else
+    {
+	cp = pd->pg_fresh;
+	pd->pg_fresh += clsize[c];
+    }
+    if (++pd->pg_inuse == clcount[c])
+	slabunlink(pd);		/* it's full */
+#ifdef MSTATS
+    nmalloc[c]++;
+#endif /* MSTATS */
+    return(cp);
+}
+
+private page_t *pageof(cp)
+/* find the descriptor of the slab or big block holding cp */
+char	*cp;
+{
+    register seg_t	*sg = segof(cp);
+    register page_t	*pd;
+
+    if (sg->sg_chunk.ch_magic != SEGMAGIC)
+	return((page_t *)NULL);
+    pd = &sg->sg_pages[pageno(sg, cp)];
+    if (pd->pg_kind == P_TAIL)
+	pd = &sg->sg_pages[pd->pg_head];
+    if (pd->pg_kind == P_SLAB && pd->pg_inuse > 0
+	    && (cp - pageaddr(sg, pd)) % clsize[pd->pg_class] == 0)
+	return(pd);
+    if (pd->pg_kind == P_BIG && cp == pageaddr(sg, pd))
+	return(pd);
+    return((page_t *)NULL);
+}
+
+public void free(cp)
+/* give back allocated storage */
+char *cp;
+{
+    register page_t	*pd;
+    register seg_t	*sg;
+    int			c;
+
+    if (cp == (char *)NULL)
+	return;
+
+    sg = segof(cp);
+    if (sg->sg_chunk.ch_magic == HUGEMAGIC && cp == (char *)sg + HUGEHEAD)
+    {
+#ifdef MSTATS
+	nhuge--;
+	bigbytes -= sg->sg_chunk.ch_size;
+#endif /* MSTATS */
+	sg->sg_chunk.ch_magic = 0L;
+	sysfree((char *)sg, sg->sg_chunk.ch_size);
+	return;
+    }
+    if ((pd = pageof(cp)) == (page_t *)NULL)
+    {
+	(void) fprintf(stderr, "Bad free() ignored\n");
+	return;
+    }
+
+    if (pd->pg_kind == P_BIG)
+    {
+#ifdef MSTATS
+	nbig--;
+	bigbytes -= pd->pg_npages * PAGESIZE;
+#endif /* MSTATS */
+	pagefree(sg, (int)(pd - sg->sg_pages));
+	return;
+    }
+
+    c = pd->pg_class;
+    *(char **)cp = pd->pg_free;
+    pd->pg_free = cp;
+    if (pd->pg_inuse-- == clcount[c])
+	slablink(pd);		/* it was full, now it has room */
+#ifdef MSTATS
+    nmalloc[c]--;
+#endif /* MSTATS */
+
+    /* give back an empty slab, unless it's the last one its class has */
+    if (pd->pg_inuse == 0 && (pd->pg_prev || pd->pg_next))
+    {
+	slabunlink(pd);
+	pagefree(sg, (int)(pd - sg->sg_pages));
+    }
+}
+
+public char *realloc(cp, nbytes)
+/* change the size of allocated storage, moving it if need be */
+char *cp;
+unsigned nbytes;
+{
+    register page_t	*pd;
+    register seg_t	*sg;
+    char		*res;
+    long		onb;
+    int			i, n, have, more;
+
+    if (cp == (char *)NULL)
+	return(malloc(nbytes));
+
+    sg = segof(cp);
+    if (sg->sg_chunk.ch_magic == HUGEMAGIC && cp == (char *)sg + HUGEHEAD)
+    {
+	onb = sg->sg_chunk.ch_size - HUGEHEAD;
+	if (nbytes <= onb && nbytes > onb / 2)
+	    return(cp);
+    }
+    else if ((pd = pageof(cp)) == (page_t *)NULL)
+    {
+	(void) fprintf(stderr, "Bad realloc() refused\n");
+	return((char *)NULL);
+    }
+    else if (pd->pg_kind == P_SLAB)
+    {
+	onb = clsize[pd->pg_class];
+	if (nbytes <= SMALLMAX
+		&& classof[(nbytes + ALIGNMENT - 1) / ALIGNMENT] == pd->pg_class)
+	    return(cp);
+    }
+    else if (nbytes > SMALLMAX
+		&& (n = (nbytes + PAGESIZE - 1) / PAGESIZE) <= MAXRUN)
+    {
+	/* a big block staying big; shrink or grow it in place if we can */
+	i = pd - sg->sg_pages;
+	have = pd->pg_npages;
+	if (n < have)
+	{
+	    runmark(sg, i, n, P_BIG);
+	    runmark(sg, i + n, have - n, P_BIG);
+	    pagefree(sg, i + n);
+	}
+	else if (n > have)
+	{
+	    more = n - have;
+	    if (i + have >= NPAGES
+			|| sg->sg_pages[i + have].pg_kind != P_FREE
+			|| sg->sg_pages[i + have].pg_npages < more)
+		goto move;
+	    runtake(sg, i + have, more);
+	    runmark(sg, i, n, P_BIG);
+	}
+#ifdef MSTATS
+	bigbytes += (long)(n - have) * PAGESIZE;
+#endif /* MSTATS */
+	return(cp);
+    }
+    else
+    move:
+	onb = pd->pg_npages * PAGESIZE;
+
+    if ((res = malloc(nbytes)) == (char *)NULL)
+	return((char *)NULL);
+    (void) memcpy(res, cp, (int)((nbytes < onb) ? nbytes : onb));
+    free(cp);
+    return(res);
+}
+
+#ifdef MSTATS
+/*
+ * mstats - print out statistics about malloc
+ *
+ * Prints two lines of numbers, one showing the count of free objects
+ * for each size class, the second showing the number of mallocs -
+ * frees for each size class.
+ */
+public void mstats(s)
+char *s;
+{
+    register int	i, j;
+    register page_t	*pd;
+    long		totfree = 0, totused = 0;
+
+    (void) fprintf(stderr, "Memory allocation statistics %s\nfree:\t", s);
+    for (i = 0; i < NCLASSES; i++)
+    {
+	for (j = 0, pd = partial[i]; pd; pd = pd->pg_next)
+	    j += clcount[i] - pd->pg_inuse;
+	(void) fprintf(stderr, " %d", j);
+	totfree += (long)j * clsize[i];
+    }
+    (void) fprintf(stderr, "\nused:\t");
+    for (i = 0; i < NCLASSES; i++)
+    {
+	(void) fprintf(stderr, " %d", nmalloc[i]);
+	totused += (long)nmalloc[i] * clsize[i];
+    }
+    (void) fprintf(stderr, "\n\tTotal in use: %ld, total free: %ld\n",
+	    totused, totfree);
+    (void) fprintf(stderr, "\tBig blocks: %d, huge: %d, %ld bytes; from system: %ld bytes\n",
+	    nbig, nhuge, bigbytes, sysbytes);
+}
+#endif /* MSTATS */
+
+/*
+ *	We call realloc() with calloc()'ed space, so we had better
+ *	supply a calloc() that we understand.
+ */
+public char *calloc(nitems, size)
+register unsigned nitems, size;
+{
+    char *s;
+
+    size *= nitems;
+
+    if (s = malloc(size))
+	(void) bzero(s, size);
+
+    return (s);
+}
+
+/*
+ *	Calloc()'ed space is frequently freed with cfree().
+ */
+public void cfree(space)
+register char *space;
+{
+    free(space);
+}
+#endif /* !lint */
+
+/* smalloc.c ends here */
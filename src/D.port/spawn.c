@@ -18,6 +18,10 @@ child processes are isolated here. Child processes are spawned with default
 signal masks, but signal masks in the parent are restored to the values they
 had before the fwait() call before exit.
 
+   Both go through launch(), so the child is started with vfork(2). Children
+run in the background are launched detached, and lreap() collects them when
+they exit instead of leaving them as zombies.
+
 REVISED BY
    Eric S. Raymond
    This software is Copyright (C) 1989 by Eric S. Raymond for the sole purpose
@@ -27,6 +31,7 @@ of protecting free redistribution; see the LICENSE file for details.
 /*LINTLIBRARY*/
 #include "libport.h"
 #include "spawn.h"
+#include "launch.h"
 
 #ifndef SHELL
 char *SHELL = "/bin/sh";
@@ -38,9 +43,9 @@ char **args;	/* arguments for child command */
 int flags;	/* foreground/background/confirmation flags */
 char *aval;	/* set $A to this if non-NULL */
 {
-    int pid, i, retval;
-    wait_t pstatus;
-    char *env[100], a[BUFSIZ + 2], **envp;
+    int pid, i, retval, lflags = LCLOSE;
+    char *env[100], a[BUFSIZ + 2], **envp, **ep;
+    static int bgfds[LNFDS] = {L_NULL, L_NULL, L_KEEP};
     extern char **environ;
 #ifdef SIGTSTP
     catch_t (*oldstop)(), (*oldttin)(), (*oldttout)();
@@ -49,57 +54,37 @@ char *aval;	/* set $A to this if non-NULL */
     oldttin = signal(SIGTTIN, SIGCAST(SIG_DFL));
     oldttout = signal(SIGTTOU, SIGCAST(SIG_DFL));
 #endif /* SIGTSTP */
-    while ((pid = fork()) == -1)
-	(void) sleep(1);	/* must not clear alarm */
-    if (pid == 0)		/* child side */
-    {
-	for (i = 3 ; i < 20 ; i++)
-	    (void) close(i);
-	if (flags & BAKGRND)
-	{
-	    (void) signal(SIGINT, SIGCAST(SIG_IGN));
-	    (void) signal(SIGQUIT, SIGCAST(SIG_IGN));
-	    (void) close(0);
-	    (void) close(1);
-	    (void) open("/dev/null", 2);
-	    (void) dup(0);
-	}
-
-	/* set $A */
-	if (aval != (char *)NULL)
-	{
-	    (void) sprintf(a, "A=%s", aval);
-	    env[0] = a;
-	    for (envp = env+1; *environ!=(char*)NULL && envp<env+98; environ++)
-		if ((*environ)[0] != 'A' || (*environ)[1] != '=')
-		    *envp++ = *environ;
-	    *envp = (char *)NULL;
-	}
-
-#ifndef lint		/* various lints disagree on setuid/setgid arg type */
-	if (flags & NOPRIVS)
-	{
-	    (void) setuid(getuid());
-	    (void) setgid(getgid());
-	}
-#endif /* lint */
 
-	(void) execve(args[0], args, env);
-	(void) fprintf(stderr, "%s: not found\n", args[0]);
-	exit(20);
+    /* set $A */
+    if (aval != (char *)NULL)
+    {
+	(void) sprintf(a, "A=%s", aval);
+	env[0] = a;
+	for (envp = env+1, ep = environ; *ep!=(char*)NULL && envp<env+98; ep++)
+	    if ((*ep)[0] != 'A' || (*ep)[1] != '=')
+		*envp++ = *ep;
+	*envp = (char *)NULL;
     }
-    if (!(flags & BAKGRND))
+
+    if (flags & BAKGRND)
+	lflags |= LNOINTR | LDETACH;
+    if (flags & NOPRIVS)
+	lflags |= LNOPRIVS;
+    pid = launch(args[0], args, (aval != (char *)NULL) ? env : (char **)NULL,
+		 (flags & BAKGRND) ? bgfds : (int *)NULL, lflags);
+
+    if (pid == FAIL)
+	retval = 1;
+    else if (flags & BAKGRND)
+	retval = SUCCEED;
+    else
     {
 	catch_t (*savequit)(), (*saveint)();
 
 	savequit = signal(SIGQUIT, SIGCAST(SIG_IGN));
 	saveint = signal(SIGINT, SIGCAST(SIG_IGN));
-	while ((i = wait(&pstatus)) != pid && (i != -1 || errno == EINTR))
-	    continue;
-	if (i == -1)
+	if ((retval = lwait(pid)) == -1)
 	    retval = 1;
-	else
-	    retval = pstatus.w_status;
 	if (flags & CWAIT)
 	{
 	    (void) fprintf(stderr, "continue? ");
@@ -109,15 +94,13 @@ char *aval;	/* set $A to this if non-NULL */
 	}
 	(void) signal(SIGQUIT, SIGCAST(savequit));
 	(void) signal(SIGINT, SIGCAST(saveint));
+    }
 #ifdef SIGTSTP
-	(void) signal(SIGTSTP, SIGCAST(oldstop));
-	(void) signal(SIGTTIN, SIGCAST(oldttin));
-	(void) signal(SIGTTOU, SIGCAST(oldttout));
+    (void) signal(SIGTSTP, SIGCAST(oldstop));
+    (void) signal(SIGTTIN, SIGCAST(oldttin));
+    (void) signal(SIGTTOU, SIGCAST(oldttout));
 #endif /* SIGTSTP */
-	return(retval);
-    }
-    else
-	return(SUCCEED);
+    return(retval);
 }
 
 int shcmd(cmd, flags, aval)
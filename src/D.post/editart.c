@@ -97,11 +97,7 @@ char	*subject;	/* new subject (may be empty) */
 	    (void) strcpy(bfr, "Re: orphan response");
     }
 
-    (void) hlcpy(fhp->h_subject, bfr);
-#ifdef ALLOCHDRS
-    if (hp == fhp)
-	hlfree(oldsubj);
-#endif /* ALLOCHDRS */
+    (void) hlcpy(fhp->h_subject, bfr);	/* this releases any old line */
 }
 
 char *prepmsg(hp, parentfile, cite, imark)
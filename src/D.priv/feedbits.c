@@ -4,32 +4,44 @@ NAME
    feedbits.c -- feed bit reading, checking and caching
 
 SYNOPSIS
-   int feedbits()	-- set up feed bitmasks in active structure
+   int feedbits()	-- set up feed bitsets for the active groups
 
 DESCRIPTION
    These functions are used to implement checking of subscription bits for
 article sends. Most of the implementation of the FEEDBITS and CACHEBITS
 options lives here.
 
-   If the FEEDBITS switch is on, the entry point feedbits() will
-initialize an extra field containing a bit for each of the systems this site
-feeds (including itself). The bit will tell whether the group is accepted
-by that system. The 0 bit of this field is set if the field was set by the
-code that sets these up. Bits 1 to n correspond to the first through nth
-entries in the feeds file. This data is used by the ngaccept() function.
+   If the FEEDBITS switch is on, the entry point feedbits() will build the
+feedmap table, which holds a bitset for each group in the active file with
+one bit for each entry in the feeds file (this site included). Bit n of a
+group's set tells whether the group is accepted by the system at record n
+of the feeds file, as given by s_tell(). The sets are as wide as the feeds
+file requires; each one is feedmap.nwords words of type fword_t. Groups added
+to the active file after the table was built have no set, and ngfeedok()
+says so. This data is used by the ngaccept() function, which ORs together
+the sets of an article's groups once per article, so that deciding whether
+each feed gets the article is a test of one bit.
 
-   If the CACHEBITS switch is on, the FEEDBITS initialization will look for a
-bit file at ADM/feedbits to read subscription bits from. If this file is
-older than the feeds file or non-existent it will be regenerated. The theory
-here is that the feeds file seldom changes, and that reading the bitfile is
-faster than regenerating the bitmap information with many ngmatch() calls.
+   If the CACHEBITS switch is on, feedbits() will look for a compiled table
+at ADM/feedbits before computing one. The file starts with a header giving
+the format version and the modification time and size of the feeds file it
+was made from; the group sets follow, and then the names of the groups they
+belong to. If the header doesn't match the current feeds file the table is
+recomputed and the file rewritten. If the groups don't match the active
+file's, the sets of the leading groups that do match are kept and the rest
+are recomputed. The theory here is that the feeds file seldom changes, and
+that loading the bitfile is much faster than matching every group against
+every system's subscription list, even though each list is compiled (see
+ngcompile() in ngmatch.c) just once. If MMAP is defined the file is mapped
+rather than read, and a current table is used in place.
 
 NOTE
-   The feed bits field of a group_t will hold subscription bits for at most
-sizeof(bits_t) - 1 target systems. The bits_t type is defined in news.h,
-initially as unsigned int. It can be changed to unsigned long with no problem;
-this may be good thing to do on 16-bit machines (or, conceivably, on 32-bit
-machines with 64-bit longs and *lots* of downstream sites...).
+   The cache file is written in the machine's own byte order and word size;
+a news spool shared between unlike machines will just recompute it every
+time the other machine wrote it last.
+
+FILES
+   ADM/feedbits	-- compiled feed bitsets
 
 AUTHOR
    Eric S. Raymond
@@ -43,80 +55,246 @@ of protecting free redistribution; see the LICENSE file for details.
 #include "active.h"
 #include "dballoc.h"
 #include "feeds.h"
-#include "bitmacros.h"
 
 #if defined(CACHEBITS) && !defined(FEEDBITS)
 #undef CACHEBITS
 #endif /* defined(CACHEBITS) && !defined(FEEDBITS) */
 
 #ifdef FEEDBITS
-int feedbits()
-/* set up the feedbits fields in the active file */
+feedmap_t	feedmap;	/* the feed bitsets of the active groups */
+
+private char	*fbbase;	/* storage holding feedmap.map */
+#ifdef MMAP
+private off_t	fbsize;		/* nonzero if fbbase is a mapped file */
+#endif /* MMAP */
+
+#ifdef CACHEBITS
+/*
+ * The compiled bitsets file is an fbhead_t, then ngroups sets of nwords
+ * fword_ts each, then the names of the ngroups groups in active-file order,
+ * each followed by a NUL. The header is a multiple of a long in size, so the
+ * sets are aligned when the file is mapped.
+ */
+#define FBMAGIC		0x46624d31L	/* identifies a feed bitsets file */
+#define FBVERSION	1		/* bump when the layout changes */
+
+typedef struct
+{
+    long	magic;		/* always FBMAGIC */
+    long	version;	/* always FBVERSION */
+    time_t	mtime;		/* modification time of the feeds file */
+    off_t	size;		/* its size */
+    long	nfeeds;		/* count of feeds the sets have bits for */
+    long	nwords;		/* fword_ts in each set */
+    long	ngroups;	/* count of sets */
+    long	namesize;	/* bytes of group names after the sets */
+}
+fbhead_t;
+
+#define FBSETS(hp)	((hp)->ngroups * (hp)->nwords * sizeof(fword_t))
+#endif /* CACHEBITS */
+
+private void fbrelease()
+/* throw away the current table */
+{
+#ifdef MMAP
+    if (fbsize)
+	(void) munmap(fbbase, (size_t)fbsize);
+    else
+#endif /* MMAP */
+    if (fbbase != (char *)NULL)
+	(void) free(fbbase);
+    fbbase = (char *)NULL;
+#ifdef MMAP
+    fbsize = 0;
+#endif /* MMAP */
+    feedmap.map = (fword_t *)NULL;
+    feedmap.nwords = feedmap.nfeeds = feedmap.ngroups = 0;
+}
+
+private void fbcompile(start)
+/* compute the bitsets of the groups from index start on */
+int	start;
 {
-    feed_t	*sys;
+    feed_t		*sys;
+    register group_t	*ngp;
+    group_t		*lastgrp = active.newsgroups + active.ngc;
+
+    s_rewind();
+    while ((sys = s_next()) != (feed_t *)NULL)
+    {
+	ngpat_t	pat = ngcompile(sys->s_ngroups);
+	int	n = s_tell(sys);
+
+	for (ngp = active.newsgroups + start; ngp < lastgrp; ngp++)
+	    if (ngexec(pat, ngp->ng_name))
+		ngmkfeed(ngp, n);
+	ngfree(pat);
+    }
+}
 
 #ifdef CACHEBITS
-    char	*bitsfile;
-    FILE	*ffp;
+private int fbload(bitsfile, hp)
+/* load the compiled bitsets, returning the count of groups they are good for */
+char		*bitsfile;	/* the file to load */
+fbhead_t	*hp;		/* the header it has to have */
+{
+    int		fd, n;
+    struct stat	st;
+    fbhead_t	*fhp;
+    char	*names, *end;
 
-    Sprint1(bitsfile, "%s/feedbits", site.admdir);
+    if ((fd = open(bitsfile, O_RDONLY)) == FAIL)
+	return(0);
+    if (fstat(fd, &st) == FAIL || st.st_size < sizeof(fbhead_t))
+    {
+	(void) close(fd);
+	return(0);
+    }
+#ifdef MMAP
+    fbbase = (char *)mmap((caddr_t)NULL, (size_t)st.st_size,
+			  PROT_READ, MAP_SHARED, fd, (off_t)0);
+    if (fbbase == (char *)-1)
+	fbbase = (char *)NULL;
+    else
+	fbsize = st.st_size;
+#else
+    if ((fbbase = malloc((unsigned)st.st_size)) != (char *)NULL
+		&& read(fd, fbbase, (iolen_t)st.st_size) != st.st_size)
+    {
+	(void) free(fbbase);
+	fbbase = (char *)NULL;
+    }
+#endif /* MMAP */
+    (void) close(fd);
+    if (fbbase == (char *)NULL)
+	return(0);
 
-    /* if the feeds file has been munged, recompile the bitmap file */
-    if (!exists(bitsfile) || modtime(bitsfile) < modtime(feeds.file))
+    /* the file has to be for this feeds file, and complete */
+    fhp = (fbhead_t *)fbbase;
+    if (fhp->magic != hp->magic || fhp->version != hp->version
+		|| fhp->mtime != hp->mtime || fhp->size != hp->size
+		|| fhp->nfeeds != hp->nfeeds || fhp->nwords != hp->nwords
+		|| fhp->ngroups < 0 || fhp->namesize < 0
+		|| st.st_size != sizeof(fbhead_t) + FBSETS(fhp) + fhp->namesize
+		|| (fhp->namesize > 0 && fbbase[st.st_size - 1] != '\0'))
     {
-	/* prepare to write the recompiled version in a readable form */
-	if ((ffp = fopen(bitsfile, "w")) == (FILE *)NULL)
-	{
-	    logerr0("Can't regenerate the feedbits file. Continuing...");
-	    return(SUCCEED);
-	}
-
-	/* recompile the bitmaps in the ng_feeds fields of the active file */
+	fbrelease();
+	return(0);
+    }
+
+    /* now see how many of its groups are still where they were */
+    names = fbbase + sizeof(fbhead_t) + FBSETS(fhp);
+    end = names + fhp->namesize;
+    for (n = 0; n < fhp->ngroups && n < active.ngc && names < end; n++)
+    {
+	if (strcmp(names, active.newsgroups[n].ng_name))
+	    break;
+	names += strlen(names) + 1;
+    }
+
+    feedmap.map = (fword_t *)(fbbase + sizeof(fbhead_t));
+    feedmap.nwords = hp->nwords;
+    feedmap.nfeeds = hp->nfeeds;
+    feedmap.ngroups = n;
+    return(n);
+}
+
+private void fbsave(bitsfile, hp)
+/* write out the bitsets for the next run, if we can */
+char		*bitsfile;	/* the file to write */
+fbhead_t	*hp;		/* the header to give it */
+{
+    char	*tfile;
+    FILE	*fp;
+    group_t	*ngp;
+
+    hp->ngroups = feedmap.ngroups;
+    hp->namesize = 0;
+    for (ngp = active.newsgroups; ngp < active.newsgroups + active.ngc; ngp++)
+	hp->namesize += strlen(ngp->ng_name) + 1;
+
+    Sprint2(tfile, "%s.%d", bitsfile, getpid());
+    if ((fp = fopen(tfile, "w")) == (FILE *)NULL)
+    {
+	logerr0("Can't regenerate the feedbits file. Continuing...");
+	(void) free(tfile);
+	return;
+    }
 #ifdef DEBUG
-	(void) logerr0("Regenerating feed bits cache file");
+    (void) logerr0("Regenerating feed bits cache file");
 #endif /* DEBUG */
+    (void) fwrite((char *)hp, sizeof(fbhead_t), 1, fp);
+    (void) fwrite((char *)feedmap.map, sizeof(fword_t),
+		  (iolen_t)(feedmap.ngroups * feedmap.nwords), fp);
+    for (ngp = active.newsgroups; ngp < active.newsgroups + active.ngc; ngp++)
+	(void) fwrite(ngp->ng_name, sizeof(char), strlen(ngp->ng_name)+1, fp);
+    if (ferror(fp) || fclose(fp) == EOF || rename(tfile, bitsfile) == FAIL)
+	(void) unlink(tfile);
+    (void) free(tfile);
+}
 #endif /* CACHEBITS */
 
-	s_rewind();
-	while ((sys = s_next()) != (feed_t *)NULL)
-	{
-	    ngrewind(TRUE);
-	    while (ngnext())
-		if (ngmatch(ngname(), sys->s_ngroups))
-		    ngmkfeed(ngactive(), s_tell(sys));
-	}
-
+int feedbits()
+/* set up the feed bitsets for the active groups */
+{
+    int		nfeeds = dbatell(&feeds), nwords = FBWORDS(nfeeds);
+    int		start = 0;
+    fword_t	*map;
 #ifdef CACHEBITS
-	ngrewind(TRUE);
-	while (ngnext())
-	    (void) fprintf(ffp, "%s:%x\n", ngname(), ngactive()->ng_feeds);
-	(void) fclose(ffp);
+    char	*bitsfile;
+    fbhead_t	head;
+    struct stat	st;
+
+    fbrelease();
+    Sprint1(bitsfile, "%s/feedbits", site.admdir);
+    head.magic = FBMAGIC;
+    head.version = FBVERSION;
+    head.mtime = (time_t)0;
+    head.size = (off_t)0;
+    if (stat(feeds.file, &st) == SUCCEED)
+    {
+	head.mtime = st.st_mtime;
+	head.size = st.st_size;
     }
-    else    /* don't need to recompile, just read in the bitmaps */
+    head.nfeeds = nfeeds;
+    head.nwords = nwords;
+
+    /* if the cache is current for every group, we're done */
+    if ((start = fbload(bitsfile, &head)) == active.ngc)
     {
-	ffp = xfopen(bitsfile, "r");
-	while (fgets(bfr, BUFLEN, ffp) != (char *)NULL)
-	{
-	    char	grpname[BUFLEN];
-	    bits_t	rbits;
-
-	    if (sscanf(bfr, "%[^:]:%x\n", grpname, &rbits) == 2)
-	    {
-	        group_t *ngp = ngfind(grpname);
-
-		if (ngp != (group_t *)NULL)
-		{
-		    ngp->ng_feeds = rbits;
-		    ngmkfeed(ngp, 0);
-		}
-	    }
-	}
-	(void) fclose(ffp);
+	(void) free(bitsfile);
+	return(SUCCEED);
     }
+#else
+    fbrelease();
+#endif /* CACHEBITS */
 
-    (void) free(bitsfile);
+    /* copy in the sets we could keep, and compute the others */
+    map = (fword_t *)calloc((unsigned)(active.ngc * nwords + 1),
+			    sizeof(fword_t));
+    if (map != (fword_t *)NULL && start > 0)
+	(void) memcpy((char *)map, (char *)feedmap.map,
+		      start * nwords * sizeof(fword_t));
+    fbrelease();
+    if (map == (fword_t *)NULL)
+    {
+#ifdef CACHEBITS
+	(void) free(bitsfile);
 #endif /* CACHEBITS */
+	return(FAIL);
+    }
+    fbbase = (char *)map;
+    feedmap.map = map;
+    feedmap.nwords = nwords;
+    feedmap.nfeeds = nfeeds;
+    feedmap.ngroups = active.ngc;
+    fbcompile(start);
 
+#ifdef CACHEBITS
+    fbsave(bitsfile, &head);
+    (void) free(bitsfile);
+#endif /* CACHEBITS */
     return(SUCCEED);
 }
 #endif /* FEEDBITS */
@@ -14,6 +14,7 @@
 extern int textwalk();
 
 extern void loginit();
+extern void logfield(), logbuffer(), logflush();
 
 /* the v[012] macros are defined in portlib.h */
 
@@ -34,6 +35,20 @@ extern int logerr();
 extern int transmit(), xmitctrl();
 extern char *artfilter(), *filefilter();
 
+/* things exported by nntpfeed.c */
+extern int nntpfeed();
+extern void nntpfdone();
+extern bool nntplink();
+
+/* lock domains for rlock()/runlock() and the lock-wait statistics */
+#define R_ACTIVE	0	/* the whole database, i.e. lock() itself */
+#define R_GROUP		1	/* one newsgroup's active-file record */
+#define R_BATCH		2	/* one feed's batch file, apart from the rest */
+#define R_HISTORY	3	/* the history data of a posting run */
+#define R_NDOMAINS	4
+#define HISTRES		"history"	/* the one resource in R_HISTORY */
+extern	void	rlock(), runlock(), lockstats();
+
 /* miscellaneous library functions */
 extern	int	mungread(), mungwrite();
 extern	void	lock(), unlock(), collect();
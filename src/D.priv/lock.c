@@ -12,14 +12,70 @@ SYNOPSIS
    
    int lcount();    -- count # of processes waiting (SV version only)
 
+   void rlock(domain, name)	-- lock one resource in a lock domain
+   int domain; char *name;
+
+   void runlock(domain, name)	-- release a resource lock
+   int domain; char *name;
+
+   void lockstats()		-- log lock-wait statistics
+
 DESCRIPTION
    These routines may be used to lock critical resources for exclusive use.
 The lock() and unlock() are approximately P and V operations on a single
 integer-valued semaphore (approximate because the implementations' efforts
 to guarantee atomicity are of varying degrees of bogosity).
 
+   Most updates don't need the whole database, though. A poster reserving an
+article number only has to keep other posters out of one newsgroup's active
+line, and a sendbatch only has to keep other sendbatches off one batch file.
+The rlock() and runlock() calls lock a single named resource within a lock
+domain (R_GROUP for a newsgroup's active-file record, R_HISTORY for the
+history data of a posting run, R_BATCH for a feed's batch file; see
+libpriv.h). Holders of different resources don't wait on each other, and all
+of them but batch lockers exclude and are excluded by lock().
+
+   Batch files aren't part of the database: posters append to them without
+locking, and only sendbatches need to keep off each other's. So an R_BATCH
+lock neither waits on lock() nor holds it off, and a sendbatch can ship a
+batch while an expire or a long rnews run has the database.
+
+   If the LOCKF switch is on, all of this is done with POSIX record locks on
+the file LIB/LOCK. The lock() call takes a write lock on byte 0. A resource
+lock takes a write lock on a byte chosen by hashing the domain and name, and
+then a read lock on byte 0 (so it keeps lock() out but not other resource
+locks). Distinct resources that hash to the same byte merely serialize.
+A gate byte, write-locked by lock() while it waits and briefly read-locked by
+resource lockers on the way in, keeps lock() from being starved by them.
+Batch locks have a range of bytes of their own past the gate, and never touch
+byte 0 or the gate. The kernel drops these locks when a process dies, so there
+is nothing to clean up after a crash. Without LOCKF, rlock() and runlock() are
+just lock() and unlock(), except that a batch lock is a filelock() on the
+batch's name.
+
+   All of these calls nest. A resource lock other than a batch lock asserted
+while the process holds lock() is already covered by it, and costs nothing.
+
+   Each wait for a lock is timed and counted in a histogram for its domain
+(R_ACTIVE for lock() itself). The lockstats() call writes the histogram of
+each domain that had to wait to the log and starts the counts over, so
+contention shows up there; the programs that update the database call it on
+exit. Waits are classed as
+free (granted at once), under 1, 4, 16 or 64 seconds, or longer. Only the
+POSIX code can tell a free lock from a short wait; the others book all waits
+under a second as free.
+
 BUGS
    The Version 7/System III implementation is ugly and flaky.
+   Calling lock() while holding a resource lock converts the read lock on
+byte 0 to a write lock. This is safe only because resource lockers wait for
+their own byte before they take byte 0, and because the news tools take
+R_HISTORY before R_GROUP and never the other way round; if two processes
+holding resource locks call lock() at once, one of them will be aborted with
+EDEADLK.
+
+FILES
+   LIB/LOCK	-- record-lock file (LOCKF version)
 
 REVISED BY
    Eric S. Raymond
@@ -42,7 +98,231 @@ bool lockp()
     return(lockcount > 0);
 }
 
-#ifdef SVIDSEMS	/* can do mandatory locking using the semaphore facilities */
+/*
+ * Lock-wait statistics, kept per domain.
+ */
+#define NWAITS	6	/* free, <1s, <4s, <16s, <64s, longer */
+
+private char	*domname[R_NDOMAINS] = {"active", "group", "batch", "history"};
+private long	waits[R_NDOMAINS][NWAITS];
+private time_t	maxwait[R_NDOMAINS];
+
+private void waited(domain, start)
+/* book a lock acquisition in a domain's histogram */
+int	domain;
+time_t	start;	/* when we began waiting, 0 if we got the lock at once */
+{
+    register int	i;
+    time_t		secs;
+
+    if (start == (time_t)0)
+	i = 0;
+    else
+    {
+	if ((secs = time((time_t *)NULL) - start) > maxwait[domain])
+	    maxwait[domain] = secs;
+	for (i = 1; i < NWAITS - 1 && secs >= (1L << (2 * (i - 1))); i++)
+	    continue;
+    }
+    waits[domain][i]++;
+}
+
+void lockstats()
+/* log the wait histogram of each domain that had to wait */
+{
+    static char	*bucket[NWAITS] = {"free", "<1s", "<4s", "<16s", "<64s", "longer"};
+    register int	d, i;
+    char		buf[BUFLEN];
+
+    for (d = 0; d < R_NDOMAINS; d++)
+    {
+	for (i = 1; i < NWAITS; i++)
+	    if (waits[d][i])
+		break;
+	if (i == NWAITS)
+	    continue;
+
+	buf[0] = '\0';
+	for (i = 0; i < NWAITS; i++)
+	    if (waits[d][i])
+		(void) sprintf(buf + strlen(buf), " %ld %s,",
+			       waits[d][i], bucket[i]);
+	log3("%s lock waits:%s max %lds", domname[d], buf, (long)maxwait[d]);
+    }
+
+    /* long-running callers report once per busy spell */
+    (void) memset((char *)waits, 0, sizeof(waits));
+    (void) memset((char *)maxwait, 0, sizeof(maxwait));
+}
+
+#ifdef LOCKF	/* we can do it all with POSIX record locks */
+#define RECLOCKS
+
+#define NSLOTS	509	/* resource lock bytes in LIB/LOCK, a prime */
+#define GATE	(off_t)(NSLOTS + 1)	/* turnstile byte, see lock() */
+#define BATCHBYTE(s)	(off_t)(GATE + 1 + (s))	/* batch locks live past it */
+
+private int	lockfd = FAIL;		/* descriptor of LIB/LOCK */
+private int	heldcount = 0;		/* no. of resource locks we hold */
+private short	slotcount[NSLOTS];	/* nesting count on each resource byte */
+private short	batchcount[NSLOTS];	/* nesting count on each batch byte */
+
+private time_t lockbyte(type, offset)
+/* set or clear a record lock on a byte of LIB/LOCK, return wait start */
+int	type;	/* F_RDLCK, F_WRLCK or F_UNLCK */
+off_t	offset;
+{
+    struct flock	fl;
+    time_t		start = (time_t)0;
+
+    if (lockfd == FAIL)
+    {
+	char	lockname[BUFLEN];
+
+	(void) sprintf(lockname, "%s/LOCK", site.libdir);
+	if ((lockfd = open(lockname, O_RDWR | O_CREAT, 0660)) == FAIL)
+	    xerror2("can't open lock file %s, errno = %d", lockname, errno);
+	(void) fcntl(lockfd, F_SETFD, 1);	/* children don't get our locks */
+    }
+
+    fl.l_type = type;
+    fl.l_whence = SEEK_SET;
+    fl.l_start = offset;
+    fl.l_len = 1;
+    if (fcntl(lockfd, F_SETLK, &fl) == FAIL)
+    {
+	if (type == F_UNLCK || (errno != EACCES && errno != EAGAIN))
+	    xerror1("lock operation aborted, errno = %d", errno);
+
+	/* somebody else has it, we'll have to wait */
+	start = time((time_t *)NULL);
+	while (fcntl(lockfd, F_SETLKW, &fl) == FAIL)
+	    if (errno != EINTR)
+		xerror1("lock operation aborted, errno = %d", errno);
+    }
+    return(start);
+}
+
+private int lockslot(domain, name)
+/* hash a resource name to its byte in LIB/LOCK */
+int	domain;
+register char	*name;
+{
+    register unsigned long	h = domain;
+
+    while (*name)
+	h = (h << 5) - h + (unsigned char)*name++;
+    return((int)(h % NSLOTS));
+}
+
+void lock()
+{
+    time_t	start;
+
+    /*
+     * Record locks don't favor writers, so a steady stream of resource
+     * lockers could keep byte 0 read-locked forever. Holding the gate
+     * while we wait stops new ones from getting in ahead of us.
+     */
+    if (lockcount++ == 0)
+    {
+	/*
+	 * If we already hold byte 0 for reading, though, we mustn't queue
+	 * at the gate behind a lock() that is waiting for us to let go.
+	 */
+	if (heldcount > 0)
+	    start = lockbyte(F_WRLCK, (off_t)0);
+	else if ((start = lockbyte(F_WRLCK, GATE)) == (time_t)0)
+	    start = lockbyte(F_WRLCK, (off_t)0);
+	else
+	    (void) lockbyte(F_WRLCK, (off_t)0);
+	if (heldcount == 0)
+	    (void) lockbyte(F_UNLCK, GATE);
+	waited(R_ACTIVE, start);
+    }
+}
+
+void unlock()
+{
+#ifdef NDEBUG
+    assert(lockcount > 0);
+#endif
+
+    /* if we still hold resource locks, keep other lock()s out */
+    if ((lockcount > 0) && (--lockcount == 0))
+	(void) lockbyte(heldcount ? F_RDLCK : F_UNLCK, (off_t)0);
+}
+
+void rlock(domain, name)
+/* lock a resource within a domain */
+int	domain;
+char	*name;
+{
+    register int	slot = lockslot(domain, name);
+    time_t		start = (time_t)0, gatestart;
+    bool		fresh = FALSE;	/* did we take a byte just now? */
+
+    /* batch locks stand apart from the database lock */
+    if (domain == R_BATCH)
+    {
+	if (batchcount[slot]++ == 0)
+	    waited(domain, lockbyte(F_WRLCK, BATCHBYTE(slot)));
+	return;
+    }
+
+    /*
+     * Wait for our own byte before taking byte 0, so that a process
+     * holding it can upgrade to lock() without waiting on us.
+     */
+    if (slotcount[slot]++ == 0 && lockcount == 0)
+    {
+	start = lockbyte(F_WRLCK, (off_t)(slot + 1));
+	fresh = TRUE;
+    }
+    if (heldcount++ == 0 && lockcount == 0)
+    {
+	/* pass through the gate, so we queue up behind a waiting lock() */
+	gatestart = lockbyte(F_RDLCK, GATE);
+	if (gatestart == (time_t)0)
+	    gatestart = lockbyte(F_RDLCK, (off_t)0);
+	else
+	    (void) lockbyte(F_RDLCK, (off_t)0);
+	(void) lockbyte(F_UNLCK, GATE);
+	if (start == (time_t)0)
+	    start = gatestart;
+	fresh = TRUE;
+    }
+    if (fresh)
+	waited(domain, start);
+}
+
+void runlock(domain, name)
+/* release a resource lock */
+int	domain;
+char	*name;
+{
+    register int	slot = lockslot(domain, name);
+
+    if (domain == R_BATCH)
+    {
+	if (batchcount[slot] > 0 && --batchcount[slot] == 0)
+	    (void) lockbyte(F_UNLCK, BATCHBYTE(slot));
+	return;
+    }
+
+#ifdef NDEBUG
+    assert(heldcount > 0 && slotcount[slot] > 0);
+#endif
+
+    if (slotcount[slot] > 0 && --slotcount[slot] == 0 && lockcount == 0)
+	(void) lockbyte(F_UNLCK, (off_t)(slot + 1));
+    if (heldcount > 0 && --heldcount == 0 && lockcount == 0)
+	(void) lockbyte(F_UNLCK, (off_t)0);
+}
+#endif /* LOCKF */
+
+#if defined(SVIDSEMS) && !defined(RECLOCKS)
+/* can do mandatory locking using the semaphore facilities */
 #define SEMAPHORES
 
 #include <sys/ipc.h>
@@ -61,29 +341,42 @@ void lock()
 	SEM_UNDO,	/* yes, we want exit(0) to undo this */
     };
 
+    time_t	start = (time_t)0;
+
     if (lockcount++ == 0)
     {
 	/* if the semaphore exists, get it */
-	if ((semid = semget((key_t)NEWSKEY, 1, 00660)) == FAIL)
+	while ((semid = semget((key_t)NEWSKEY, 1, 00660)) == FAIL)
 	{
 	    /* semaphore did not exist, lets try to create it */
-	    if ((semid = semget((key_t)NEWSKEY, 1, IPC_CREAT | 00660)) == FAIL)
+	    if ((semid = semget((key_t)NEWSKEY, 1, IPC_CREAT|IPC_EXCL|00660)) != FAIL)
+	    {
+		/*
+		 * We just created the semaphore, set its value to 1 (so that
+		 * exactly one locked() process can be running at any given
+		 * time). IPC_EXCL makes sure only one creator does this.
+		 */
+		(void) semctl(semid, 0, SETVAL, 1);
+		break;
+	    }
+	    else if (errno != EEXIST)	/* else somebody beat us to it */
 		xerror1("could not get news lock semaphore, errno = %d",errno);
-
-	    /*
-	     * If we just created the semaphore, set its value to 1 (so that
-	     * exactly one locked() process can be running at any given time)
-	     */
-	    (void) semctl(semid, 0, SETVAL, 1);
 	}
 
-	/* now try to assert the lock */
-#ifdef lint	/* 3B1 llib-lc is deluded about the type of semop's arg 2 */
-	if (lockop.sem_op)
-#else
-	if (semop(semid, &lockop, 1) == FAIL)	
+	/* now try to assert the lock, see if we have to wait for it */
+#ifndef lint	/* 3B1 llib-lc is deluded about the type of semop's arg 2 */
+	lockop.sem_flg = SEM_UNDO | IPC_NOWAIT;
+	if (semop(semid, &lockop, 1) == FAIL)
+	{
+	    if (errno != EAGAIN)
+		xerror1("lock operation aborted, errno = %d", errno);
+	    start = time((time_t *)NULL);
+	    lockop.sem_flg = SEM_UNDO;
+	    if (semop(semid, &lockop, 1) == FAIL)
+		xerror1("lock operation aborted, errno = %d", errno);
+	}
 #endif /* lint */
-	    xerror1("lock operation aborted, errno = %d", errno);
+	waited(R_ACTIVE, start);
     }
 }
 
@@ -108,11 +401,11 @@ void unlock()
 #endif /* lint */
 	    xerror1("unlock operation aborted, errno = %d", errno);
 
-#ifndef lint	/* the #$@%#! sem.h on SVr1 doesn't define struct sembuf! */
-	/* if we're the last process waiting on the semaphore, flush it */
-	if (semctl(semid, 0, GETNCNT, 0) == 0)
-	    (void) semctl(semid, 0, IPC_RMID, 0);
-#endif /* lint */
+	/*
+	 * The semaphore used to be removed here when nobody was waiting on
+	 * it, but a process between its semget() and semop() isn't counted
+	 * as waiting, and would find its semaphore gone. So it stays.
+	 */
     }
 }
 
@@ -123,7 +416,7 @@ int lcount()
 }
 #endif /* SVIDSEMS */
 
-#if defined(XENIXSEMS) && !defined(SEMAPHORES)
+#if defined(XENIXSEMS) && !defined(SEMAPHORES) && !defined(RECLOCKS)
 #define SEMAPHORES
 
 private char sem_name[] = "/tmp/.active_lock";
@@ -131,6 +424,8 @@ private int sem_num;
 
 void lock()	/* get (or wait for) control of the resource */
 {
+    time_t	start;
+
     if (lockcount++ == 0) {
 	/* try to create the semaphore */
 	if ((sem_num = creatsem(sem_name, 0660)) == FAIL) {
@@ -149,7 +444,9 @@ void lock()	/* get (or wait for) control of the resource */
 	 * resource.  Hence, if this process created (as opposed to
 	 * opened) the semaphore, waitsem will return immediately.
 	 */
+	start = time((time_t *)NULL);
 	(void) waitsem(sem_num);
+	waited(R_ACTIVE, time((time_t *)NULL) > start ? start : (time_t)0);
     }
 }
 
@@ -166,7 +463,7 @@ void unlock()	/* release control of the resource */
 
 #endif	/* XENIXSEMS */
 
-#ifndef SEMAPHORES
+#if !defined(SEMAPHORES) && !defined(RECLOCKS)
 /*
  * This is the generic implementation in terms of filelock().
  * All V7, SIII and BSD systems up to 4.3 will use this.
@@ -179,8 +476,14 @@ void unlock()	/* release control of the resource */
 
 void lock()
 {
+    time_t	start;
+
     if (lockcount++ == 0)
+    {
+	start = time((time_t *)NULL);
 	(void) filelock(NEWSLOCK);
+	waited(R_ACTIVE, time((time_t *)NULL) > start ? start : (time_t)0);
+    }
 }
 
 void unlock()
@@ -195,6 +498,40 @@ void unlock()
 
 #endif /* !SEMAPHORES */
 
+#ifndef RECLOCKS
+/*
+ * Without record locks, every resource lock is the whole-database lock,
+ * save that batch locks are file locks on the batch's name.
+ */
+void rlock(domain, name)
+/* lock a resource within a domain */
+int	domain;
+char	*name;
+{
+    time_t	start;
+
+    if (domain == R_BATCH)
+    {
+	start = time((time_t *)NULL);
+	(void) filelock(name);
+	waited(domain, time((time_t *)NULL) > start ? start : (time_t)0);
+    }
+    else
+	lock();
+}
+
+void runlock(domain, name)
+/* release a resource lock */
+int	domain;
+char	*name;
+{
+    if (domain == R_BATCH)
+	(void) fileunlock(name);
+    else
+	unlock();
+}
+#endif /* RECLOCKS */
+
 #ifdef MAIN
 #include <stdio.h>
 
@@ -207,11 +544,18 @@ char	**argv;
 {
     newsinit();
     (void) fprintf(stderr, "locktest: locking process %d\n", getpid());
-    lock();
+    if (argc > 2)
+	rlock(R_GROUP, argv[2]);	/* lock just the named group */
+    else
+	lock();
     (void) fprintf(stderr, "locktest: locked.\n");
     (void) sleep(atol(argv[1]));
     (void) fprintf(stderr, "locktest: unlocking process %d\n", getpid());
-    unlock();
+    if (argc > 2)
+	runlock(R_GROUP, argv[2]);
+    else
+	unlock();
+    lockstats();
     (void) fprintf(stderr, "locktest: process %d exiting\n", getpid());
 }
 #endif /* MAIN */
@@ -20,6 +20,14 @@ SYNOPSIS
    int logerr(lmsg)			-- log an error message
    char *lmsg;
 
+   void logfield(key, value)		-- attach key=value to the next record
+   char *key, *value;
+
+   void logbuffer(on)			-- turn record buffering on or off
+   bool on;
+
+   void logflush()			-- write out buffered records
+
 DESCRIPTION
    These functions provide error-logging services for the news software.
 It is expected that xerror(), nlog() and logerr() will be called through the
@@ -31,6 +39,23 @@ verbose flag is on, all log messages are written to stderr and the appropriate
 logfile(s). If debug and verbose are both off, ordinary log calls are written
 to the log file only.
 
+   Each log record carries the time, and ordinary records the last relay
+site. A caller may tag the next record with key=value fields (an article's
+line count, a feed name, a byte count, a latency) by calling logfield() once
+per field before logging it. The fields follow the message after a tab, so
+programs that read the log can pick them out without parsing the message.
+
+   Normally every record is written to its file(s) as it is logged, which
+costs an access(), open(), write() and close() each time. A program that
+logs heavily (rnews logs several records per article) can call logbuffer(TRUE)
+to have records held in memory and appended to each file with one write()
+when LOGBUF bytes have piled up, when the oldest held record is LOGDELAY
+seconds old, or when logflush() or logbuffer(FALSE) is called. Error records
+flush everything held at once, so the log never loses what led up to an
+error, and xerror() and the fatal-signal handler (which goes through xerror())
+flush before exiting. Processes forked after buffering began write their
+records straight through, since they may exec or _exit() without flushing.
+
 FILES
    ADM/log	-- log file for ordinary transactions
    ADM/errlog	-- log file for errors
@@ -50,6 +75,23 @@ of protecting free redistribution; see the LICENSE file for details.
 
 char	xbf[BUFLEN];		/* buffer for assembling error messages	*/
 
+#define LOGBUF		4096	/* bytes of records held before a flush */
+#define LOGDELAY	5	/* seconds a record may be held */
+
+typedef struct
+{
+    char	*suffix;	/* name of the file in ADM */
+    int		len;		/* bytes of held records */
+    char	text[LOGBUF];	/* the records themselves */
+}
+logbuf_t;
+
+private logbuf_t logbufs[] = {{"log"}, {"errlog"}};
+private bool	buffering = FALSE;	/* are we holding records? */
+private int	bufpid;			/* process that owns the held records */
+private time_t	oldest;			/* when the oldest was logged */
+private char	fields[BUFLEN];		/* key=value fields for next record */
+
 private bool dump_core = FALSE;
 private char *junkyard;
 
@@ -61,6 +103,8 @@ void doubletrouble()
 	(void) chdir(Progname);
     }
 
+    logflush();
+
 #ifdef BSD
     /* in BSD systems, a core dump won't happen if euid != ruid */
     (void) setruid(geteuid());
@@ -171,6 +215,7 @@ char *message;
 	
     (void) fflush(stdout);
     logerr(message);
+    logflush();
     if (dump_core || (++strike > 3))
 	doubletrouble();
     xxit(1);
@@ -196,6 +241,57 @@ char *lmsg;
 #undef close
 #endif /* OPENDEBUG */
 
+void logfield(key, value)
+/* attach a key=value field to the next log record */
+char	*key, *value;
+{
+    register int	len = strlen(fields);
+
+    if (len + strlen(key) + strlen(value) + 2 < sizeof(fields))
+	(void) sprintf(fields + len, "%s%s=%s", len ? " " : "", key, value);
+}
+
+private void logwrite(bp, text, len)
+/* append records to a log file, if it's there and we may write it */
+logbuf_t	*bp;
+char		*text;
+int		len;
+{
+    char	logfname[BUFLEN];
+    int		fd;
+
+    (void) sprintf(logfname, "%s/%s", site.admdir, bp->suffix);
+    if (access(logfname, W_OK) == 0
+		&& (fd = open(logfname, O_WRONLY | O_APPEND)) != FAIL)
+    {
+	(void) write(fd, text, (iolen_t)len);
+	(void) close(fd);
+    }
+}
+
+void logflush()
+/* write out any held records */
+{
+    register logbuf_t	*bp;
+
+    for (bp = logbufs; bp < logbufs + 2; bp++)
+    {
+	/* a forked child's copy of the parent's records isn't its to write */
+	if (bp->len > 0 && getpid() == bufpid)
+	    logwrite(bp, bp->text, bp->len);
+	bp->len = 0;
+    }
+}
+
+void logbuffer(on)
+/* turn record buffering on or off */
+bool	on;
+{
+    logflush();
+    buffering = on;
+    bufpid = getpid();
+}
+
 private int logx(level, lmsg)
 /*
  * Log the given message if it can be written.  The time and an attempt at
@@ -204,19 +300,20 @@ private int logx(level, lmsg)
 int level;
 char *lmsg;
 {
-    static char	    *lfsuffix[] = {"log", "errlog", (char *)NULL};
     extern char	    *Progname;
-    FILE	    *logfile = (FILE *)NULL;
     register char   *p, *logtime;
-    char	    logfname[BUFLEN];		/* the log file */
+    register logbuf_t	*bp;
+    char	    record[LBUFLEN * 2];
     char	    rmtsys[SBUFLEN];
-    int		    i;
+    int		    i, len;
     time_t	    t;
+    bool	    held;
 
 #ifdef DEBUG
     if (debug)	/* switch on to see diagnostics without logging them */
     {
 	(void) fprintf(stdout, "%s: %s\n", Progname, lmsg);
+	fields[0] = '\0';
 	return;
     }
 #endif /* DEBUG */
@@ -242,34 +339,43 @@ char *lmsg;
     logtime[16] = '\0';
     logtime += 4;
 
+    held = buffering && getpid() == bufpid;
+
     /* log the event to some logfile(s) */
     for (i = 0;  i <= level; i++)
     {
-	(void) sprintf(logfname, "%s/%s", site.admdir, lfsuffix[i]);
-
-	if (access(logfname, W_OK) == 0 && (logfile = fopen(logfname, "a")))
-	{
-	    /* force append mode on the file */
-#ifdef FCNTL
-	    int flags;
-	    flags = fcntl(fileno(logfile), F_GETFL, 0);
-	    (void) fcntl(fileno(logfile), F_SETFL, flags|O_APPEND);
-#else /* !FCNTL */
-	    (void) lseek(fileno(logfile), (off_t)0, SEEK_END);
-#endif /* !FCNTL */
-
-	    if (i)
-		(void) fprintf(logfile, "%s %s\t%s: %s\n",
+	if (i)
+	    (void) sprintf(record, "%s %s\t%s: %.*s",
 			logtime,
 			hlnblank(header.h_ident)? header.h_ident : username,
 			Progname,
-			lmsg);
-	    else
-		(void) fprintf(logfile, "%s %s\t%s\n",
-				logtime, rmtsys, lmsg);
-	    (void) fclose(logfile);
+			LBUFLEN, lmsg);
+	else
+	    (void) sprintf(record, "%s %s\t%.*s",
+			logtime, rmtsys, LBUFLEN, lmsg);
+	if (fields[0])
+	    (void) sprintf(record + strlen(record), "\t%s", fields);
+	(void) strcat(record, "\n");
+	len = strlen(record);
+
+	bp = logbufs + i;
+	if (!held || len > LOGBUF)
+	    logwrite(bp, record, len);
+	else
+	{
+	    if (bp->len + len > LOGBUF)
+		logflush();
+	    if (logbufs[0].len == 0 && logbufs[1].len == 0)
+		oldest = t;
+	    (void) memcpy(bp->text + bp->len, record, len);
+	    bp->len += len;
 	}
     }
+    fields[0] = '\0';
+
+    /* errors go out at once, along with whatever led up to them */
+    if (held && (level || t - oldest >= LOGDELAY))
+	logflush();
 }
 
 #ifdef OPENDEBUG
@@ -29,9 +29,20 @@ distributions for each group are written into it here.
 header will be accepted on sys. Some optimizations of this expensive check
 are enabled by FEEDBITS and CACHEBITS. See also feedbits.c
 
+   If FEEDBITS is on and feedbits() has been called, ngprepare() ORs together
+the feed bitsets of the article's groups. When every destination is a known
+group with a bitset and no distribution prefix (the usual case), ngaccept()
+just tests the target's bit in that union. Otherwise it goes through the
+destinations one by one as before, testing each group's own bit instead of
+calling ngmatch() on the feed's subscription list wherever it can.
+
+   The names of unrecognized groups are saved in artregion, a region (see
+region.c) that ngprepinit() creates to hold storage living exactly as long
+as the article being posted. The poster is expected to rgreset() it when
+it is through with each article; ngprepare() never frees anything itself.
+
 NOTE
    The LEAFNODE code is experimental and should be ignored for the moment.
-The FEEDBITS code is broken.
 
 FILES
     ADM/aliases       -- news group aliases file
@@ -52,25 +63,28 @@ of protecting free redistribution; see the LICENSE file for details.
 #include "alist.h"
 #include "feeds.h"
 #include "active.h"
+#include "region.h"
 #include "ngprep.h"
-#ifdef FEEDBITS
-#include "bitmacros.h"
-#endif /* FEEDBITS */
 #ifdef LEAFNODE
 #include "newsrc.h"
 #endif /* LEAFNODE */
 
-#undef FEEDBITS
-
 ALIST(distlist, 20, 10)	    /* hold the distributions list */
 ALIST(aliases, 20, 10)	    /* hold the newsgroup aliases list */
 ALIST(buggroups, 20, 10)    /* hold the bug-group aliases list */
 ALIST(pathlist, 2,  2)	    /* hold the moderator/backbone site list */
 
 dest_t	destinations[CROSSPOSTS];
+region_t *artregion;	/* storage for the article being posted */
 
 private char	distspace[BUFLEN], *distpt = distspace;
 
+#ifdef FEEDBITS
+private fword_t	*artfeeds;	/* union of the destinations' feed bitsets */
+private int	artwords;	/* words allocated for it */
+private bool	artplain;	/* if TRUE, artfeeds decides ngaccept() */
+#endif /* FEEDBITS */
+
 /*
  * The following hackery intends to minimize the number of those expensive
  * ngfind() operations that need to be performed while posting an article
@@ -114,12 +128,54 @@ void ngprepinit()
 	(void) dbaread(&distlist);
     }
 
+    if (artregion == (region_t *)NULL)
+	artregion = rgnew(LBUFLEN);
+
     /* find our path to the backbone (if we have one) */
     p = strchr(newsattr("backbone", BACKBONE), '%');
     if (p != (char*)NULL && p[1] != 's')
 	xerror0("backbone address corrupted");
 }
 
+#ifdef FEEDBITS
+private void ngunion()
+/* OR together the feed bitsets of the current article's destinations */
+{
+    register dest_t	*dst;
+    register fword_t	*set;
+    register int	i;
+
+    artplain = FALSE;
+    if (feedmap.nwords == 0)
+	return;
+    if (artwords < feedmap.nwords)
+    {
+	if (artfeeds != (fword_t *)NULL)
+	    (void) free((char *)artfeeds);
+	artfeeds = (fword_t *)malloc(feedmap.nwords * sizeof(fword_t));
+	if (artfeeds == (fword_t *)NULL)
+	{
+	    artwords = 0;
+	    return;
+	}
+	artwords = feedmap.nwords;
+    }
+
+    for (i = 0; i < feedmap.nwords; i++)
+	artfeeds[i] = (fword_t)0;
+    for (dst = destinations; dst->d_status != D_NOMORE; dst++)
+    {
+	if (dst->d_status == D_UNKNOWN || dst->d_dist != (char *)NULL
+		|| dst->d_ptr == (group_t *)NULL || !ngfeedok(dst->d_ptr, 0))
+	    return;
+	set = ngfeeds(dst->d_ptr);
+	for (i = 0; i < feedmap.nwords; i++)
+	    artfeeds[i] |= set[i];
+    }
+    artplain = TRUE;
+}
+#endif /* FEEDBITS */
+
 void ngprepare()
 {
     register char *ptr;
@@ -128,16 +184,12 @@ void ngprepare()
     bool	nodist;
 
     /*
-     * Undo any allocations hanging out from a previous ngprepare().
+     * Clear out a previous ngprepare(); any names it saved live in artregion.
      * Because D_NOMORE is 0, this will do nothing on the first call.
      */
     for (dest = destinations; dest->d_status != D_NOMORE; dest++)
     {
-	if (dest->d_status == D_UNKNOWN && dest->d_name != (char*)NULL)
-	{
-	    free(dest->d_name);
-	    dest->d_name = (char*)NULL;
-	}
+	dest->d_name = (char*)NULL;
 	dest->d_ptr = (group_t *) NULL;
 	dest->d_status = D_NOMORE;
     }
@@ -217,7 +269,7 @@ void ngprepare()
 	    else
 	    {
 		dest->d_status = D_UNKNOWN;
-		dest->d_name = savestr(ptr);
+		dest->d_name = rgsave(artregion, ptr);
 	    }
 	}
 
@@ -246,7 +298,7 @@ void ngprepare()
 #endif /* B211COMPAT */
 	    {
 		dest->d_status = D_UNKNOWN;
-		dest->d_name = savestr(ptr);
+		dest->d_name = rgsave(artregion, ptr);
 	    }
 	}
 
@@ -267,6 +319,10 @@ void ngprepare()
     if (nodist)
 	hlcpy(header.h_distribution, defdist);
     dest->d_status = D_NOMORE;
+
+#ifdef FEEDBITS
+    ngunion();
+#endif /* FEEDBITS */
 }
 
 int ngaccept(target)
@@ -280,7 +336,14 @@ feed_t	*target;    /* against this feed description */
 		&& !ngmatch(header.h_distribution, target->s_distribs)
 		&& !ngmatch(header.h_distribution, target->s_ngroups))
 	return(A_DISTNG);
-    else for (dst = destinations; dst->d_status != D_NOMORE; dst++)
+
+#if defined(FEEDBITS) && !defined(LEAFNODE)
+    /* if the union of the groups' bitsets settles it, we're done */
+    if (artplain && s_tell(target) < feedmap.nfeeds)
+	return(fbtest(artfeeds, s_tell(target)) ? A_ACCEPT : A_GRPSNG);
+#endif /* defined(FEEDBITS) && !defined(LEAFNODE) */
+
+    for (dst = destinations; dst->d_status != D_NOMORE; dst++)
     {
 	bool	pref;
 
@@ -314,10 +377,10 @@ feed_t	*target;    /* against this feed description */
 	    return(A_ACCEPT);
 #else
 #ifdef FEEDBITS
-	/* if this group's bitmap was ever compiled, use the bits */
-	if (ngfeed(ngactive(), 0))
- 	{
-	    if (ngfeed(ngactive(), s_tell(target) + 1))
+	/* if this group has a bitset, use the bits */
+	if (ngfeedok(ngactive(), s_tell(target)))
+	{
+	    if (ngfeed(ngactive(), s_tell(target)))
 		return(A_ACCEPT);
 	}
 	else
@@ -17,6 +17,7 @@ typedef struct
 }
 dest_t;
 extern dest_t	destinations[];	/* the list of compiled destinations */
+extern struct region *artregion;	/* per-article storage */
 
 extern	void	ngprepinit();
 extern	void	ngprepare();
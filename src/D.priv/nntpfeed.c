@@ -0,0 +1,574 @@
+/****************************************************************************
+
+NAME
+   nntpfeed.c -- stream articles to a peer's news server over NNTP
+
+SYNOPSIS
+   #include "news.h"
+   #include "libpriv.h"
+   #include "dballoc.h"
+   #include "feeds.h"
+
+   bool nntplink(sp)		-- is this an NNTP feed?
+   feed_t *sp;
+
+   int nntpfeed(sp, id, fname)	-- offer an article to an NNTP feed
+   feed_t *sp; char *id; char *fname;
+
+   void nntpfdone(name)		-- finish off transmission to NNTP feeds
+   char *name;
+
+DESCRIPTION
+   These functions implement the NNTP transport for transmit(), selected by
+giving a feed the option T"nntp". Instead of handing articles to uux or
+another command, the transmission code offers them to the news server named
+in the feed's transmission command field (default: the system name itself),
+optionally followed by a slash and a port number, as in "news.foo.com/1119".
+A number after a slash in the T option argument, as in T"nntp/32", sets the
+window (see below).
+
+   The nntplink() function tells whether a feed uses this transport.
+
+   The nntpfeed() function offers the article with the given ID, whose text is
+in the given file, to the feed's server. The first offer opens a connection
+that is kept until nntpfdone() is called, so a whole rnews or sendbatch run
+goes down one connection per feed. If the server agrees to MODE STREAM each
+offer is a CHECK command, and nntpfeed() returns as soon as the command is
+queued; the article file is held open and the text goes out with TAKETHIS
+when the server answers 238. Up to a window of FEEDWINDOW commands may be
+outstanding, and responses are collected only when the window is full or
+the output buffer has to be sent anyway. A server that won't stream gets an
+IHAVE for each article, in lockstep.
+
+   Article text is copied from the spool file to the connection a block at
+a time, with newlines made into CR-LF and leading dots doubled on the way;
+it is never read through stdio or split into per-line writes.
+
+   Each feed's results are counted: articles the server took, refused
+(because it had them), rejected, and deferred. A deferred article is one
+the server told us to try again later (431 or 436), or one still outstanding
+when the connection was lost or could not be made. Deferred articles have
+their IDs appended to the feed's batch file, BATCH/<system>, which is where
+sendbatch will pick them up for another try. The IDs of rejected articles
+are logged.
+
+   The nntpfdone() function waits for all outstanding responses on the named
+feed's connection (all connections, if the name is NULL), closes it, and
+logs the totals. Anything that calls transmit() must call it before exiting.
+
+FILES
+   BATCH/<system>	-- IDs of deferred articles are appended here
+
+BUGS
+   A server that stops responding will hang the transmitting process, since
+there is no timeout.
+   The C, E and A options make no sense on an NNTP link and are ignored.
+
+SEE ALSO
+   transmit.c	-- the transport switch that calls nntpfeed()
+   sendbatch.c	-- feeds batch files through nntpfeed()
+   nntprecv.c	-- the receiving end
+
+AUTHOR
+   Eric S. Raymond
+   This software is Copyright (C) 1989 by Eric S. Raymond for the sole purpose
+of protecting free redistribution; see the LICENSE file for details.
+
+**************************************************************************/
+/*LINTLIBRARY*/
+#include "news.h"
+#include "libpriv.h"
+#include "dballoc.h"
+#include "feeds.h"
+#include "nntp.h"
+
+#ifdef BSD4_2
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netdb.h>
+#endif /* BSD4_2 */
+
+#define NNTPPORT	119	/* port to use if there's no nntp service */
+#define FEEDWINDOW	16	/* default most commands outstanding */
+#define MAXWINDOW	64	/* most the window may be set to */
+#define MAXFEEDS	8	/* most NNTP feeds one process may have open */
+#define FBUFSIZ		8192	/* size of connection buffers */
+
+/* verbosity level minima for various messages */
+#define V_SHOWFEED	1	/* log connection totals */
+#define V_SHOWCMD	3	/* log each command sent */
+
+#define F_CHECK		0	/* streaming offer */
+#define F_TAKETHIS	1	/* streaming transfer */
+
+typedef struct
+{
+    char	id[NAMELEN];	/* Message-ID of the article */
+    int		cmd;		/* which command is waiting on the response */
+    int		fd;		/* article file, until the text has gone out */
+}
+fpend_t;
+
+typedef struct
+{
+    char	name[BUFLEN];	/* system name from feeds, "" if slot free */
+    int		sock;		/* the connection, FAIL if it's down */
+    bool	stream;		/* server does CHECK and TAKETHIS? */
+    int		window;		/* most commands outstanding */
+    fpend_t	pend[MAXWINDOW];	/* commands awaiting responses */
+    int		first, npend;
+    char	ibuf[FBUFSIZ];	/* responses not yet parsed */
+    char	*iptr, *iend;
+    char	obuf[FBUFSIZ];	/* commands and text not yet sent */
+    int		olen;
+    long	offered, sent, refused, rejected, deferred;
+}
+fconn_t;
+
+private fconn_t	fconns[MAXFEEDS];
+
+bool nntplink(sp)
+/* does this feed go by NNTP? */
+feed_t	*sp;
+{
+    char	*cp = s_option(sp, 'T');
+
+    return(cp != (char *)NULL && prefix(cp, "nntp"));
+}
+
+private void feeddefer(fp, id)
+/* put an article back in its feed's batch file to be tried again */
+fconn_t	*fp;
+char	*id;
+{
+    int		fd;
+    char	batchfile[BUFLEN];
+
+    fp->deferred++;
+    (void) sprintf(batchfile, "%s/%s", site.batchdir, fp->name);
+    if ((fd = open(batchfile, O_CREAT | O_WRONLY | O_APPEND, 0666)) == FAIL)
+    {
+	logerr2("can't requeue %s for %s", id, fp->name);
+	return;
+    }
+    (void) sprintf(bfr, "%s\n", id);
+    if (write(fd, bfr, (iolen_t)strlen(bfr)) == FAIL)
+	logerr2("can't requeue %s for %s", id, fp->name);
+    (void) close(fd);
+}
+
+private void feeddown(fp)
+/* the connection is gone, defer everything that was riding on it */
+register fconn_t	*fp;
+{
+    register fpend_t	*pp;
+
+    if (fp->sock != FAIL)
+    {
+	logerr1("lost NNTP connection to %s", fp->name);
+	(void) close(fp->sock);
+	fp->sock = FAIL;
+    }
+    for (; fp->npend > 0; fp->npend--, fp->first = (fp->first+1) % MAXWINDOW)
+    {
+	pp = &fp->pend[fp->first];
+	if (pp->fd != FAIL)
+	    (void) close(pp->fd);
+	feeddefer(fp, pp->id);
+    }
+    fp->olen = 0;
+}
+
+private void feedflush(fp)
+/* send everything in a connection's output buffer */
+register fconn_t	*fp;
+{
+    register int	n, done;
+
+    for (done = 0; done < fp->olen && fp->sock != FAIL; done += n)
+	if ((n = write(fp->sock, fp->obuf + done, (iolen_t)(fp->olen - done))) <= 0)
+	    feeddown(fp);
+    fp->olen = 0;
+}
+
+private void feedcmd(fp, cmd, id)
+/* queue a command line on a connection */
+register fconn_t	*fp;
+char	*cmd, *id;
+{
+    if (fp->olen + strlen(cmd) + strlen(id) + 3 > FBUFSIZ)
+	feedflush(fp);
+    if (id[0])
+	(void) sprintf(fp->obuf + fp->olen, "%s %s\r\n", cmd, id);
+    else
+	(void) sprintf(fp->obuf + fp->olen, "%s\r\n", cmd);
+    fp->olen += strlen(fp->obuf + fp->olen);
+#ifdef DEBUG
+    if (verbose >= V_SHOWCMD)
+	log3("%s: >>> %s %s", fp->name, cmd, id);
+#endif /* DEBUG */
+}
+
+private void feedtext(fp, fd)
+/* copy an article file onto the connection in NNTP text form */
+register fconn_t	*fp;
+int			fd;
+{
+    char		blk[FBUFSIZ];
+    register char	*cp, *ep;
+    register int	n;
+    bool		bol = TRUE, nlend = TRUE;
+
+    while (fp->sock != FAIL && (n = read(fd, blk, sizeof(blk))) > 0)
+    {
+	for (cp = blk, ep = blk + n; cp < ep; cp++)
+	{
+	    /* worst case a character turns into three: ".\r\n" */
+	    if (fp->olen + 3 > FBUFSIZ)
+		feedflush(fp);
+	    if (bol && *cp == '.')
+		fp->obuf[fp->olen++] = '.';
+	    if (*cp == '\n')
+		fp->obuf[fp->olen++] = '\r';
+	    fp->obuf[fp->olen++] = *cp;
+	    bol = (*cp == '\n');
+	}
+	nlend = bol;
+    }
+    (void) close(fd);
+
+    if (fp->olen + 5 > FBUFSIZ)
+	feedflush(fp);
+    if (!nlend)
+    {
+	(void) strcpy(fp->obuf + fp->olen, "\r\n");
+	fp->olen += 2;
+    }
+    (void) strcpy(fp->obuf + fp->olen, ".\r\n");
+    fp->olen += 3;
+}
+
+private int feedresp(fp, buf, size)
+/* get the next response line from a connection; return its code */
+register fconn_t	*fp;
+char			*buf;
+int			size;
+{
+    register char	*cp = buf;
+    int			n;
+
+    feedflush(fp);		/* the server may be waiting on these */
+    if (fp->sock == FAIL)
+	return(FAIL);
+    for (;;)
+    {
+	if (fp->iptr >= fp->iend)
+	{
+	    if ((n = read(fp->sock, fp->ibuf, sizeof(fp->ibuf))) <= 0)
+	    {
+		feeddown(fp);
+		return(FAIL);
+	    }
+	    fp->iptr = fp->ibuf;
+	    fp->iend = fp->ibuf + n;
+	}
+	if (*fp->iptr == '\n')
+	{
+	    fp->iptr++;
+	    break;
+	}
+	if (cp < buf + size - 1)
+	    *cp++ = *fp->iptr;
+	fp->iptr++;
+    }
+    if (cp > buf && cp[-1] == '\r')
+	cp--;
+    *cp = '\0';
+#ifdef DEBUG
+    if (verbose >= V_SHOWCMD)
+	log2("%s: <<< %s", fp->name, buf);
+#endif /* DEBUG */
+    return(atoi(buf));
+}
+
+private void feedpush(fp, cmd, id, fd)
+/* remember that a command is waiting on a response */
+register fconn_t	*fp;
+int	cmd;
+char	*id;
+int	fd;
+{
+    register fpend_t	*pp = &fp->pend[(fp->first+fp->npend++) % MAXWINDOW];
+
+    (void) strcpy(pp->id, id);
+    pp->cmd = cmd;
+    pp->fd = fd;
+}
+
+private void feedreap(fp)
+/* collect the response to the oldest outstanding command */
+register fconn_t	*fp;
+{
+    fpend_t	req;
+    char	line[NNTP_STRLEN];
+    int		code;
+
+    if ((code = feedresp(fp, line, sizeof(line))) == FAIL)
+	return;			/* feeddown() has dealt with the window */
+    req = fp->pend[fp->first];
+    fp->first = (fp->first + 1) % MAXWINDOW;
+    fp->npend--;
+
+    if (req.cmd == F_CHECK && code == OK_CHECK)
+    {
+	/* it's wanted, so the transfer takes the offer's place */
+	feedpush(fp, F_TAKETHIS, req.id, FAIL);
+	feedcmd(fp, "TAKETHIS", req.id);
+	feedtext(fp, req.fd);
+	return;
+    }
+
+    if (req.fd != FAIL)
+	(void) close(req.fd);
+    if (code == OK_TAKETHIS)
+	fp->sent++;
+    else if (code == ERR_NOCHECK)
+	fp->refused++;
+    else if (code == ERR_TAKETHIS)
+    {
+	log2("%s rejected by %s", req.id, fp->name);
+	fp->rejected++;
+    }
+    else
+    {
+	if (code != ERR_CHECKLATER)
+	    logerr3("%s: unexpected response to %s: %s",
+		    fp->name, req.id, line);
+	feeddefer(fp, req.id);
+    }
+}
+
+private void feedihave(fp, id, fd)
+/* offer an article to a server that won't stream */
+register fconn_t	*fp;
+char	*id;
+int	fd;
+{
+    char	line[NNTP_STRLEN];
+    int		code;
+
+    feedcmd(fp, "IHAVE", id);
+    if ((code = feedresp(fp, line, sizeof(line))) == CONT_XFER)
+    {
+	feedtext(fp, fd);
+	fd = FAIL;
+	code = feedresp(fp, line, sizeof(line));
+    }
+    if (fd != FAIL)
+	(void) close(fd);
+
+    if (code == OK_XFERED)
+	fp->sent++;
+    else if (code == ERR_GOTIT)
+	fp->refused++;
+    else if (code == ERR_XFERRJCT)
+    {
+	log2("%s rejected by %s", id, fp->name);
+	fp->rejected++;
+    }
+    else
+    {
+	if (code != ERR_XFERFAIL && code != FAIL)
+	    logerr3("%s: unexpected response to %s: %s", fp->name, id, line);
+	feeddefer(fp, id);
+    }
+}
+
+private int feedconnect(fp, sp)
+/* open the connection to a feed's server */
+register fconn_t	*fp;
+feed_t			*sp;
+{
+#ifndef BSD4_2
+    logerr1("can't feed %s by NNTP without sockets", sp->s_name);
+    return(FAIL);
+#else
+    struct sockaddr_in	sin;
+    struct servent	*svp;
+    struct hostent	*hp;
+    char		host[BUFLEN], line[NNTP_STRLEN], *cp;
+
+    (void) strcpy(host, sp->s_xmit[0] ? sp->s_xmit : sp->s_name);
+    (void) bzero((char *)&sin, sizeof(sin));
+    if ((cp = strchr(host, S_FLEXSEP)) != (char *)NULL)
+    {
+	*cp++ = '\0';
+	sin.sin_port = htons(atoi(cp));
+    }
+    else if ((svp = getservbyname("nntp", "tcp")) != (struct servent *)NULL)
+	sin.sin_port = svp->s_port;
+    else
+	sin.sin_port = htons(NNTPPORT);
+    if ((hp = gethostbyname(host)) == (struct hostent *)NULL)
+    {
+	logerr2("NNTP feed %s: unknown host %s", sp->s_name, host);
+	return(FAIL);
+    }
+    (void) memcpy((char *)&sin.sin_addr, hp->h_addr, hp->h_length);
+    sin.sin_family = hp->h_addrtype;
+
+    if ((fp->sock = socket(AF_INET, SOCK_STREAM, 0)) == FAIL)
+    {
+	logerr2("NNTP feed %s: socket() failed, errno = %d", sp->s_name, errno);
+	return(FAIL);
+    }
+    if (connect(fp->sock, (struct sockaddr *)&sin, sizeof(sin)) == FAIL)
+    {
+	logerr3("NNTP feed %s: can't connect to %s, errno = %d",
+		sp->s_name, host, errno);
+	(void) close(fp->sock);
+	fp->sock = FAIL;
+	return(FAIL);
+    }
+
+    /* a dead server shows up as a failed write, not a signal */
+    (void) signal(SIGPIPE, SIGCAST(SIG_IGN));
+
+    if (feedresp(fp, line, sizeof(line)) / 100 != 2)
+    {
+	logerr2("NNTP feed %s: server says %s", sp->s_name, line);
+	feeddown(fp);
+	return(FAIL);
+    }
+    feedcmd(fp, "MODE", "STREAM");
+    fp->stream = (feedresp(fp, line, sizeof(line)) == OK_STREAM);
+    return(fp->sock == FAIL ? FAIL : SUCCEED);
+#endif /* BSD4_2 */
+}
+
+private fconn_t *feedget(sp)
+/* find a feed's connection, opening it if need be */
+feed_t	*sp;
+{
+    register fconn_t	*fp, *freep = (fconn_t *)NULL;
+    char		*cp;
+
+    for (fp = fconns; fp < fconns + MAXFEEDS; fp++)
+	if (strcmp(fp->name, sp->s_name) == 0)
+	    return(fp);
+	else if (fp->name[0] == '\0' && freep == (fconn_t *)NULL)
+	    freep = fp;
+    if ((fp = freep) == (fconn_t *)NULL)
+    {
+	logerr1("too many NNTP feeds open to add %s", sp->s_name);
+	return((fconn_t *)NULL);
+    }
+
+    (void) strcpy(fp->name, sp->s_name);
+    fp->first = fp->npend = fp->olen = 0;
+    fp->iptr = fp->iend = fp->ibuf;
+    fp->offered = fp->sent = fp->refused = fp->rejected = fp->deferred = 0L;
+    fp->sock = FAIL;
+    fp->stream = FALSE;
+    fp->window = FEEDWINDOW;
+    if ((cp = s_option(sp, 'T')) != (char *)NULL
+		&& (cp = strchr(cp, S_FLEXSEP)) != (char *)NULL
+		&& (fp->window = atoi(cp + 1)) <= 0)
+	fp->window = 1;
+    else if (fp->window > MAXWINDOW)
+	fp->window = MAXWINDOW;
+
+    (void) feedconnect(fp, sp);	/* if it fails, offers just get deferred */
+    return(fp);
+}
+
+int nntpfeed(sp, id, fname)
+/* offer an article to an NNTP feed */
+feed_t	*sp;	/* the feed */
+char	*id;	/* Message-ID of the article */
+char	*fname;	/* file holding its text */
+{
+    register fconn_t	*fp;
+    int			fd;
+
+    if (id == (char *)NULL || id[0] == '\0')
+    {
+	logerr1("can't feed %s to NNTP without a Message-ID", fname);
+	return(FAIL);
+    }
+#ifdef DEBUG
+    if (debug)
+    {
+	log2("would offer %s to %s by NNTP", id, sp->s_name);
+	return(SUCCEED);
+    }
+#endif /* DEBUG */
+    if ((fp = feedget(sp)) == (fconn_t *)NULL)
+	return(FAIL);
+
+    fp->offered++;
+    if (fp->sock == FAIL)
+    {
+	feeddefer(fp, id);
+	return(SUCCEED);
+    }
+    if ((fd = open(fname, O_RDONLY)) == FAIL)
+    {
+	logerr2("can't open %s to feed it to %s", fname, sp->s_name);
+	return(FAIL);
+    }
+
+    if (!fp->stream)
+	feedihave(fp, id, fd);
+    else
+    {
+	while (fp->npend >= fp->window && fp->sock != FAIL)
+	    feedreap(fp);
+	if (fp->sock == FAIL)
+	{
+	    (void) close(fd);
+	    feeddefer(fp, id);
+	}
+	else
+	{
+	    /* on the window first, so feeddown() can defer it */
+	    feedpush(fp, F_CHECK, id, fd);
+	    feedcmd(fp, "CHECK", id);
+	}
+    }
+    return(SUCCEED);
+}
+
+void nntpfdone(name)
+/* drain and close NNTP feed connections */
+char	*name;	/* feed to close, or NULL for all of them */
+{
+    register fconn_t	*fp;
+    char		line[NNTP_STRLEN];
+
+    for (fp = fconns; fp < fconns + MAXFEEDS; fp++)
+    {
+	if (fp->name[0] == '\0'
+		|| (name != (char *)NULL && strcmp(fp->name, name) != 0))
+	    continue;
+
+	while (fp->npend > 0 && fp->sock != FAIL)
+	    feedreap(fp);
+	if (fp->sock != FAIL)
+	{
+	    feedcmd(fp, "QUIT", "");
+	    (void) feedresp(fp, line, sizeof(line));
+	    (void) close(fp->sock);
+	    fp->sock = FAIL;
+	}
+	if (verbose >= V_SHOWFEED)
+	    log4("%s: %ld offered, %ld sent, %ld refused by NNTP",
+		 fp->name, fp->offered, fp->sent, fp->refused);
+	if (fp->rejected || fp->deferred)
+	    log3("%s: %ld rejected, %ld deferred",
+		 fp->name, fp->rejected, fp->deferred);
+	fp->name[0] = '\0';
+    }
+}
+
+/* nntpfeed.c ends here */
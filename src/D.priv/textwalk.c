@@ -21,7 +21,24 @@ In addition, the current-article global is correct at each article node.
 If the node type is TW_GROUP, argument 2 is the dot-separated group name of
 the group we are entering, rather than the last segment of the node name;
 and the value of the current-group field of the current-article global will
-be zero.
+be zero. The path and group name handed to the function live in static
+buffers that change as the walk goes on; copy them if you need them later.
+
+NOTES
+   On a big spool nearly every entry is an article, and the old way of
+finding out which entries are subdirectories -- a stat(2) on each one -- is
+what expire -r spends most of its time on. So we avoid stat where we can.
+If the system's directory entries carry a file type (d_type, with DT_DIR
+defined) that is believed, except that symbolic links are always followed
+with a stat. Otherwise a directory's link count tells us how many
+subdirectories it has, and once they have all turned up, the remaining
+all-digit names are taken to be articles without a stat. A symbolic link to
+a directory isn't among those links, so it is found with lstat(2) (where
+there are symbolic links) and followed without being counted. Names that aren't
+all digits are always checked, so a group directory that is a symbolic link
+is still followed unless its name is a number and there's no d_type.
+   Path and group names are built in place, one name segment at a time,
+rather than copied whole for every entry.
 
 FILES
    TEXT/*	-- article text directories
@@ -39,9 +56,21 @@ of protecting free redistribution; see the LICENSE file for details.
 #include "active.h"
 
 static int (*funcptr)();
+static char	path[PATHLEN];	/* name of the directory being searched */
+static char	group[BUFLEN];	/* the corresponding group name */
 
-static int spoolsearch(dirname, group)
-char	*dirname, *group;
+static bool numeric(name)
+/* could this be an article's name? */
+register char	*name;
+{
+    while (isdigit(*name))
+	name++;
+    return(*name == '\0');
+}
+
+static int spoolsearch(plen, glen)
+int	plen;	/* length of the directory's name in path */
+int	glen;	/* length of its group name in group */
 /*
  * This subroutine performs a recursive search down a spool directory,
  * adding newsgroups to the active file if they are not present.
@@ -49,19 +78,22 @@ char	*dirname, *group;
 {
     DIR			*directory;	/* Current directory structure */
     struct dirent	*entry;		/* An entry within it. */
-    char		nextdir[BUFLEN]; /* name of lower level directory */
-    char		nextgroup[BUFLEN];
+    struct stat		st;
     nart_t		artcount = (nart_t)0;
     place_t		save;
-    int			res;
+    int			res, nlen, subdirs;
+    bool		dir, real;	/* real if a directory, not a link to one */
 
     /* we're looking at a new directory */
-    if ((*funcptr)(dirname, (char *)NULL, TW_DIRECTORY) == FAIL)
+    if ((*funcptr)(path, (char *)NULL, TW_DIRECTORY) == FAIL)
 	return(FAIL);
 	
-    if ((directory = opendir(dirname)) == (DIR *)NULL)
+    if (stat(path, &st) == FAIL || (directory = opendir(path)) == (DIR *)NULL)
 	return(FAIL);
-	
+
+    /* its links are its own entry, its ".", and each subdirectory's ".." */
+    subdirs = (st.st_nlink >= 2) ? st.st_nlink - 2 : FAIL;
+
     /* now pick the next entry out of the directory */
     while (entry = readdir(directory))
     {
@@ -69,15 +101,56 @@ char	*dirname, *group;
 	if (entry->d_name[0] == '.')
 	    continue;
 
+	/* too long to name can't be anything we want */
+	nlen = strlen(entry->d_name);
+	if (plen + nlen + 2 > sizeof(path) || glen + nlen + 2 > sizeof(group))
+	    continue;
+
+	/* is it a directory? find out without a stat() if we can */
+#ifdef DT_DIR
+	if (entry->d_type != DT_UNKNOWN && entry->d_type != DT_LNK)
+	    dir = real = (entry->d_type == DT_DIR);
+	else if (entry->d_type == DT_UNKNOWN
+		 && subdirs == 0 && numeric(entry->d_name))
+#else
+	if (subdirs == 0 && numeric(entry->d_name))
+#endif /* DT_DIR */
+	    dir = real = FALSE;
+	else
+	{
+	    path[plen] = '/';
+	    (void) strcpy(path + plen + 1, entry->d_name);
+#ifdef S_IFLNK
+	    if (lstat(path, &st) == FAIL)
+		dir = real = FALSE;
+	    else if ((st.st_mode & S_IFMT) == S_IFLNK)
+	    {
+		dir = isdir(path);
+		real = FALSE;
+	    }
+	    else
+		dir = real = ((st.st_mode & S_IFMT) == S_IFDIR);
+#else
+	    dir = real = isdir(path);
+#endif /* S_IFLNK */
+	    path[plen] = '\0';
+	}
+
 	/* If it's a directory, recursively search it. */
-	(void) sprintf(nextdir, "%s/%s", dirname, entry->d_name);
-	if (isdir(nextdir))
+	if (dir)
 	{
-	    (void) sprintf(nextgroup, "%s%s%s", group,
-			   group[0] ? "." : "", entry->d_name);
+	    if (real && subdirs > 0)
+		subdirs--;
+	    path[plen] = '/';
+	    (void) strcpy(path + plen + 1, entry->d_name);
+	    if (glen > 0)
+		group[glen] = NGSEP;
+	    (void) strcpy(group + glen + (glen > 0), entry->d_name);
 	    save.m_group = active.article.m_group;
 	    save.m_number = active.article.m_number;
-	    if (spoolsearch(nextdir, nextgroup) == FAIL)
+	    res = spoolsearch(plen + 1 + nlen, glen + (glen > 0) + nlen);
+	    path[plen] = group[glen] = '\0';
+	    if (res == FAIL)
 	    {
 		(void) closedir(directory);
 		return(FAIL);
@@ -92,19 +165,19 @@ char	*dirname, *group;
 
 	/* get current article number; if it's zero, ignore and flag it. */
 	if ((active.article.m_number = atoa(entry->d_name)) == 0)
-	    res = (*funcptr)(dirname, entry->d_name, TW_BADNUMBER);
+	    res = (*funcptr)(path, entry->d_name, TW_BADNUMBER);
 	else
 	{
 	    if (artcount++ == 0)
 	    {
 		active.article.m_group = ngfind(group);
-		if ((*funcptr)(dirname, group, TW_GROUP) == FAIL)
+		if ((*funcptr)(path, group, TW_GROUP) == FAIL)
 		{
 		    (void) closedir(directory);
 		    return(FAIL);
 		}
 	    }
-	    res = (*funcptr)(dirname, entry->d_name, TW_ARTICLE);
+	    res = (*funcptr)(path, entry->d_name, TW_ARTICLE);
 	}
 	if (res == FAIL)
 	{
@@ -121,7 +194,9 @@ int textwalk(func)
 int	(*func)();
 {
     funcptr = func;
-    return(spoolsearch(site.textdir, ""));
+    (void) strcpy(path, site.textdir);
+    group[0] = '\0';
+    return(spoolsearch(strlen(path), 0));
 }
 
 /* textwalk.c ends here */
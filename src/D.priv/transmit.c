@@ -21,9 +21,10 @@ SYNOPSIS
 
 DESCRIPTION
    These functions do point-to-point news transmission. They interpret
-the A, C, D, E, F, H, M, S, U, V and X transmission options. The
-'T' option is not presently used but is reserved for transport layer
-specification.
+the A, C, D, E, F, H, M, S, T, U, V and X transmission options. The
+'T' option selects a transport other than a command or mail; at present
+the only one is T"nntp", which hands the article to nntpfeed() for
+streaming to the feed's news server.
 
    Some of this code invokes a UUCP multicast facility, selected by the
 combination the X transmission options and no explicit transmit command.
@@ -43,6 +44,7 @@ FILES
 SEE ALSO
    sevenbit.c -- for encode()
    uucast.c -- multicast transmission code
+   nntpfeed.c -- the NNTP transport
 
 AUTHOR
    Eric S. Raymond
@@ -52,7 +54,7 @@ of protecting free redistribution; see the LICENSE file for details.
 *****************************************************************************/
 /*LINTLIBRARY*/
 #include "news.h"
-#include "spawn.h"
+#include "launch.h"
 #include "libpriv.h"
 #include "header.h"
 #include "post.h"
@@ -106,6 +108,10 @@ bool		fopt;	/* enables batchit */
 /* X:	mxcast: the system list we're transmitting to is a multicast group */
     bool mxcast = (s_option(sp, 'X') != (char *)NULL);
 
+/* T:	transport: "nntp" offers the article to the feed's news server */
+    if (nntplink(sp))
+	return(nntpfeed(sp, id, fname));
+
     /* compute the proper remote agent */
     rcvcmd = "rnews";
     if (version != (char *)NULL && strncmp(version, "2.10", 4) == 0)
@@ -268,30 +274,16 @@ bool	noshell;	/* whether or not to spawn the command direct */
     /* generate the actual transmission command */
     (void) sprintf(cmdbuf, cmd, sys);
 
-    /* execute the generated transmission command */
-    if (noshell)
-    {
+    /*
+     * Execute the generated transmission command. A helper process runs
+     * it, so we don't fork a process as big as this one for every article.
+     */
 #ifdef DEBUG
-	if (debug)
-	    log1("via %s (no shell)", cmdbuf);
-	else
-#endif /* DEBUG */
-	{
-	    char *argv[MAXARGS];
-
-	    (void) vcrack(cmdbuf, argv, MAXARGS);
-	    (void) spawn(argv, FORGRND, (char *)NULL);
-	}
-    }
+    if (debug)
+	log2("via %s%s", cmdbuf, noshell ? " (no shell)" : "");
     else
-    {
-#ifdef DEBUG
-	if (debug)
-	    log1("via %s", cmdbuf);
-	else
 #endif /* DEBUG */
-	    (void) system(cmdbuf);
-    }
+	(void) lrun(cmdbuf, noshell ? 0 : LSHELL);
 }
 
 /*
@@ -37,8 +37,9 @@ image.
 
    The functions ngcreate() and ngnewart() do not use the allocation
 machinery the other functions are built around; they alter the active file
-in place (ngnewart() uses lock() and unlock() to ensure that multiple users
-can do this consistently; ngcreate() relies on the atomicity of small writes.
+in place (ngnewart() locks the group's record with rlock() to ensure that
+multiple users can do this consistently, without making posters to other
+groups wait; ngcreate() relies on the atomicity of small writes.
 The intent is to permit multiple posting programs to run concurrently. Note
 that posting programs still can and should use the result of a rdactive()
 to check for the validity of group names.
@@ -55,6 +56,18 @@ of the expiration control lines (statistics routines can index this with the
 contents of the ng_findex field of each group, which rdflags() sets to the line
 number of the last line that the group matches).
 
+   Matching every admin line against every group is slow with a big active
+file, so rdflags() keeps the line numbers each group matches in a compiled
+copy of the admin file, ADM/admin.cmp. A process finding it current for the
+admin file's modification time, size and line count only has to read it and
+set the flags; it doesn't match any groups. Since the active file is
+rewritten in place with each article, the copy is checked against the names
+of the groups rather than the active file's time. The group records are in
+active-file order; from the first one that doesn't match the current
+group, the groups are matched against the compiled subscriptions and the
+copy is rewritten. Processes that can't write ADM only match the lines that
+concern the flags they asked for, as before.
+
 NOTE
    When the code is compiled with DEBUG and debug is on, actions that would
 modify the on-disk version of the database are suppressed. Diagnostics are
@@ -68,6 +81,7 @@ distribution-name storage.
 FILES
    ADM/active	-- active group information
    ADM/admin	-- group flags and expiration period information
+   ADM/admin.cmp	-- compiled group matches for ADM/admin
 
 AUTHOR
    Eric S. Raymond
@@ -96,6 +110,7 @@ extern int	rdactcount;	/* defined in rdactive.c */
 #endif /* BIGGROUPS */
 
 #define MAXCTLS		256	/* max expiration control lines */
+#define ADMCOMPILED	"admin.cmp"	/* compiled copy of ADM/admin */
 
 #define	SEPARATORS	" \t:"
 
@@ -107,7 +122,7 @@ group_t	*ngp;
 #ifdef DEBUG
     if (!debug)
 #endif /* DEBUG */
-	lock();
+	rlock(R_GROUP, ngp->ng_name);	/* others may post elsewhere */
     (void) ngreread(ngp, NULLPRED);
 #endif
     if (ngp->ng_min < 0 || ngp->ng_max >= MAXART)
@@ -131,7 +146,7 @@ group_t	*ngp;
 #ifdef DEBUG
     if (!debug)
 #endif /* DEBUG */
-	unlock();
+	runlock(R_GROUP, ngp->ng_name);
 #endif /* SPOOLNEWS */
     return(ngp->ng_max);
 }
@@ -202,7 +217,7 @@ void ngdelete()
 #ifdef DEBUG
     if (!debug)
 #endif /* DEBUG */
-	lock();
+	rlock(R_GROUP, cgp->ng_name);
     (void) ngreread(cgp, NULLPRED);
     cgp->ng_flags |= NG_REMOVED;
     (void) fseek(active.fp,
@@ -216,7 +231,7 @@ void ngdelete()
 #ifdef DEBUG
     if (!debug)
 #endif /* DEBUG */
-	unlock();
+	runlock(R_GROUP, cgp->ng_name);
 }
 
 void ngshow(ngp, fp)
@@ -332,11 +347,125 @@ typedef struct
 }
 flagdef;
 
+/*
+ * The compiled copy of the admin file is an admhead_t followed by one record
+ * per group, in active-file order: an admrec_t, the group name (without its
+ * NUL) and then the line numbers of the admin lines that match the group.
+ */
+#define ADMMAGIC	0x41644631L	/* identifies a compiled admin file */
+
+typedef struct
+{
+    long	magic;		/* always ADMMAGIC */
+    time_t	mtime;		/* modification time of the admin file */
+    off_t	size;		/* its size */
+    int		nlines;		/* its line count */
+}
+admhead_t;
+
+typedef struct
+{
+    short	namelen;	/* length of the group name that follows */
+    short	nmatch;		/* count of line numbers after the name */
+}
+admrec_t;
+
+typedef struct
+{
+    char	*name;		/* the subscription, NULL if line isn't a rule */
+    ngpat_t	pat;		/* its compiled form, once needed */
+    int		turnon;		/* flags the line turns on */
+    int		turnoff;	/* flags the line turns off */
+    long	expire;		/* expiration period, or 0 */
+    char	*dist;		/* default distribution, or NULL */
+}
+admrule_t;
+
+private admrule_t admrules[MAXCTLS];
+
+private int admmatch(group, lines, nlines, mode, all)
+/* find the admin lines that apply to a group */
+char	*group;		/* the group */
+short	*lines;		/* put the matching line numbers here */
+int	nlines;		/* count of admin lines */
+int	mode;		/* flags wanted */
+bool	all;		/* match every rule, not just those touching mode */
+{
+    register admrule_t	*rp;
+    register int	n = 0;
+
+    for (rp = admrules; rp < admrules + nlines; rp++)
+    {
+	if (rp->name == (char *)NULL
+		|| !(all || ((rp->turnon | rp->turnoff) & mode)))
+	    continue;
+	if (rp->pat == (ngpat_t)NULL)
+	    rp->pat = ngcompile(rp->name);
+	if (ngexec(rp->pat, group))
+	    lines[n++] = rp - admrules + 1;
+    }
+    return(n);
+}
+
+private void admapply(ngrp, lines, n, mode)
+/* apply matching admin lines to a group, in order */
+group_t	*ngrp;		/* the group */
+short	*lines;		/* the line numbers */
+int	n;		/* how many of them */
+int	mode;		/* flags wanted */
+{
+    register admrule_t	*rp;
+
+    while (n-- > 0)
+    {
+	rp = admrules + *lines++ - 1;
+	if (((rp->turnon | rp->turnoff) & mode) == 0)
+	    continue;
+	ngrp->ng_findex = rp - admrules + 1;
+	ngrp->ng_flags |= (mode & rp->turnon);
+	ngrp->ng_flags &=~ (mode & rp->turnoff);
+	if (rp->expire)
+	{
+	    ngrp->ng_expire = rp->expire;
+	    ngrp->ng_flags |= NG_EXPIRE;
+	}
+	if ((mode & NG_GETDIST) && rp->dist != (char *)NULL)
+	    ngrp->ng_defdist = rp->dist;
+    }
+}
+
+private bool admlines(lines, n, nlines)
+/* are the line numbers from a compiled record all real admin lines? */
+short	*lines;		/* the line numbers */
+int	n;		/* how many of them */
+int	nlines;		/* line count of the admin file */
+{
+    while (n-- > 0)
+    {
+	if (*lines < 1 || *lines > nlines)
+	    return(FALSE);
+	lines++;
+    }
+    return(TRUE);
+}
+
+private FILE *admcreate(tfile, hp)
+/* start a new compiled admin file */
+char		*tfile;
+admhead_t	*hp;
+{
+    FILE	*fp;
+
+    if ((fp = fopen(tfile, "w")) != (FILE *)NULL)
+	(void) fwrite((char *)hp, sizeof(admhead_t), 1, fp);
+    return(fp);
+}
+
 char **rdflags(mode)
 /* read in a given collection of administration flags */
 int	mode;
 {
-    FILE    *fp;
+    FILE    *fp, *cfp, *nfp = (FILE *)NULL;
     static flagdef flaglist[] =
     {
 	/* to add more flags, just add entries to this table */
@@ -349,14 +478,23 @@ int	mode;
 	{'\0',	0}
     };
     flagdef *fpt;
-    static char *ctrllines[MAXCTLS];
-    char **cpp;
-    int ctline = 0;
+    static char *ctrllines[MAXCTLS + 1];
+    char **cpp, cfile[BUFLEN], tfile[BUFLEN], gname[BUFLEN];
+    short lines[MAXCTLS];
+    int ctline = 0, n;
+    admhead_t head;
+    admrec_t rec;
+    register admrule_t *rp;
+    struct stat st;
+    bool usecache;
+    long recoff;
 
     (void) sprintf(bfr, "%s/admin", site.admdir);
     if ((fp = fopen(bfr, "r")) == (FILE *)NULL)
 	return((char **)NULL);
+    (void) fstat(fileno(fp), &st);
 
+    /* first, crack each line into a rule */
     for (cpp = ctrllines; cpp < ctrllines + MAXCTLS; cpp++)
     {
 	char	*cp, *name;
@@ -369,7 +507,9 @@ int	mode;
 
 	(void) nstrip(bfr);
 	*cpp = savestr(bfr);
-	ctline++;
+	rp = admrules + ctline++;
+	rp->name = (char *)NULL;
+	rp->pat = (ngpat_t)NULL;
 	
 	if ((cp = strchr(bfr, '#')) != (char *)NULL)
 	    *cp = '\0';
@@ -423,32 +563,99 @@ int	mode;
 	if (cp = strtok((char *)NULL, SEPARATORS))
 	    cp = *cpp + (cp - bfr);
 
-	/* next step: apply options to each group that matches the spec */
-	if ((turnon | turnoff) & mode)
+	rp->name = savestr(name);
+	rp->turnon = turnon;
+	rp->turnoff = turnoff;
+	rp->expire = expire;
+	rp->dist = cp;
+    }
+    (void) fclose(fp);
+    *cpp++ = (char *)NULL;
+
+    /*
+     * Next, find out which lines match each group. The answer is kept in a
+     * compiled copy of the file, which is good as long as the admin file is
+     * unchanged and the groups are the ones it lists. Where it isn't, the
+     * groups are matched here and a new copy is written if we can.
+     */
+    head.magic = ADMMAGIC;
+    head.mtime = st.st_mtime;
+    head.size = st.st_size;
+    head.nlines = ctline;
+    (void) sprintf(cfile, "%s/%s", site.admdir, ADMCOMPILED);
+    (void) sprintf(tfile, "%s.%d", cfile, getpid());
+    usecache = FALSE;
+    if ((cfp = fopen(cfile, "r")) != (FILE *)NULL)
+    {
+	admhead_t	chead;
+
+	usecache = fread((char *)&chead, sizeof(admhead_t), 1, cfp) == 1
+		&& chead.magic == head.magic && chead.mtime == head.mtime
+		&& chead.size == head.size && chead.nlines == head.nlines;
+    }
+    if (!usecache)
+	nfp = admcreate(tfile, &head);
+
+    ngrewind(TRUE);
+    while (ngnext())
+    {
+	if (usecache)
 	{
-	    ngrewind(TRUE);
-	    while (ngnext())
+	    recoff = ftell(cfp);
+	    if (fread((char *)&rec, sizeof(admrec_t), 1, cfp) != 1
+		|| rec.namelen < 0 || rec.namelen >= sizeof(gname)
+		|| rec.nmatch < 0 || rec.nmatch > ctline
+		|| fread(gname, sizeof(char), rec.namelen, cfp) != rec.namelen
+		|| (gname[rec.namelen] = '\0', strcmp(gname, ngname()))
+		|| fread((char *)lines, sizeof(short), rec.nmatch, cfp)
+			!= rec.nmatch
+		|| !admlines(lines, rec.nmatch, ctline))
 	    {
-		if (ngmatch(ngname(), name))
+		/*
+		 * The groups have changed, or the copy is damaged; keep the
+		 * good part of it and match the rest from the admin file.
+		 */
+		usecache = FALSE;
+		if ((nfp = admcreate(tfile, &head)) != (FILE *)NULL)
 		{
-		    group_t *ngrp = active.article.m_group;
-
-		    ngrp->ng_findex = ctline;
-		    ngrp->ng_flags |= (mode & turnon);
-		    ngrp->ng_flags &=~ (mode & turnoff);
-		    if (expire)
-		    {
-			ngrp->ng_expire = expire;
-			ngrp->ng_flags |= NG_EXPIRE;
-		    }
-		    if ((mode & NG_GETDIST) && cp != (char *)NULL)
-			ngrp->ng_defdist = cp;
+		    (void) fseek(cfp, (off_t)sizeof(admhead_t), SEEK_SET);
+		    for (recoff -= sizeof(admhead_t); recoff > 0; recoff--)
+			(void) putc(getc(cfp), nfp);
 		}
 	    }
+	    else
+		n = rec.nmatch;
 	}
+
+	if (!usecache)
+	{
+	    n = admmatch(ngname(), lines, ctline, mode, nfp != (FILE *)NULL);
+	    if (nfp != (FILE *)NULL)
+	    {
+		rec.namelen = strlen(ngname());
+		rec.nmatch = n;
+		(void) fwrite((char *)&rec, sizeof(admrec_t), 1, nfp);
+		(void) fwrite(ngname(), sizeof(char), rec.namelen, nfp);
+		(void) fwrite((char *)lines, sizeof(short), n, nfp);
+	    }
+	}
+
+	admapply(active.article.m_group, lines, n, mode);
     }
-    (void) fclose(fp);
-    *cpp++ = (char *)NULL;
+
+    if (cfp != (FILE *)NULL)
+	(void) fclose(cfp);
+    if (nfp != (FILE *)NULL
+		&& (fclose(nfp) == EOF || rename(tfile, cfile) == FAIL))
+	(void) unlink(tfile);
+
+    for (rp = admrules; rp < admrules + ctline; rp++)
+	if (rp->name != (char *)NULL)
+	{
+	    (void) free(rp->name);
+	    if (rp->pat != (ngpat_t)NULL)
+		ngfree(rp->pat);
+	}
     return((char **) ctrllines);
 }
 
@@ -17,6 +17,9 @@ SYNOPSIS
    char *id; time_t rdate, edate;
    char *gp; nart_t msg;
 
+   int hstaddh(hp, gp, msg)		-- add a location for a header
+   hdr_t *hp; char *gp; nart_t msg;
+
    void hstparent(hp)		-- tell parent of hp where its followup is
    hdr_t *hp;
 
@@ -37,6 +40,11 @@ record corresponding to the given ID one is created using the given ID and
 receipt date (otherwise the receipt date argument is ignored). If the
 group pointer given is NULL, the article is cancelled instead.
 
+   The hstaddh() function does the same for the article described by a
+header, taking the ID and dates from it. If it creates the record, it also
+records the post date and a checksum of the From line there, so expire can
+apply its -p and -f criteria without reading the article.
+
    The hstparent() function parses the References line of a given header (if
 there is one) and adds its ID to the Back-References header of the last parent
 listed (establishing a link that can be used for followup-chasing). If the
@@ -68,6 +76,8 @@ of protecting free redistribution; see the LICENSE file for details.
 #define GFORM	"%s/%d"
 #endif /* BIGGROUPS */
 
+private hdr_t	*newhdr;	/* header whose metadata hstmake() records */
+
 #ifdef DEBUG
 int hstwrfile(fp)
 /* write hist data in readable format to a given destination */
@@ -119,7 +129,11 @@ char	*buf;	/* where to write new entry */
     if (rdate == (time_t)0)
 	rdate = time((time_t *)NULL);
 #ifndef TMNCONVERT
-    (void) sprintf(buf, "%s\t%ld %ld\t", id, (long)rdate, (long)edate);
+    if (newhdr != (hdr_t *)NULL)
+	(void) sprintf(buf, "%s\t%ld %ld %ld %lx\t", id, (long)rdate, (long)edate,
+		       (long)newhdr->h_posttime, checkstring(newhdr->h_from, (ulong)0L));
+    else
+	(void) sprintf(buf, "%s\t%ld %ld\t", id, (long)rdate, (long)edate);
 #else /* TMNCONVERT */
     tm = localtime(&rdate);
 #ifdef USG
@@ -194,6 +208,20 @@ nart_t	artn;	/* article number of the article */
     return(hstat() != FAIL);
 }
 
+int hstaddh(hp, gp, artn)
+/* add a location for the article with header hp, noting its metadata */
+hdr_t	*hp;	/* header of the article */
+char	*gp;	/* group of the article */
+nart_t	artn;	/* article number of the article */
+{
+    int		retval;
+
+    newhdr = hp;
+    retval = hstadd(hp->h_ident, hp->h_rectime, hp->h_exptime, gp, artn);
+    newhdr = (hdr_t *)NULL;
+    return(retval);
+}
+
 int hstexpire()
 /* drop the current article location */
 {
@@ -204,8 +232,13 @@ int hstexpire()
     (void) strcpy(id, hstid());
     lcase(id);
     (void) artlstdel(&hstlst);
-    (void) sprintf(line, "%s\t%ld %ld\t%s", chstname, chstdate, chstexpd,
-	    artlstret(&hstlst));
+    if (chstpost)	/* keep the expiry metadata, if the line had it */
+	(void) sprintf(line, "%s\t%ld %ld %ld %lx\t%s",
+		       chstname, chstdate, chstexpd, chstpost, chstfrom,
+		       artlstret(&hstlst));
+    else
+	(void) sprintf(line, "%s\t%ld %ld\t%s", chstname, chstdate, chstexpd,
+		       artlstret(&hstlst));
     retval = dbmput(id, (unsigned) strlen(id),
 		      line, (unsigned) strlen(line), wrhistdb);
     return(retval);
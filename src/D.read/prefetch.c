@@ -0,0 +1,260 @@
+/**************************************************************************
+
+NAME
+   prefetch.c -- read-ahead cache of articles for interactive readers
+
+SYNOPSIS
+   #include "session.h"
+
+   void msgprefetch()		-- idle function, fetch one predicted article
+
+   int pfgetart(pl, hd, txt)	-- getart() through the prefetch cache
+   place_t *pl; hdr_t *hd; char *txt;
+
+   void pfflush()		-- release all prefetched articles
+
+DESCRIPTION
+   Opening, decompressing and header-parsing an article can take a noticeable
+time on a slow disk, and a very noticeable time when the article has to be
+fetched over NNTP. These functions let a reader do that work while it is
+waiting on the keyboard, so the next page is usually available at once.
+
+   The msgprefetch() function is meant to be called from a reader's keyboard
+idle hook (see the tick() functions in vnews.c and vrn.c). Each call predicts
+the next PREFETCH articles the session will visit, using the same rules as
+msgread() (session.reread, session.reverse and, if BYTHREADS is on, the first
+unread followup of the current article in thread mode). The first predicted
+article that is not already cached is fetched into a cache slot with getart().
+Only one article is fetched per call, so the reader stays responsive to
+typeahead. The current article location is restored before return. Under
+NONLOCAL, that article and the uncached ones predicted after it are first
+handed to artahead(), so the NNTP server streams them all while the reader
+waits on the first.
+
+   The pfgetart() function has the same calling sequence and return values as
+getart(). If the requested location is in the cache, the prefetched header
+block (including its open h_fp) is handed over to the caller and the slot is
+freed; otherwise the call falls through to getart().
+
+   Cache slots are recycled least-recently-predicted first, so the cache never
+holds more than PREFETCH open article files. The pfflush() function closes
+them all; msgend() calls it.
+
+   If the DEBUG code is enabled and verbose is at least V_SHOWPREFETCH,
+fetches and cache hits are reported.
+
+BUGS
+   Prediction is abandoned while the user is backtracking through the trail,
+since the next article then comes from the trail rather than from nextmsg().
+
+SEE ALSO
+   session.c	-- the trail code that calls pfgetart()
+   getart.c	-- the underlying article fetcher
+
+AUTHOR
+   Eric S. Raymond
+   This software is Copyright (C) 1989 by Eric S. Raymond for the sole purpose
+of protecting free redistribution; see the LICENSE file for details.
+
+**************************************************************************/
+/*LINTLIBRARY*/
+#include "news.h"
+#include "vio.h"
+#include "header.h"
+#include "active.h"
+#include "dballoc.h"
+#include "nextmsg.h"
+#include "session.h"
+
+#ifdef PREFETCH
+
+#define V_SHOWPREFETCH	3	/* report prefetches and cache hits */
+
+typedef struct
+{
+    place_t	loc;		/* article location; NULL group if slot free */
+    int		status;		/* status returned by getart() */
+    long	stamp;		/* prediction pass that last wanted this */
+    hdr_t	hdr;		/* parsed header and open article file */
+    char	text[BUFLEN];	/* name of the article file */
+}
+pfslot_t;
+
+private pfslot_t	pfcache[PREFETCH];	/* the cache itself */
+private long		pfclock;		/* count of prediction passes */
+private long		pfhits, pfmisses;	/* cache statistics */
+
+private pfslot_t *pffind(pl)
+/* find the cache slot holding a given location, if any */
+place_t	*pl;
+{
+    register pfslot_t	*sp;
+
+    for (sp = pfcache; sp < pfcache + PREFETCH; sp++)
+	if (sp->loc.m_group == pl->m_group && sp->loc.m_number == pl->m_number)
+	    return(sp);
+    return((pfslot_t *)NULL);
+}
+
+private void pfrelease(sp)
+/* drop the article held in a cache slot */
+register pfslot_t	*sp;
+{
+    if (sp->loc.m_group == (group_t *)NULL)
+	return;
+    if (sp->status >= 0 && sp->hdr.h_fp != (FILE *)NULL)
+	(void) msgclose(sp->hdr.h_fp);
+    hfree(&sp->hdr);
+#ifdef NONLOCAL
+    artdone(sp->text);
+#endif /* NONLOCAL */
+    sp->text[0] = '\0';
+    sp->loc.m_group = (group_t *)NULL;
+}
+
+private pfslot_t *pfvictim()
+/* choose a slot to hold the next prefetch */
+{
+    register pfslot_t	*sp, *oldest = pfcache;
+
+    for (sp = pfcache; sp < pfcache + PREFETCH; sp++)
+	if (sp->loc.m_group == (group_t *)NULL)
+	    return(sp);
+	else if (sp->stamp < oldest->stamp)
+	    oldest = sp;
+    return(oldest);
+}
+
+#ifdef BYTHREADS
+private bool pfthread()
+/* in thread mode, seek to the followup msgread() will pick next */
+{
+    char	*cp, *ep, id[NAMELEN];
+
+    if (!session.thread
+	|| (cp = session.cmsg->follow) == (char *)NULL
+	|| (cp = strchr(cp, '<')) == (char *)NULL
+	|| (ep = strchr(cp, '>')) == (char *)NULL
+	|| ep - cp + 1 >= sizeof(id))
+	return(FALSE);
+
+    /* copy the ID, nextchild() in session.c owns the follow list */
+    (void) strncpy(id, cp, ep - cp + 1);
+    id[ep - cp + 1] = '\0';
+    return(msggoto(id) == SUCCEED);
+}
+#endif /* BYTHREADS */
+
+void msgprefetch()
+/* idle function that fetches the next predicted article not yet cached */
+{
+    register pfslot_t	*sp;
+    place_t		oldloc;
+    int			depth;
+
+    /* avoid grinding on missing messages, and don't guess inside the trail */
+    if (header.h_fp == (FILE *)NULL || session.backtrack)
+	return;
+
+    pfclock++;
+    (void) tellmsg(&oldloc);
+    for (depth = 0; depth < PREFETCH; depth++)
+    {
+#ifdef BYTHREADS
+	if (depth > 0 || !pfthread())
+#endif /* BYTHREADS */
+	    if (nextmsg(session.reread, session.reverse) == FAIL)
+		break;
+
+	/* already have it? then mark it wanted and look further ahead */
+	if ((sp = pffind(&active.article)) != (pfslot_t *)NULL)
+	{
+	    sp->stamp = pfclock;
+	    continue;
+	}
+
+	/* one fetch per call keeps us responsive to typeahead */
+	sp = pfvictim();
+	pfrelease(sp);
+	(void) tellmsg(&sp->loc);
+#ifdef NONLOCAL
+	/* ...but the server can be sending the ones after it meanwhile */
+	artahead(&sp->loc);
+	while (++depth < PREFETCH
+	       && nextmsg(session.reread, session.reverse) != FAIL)
+	    if (pffind(&active.article) == (pfslot_t *)NULL)
+		artahead(&active.article);
+#endif /* NONLOCAL */
+	sp->stamp = pfclock;
+	if ((sp->status = getart(&sp->loc, &sp->hdr, sp->text)) < 0)
+	    hfree(&sp->hdr);	/* getart() has closed any file it opened */
+#ifdef DEBUG
+	if (verbose >= V_SHOWPREFETCH)
+	    msg3("prefetch: %s/%ld, status %d",
+		 sp->loc.m_group->ng_name, (long)sp->loc.m_number, sp->status);
+#endif /* DEBUG */
+	break;
+    }
+    (void) seekmsg(&oldloc);
+}
+
+int pfgetart(pl, hd, txt)
+/* get access to an article, using the prefetch cache if we can */
+place_t	*pl;
+hdr_t	*hd;
+char	*txt;
+{
+    register pfslot_t	*sp;
+    int			status;
+
+    if ((sp = pffind(pl)) == (pfslot_t *)NULL)
+    {
+	pfmisses++;
+	return(getart(pl, hd, txt));
+    }
+
+    pfhits++;
+    if ((status = sp->status) >= 0)
+    {
+	hdr_t	empty;
+
+	/* hand the slot's header block and open file over to the caller */
+	if (hd->h_fp)
+	    (void) msgclose(hd->h_fp);
+	hfree(hd);
+#ifdef NONLOCAL
+	artdone(txt);		/* caller is through with its old copy */
+#endif /* NONLOCAL */
+
+	/* swap, so the slot inherits the caller's (now empty) text arena */
+	empty = *hd;
+	*hd = sp->hdr;
+	sp->hdr = empty;
+	(void) strcpy(txt, sp->text);
+	sp->text[0] = '\0';
+    }
+    sp->loc.m_group = (group_t *)NULL;
+
+#ifdef DEBUG
+    if (verbose >= V_SHOWPREFETCH)
+	msg2("prefetch: hit on %s/%ld", pl->m_group->ng_name, (long)pl->m_number);
+#endif /* DEBUG */
+    return(status);
+}
+
+void pfflush()
+/* release all prefetched articles */
+{
+    register pfslot_t	*sp;
+
+    for (sp = pfcache; sp < pfcache + PREFETCH; sp++)
+	pfrelease(sp);
+#ifdef DEBUG
+    if (verbose >= V_SHOWPREFETCH)
+	msg2("prefetch: %ld hits, %ld misses", pfhits, pfmisses);
+#endif /* DEBUG */
+}
+
+#endif /* PREFETCH */
+
+/* prefetch.c ends here */
@@ -49,13 +49,19 @@ to the current article. The msgtext() function arranges access to the article
 text. The msgread() code will close the article file pointer with msgclose()
 at the appropriate times.
 
-   All fetching of article text is done through the function getart(), which
+   All fetching of article text is done through the function getart() (by
+way of the read-ahead cache in prefetch.c if PREFETCH is on), which
 is expected to take three arguments; the address of a place, the address of
 a header block, and the address of a filename buffer. The function is expected
 to load the header block with header information for the given article,
 including the h_fp, h_startoff, h_textoff and h_endoff fields that give the
 reader a real handle on the article text.
 
+   If NEWSFILTER is on, the first visit to a selected group queues all its
+remaining articles to the newsfilter in one batch (see fltqueue() in
+tofilter.c), so the interest scores msgread() wants are usually waiting
+by the time it asks for them.
+
    The public variable 'verbose' controls its level of garrulity about
 unselected or garbled articles.
 
@@ -401,6 +407,31 @@ hdr_t	*hp;
     return(FALSE);
 }
 
+#if defined(NEWSFILTER) && !defined(NONLOCAL)
+private void msgbatch()
+/* ask the filter about the rest of the current group all at once */
+{
+    place_t	pl;
+    char	fn[BUFLEN];
+
+#ifdef CRACKMAIL
+    if (rcflag(RC_MAILBOX))
+	return;
+#endif /* CRACKMAIL */
+    pl.m_group = ngactive();
+    for (pl.m_number = msgnum();
+	 pl.m_number <= ngactive()->ng_max;
+	 pl.m_number++)
+	if (session.reread || !getbit(pl.m_number, ngactive()))
+	{
+	    (void) artname(&pl, fn);
+	    if (fltqueue((char *)NULL, fn, (char *)NULL) == FAIL)
+		break;
+	}
+    (void) fltsend();
+}
+#endif /* defined(NEWSFILTER) && !defined(NONLOCAL) */
+
 int msgtext()
 /* get us access to message text for current article */
 {
@@ -415,7 +446,7 @@ int msgtext()
 #endif /* DEBUG */
 
 	/* fetch article into current session/header block */
-	if ((status = getart(&active.article, &header, session.text)) < 0)
+	if ((status = pfgetart(&active.article, &header, session.text)) < 0)
 	{
 	    (void) arterr(status, &active.article, &header, bfr);
 	    msg1("Fetch failure: %s", bfr);
@@ -463,6 +494,10 @@ int msgread()
 #ifdef NEWSFILTER
 	    if (fltnewsgroup(ngname()) < 0)
 		rcfset(RC_UNSEL);
+#ifndef NONLOCAL
+	    else
+		msgbatch();
+#endif /* NONLOCAL */
 #endif /* NEWSFILTER */
 	}
 
@@ -507,6 +542,9 @@ void msgend()
 #ifdef NEWSFILTER
     (void) fltbye((char *)NULL);
 #endif /* NEWSFILTER */
+#ifdef PREFETCH
+    pfflush();
+#endif /* PREFETCH */
     hstclose();
     clsactive();
 }
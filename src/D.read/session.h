@@ -16,6 +16,7 @@
 #define F_CONDEMN	'-'	/* condemn the current article */
 
 #define RUNCOUNT	/* try to economize on trail storage */
+#define PREFETCH 3	/* articles to read ahead while waiting on keyboard */
 
 /*
  * The trail datum structure.
@@ -111,6 +112,15 @@ extern void msgadd();	/* update groups holding a followup article */
 extern void msgrate();	/* register feedback on an article */
 extern void msgsweep();	/* dump session feedback to the sweep database */
 
+#ifdef PREFETCH
+/* prefetch.c functions */
+extern void msgprefetch();	/* idle-time fetch of a predicted article */
+extern int pfgetart();		/* getart() through the prefetch cache */
+extern void pfflush();		/* release all prefetched articles */
+#else
+#define pfgetart	getart
+#endif /* PREFETCH */
+
 #define msgfile()	session.text
 
 /* session.h ends here */
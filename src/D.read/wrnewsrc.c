@@ -417,13 +417,16 @@ void setsubsc(list)
 char	*list;	/* comma-separated list of groups to subscribe to */
 {
     register group_t	*ngp;
+    ngpat_t		pat;
 
     if (list == (char *)NULL || *list == '\0')
 	return;
 
+    pat = ngcompile(list);
     for (ngp = active.newsgroups; ngp < active.newsgroups + active.ngc; ngp++)
-	if (!ngmatch(ngp->ng_name, list))
+	if (!ngexec(pat, ngp->ng_name))
 	    ngp->rc_flags |= RC_UNSEL;
+    ngfree(pat);
 }
 
 void subscribe()
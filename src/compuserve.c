@@ -322,12 +322,15 @@ static void cpost()
     {
 	static char ngsep[] = {NGDELIM, ' ', '\0'};
 	char forum[IDSIZE],section[IDSIZE],scratch[IDSIZE],parent[IDSIZE],*grp;
+	char nglist[BUFLEN];
 	int fgood;
 
 	header.h_subject[MAXSUBJ] = '\0';	/* CIS is soooo brain-dead! */
 
 	/* there are no 'cross-posts' in the CIS world */
-	grp = strtok(header.h_newsgroups, ngsep);
+	(void) strncpy(nglist, header.h_newsgroups, sizeof(nglist) - 1);
+	nglist[sizeof(nglist) - 1] = '\0';
+	grp = strtok(nglist, ngsep);	/* header text may be shared */
 	do {
 	    bool	isreply;
 	    int		i, nparts, parts[MAXSPLIT + 1];
@@ -534,7 +534,7 @@ char *artbody;
 #ifdef DEBUG
 	    if (!debug)
 #endif /* DEBUG */
-		lock();
+		rlock(R_GROUP, grp->ng_name);
 	    (void) ngreread(grp, NULLPRED);
 #endif /* SPOOLNEWS */
 	
@@ -557,7 +557,7 @@ char *artbody;
 #ifdef DEBUG
 	    if (!debug)
 #endif /* DEBUG */
-		unlock();
+		runlock(R_GROUP, grp->ng_name);
 #endif /* SPOOLNEWS */
 
 	    if (mkmod)
@@ -803,15 +803,18 @@ char **argv;
 	/*
 	 * since the cancel message wants to alter an existing history entry,
 	 * we have to read in the whole history file and lock out other
-	 * instances of inews/rnews and expire until we've written it out
-	 * again, which in practice means waiting till xxit().
+	 * instances of inews/rnews and expire while we change it. This nests
+	 * inside the history lock our poster already holds.
 	 */
-	lock();
+	rlock(R_HISTORY, HISTRES);
 	(void) hstread(TRUE);
 #endif /* ENTRYLOCK */
 
 	/* now write the change to the history array */
 	(void) hstcancel(argv[1]);
+#ifndef ENTRYLOCK
+	runlock(R_HISTORY, HISTRES);
+#endif /* ENTRYLOCK */
     }
 }
 
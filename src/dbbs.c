@@ -114,7 +114,7 @@ FILE	*mailfp;	/* where to put captured mail */
 static void bbspost()
 /* post the article or BBS mail defined by a header */
 {
-    char	c, *cp, *grp;
+    char	c, *cp, *grp, nglist[BUFLEN];
     off_t	linec, ccnt = header.h_endoff - header.h_startoff;
     bool	priv = FALSE;
     static char ngdel[] = {NGDELIM, ' ', '\0'};
@@ -128,7 +128,9 @@ static void bbspost()
     }
 
     /* there are no 'cross-posts' in the DBBS world */
-    grp = strtok(header.h_newsgroups, ngdel);
+    (void) strncpy(nglist, header.h_newsgroups, sizeof(nglist) - 1);
+    nglist[sizeof(nglist) - 1] = '\0';
+    grp = strtok(nglist, ngdel);	/* header text may be shared */
     do {
 	/*
 	 * First, make sure current group is a valid DBBS conference
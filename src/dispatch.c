@@ -14,9 +14,10 @@ description pointed to by its second argument to tell how to transmit the
 article described by its third and fourth args. The maynotify flag enables the
 N option.
    The dispatch() code interprets the F, L and N options. The A, B, C, D, E,
-S, U, and X options are interpreted by transmit(). The B option is used by both
-layers (transmit() needs it to generate the command to be used for remote
-execution).
+S, T, U, and X options are interpreted by transmit(). The B option is used by
+both layers (transmit() needs it to generate the command to be used for remote
+execution). Articles for an unbatched NNTP link (T"nntp") go to transmit()
+straight from the spool, without the compression and encoding filters.
 
 AUTHOR
    Eric S. Raymond
@@ -120,6 +121,10 @@ bool		maynotify;  /* if FALSE, disables N option */
 	}
     }
 
+    /* NNTP peers take the spooled article as it is, and need its ID */
+    if (nntplink(sp))
+	return(transmit(tp, sp, hp->h_ident, fname, FALSE, FALSE) != FAIL);
+
     /* if the N option is active, just send a notification */
     if (notify)
     {
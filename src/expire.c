@@ -17,6 +17,20 @@ NOTE
    If you compile with TMNCONVERT on, explicit expire dates will be ignored.
    If region-locking is used to serialize access to the history database,
 expire can run concurrently with rnews.
+   With -j N, the unlinking and archiving of expired articles is handed off
+to N reaper processes forked after Phase 1, so that many unlinks can be in
+flight at once. Expiry decisions and all history and active-file updates
+stay in the parent. Each group is given to one reaper (by its index in the
+active array), so every article in a directory goes through the same
+process. The parent writes article names down a pipe to each reaper through
+stdio, so they go over in blocks rather than one write per article; each
+reaper sends its unlink statistics back when its pipe is closed, and the
+parent waits for all of them before it starts removing empty directories.
+   History lines written by current versions of rnews and expire -r carry
+the post date and a checksum of the From line (see rdhistory.c), so the -p
+and -f criteria and archiving are normally decided from the history file
+alone. An article file is only opened if its history line is of the older
+kind, or to confirm a -f match when the From checksums agree.
 
 BUGS
    Expire won't use a user's newsrc unless it's in the standard location.
@@ -64,10 +78,13 @@ char *OHISTORY;
 private int	ignorexp, ignorold, noexpire;
 private int	rebuild, usepost, frflag, nosend, convert, fastmode;
 private int	expdays, forgetdays, unlinks_noent, unlinks_failed, hbuilds;
+private int	njobs;
+private int	nreapers;	/* count of reapers actually running */
 private long	expincr, forgetincr;
 private char	arpat[BUFLEN] = "all", ngpat[BUFLEN] = "all";
 private char	baduser[BUFLEN], artfile[BUFLEN];
 private	bool	havehdr = FALSE, dowractive = FALSE;
+private ulong	badsum;		/* checkstring() of the -f argument */
 private time_t	now;
 
 extern int	rdactcount;	/* defined in rdactive.c */
@@ -101,6 +118,27 @@ private expstat *statistics;	/* malloc'ed statistics array */
 private char **ctrllines;	/* the control lines array */
 private int ctlines;		/* number of elements in above */
 
+/* the processes that do unlinks and archiving for -j */
+#define MAXJOBS	16		/* most reapers we'll run */
+
+typedef struct
+{
+    int		pid;		/* the reaper's process ID */
+    FILE	*fp;		/* we write it names of files to reap here */
+    int		rfd;		/* it reports its statistics back here */
+}
+reaper_t;
+
+typedef struct
+{
+    int		noent;		/* unlinks of nonexistent articles */
+    int		failed;		/* unlinks that failed */
+}
+reapstat_t;
+
+private reaper_t reapers[MAXJOBS];
+private bool	reaping = FALSE;	/* TRUE in a reaper process */
+
 private option_t options[] =
 {
 /*
@@ -113,6 +151,7 @@ optlet  filchar	flag	    from    to	    type     buf
 'f',	'\0',	&frflag,    DNC,    DNC,    OPTION,  baduser,
 'F',	'\0',	&fastmode,  DNC,    DNC,    OPTION,  (char *)NULL,
 'i',	'\0',	&ignorold,  DNC,    DNC,    OPTION,  (char *)NULL,
+'j',	 ' ',	&njobs,     DNC,    DNC,    NUMBER,  (char *)NULL,
 'I',	'\0',	&ignorexp,  DNC,    DNC,    OPTION,  (char *)NULL,
 'p',	'\0',	&usepost,   DNC,    DNC,    OPTION,  (char *)NULL,
 'r',	'\0',	&rebuild,   DNC,    DNC,    OPTION,  (char *)NULL,
@@ -130,7 +169,7 @@ int	argc;
 char	**argv;
 {
     forward bool	obsolesce();
-    forward void	cleandirs(), printstats();
+    forward void	cleandirs(), printstats(), startreapers(), stopreapers();
     forward int		build();
     int volatiles = 0;
 
@@ -158,7 +197,7 @@ char	**argv;
     verbose = V_SHOWSTATS;
     if (procopts(argc, argv, DNC, options) == FAIL) {
 	(void) fprintf(stderr,
-		       "Usage: expire [-v [level]] [-eE days ] [-iIarhpusx] [-f user] [-n groups]\n"
+		       "Usage: expire [-v [level]] [-eE days ] [-j jobs] [-iIarhpusx] [-f user] [-n groups]\n"
 		       );
 	exit(1);
     }
@@ -174,6 +213,9 @@ char	**argv;
     if (expdays && forgetdays)
 	xerror0("can't forget things sooner than they expire.");
 
+    if (frflag)
+	badsum = checkstring(baduser, (ulong)0L);
+
     if (expdays)
 	expincr = expdays * DAYS;
 
@@ -376,11 +418,19 @@ char	**argv;
     if (rebuild)
 	(void) textwalk(build);
     else
+    {
+#ifdef DEBUG
+	if (debug)
+	    njobs = 0;		/* nothing gets unlinked anyway */
+#endif /* DEBUG */
+	if (njobs > 0 && !noexpire)
+	    startreapers();
 	while (nextentry())
 	{
 	    (void) artname(&art, artfile);
 	    (void) obsolesce();
 	}
+    }
 
     /*
      * Phase 3. Cleanup time. Adjust minimum-active-number fields 
@@ -417,8 +467,9 @@ char	**argv;
 #endif /* MARKPARENTS */
 
     /*
-     * Phase 5: remove empty spool directories
+     * Phase 5: remove empty spool directories, once the reapers are done
      */
+    stopreapers();
     if (!noexpire)
     {
 	if (verbose >= V_SHOWPHASE)
@@ -462,6 +513,10 @@ group_t	*grnew, *grold;
 
 catch_t xxit(i)
 {
+    /* a reaper just goes away; the parent will notice */
+    if (reaping)
+	_exit(i);
+
     /*
      * If we haven't already locked the news database for exclusive use
      * now is the time to do it. And if we're doing it now, let's reread
@@ -499,6 +554,7 @@ catch_t xxit(i)
 #ifndef ENTRYLOCK
     (void) privunlock();
 #endif /* ENTRYLOCK */
+    lockstats();
 
     if (!nosend && !noexpire && sigcaught != SIGQUIT)
     {
@@ -572,6 +628,18 @@ char	*txtfile;   /* the article file */
     }
 
     (void) msgclose(fp);    /* don't need to see the article text */
+    return(havehdr = TRUE);
+}
+
+private bool postdate(datep)
+/* get the current article's post date, from the history line if we can */
+time_t	*datep;
+{
+    if ((*datep = hstpost()) != (time_t)0)
+	return(TRUE);
+    else if (!gethdr(artfile))
+	return(FALSE);
+    *datep = header.h_posttime;
     return(TRUE);
 }
 
@@ -608,20 +676,22 @@ private bool expired()
 
     /*
      * We need to read the message header if the current expiration date
-     * formula requires looking at the sender or the posting date field.
+     * formula requires looking at the sender or the posting date field,
+     * and the history line doesn't tell us enough. If it carries a From
+     * checksum that doesn't match, this can't be the user we're after.
      */
-    if (frflag || usepost)
-	if (!gethdr(artfile))
-	{
-	    (void) fprintf(stdout,
-		"Expiring %s/%ld (couldn't get header)\n",
-		ngname(), (long)active.article.m_number);
-	    stats->drops.total++;
-	    return(TRUE);
-	}
+    if ((frflag && (!hstpost() || hstfrom() == badsum) && !gethdr(artfile))
+		|| (usepost && !postdate(&creatdat)))
+    {
+	(void) fprintf(stdout,
+	    "Expiring %s/%ld (couldn't get header)\n",
+	    ngname(), (long)active.article.m_number);
+	stats->drops.total++;
+	return(TRUE);
+    }
 
     /* if we're tossing everything posted by a given user, check that */
-    if (frflag && strcmp(baduser,header.h_from) == 0)
+    if (frflag && havehdr && strcmp(baduser,header.h_from) == 0)
     {
 	if (verbose >= V_SHOWACTS)
 	    (void) fprintf(stdout,
@@ -631,10 +701,8 @@ private bool expired()
 	return(TRUE);
     }
 
-    /* compute the creation time of the article */
-    if (usepost)
-	creatdat = header.h_posttime;  /* use the post date from the header */
-    else
+    /* compute the creation time of the article (postdate() did -p) */
+    if (!usepost)
 	creatdat = hstdate();	/* use the 'creation' time of the file */
 
     /* count daily incoming volume */
@@ -697,6 +765,146 @@ private bool expired()
     return(FALSE);
 }
 
+private void reapfile(fn)
+/* unlink an expired article file, counting failures */
+char	*fn;
+{
+    if (unlink(fn) < 0)
+    {
+	unlinks_failed++;
+	if (errno == ENOENT)
+	    unlinks_noent++;
+	logerr2("unlink(%s): %s\n", fn, errmsg(errno));
+    }
+}
+
+private void reap(in, out)
+/* body of a reaper process; unlink or archive each file named on in */
+int	in, out;
+{
+    void	archiveit();
+    FILE	*fp;
+    reapstat_t	rs;
+    char	line[LBUFLEN], fn[LBUFLEN], how;
+    long	adate;
+
+    reaping = TRUE;
+    unlinks_noent = unlinks_failed = 0;
+    if ((fp = fdopen(in, "r")) == (FILE *)NULL)
+	_exit(1);
+    while (fgets(line, sizeof(line), fp) != (char *)NULL)
+	if (sscanf(line, "%c %ld %s", &how, &adate, fn) == 3)
+	{
+	    if (how == 'a')
+		archiveit(fn, (time_t)adate);
+	    reapfile(fn);
+	}
+
+    rs.noent = unlinks_noent;
+    rs.failed = unlinks_failed;
+    (void) write(out, (char *)&rs, sizeof(rs));
+    (void) fflush(stdout);
+    _exit(0);
+}
+
+private void startreapers()
+/* fork off the -j processes that unlink and archive expired articles */
+{
+    register reaper_t	*rp, *op;
+    int			jobs[2], stats[2];
+
+    if (njobs > MAXJOBS)
+	njobs = MAXJOBS;
+    if (verbose >= V_SHOWPHASE)
+	(void) fprintf(stdout, "Starting %d reapers...\n", njobs);
+    (void) fflush(stdout);	/* don't let the children inherit output */
+    (void) fflush(stderr);
+    (void) signal(SIGPIPE, SIGCAST(SIG_IGN));	/* a dead reaper gets logged */
+
+    for (rp = reapers; rp < reapers + njobs; rp++)
+    {
+	if (pipe(jobs) == FAIL)
+	    break;
+	if (pipe(stats) == FAIL)
+	{
+	    (void) close(jobs[0]);
+	    (void) close(jobs[1]);
+	    break;
+	}
+	switch (rp->pid = fork())
+	{
+	case FAIL:
+	    (void) close(jobs[0]);
+	    (void) close(jobs[1]);
+	    (void) close(stats[0]);
+	    (void) close(stats[1]);
+	    break;
+
+	case 0:
+	    /* drop the earlier reapers' pipes, so they'll see EOF */
+	    for (op = reapers; op < rp; op++)
+	    {
+		(void) close(fileno(op->fp));
+		(void) close(op->rfd);
+	    }
+	    (void) close(jobs[1]);
+	    (void) close(stats[0]);
+	    reap(jobs[0], stats[1]);
+	    /*NOTREACHED*/
+
+	default:
+	    (void) close(jobs[0]);
+	    (void) close(stats[1]);
+	    if ((rp->fp = fdopen(jobs[1], "w")) == (FILE *)NULL)
+		xerror0("can't fdopen reaper pipe");
+	    rp->rfd = stats[0];
+	    nreapers++;
+	    break;
+	}
+	if (rp->pid == FAIL)
+	    break;
+    }
+
+    /* if we couldn't start them all, make do with the ones we have */
+    if (nreapers < njobs)
+    {
+	logerr3("started only %d of %d reapers, errno is %d",
+		nreapers, njobs, errno);
+	njobs = nreapers;
+    }
+}
+
+private void stopreapers()
+/* wait for the reapers to finish and collect their statistics */
+{
+    register reaper_t	*rp;
+    reapstat_t		rs;
+    wait_t		status;
+    int			pid;
+
+    if (nreapers <= 0)
+	return;
+
+    /* close all the pipes first so the reapers finish in parallel */
+    for (rp = reapers; rp < reapers + nreapers; rp++)
+	(void) fclose(rp->fp);
+
+    for (rp = reapers; rp < reapers + nreapers; rp++)
+    {
+	if (read(rp->rfd, (char *)&rs, sizeof(rs)) == sizeof(rs))
+	{
+	    unlinks_noent += rs.noent;
+	    unlinks_failed += rs.failed;
+	}
+	else
+	    logerr1("reaper %d died without reporting", rp->pid);
+	(void) close(rp->rfd);
+	while ((pid = wait(&status)) != rp->pid && (pid != FAIL || errno == EINTR))
+	    continue;
+    }
+    njobs = nreapers = 0;
+}
+
 private bool obsolesce()
 /*
  * Return TRUE or FALSE according as the message is/is not obsolete.
@@ -706,6 +914,8 @@ private bool obsolesce()
  */
 {
     void	    archiveit();
+    bool	    archive;
+    time_t	    adate;
 
     /*
      * Skip groups marked unsubscribed in pass 1. Note that this use of
@@ -724,8 +934,8 @@ private bool obsolesce()
 #ifdef DEBUG
 	if (debug)
 	{
-	    if (ngflag(NG_ARCHIVEIT) && gethdr(artfile))
-		archiveit(artfile, header.h_posttime);
+	    if (ngflag(NG_ARCHIVEIT) && postdate(&adate))
+		archiveit(artfile, adate);
 	}
 	else
 #endif /* DEBUG */
@@ -734,16 +944,25 @@ private bool obsolesce()
 	    ngfset(NG_CHANGED);		/* mark current group changed */
 
 	    /* you may want to archive the expired message */
-	    if (ngflag(NG_ARCHIVEIT) && gethdr(artfile))
-		archiveit(artfile, header.h_posttime);
+	    if (archive = (ngflag(NG_ARCHIVEIT) && postdate(&adate)))
+		statistics[active.article.m_group->ng_findex].archived++;
 
-	    /* perform the actual file unlink */
-	    if (unlink(artfile) < 0)
+	    if (njobs > 0)
+	    {
+		/* hand it to the reaper that owns this group */
+		reaper_t *rp = reapers
+			+ (active.article.m_group - active.newsgroups) % njobs;
+
+		(void) fprintf(rp->fp, "%c %ld %s\n",
+			       archive ? 'a' : 'u',
+			       archive ? (long)adate : 0L,
+			       artfile);
+	    }
+	    else
 	    {
-		unlinks_failed++;
-		if (errno == ENOENT)
-		    unlinks_noent++;
-		logerr2("unlink(%s): %s\n", artfile, errmsg(errno));
+		if (archive)
+		    archiveit(artfile, adate);
+		reapfile(artfile);	/* perform the actual file unlink */
 	    }
 	}
 
@@ -1007,6 +1226,7 @@ int	mode;
 
 	/* we need the header for any further actions */
 	(void) artname(&active.article, artfile);
+	havehdr = FALSE;
 	if (!gethdr(artfile))
 	{
 	    logerr1("missing or garbled header on %s", artfile);
@@ -1016,9 +1236,7 @@ int	mode;
 	/* add the history file information */
 	if (header.h_rectime == (time_t)0)
 	    header.h_rectime = modtime(artfile);
-	(void) hstadd(header.h_ident,
-		      header.h_rectime, header.h_exptime,
-		      ngname(), active.article.m_number);
+	(void) hstaddh(&header, ngname(), active.article.m_number);
 	hbuilds++;
 
 	/*
@@ -1082,7 +1300,6 @@ time_t	adate;	/* date to set as last-access time */
 	return;
 #endif
 
-    statistics[active.article.m_group->ng_findex].archived++;
     if (link(fn, bfr) == FAIL)
     {
 	char *lastslash;
@@ -325,7 +325,9 @@ char	*fname;	    /* name of the file to put the text in */
 
 	/* Now allow the user to supply some headers. */
 	(void) hread(&header, 0L, stdin);
-	lcase(header.h_newsgroups);
+	(void) strcpy(bfr, header.h_newsgroups);	/* it may be shared */
+	lcase(bfr);
+	(void) hlcpy(header.h_newsgroups, bfr);
 
 	/* force the From: line into canonical form */
 	if (hlnblank(header.h_from))
@@ -46,8 +46,6 @@ of protecting free redistribution; see the LICENSE file for details.
 #include "newsrc.h"
 #endif /* LEAFNODE */
 
-#undef FEEDBITS
-
 /* verbosity level minima for various messages */
 #define V_INSERT	1	/* report on each local insertion */
 
@@ -270,7 +268,7 @@ group_t	*gp;		/* where to post the article to */
     if (ngflag(NG_COMPRESSED))
 	(void) unlink(CMPART);
 
-    (void) hstadd(hp->h_ident,hp->h_rectime,hp->h_exptime,gp->ng_name,newart);
+    (void) hstaddh(hp, gp->ng_name, newart);
 
     if (verbose >= V_INSERT)
 	(void) printf("tolocal: %s to %s/%ld\n",
@@ -498,7 +496,6 @@ bool	originator;
 		    mk_flexgroup(dest->d_name, header.h_approved);
 		    dest->d_status = D_OK;
 		    (void) strcpy(bfr, dest->d_name);
-		    (void) free(dest->d_name);
 		    dest->d_name = NULL;
 		    dest->d_ptr = ngfind(bfr);
 		}
@@ -517,11 +514,10 @@ bool	originator;
 			    *cp = '\0';
 			else
 			{
-			    (void) free(dest->d_name);
 			    dest->d_ptr = ngp;
-			    (void) free(dest->d_name);
+			    dest->d_status = D_OK;
 			    dest->d_name = NULL;
-			    dest->d_ptr = ngp;
+			    break;
 			}
 		    }
 
@@ -551,7 +547,8 @@ bool	originator;
 
 #ifdef FEEDBITS
 	    /* don't localize crossposts to groups we don't accept */
-	    if (ngfeed(ngactive(), 0) && !ngfeed(ngactive(), s_tell(self)))
+	    if (ngfeedok(ngactive(), s_tell(self))
+			&& !ngfeed(ngactive(), s_tell(self)))
 		continue;
 #endif /* FEEDBITS */
 
@@ -250,13 +250,18 @@ group_t	*ngp;
 		);
 
     /* next, display miscellaneous other .newsrc-derived fields */
-    (void) printf(
 #ifdef FEEDBITS
-	" (feeds 0x%2x, index %ld, %d unread)%c",
-	ngp->ng_feeds,
-#else
-	" (index %ld, %d unread, 0x%2x)%c",
+    if (ngfeedok(ngp, 0))
+    {
+	int	i;
+
+	(void) fputs(" (feeds 0x", stdout);
+	for (i = feedmap.nwords - 1; i >= 0; i--)
+	    (void) printf("%0*lx", (int)FWBITS / 4, ngfeeds(ngp)[i]);
+	(void) fputc(')', stdout);
+    }
 #endif /* FEEDBITS */
+    (void) printf(" (index %ld, %d unread, 0x%2x)%c",
 	(long)ngp->rc_lindex, ngp->ng_unread,
 	ngp->rc_seen ? ngp->rc_seen[0] : 0,
 	(ngp->rc_flags & RC_UNSUB) ? UNSUBSCMK : SUBSCMK
@@ -936,7 +941,11 @@ char	*cmdline;
     {
 	if (active.article.m_group == (group_t *)NULL)
 	    debuginit(I_RDACTIVE);
-	feedbits();
+	if (feedbits() == FAIL)
+	    (void) printf("Couldn't set up the feed bitsets\n");
+	else
+	    (void) printf("Feed bitsets set up for %d groups, %d feeds\n",
+			  feedmap.ngroups, feedmap.nfeeds);
     }
 #endif /* FEEDBITS */
     else if (sscanf(cmdline, "a %s %s", strv, strv2) == 2)
@@ -961,7 +970,7 @@ char	*cmdline;
 	(void) printf("f grp dist  -- dist.grp accepted for feed?\n");
 	(void) printf("o opt       -- value of option on current system\n");
 #ifdef FEEDBITS
-	(void) printf("F           -- load cached feed bits\n");
+	(void) printf("F           -- load or compute feed bitsets\n");
 #endif /* FEEDBITS */
 	(void) printf("a site grp  -- add subscription to given site\n");
 	(void) printf("d site grp  -- delete subscription from given site\n");
@@ -0,0 +1,715 @@
+/*****************************************************************************
+
+NAME
+   nntprecv.c - accept streaming news feeds from NNTP peers
+
+SYNOPSIS
+   main(argc, argv)		-- main sequence of nntprecv
+   int argc; char **argv;
+
+   catch_t xxit(status)		-- exit the program, cleaning up all locks
+   int status;
+
+DESCRIPTION
+   This program is a transit-only NNTP server. Peers offer it articles with
+IHAVE (RFC 977) or with the streaming CHECK and TAKETHIS commands (after MODE
+STREAM), and the accepted ones go straight into the local article tree through
+post() and insert(), just as if they had come out of a batch given to rnews.
+There is no batch file in between; each article is written to a work file in
+TEXT/.tmp as it arrives and handed over as soon as its terminating dot is
+seen.
+
+   Offers are checked against the history file in the command handler, so a
+peer is told not to send an article we have (438 to CHECK, 435 to IHAVE)
+without the article crossing the wire. An article one peer has been told to
+send is held in an in-flight table until it arrives, and offers of it from
+other peers meanwhile get 431 (try again later). Articles received with
+TAKETHIS are read in any case, and answered with 239 if they were accepted
+and 439 if not; IHAVE transfers get 235 or 437. An article counts as accepted
+if post() left its Message-ID in the history file.
+
+   Several connections are served at once by a single process, which waits
+for input on all of them (and on the listening socket) with select(2) and
+processes whatever complete command lines and article text each one has
+sent. Responses to a peer's pipelined commands are collected and sent back
+in one write.
+
+   Each article is posted under the history lock (see rlock() in lock.c),
+and post() locks the active line of each group it numbers the article in,
+so local posting, rnews runs and sendbatch get in between articles even while
+peers stay connected. If SPOOLNEWS is on the active data is kept in core
+instead, and as with an rnews daemon the whole database is locked while at
+least one peer is connected, and released after the active file is written
+back when the last one goes away. Connections to downstream NNTP links (see
+nntpfeed.c) are drained and closed when the last peer leaves.
+
+OPTIONS
+   -p port	-- listen on the given TCP port (default NNTPPORT)
+   -l		-- listen on the loopback address only, for testing
+   -i		-- serve one connection on stdin/stdout (for inetd)
+   -x list	-- don't retransmit to the listed systems
+   -v level	-- verbosity level
+
+   A test feed can be run through a loopback listener on an unprivileged
+port, say "nntprecv -l -p 1119", by connecting to port 1119 on localhost and
+typing or piping in NNTP commands.
+
+FILES
+   TEXT/.tmp/nrecv??????	-- work file for an article being received
+   ADM/log			-- event log file
+   ADM/errlog			-- error event log file
+
+BUGS
+   Without BSD4_2 sockets only the -i mode is available.
+   A peer that stops reading our responses can stall the other connections,
+since responses are written with blocking writes.
+
+SEE ALSO
+   rnews.c	-- the batch-oriented way of getting articles in
+   post.c	-- the posting code nntprecv hands articles to
+
+AUTHORS
+   Eric S. Raymond
+   This software is Copyright (C) 1989 by Eric S. Raymond for the sole purpose
+of protecting free redistribution; see the LICENSE file for details.
+
+*****************************************************************************/
+/*LINTLIBRARY*/
+#include "news.h"
+#include "libpriv.h"
+#include "header.h"
+#include "procopts.h"
+#include "active.h"
+#include "history.h"
+#include "post.h"
+#include "nntp.h"
+
+#ifdef BSD4_2
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#endif /* BSD4_2 */
+
+#define NROPTFORM   "usage: nntprecv [-il] [-p port] [-v level] [-x nosend]\n"
+
+#define NNTPPORT	119	/* default port to listen on */
+#define MAXCONN		16	/* most peers served at once */
+#define INFLIGHT	256	/* most articles peers have been asked for */
+#define CBUFSIZ		8192	/* per-connection input and output buffers */
+
+/* verbosity level minima for various messages */
+#define V_SHOWCONN	1	/* log connections and their totals */
+#define V_SHOWCMD	3	/* log each command received */
+
+extern void postinit();		/* pacify lint -- there's no insert.h */
+
+char	*Progname = "nntprecv";	/* so xerror identifies failing program */
+
+typedef struct
+{
+    int		rfd, wfd;	/* descriptors, rfd is FAIL if slot free */
+    char	peer[SBUFLEN];	/* who's at the other end */
+    bool	intext;		/* reading article text, not commands? */
+    bool	midline;	/* in the middle of an overlong text line? */
+    int		how;		/* IHAVE or TAKETHIS, for the text */
+    char	id[NAMELEN];	/* Message-ID the text is supposed to have */
+    char	work[BUFLEN];	/* name of the article work file */
+    FILE	*afp;		/* the work file, open while intext */
+    char	ibuf[CBUFSIZ];	/* input not yet processed */
+    int		ilen;
+    char	obuf[CBUFSIZ];	/* responses not yet sent */
+    int		olen;
+    long	accepted, rejected, refused;
+}
+conn_t;
+
+/* the commands a connection can be reading text for */
+#define C_IHAVE		1
+#define C_TAKETHIS	2
+
+typedef struct
+{
+    char	id[NAMELEN];	/* Message-ID we asked for */
+    conn_t	*from;		/* who we asked, NULL if slot free */
+}
+flight_t;
+
+/* things only nntprecv.c needs to see */
+private int	port = NNTPPORT;	/* TCP port to listen on */
+private int	iflag, lflag;		/* inetd and loopback modes */
+private int	quitsig = 0;		/* we received a signal to quit */
+private int	locked = 0;		/* are we set up for a busy spell? */
+private conn_t	conns[MAXCONN];
+private int	nconns;
+private flight_t flights[INFLIGHT];
+
+private option_t recvopts[] =
+{ /*
+opt  filchar flag     from to	buf     meaning   */
+'p', '\0',   &port,   DNC, DNC,	NUMBER, (char *)NULL,	/* listen port */
+'l', '\0',   &lflag,  DNC, DNC,	OPTION, (char *)NULL,	/* loopback only */
+'i', '\0',   &iflag,  DNC, DNC,	OPTION, (char *)NULL,	/* inetd mode */
+'v', '\0',   &verbose,DNC, DNC,	NUMBER, (char *)NULL,	/* verbosity level */
+'x', '\0',   (int*)0, DNC, DNC,	STRING,	nosend,		/* suppress send to */
+#ifdef DEBUG
+'D', '\0',   &debug,  DNC, DNC, NUMBER, (char *)NULL,	/* debug mode */
+#endif /* DEBUG */
+'\0','\0',   (int*)0, 0,    0,	0,      (char *)NULL
+};
+
+static catch_t catcher()
+{
+    quitsig++;
+}
+
+/*
+ * Locking and release of the news database
+ */
+
+private void recvbegin()
+/* get the news database ready when the first peer connects */
+{
+    static bool	ready = FALSE;
+
+    if (locked)
+	return;
+#if defined(SPOOLNEWS) && !defined(ENTRYLOCK)
+    lock();			/* the active data lives in core till recvend() */
+#endif /* defined(SPOOLNEWS) && !defined(ENTRYLOCK) */
+    locked++;
+    if (!ready)
+    {
+	(void) hstread(TRUE);
+	(void) rdactive(NULLPRED);
+	(void) rdflags(NG_COMPRESSED | NG_GETDIST);
+	postinit();
+	ready = TRUE;
+    }
+    else
+	(void) rdactive(NULLPRED);	/* pick up others' changes */
+}
+
+private void recvend()
+/* wind up a busy spell when the last peer leaves */
+{
+    if (!locked)
+	return;
+    nntpfdone((char *)NULL);	/* finish relaying to NNTP links */
+#ifdef SPOOLNEWS
+    wractive(TRUE);
+#ifndef ENTRYLOCK
+    unlock();
+#endif /* ENTRYLOCK */
+#endif /* SPOOLNEWS */
+    lockstats();
+    logflush();			/* don't hold records while we're idle */
+    locked = 0;
+}
+
+/*
+ * The in-flight table
+ */
+
+private flight_t *flightfind(id)
+/* find the in-flight entry for an ID, if there is one */
+char	*id;
+{
+    register flight_t	*fp;
+
+    for (fp = flights; fp < flights + INFLIGHT; fp++)
+	if (fp->from != (conn_t *)NULL && strcmp(fp->id, id) == 0)
+	    return(fp);
+    return((flight_t *)NULL);
+}
+
+private void flightadd(id, cp)
+/* note that a peer has been told to send an article */
+char	*id;
+conn_t	*cp;
+{
+    register flight_t	*fp;
+
+    for (fp = flights; fp < flights + INFLIGHT; fp++)
+	if (fp->from == (conn_t *)NULL)
+	{
+	    (void) strcpy(fp->id, id);
+	    fp->from = cp;
+	    return;
+	}
+    /* table full -- we just won't catch duplicate offers of this one */
+}
+
+private void flightdrop(id, cp)
+/* clear in-flight entries for an ID, or for everything a peer was sending */
+char	*id;
+conn_t	*cp;
+{
+    register flight_t	*fp;
+
+    for (fp = flights; fp < flights + INFLIGHT; fp++)
+	if (fp->from != (conn_t *)NULL
+		&& (id != (char *)NULL ? strcmp(fp->id, id)==0 : fp->from==cp))
+	    fp->from = (conn_t *)NULL;
+}
+
+/*
+ * Connection management
+ */
+
+private void reply(cp, code, text)
+/* queue a response line for a peer */
+conn_t	*cp;
+int	code;
+char	*text;
+{
+    char	line[NNTP_STRLEN + 8];
+
+    (void) sprintf(line, "%d %.*s\r\n", code, NNTP_STRLEN - 8, text);
+    if (cp->olen + strlen(line) > sizeof(cp->obuf))
+    {
+	(void) write(cp->wfd, cp->obuf, (iolen_t)cp->olen);
+	cp->olen = 0;
+    }
+    (void) strcpy(cp->obuf + cp->olen, line);
+    cp->olen += strlen(line);
+}
+
+private void replyflush(cp)
+/* send all queued responses to a peer */
+conn_t	*cp;
+{
+    if (cp->olen > 0)
+	(void) write(cp->wfd, cp->obuf, (iolen_t)cp->olen);
+    cp->olen = 0;
+}
+
+private conn_t *connopen(rfd, wfd, peer)
+/* set up a slot for a new connection */
+int	rfd, wfd;
+char	*peer;
+{
+    register conn_t	*cp;
+
+    for (cp = conns; cp < conns + MAXCONN; cp++)
+	if (cp->rfd == FAIL)
+	    break;
+    if (cp >= conns + MAXCONN)
+	return((conn_t *)NULL);
+
+    (void) bzero((char *)cp, sizeof(conn_t));
+    cp->rfd = rfd;
+    cp->wfd = wfd;
+    (void) strncpy(cp->peer, peer, sizeof(cp->peer) - 1);
+    (void) sprintf(cp->work, "%s/.tmp/nrecvXXXXXX", site.textdir);
+    (void) mktemp(cp->work);
+
+    if (nconns++ == 0)
+	recvbegin();
+    if (verbose >= V_SHOWCONN)
+	log1("connection from %s", cp->peer);
+    (void) sprintf(bfr, "%s news transit service ready", site.truename);
+    reply(cp, OK_NOPOST, bfr);
+    replyflush(cp);
+    return(cp);
+}
+
+private void connclose(cp)
+/* shut down a connection and free its slot */
+conn_t	*cp;
+{
+    replyflush(cp);
+    if (cp->afp != (FILE *)NULL)
+	(void) fclose(cp->afp);
+    (void) unlink(cp->work);
+    flightdrop((char *)NULL, cp);
+    (void) close(cp->rfd);
+    if (cp->wfd != cp->rfd)
+	(void) close(cp->wfd);
+    cp->rfd = FAIL;
+
+    log4("%s: %ld accepted, %ld rejected, %ld refused",
+	 cp->peer, cp->accepted, cp->rejected, cp->refused);
+    if (--nconns == 0)
+	recvend();
+}
+
+/*
+ * Command and article processing
+ */
+
+private bool wanted(id)
+/* do we want the article with this ID? */
+char	*id;
+{
+    switch (hstseek(id, FALSE))
+    {
+    case SUCCEED:
+    case CANCELLED:
+    case EXPIRED:
+	return(FALSE);
+    default:		/* not there, or only as an unreceived parent */
+	return(TRUE);
+    }
+}
+
+private void textbegin(cp, how, id)
+/* get ready to receive the text of an article */
+conn_t	*cp;
+int	how;
+char	*id;
+{
+    cp->how = how;
+    (void) strcpy(cp->id, id);
+    cp->midline = FALSE;
+    if ((cp->afp = fopen(cp->work, "w+")) == (FILE *)NULL)
+	logerr2("can't create %s, errno %d", cp->work, errno);
+    cp->intext = TRUE;
+}
+
+private void textend(cp)
+/* post an article whose text is all in */
+conn_t	*cp;
+{
+    bool	ok = FALSE;
+
+    cp->intext = FALSE;
+    if (cp->afp != (FILE *)NULL)
+    {
+	(void) fflush(cp->afp);
+	rewind(cp->afp);
+	hfree(&header);
+	if (hread(&header, 0L, cp->afp) == 0)
+	    logerr2("%s: garbled header on %s", cp->peer, cp->id);
+	else if (strcmp(header.h_ident, cp->id) != 0)
+	    logerr3("%s: offered %s, sent %s", cp->peer, cp->id,header.h_ident);
+	else if (cp->how == C_TAKETHIS && !wanted(cp->id))
+	    log2("%s: %s sent after all", cp->peer, cp->id);
+	else
+	{
+	    (void) fseek(cp->afp, 0L, SEEK_END);
+	    header.h_endoff = ftell(cp->afp);
+	    (void) fseek(cp->afp, header.h_textoff, SEEK_SET);
+#if !defined(SPOOLNEWS) && !defined(ENTRYLOCK)
+	    rlock(R_HISTORY, HISTRES);	/* just for this article */
+#endif /* !defined(SPOOLNEWS) && !defined(ENTRYLOCK) */
+	    post();
+	    ok = (hstseek(cp->id, FALSE) == SUCCEED);
+#if !defined(SPOOLNEWS) && !defined(ENTRYLOCK)
+	    runlock(R_HISTORY, HISTRES);
+#endif /* !defined(SPOOLNEWS) && !defined(ENTRYLOCK) */
+	}
+	(void) fclose(cp->afp);
+	cp->afp = (FILE *)NULL;
+    }
+    flightdrop(cp->id, cp);
+
+    if (ok)
+	cp->accepted++;
+    else
+	cp->rejected++;
+    if (cp->how == C_TAKETHIS)
+	reply(cp, ok ? OK_TAKETHIS : ERR_TAKETHIS, cp->id);
+    else
+	reply(cp, ok ? OK_XFERED : ERR_XFERRJCT, ok ? "thanks" : "rejected");
+}
+
+private void textline(cp, line, len, whole)
+/* accept a line (or piece of one) of article text */
+conn_t	*cp;
+char	*line;
+int	len;
+bool	whole;	/* did we see the end of the line? */
+{
+    if (!cp->midline && line[0] == '.')
+    {
+	if (len == 1 && whole)
+	{
+	    textend(cp);
+	    return;
+	}
+	line++, len--;		/* undo dot-stuffing */
+    }
+    if (cp->afp != (FILE *)NULL)
+    {
+	(void) fwrite(line, sizeof(char), (iolen_t)len, cp->afp);
+	if (whole)
+	    (void) putc('\n', cp->afp);
+    }
+    cp->midline = !whole;
+}
+
+private bool command(cp, line)
+/* interpret a command line from a peer, return FALSE to drop it */
+conn_t	*cp;
+char	*line;
+{
+    char	verb[SBUFLEN], *arg, *ep;
+    int		n;
+
+#ifdef DEBUG
+    if (verbose >= V_SHOWCMD)
+	log2("%s: %s", cp->peer, line);
+#endif /* DEBUG */
+
+    for (n = 0; line[n] && !isspace(line[n]) && n < sizeof(verb) - 1; n++)
+	verb[n] = line[n];
+    verb[n] = '\0';
+    lcase(verb);
+    for (arg = line + n; isspace(*arg); arg++)
+	continue;
+    for (ep = arg; *ep && !isspace(*ep); ep++)
+	continue;
+    *ep = '\0';
+
+    if (strcmp(verb, "quit") == 0)
+    {
+	reply(cp, OK_GOODBYE, "closing connection");
+	return(FALSE);
+    }
+    else if (strcmp(verb, "mode") == 0)
+    {
+	lcase(arg);
+	if (strcmp(arg, "stream") == 0)
+	    reply(cp, OK_STREAM, "streaming OK");
+	else
+	    reply(cp, ERR_ACCESS, "transit service only");
+    }
+    else if (strcmp(verb, "ihave") == 0 || strcmp(verb, "check") == 0)
+    {
+	bool	ihave = (verb[0] == 'i');
+
+	if (arg[0] != '<' || strlen(arg) >= NAMELEN)
+	    reply(cp, ERR_CMDSYN, "bad Message-ID");
+	else if (!wanted(arg))
+	{
+	    cp->refused++;
+	    reply(cp, ihave ? ERR_GOTIT : ERR_NOCHECK, arg);
+	}
+	else if (flightfind(arg) != (flight_t *)NULL)
+	{
+	    cp->refused++;
+	    reply(cp, ihave ? ERR_XFERFAIL : ERR_CHECKLATER, arg);
+	}
+	else
+	{
+	    flightadd(arg, cp);
+	    if (ihave)
+	    {
+		reply(cp, CONT_XFER, "send it");
+		textbegin(cp, C_IHAVE, arg);
+	    }
+	    else
+		reply(cp, OK_CHECK, arg);
+	}
+    }
+    else if (strcmp(verb, "takethis") == 0)
+    {
+	/* we must read the text whatever we think of the ID */
+	if (strlen(arg) >= NAMELEN)
+	    arg[NAMELEN - 1] = '\0';
+	textbegin(cp, C_TAKETHIS, arg);
+    }
+    else
+	reply(cp, ERR_COMMAND, "command not recognized");
+    return(TRUE);
+}
+
+private bool connread(cp)
+/* handle input from a peer, return FALSE if it has gone away */
+conn_t	*cp;
+{
+    register char	*lp, *nl;
+    char		*end;
+    int			n;
+
+    if ((n = read(cp->rfd, cp->ibuf + cp->ilen,
+		  (iolen_t)(sizeof(cp->ibuf) - cp->ilen))) <= 0)
+	return(FALSE);
+    cp->ilen += n;
+    end = cp->ibuf + cp->ilen;
+
+    for (lp = cp->ibuf; lp < end; lp = nl + 1)
+    {
+	for (nl = lp; nl < end && *nl != '\n'; nl++)
+	    continue;
+	if (nl >= end)
+	    break;
+	n = nl - lp;
+	if (n > 0 && lp[n - 1] == '\r')
+	    n--;
+	if (cp->intext)
+	    textline(cp, lp, n, TRUE);
+	else
+	{
+	    lp[n] = '\0';
+	    if (!command(cp, lp))
+		return(FALSE);
+	}
+    }
+
+    /* keep any partial line, unless it has filled the whole buffer */
+    if (lp == cp->ibuf && cp->ilen == sizeof(cp->ibuf))
+    {
+	if (cp->intext)
+	    textline(cp, lp, cp->ilen, FALSE);
+	else
+	    reply(cp, ERR_CMDSYN, "line too long");
+	cp->ilen = 0;
+    }
+    else
+    {
+	for (nl = cp->ibuf; lp < end; )
+	    *nl++ = *lp++;
+	cp->ilen = nl - cp->ibuf;
+    }
+    replyflush(cp);
+    return(TRUE);
+}
+
+#ifdef BSD4_2
+private int listener()
+/* set up the socket peers connect to */
+{
+    struct sockaddr_in	sin;
+    int			s, on = 1;
+
+    if ((s = socket(AF_INET, SOCK_STREAM, 0)) < 0)
+	xerror1("can't create socket, errno %d", errno);
+    (void) setsockopt(s, SOL_SOCKET, SO_REUSEADDR, (char *)&on, sizeof(on));
+    (void) bzero((char *)&sin, sizeof(sin));
+    sin.sin_family = AF_INET;
+    sin.sin_port = htons((u_short)port);
+    sin.sin_addr.s_addr = htonl(lflag ? INADDR_LOOPBACK : INADDR_ANY);
+    if (bind(s, (struct sockaddr *)&sin, sizeof(sin)) < 0)
+	xerror2("can't bind port %d, errno %d", port, errno);
+    if (listen(s, 5) < 0)
+	xerror1("can't listen, errno %d", errno);
+    return(s);
+}
+
+private void newconn(s)
+/* accept a connection waiting on the listening socket */
+int	s;
+{
+    struct sockaddr_in	sin;
+    int			fd, len = sizeof(sin);
+
+    if ((fd = accept(s, (struct sockaddr *)&sin, &len)) < 0)
+	return;
+    if (connopen(fd, fd, inet_ntoa(sin.sin_addr)) == (conn_t *)NULL)
+    {
+	(void) sprintf(bfr, "%d too many connections, try later\r\n",
+		       ERR_GOODBYE);
+	(void) write(fd, bfr, (iolen_t)strlen(bfr));
+	(void) close(fd);
+    }
+}
+#endif /* BSD4_2 */
+
+private void recvloop(s)
+/* serve peers until told to stop */
+int	s;	/* listening socket, FAIL in inetd mode */
+{
+    register conn_t	*cp;
+#ifdef BSD4_2
+    fd_set		ready;
+    int			maxfd;
+#endif /* BSD4_2 */
+
+    while (!quitsig && (s != FAIL || nconns > 0))
+    {
+#ifdef BSD4_2
+	FD_ZERO(&ready);
+	maxfd = s;
+	if (s != FAIL)
+	    FD_SET(s, &ready);
+	for (cp = conns; cp < conns + MAXCONN; cp++)
+	    if (cp->rfd != FAIL)
+	    {
+		FD_SET(cp->rfd, &ready);
+		if (cp->rfd > maxfd)
+		    maxfd = cp->rfd;
+	    }
+	if (select(maxfd + 1, &ready, (fd_set *)NULL, (fd_set *)NULL,
+		   (struct timeval *)NULL) < 0)
+	    continue;		/* probably a signal */
+
+	if (s != FAIL && FD_ISSET(s, &ready))
+	    newconn(s);
+#endif /* BSD4_2 */
+	for (cp = conns; cp < conns + MAXCONN; cp++)
+	    if (cp->rfd != FAIL
+#ifdef BSD4_2
+			&& FD_ISSET(cp->rfd, &ready)
+#endif /* BSD4_2 */
+			&& !connread(cp))
+		connclose(cp);
+    }
+}
+
+main(argc, argv)
+int	argc;
+char	**argv;
+{
+#if defined(SHARED) || defined(NONLOCAL)
+    xerror0("nntprecv must run on the news host itself");
+#else
+    register conn_t	*cp;
+    int			s = FAIL;
+
+    if (procopts(argc, argv, 0, recvopts) == FAIL)
+    {
+	(void) fputs(NROPTFORM, stderr);
+	exit(1);
+	/*NOTREACHED*/
+    }
+
+    newsinit();
+#ifdef DEBUG
+    if (!debug)
+#endif /* DEBUG */
+	loginit();
+    logbuffer(TRUE);
+
+    for (cp = conns; cp < conns + MAXCONN; cp++)
+	cp->rfd = FAIL;
+    (void) signal(SIGHUP, catcher);
+    (void) signal(SIGINT, catcher);
+    (void) signal(SIGTERM, catcher);
+    (void) signal(SIGPIPE, SIG_IGN);
+
+    if (iflag)
+	(void) connopen(fileno(stdin), fileno(stdout), "stdin");
+    else
+    {
+#ifdef BSD4_2
+	s = listener();
+	log1("listening on port %d", port);
+#else
+	xerror0("no sockets here, use -i under inetd");
+#endif /* BSD4_2 */
+    }
+
+    recvloop(s);
+
+    for (cp = conns; cp < conns + MAXCONN; cp++)
+	if (cp->rfd != FAIL)
+	{
+	    reply(cp, ERR_GOODBYE, "server shutting down");
+	    connclose(cp);
+	}
+    xxit(0);
+    /*NOTREACHED*/
+#endif /* defined(SHARED) || defined(NONLOCAL) */
+}
+
+catch_t xxit(status)
+/* exit and cleanup */
+int status;
+{
+    recvend();
+    logflush();
+    exit(status);
+}
+
+/* nntprecv.c ends here */
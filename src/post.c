@@ -22,6 +22,12 @@ Mailtomod() extracts post addresses of moderated groups and sends the article
 to them. The fourth function, broadcast(), transmits the article to all
 neighbor systems.
 
+   Storage that lives only as long as the article does is allocated from
+artregion (see ngprep.c), and post() releases it all in one rgreset() when
+the article is done. If DEBUG is on and verbose is at least V_SHOWALLOC, the
+count and total size of the allocations made for each article, in artregion
+and in its header's text arena, are logged first.
+
 FILES
    TEXT/.tmp/news??????	-- temp file used to store incoming article(s)
 
@@ -46,6 +52,7 @@ of protecting free redistribution; see the LICENSE file for details.
 #include "feeds.h"
 #include "active.h"
 #include "history.h"
+#include "region.h"
 #include "ngprep.h"
 #include "post.h"
 #include "fascist.h"	/* for getgrplist() declaration */
@@ -56,6 +63,7 @@ private feed_t target;
 
 /* verbosity level minima for various messages */
 #define V_SHOWHEADERS	7	/* dump headers as they're processed */
+#define V_SHOWALLOC	4	/* report per-article allocation statistics */
 
 /* rnews options processing may set this */
 char	nosend[BUFLEN];		/* list of systems not to xmit to */
@@ -79,7 +87,7 @@ char	*f;
 
 #endif /* DEBUG */
 
-void post()
+private void postart()
 /* post the article described by the current header to the right places */
 {
     forward void	mailtomod(), broadcast();
@@ -261,9 +269,24 @@ void post()
 #ifdef OLDSTYLE
 	    log2("%s from %s", header.h_ident, header.h_from);
 #else
-	log4("art %s dist %s ng %s path %s",
-	     header.h_ident, header.h_distribution,
-	     header.h_newsgroups,header.h_path);
+	{
+	    char	num[SBUFLEN];
+
+	    /* tag the record with size, propagation delay and fingerprint */
+	    if (header.h_intnumlines > 0)
+	    {
+		(void) sprintf(num, "%d", header.h_intnumlines);
+		logfield("lines", num);
+	    }
+	    (void) sprintf(num, "%ld",
+			   (long)(header.h_rectime - header.h_posttime));
+	    logfield("age", num);
+	    if (header.h_bodysum[0])
+		logfield("body", header.h_bodysum);
+	    log4("art %s dist %s ng %s path %s",
+		 header.h_ident, header.h_distribution,
+		 header.h_newsgroups,header.h_path);
+	}
 #endif /* OLDSTYLE */
     }
 
@@ -373,6 +396,29 @@ void post()
     (void) unlink(ARTICLE);
 }
 
+void post()
+/* post an article, then release the storage it used */
+{
+    if (artregion == (region_t *)NULL)
+	artregion = rgnew(LBUFLEN);
+
+    postart();
+
+#ifdef DEBUG
+    if (verbose >= V_SHOWALLOC)
+    {
+	region_t	*hs = header.h_store;
+
+	log4("alloc %s: %ld allocs, %ld bytes, header %ld bytes",
+	     header.h_ident,
+	     artregion->rg_allocs + (hs ? hs->rg_allocs : 0L),
+	     artregion->rg_bytes + (hs ? hs->rg_bytes : 0L),
+	     hs ? hs->rg_bytes : 0L);
+    }
+#endif /* DEBUG */
+    rgreset(artregion);
+}
+
 private void broadcast(hp, fname)
 /* transmit this article to all interested systems */
 hdr_t	*hp;		/* header of the message */
@@ -316,6 +316,9 @@ char	**argv;
 	rnews_daemon();
 #endif /* UNIX */
 
+    /* we log several records per article, so don't write them one by one */
+    logbuffer(TRUE);
+
     if (!Pflag)
 	privileged = 0;	/* Turn off privileged mode */
 
@@ -375,10 +378,18 @@ char	**argv;
      * no need to do exclusions here. Otherwise we have to lock out other
      * instances of inews/rnews until history data is written out again
      * which in turn implies that we need signal protection to guarantee that
-     * unlock() gets done.
+     * runlock() gets done. The history lock is all we need for that; each
+     * group's active line is locked by ngnewart() as articles go in, so
+     * sendbatch and other group updates aren't held up for the whole run.
+     * A spool daemon keeps the active data in core, though, and has to
+     * lock out the world.
      */
+#ifdef SPOOLNEWS
     lock();
-#endif /* LOCKF */
+#else
+    rlock(R_HISTORY, HISTRES);
+#endif /* SPOOLNEWS */
+#endif /* ENTRYLOCK */
     (void) hstread(TRUE);
 
 #ifdef DEBUG
@@ -433,7 +444,7 @@ char	**argv;
 	 * much cheaper.
 	 */
 	if (feedbits() == FAIL)   /* set up cached subscription bits */
-	    logerr0("Feed bitmaps file was corrupted!");
+	    logerr0("No room for feed bitsets, matching feeds the slow way");
 #endif /* FEEDBITS */
 
 	/* process each file in the directory */
@@ -526,6 +537,7 @@ int status;
     }
     if (outfd)
 	(void) close(outfd);	/* this is not strictly necessary */
+    nntpfdone((char *)NULL);	/* finish streaming to NNTP links */
 #ifdef SPOOLNEWS
     if (wractonexit)
 	    wractive(TRUE);
@@ -534,8 +546,14 @@ int status;
 #ifdef DEBUG
     if (!debug)
 #endif /* DEBUG */
+#ifdef SPOOLNEWS
 	unlock();
+#else
+	runlock(R_HISTORY, HISTRES);
+#endif /* SPOOLNEWS */
 #endif /* ENTRYLOCK */
+    lockstats();		/* report any lock contention */
+    logflush();
 #ifdef PROFILE
     chdir(site.libdir);
     {
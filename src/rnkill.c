@@ -10,6 +10,11 @@ DESCRIPTION
    This code builds on the lnfilter.c facilities to implement a kill language
 resembling that of rn.
 
+   Commands that match only the Subject line are declared to lnfilter through
+lnclasses(), so the RE of such a command is tried only on articles whose
+subject (folded to lower case unless the c modifier is given) contains the
+literal part of the RE.
+
 AUTHOR
    Eric S. Raymond.
    This software is Copyright (C) 1989 by Eric S. Raymond for the sole purpose
@@ -30,6 +35,68 @@ of protecting free redistribution; see the LICENSE file for details.
 #define L_HEADER    1	/* match any header */
 #define L_TEXT	    2	/* match anywhere in text or header */
 
+/* text classes for lnclasses(), so lnfilter can prefilter subject commands */
+#define C_SUBJECT   1	/* the Subject line as is */
+#define C_FOLDED    2	/* the Subject line forced to lower case */
+
+private char *rnmode(cmd, levelp, caseblindp)
+/* crack the modifiers of a command, return the action part */
+char	*cmd;
+int	*levelp;
+bool	*caseblindp;
+{
+    /* skip the // RE-delimiter pair */
+    cmd += 3;
+
+    /* determine the level of the desired match */
+    *levelp = L_SUBJECT;
+    *caseblindp = TRUE;
+    if (strchr(cmd, ':'))
+    {
+	for (; *cmd != ':'; cmd++)
+	    if (*cmd == 'h')
+		*levelp = L_HEADER;
+	    else if (*cmd == 'a')
+		*levelp = L_TEXT;
+	    else if (*cmd == 'c')
+		*caseblindp = FALSE;
+	cmd++;
+    }
+    return(cmd);
+}
+
+private int rnclass(cmd)
+/* tell lnfilter what text a command's RE will be matched against */
+char	*cmd;
+{
+    bool	caseblind;
+    int		level;
+
+    if (strlen(cmd) < 3)
+	return(0);
+    else if (cmd[3] == '\0')
+	return(C_SUBJECT);	/* the fast simple case in rnscore() */
+    (void) rnmode(cmd, &level, &caseblind);
+    if (level != L_SUBJECT)
+	return(0);
+    return(caseblind ? C_FOLDED : C_SUBJECT);
+}
+
+private char *rntext(class, hp)
+/* fetch the text of a class for lnfilter's prefilter */
+int	class;
+hdr_t	*hp;
+{
+    static char	folded[LBUFLEN];
+
+    if (class == C_SUBJECT)
+	return(hp->h_subject);
+    (void) strncpy(folded, hp->h_subject, sizeof(folded) - 1);
+    folded[sizeof(folded) - 1] = '\0';
+    lcase(folded);
+    return(folded);
+}
+
 private int rnscore(re, cmd, grp, hp)
 /* kill language interpreter */
 regexp	*re;	/* compiled RE from pattern part of command */
@@ -44,27 +111,12 @@ hdr_t	*hp;	/* header of article to be scored (NULL for group scoring) */
     if (hp == (hdr_t *)NULL)
 	return(0);
 
-    /* OK, we're scoring an article, skip the // RE-delimiter pair */
-    cmd += 3;
-
     /* handle the fast simple case first */
-    if (*cmd == '\0')
+    if (strlen(cmd) <= 3)
 	return(regexec(re, hp->h_subject) ? -1 : 0);
 
-    /* determine the level of the desired match */
-    level = L_SUBJECT;
-    caseblind = TRUE;
-    if (strchr(cmd, ':'))
-    {
-	for (; *cmd != ':'; cmd++)
-	    if (*cmd == 'h')
-		level = L_HEADER;
-	    else if (*cmd == 'a')
-		level = L_TEXT;
-	    else if (*cmd == 'c')
-		caseblind = FALSE;
-	cmd++;
-    }
+    /* OK, we're scoring an article, see what kind of match is wanted */
+    cmd = rnmode(cmd, &level, &caseblind);
 
     /* go to it */
     if (level == L_TEXT || level == L_HEADER)
@@ -87,10 +139,10 @@ hdr_t	*hp;	/* header of article to be scored (NULL for group scoring) */
     else    /* we only need to look at one header line, don't fetch article */
     {
 	if (!caseblind)
-	    match = regexec(re, header.h_subject);
+	    match = regexec(re, hp->h_subject);
 	else
 	{
-	    (void) strcpy(bfr, header.h_subject);
+	    (void) strcpy(bfr, hp->h_subject);
 	    lcase(bfr);
 	    match = regexec(re, bfr);
 	}
@@ -127,6 +179,7 @@ main(argc, argv)
 int argc;
 char *argv[];
 {
+    lnclasses(rnclass, rntext);
     return(lnfilter("rnkill",RNKILLV, rnscore, cmdproc, argc,argv));
 }
 
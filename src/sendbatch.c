@@ -11,9 +11,15 @@ DESCRIPTION
 If a list of system names is given on the command, only those systems are sent
 to. The -x option overrides the tests for minimum uucp spool space available
 and uucp queue length, forcing transmission.
-   The A, B, C, D, E, N, Q, S, U, V and X transmission options are interpreted
-when sending batches from here. Special arrangements are made to do N and Q;
-the others are handed off to the lower level routines in transmit.c.
+   The A, B, C, D, E, N, Q, S, T, U, V and X transmission options are
+interpreted when sending batches from here. Special arrangements are made to
+do N, Q and T; the others are handed off to the lower level routines in
+transmit.c.
+   A link with the T"nntp" option doesn't need B, and isn't batched at all.
+The IDs in its batch file are offered one by one to the feed's news server
+through nntpfeed(), down a single streaming connection, and the UUCP queue and
+spool space checks are skipped. Articles the server defers are put back in
+the batch file for the next run.
    The format sendbatch emits is the standard one, i.e.
 
         #! aaaa
@@ -40,6 +46,7 @@ NOTE
 
 main
   newsbatch	    -- send all batched news to a given system
+    nntpbatch	    -- stream the articles in a batch file to an NNTP link
     uuq		    -- check for UUCP queue overflow
     df		    -- check for sufficient spool space
     uuxbatch	    -- transmit batches implied by a batch file
@@ -280,7 +287,7 @@ char	*target;	/* system list to send to */
 feed_t  *sp;            /* data on the link */
 {
     register char *cp, *tp;
-    forward void redirect(), uuxbatch();
+    forward void redirect(), uuxbatch(), nntpbatch();
     off_t maxbytes, qlen, spoolmin;
 
     /* Find the batch list at BATCH/<system(s)>... */
@@ -288,9 +295,20 @@ feed_t  *sp;            /* data on the link */
 
     /*
      * ...so we can exclusive-lock it. This may involve waiting on
-     * another sendbatch to let go of it.
+     * another sendbatch to let go of it. The lock is on the name,
+     * not the file, because the file gets renamed away as we work.
      */
-    (void) filelock(batchname);
+    rlock(R_BATCH, batchname);
+
+    /* NNTP links don't go through UUCP, so none of the checks below apply */
+    if (!fileg && nntplink(sp))
+    {
+	if (verbose >= V_SHOWSYS)
+	    (void) fprintf(stderr, "Streaming to system %s\n", target);
+	nntpbatch(sp, batchname);
+	runlock(R_BATCH, batchname);
+	return;
+    }
 
     /* check that all UUCP queues for target systems are below threshold */
     if (!nochk && (cp = s_option(sp, 'Q')))
@@ -301,6 +319,7 @@ feed_t  *sp;            /* data on the link */
 	    {
 		logerr3("Can't batch to %s, %s uucp queue is %ld",
 			target, tp, qlen);
+		runlock(R_BATCH, batchname);
 		return;
 	    }
 	} while
@@ -311,6 +330,7 @@ feed_t  *sp;            /* data on the link */
 	&& maxbytes < (spoolmin = atoi(newsattr("spoolmin", SPOOLMIN))))
     {
         logerr1("Can't batch to %s, too low on uucp spool space", target);
+	runlock(R_BATCH, batchname);
         return;
     }
 
@@ -321,6 +341,7 @@ feed_t  *sp;            /* data on the link */
     if ((cp = s_option(sp, 'B')) == (char *)NULL)
     {
         logerr1("Batching not enabled for system(s) %s", target);
+	runlock(R_BATCH, batchname);
         return;
     }
 
@@ -334,7 +355,69 @@ feed_t  *sp;            /* data on the link */
     uuxbatch(target, sp, batchname, maxbytes);
 
     /* we're done, release the batch file */
-    (void) fileunlock(batchname);
+    runlock(R_BATCH, batchname);
+}
+
+private void nntpbatch(sp, batchfile)
+/* offer the articles listed in a batch file to an NNTP feed */
+feed_t	*sp;		/* the feed */
+char	*batchfile;	/* the file */
+{
+    char	linbuf[BUFLEN], *fname, *cp;
+    FILE	*fp;
+
+#ifdef DEBUG
+    if (debug)		/* so we can test without news permissions */
+	(void) strcpy(workfile, batchfile);
+    else
+#endif /* DEBUG */
+    {
+	/* as in uuxbatch(), a leftover work file is from a crashed run */
+	(void) sprintf(workfile, "%s.work", batchfile);
+	if (access(workfile, F_OK) < 0)
+	{
+	    if (access(batchfile, F_OK) < 0 && errno == ENOENT)
+		return;	/* no news */
+	    if (rename(batchfile, workfile) < 0)
+	    {
+		logerr3("rename(%s,%s) %s",
+			sp->s_name, workfile, sys_errlist[errno]);
+		return;
+	    }
+	}
+    }
+    if ((fp = fopen(workfile, "r")) == (FILE *)NULL)
+    {
+	logerr2("fopen(%s,r) %s", workfile, sys_errlist[errno]);
+	return;
+    }
+
+    while (fgets(linbuf, sizeof(linbuf), fp) != (char *)NULL)
+    {
+	/* per-article directives after the ID mean nothing to NNTP */
+	for (cp = linbuf; *cp && !isspace(*cp); cp++)
+	    continue;
+	*cp = '\0';
+	if (linbuf[0] == '\0')
+	    continue;
+
+	if ((fname = hstfile(linbuf)) == (char *)NULL)
+	    logerr1("no copy of %s available", linbuf);
+	else
+	{
+	    if (verbose >= V_SHOWPARTS)
+		(void) fprintf(stderr, "sendbatch: offering %s\n", linbuf);
+	    (void) nntpfeed(sp, linbuf, fname);
+	}
+    }
+    (void) fclose(fp);
+
+    /* wait for the last responses, deferred articles go back in batchfile */
+    nntpfdone(sp->s_name);
+#ifdef DEBUG
+    if (!debug)
+#endif /* DEBUG */
+	(void) unlink(workfile);
 }
 
 /*
@@ -568,6 +651,7 @@ int status;
     (void) unlink(batch);
     (void) unlink(outfile);
     unlock();
+    lockstats();
     exit(status);
 }
 
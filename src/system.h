@@ -95,6 +95,16 @@ typedef int iolen_t;		/* use this to cast read()/write() lengths */
 #endif /* !v7 */
 #endif
 
+/* get memory-mapped file calls if we have them */
+#ifdef MMAP
+#include <sys/mman.h>
+#endif /* MMAP */
+
+/* get scatter/gather I/O if we have it */
+#ifdef WRITEV
+#include <sys/uio.h>
+#endif /* WRITEV */
+
 /* find time types */
 #if defined(BSD4_2) || defined(BSD4_1C)
 #include <sys/time.h>
@@ -20,6 +20,12 @@ etc. For each article in the batch, the code calls the given post function with
 the header global loaded with the article information. If outfd is nonzero, the
 article's generated ID is written to outfd as each article is posted.
 
+   As the splitter reads its way through each article's body looking for the
+next batch line, it hands the text to ckupdate() (see checksum.c), and the
+body's fingerprint is left in the header's h_bodysum field for the post
+function. So post() can log it for duplicate-body and spool integrity checks
+without reading the article again.
+
    The format accepted is the standard one, i.e.
 
 	# {rnews|unbatch|cunbatch|c7unbatch}
@@ -56,6 +62,7 @@ of protecting free redistribution; see the LICENSE file for details.
 #include "news.h"
 #include "libpriv.h"
 #include "header.h"
+#include "checksum.h"
 
 /*
  * Here is everything the program knows about batch line format.
@@ -370,6 +377,7 @@ FILE	*msgin;	    /* the input source */
     static long	expect = 0L;	/* size of next batch section */
     bool	foundhdr;	/* message ended by a batch header? */
     char	inbuf[BUFLEN];	/* article file input buffer */
+    cksum_t	body;		/* fingerprint of the body so far */
 
     inbuf[0] = '\0';
     if (bflag)
@@ -409,9 +417,10 @@ FILE	*msgin;	    /* the input source */
 	(void) printf("just read header of %s\n", header.h_ident);
 #endif /* DEBUG */
 
-    /* now skip the text part */
+    /* now skip the text part, fingerprinting it as we go */
     lcount = 0;
     foundhdr = FALSE;
+    ckinit(&body);
     do {
 #ifdef ZAPNOTES
 	/* discard leading notesfile IDs (if any), mung header accordingly */
@@ -437,8 +446,12 @@ FILE	*msgin;	    /* the input source */
 	    lcount++;
 	else
 	    break;		/* length checks will catch any problems */
+	if (bflag && (foundhdr = BATCHLINE(inbuf)))
+	    break;
+	ckupdate(&body, inbuf, strlen(inbuf));
     } while
-	(!bflag || !(foundhdr = BATCHLINE(inbuf)));
+	(TRUE);
+    (void) ckfinal(&body, header.h_bodysum);
     header.h_endoff = ftell(msgin);
     if (foundhdr)
     {
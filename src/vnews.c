@@ -488,7 +488,12 @@ int	icount;	/* NZ if on keyboard wait, 0 on timer tick interrupt */
     if (icount == 0)
 	clockdaemon(wrnewsrc, asave * SAVESECS);
     else
+    {
 	subjadd();	/* compile more index information */
+#ifdef PREFETCH
+	msgprefetch();	/* read ahead in the direction we're going */
+#endif /* PREFETCH */
+    }
 }
 
 static bool vexpand(cgetf, cungetf, buf)
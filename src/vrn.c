@@ -537,10 +537,16 @@ char *argv[];
     /*NOTREACHED*/
 }
 
-private void tick()
+private void tick(icount)
 /* function to call at tick intervals */
+int	icount;	/* NZ if on keyboard wait, 0 on timer tick interrupt */
 {
-    clockdaemon(wrnewsrc, asave * SAVESECS);
+    if (icount == 0)
+	clockdaemon(wrnewsrc, asave * SAVESECS);
+#ifdef PREFETCH
+    else
+	msgprefetch();	/* read ahead in the direction we're going */
+#endif /* PREFETCH */
 }
 
 static bool vexpand(cgetf, cungetf, buf)